@@ -0,0 +1,172 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SDL.h"
+
+#include "Headless.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+namespace dae
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		// Roughly how many cores one frame keeps busy through its serial parts, picks the default frames in flight
+		constexpr int g_CoresPerFrame{ 16 };
+		constexpr int g_MaxFramesInFlight{ 8 };
+
+		// Everything one frame in flight needs, only the scene's mesh buffers are shared (the first slot's, see Scene::InitializeInstance)
+		struct FrameSlot
+		{
+			std::unique_ptr<HeadlessRenderer> pTarget{};
+			std::unique_ptr<Scene> pScene{};
+			std::unique_ptr<Timer> pTimer{};
+		};
+
+		struct FrameResult
+		{
+			bool isWritten{};
+			int slot{};
+			float updateMs{};
+			float traceMs{};
+			float writeMs{};
+		};
+
+		float MillisecondsBetween(Clock::time_point start, Clock::time_point end)
+		{
+			return std::chrono::duration<float, std::milli>(end - start).count();
+		}
+	}
+
+	int Animation::RenderBatch(const Settings& settings)
+	{
+		const int frameCount{ settings.lastFrame - settings.firstFrame + 1 };
+		if (frameCount <= 0 || settings.frameRate <= 0.f)
+		{
+			std::cout << "Animation: empty frame range\n";
+			return 1;
+		}
+
+		const int coreCount{ static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) };
+		const int slotCount{ std::min(frameCount, settings.framesInFlight > 0 ? settings.framesInFlight : std::clamp(coreCount / g_CoresPerFrame, 1, g_MaxFramesInFlight)) };
+
+		SDL_Init(SDL_INIT_VIDEO);
+
+		// Windows are created here on the main thread, the slots only tone map into their surfaces & never show them
+		std::vector<FrameSlot> slots(slotCount);
+		bool isReady{ true };
+		for (FrameSlot& slot : slots)
+		{
+			slot.pTarget = std::make_unique<HeadlessRenderer>("RayTracer - Animation", settings.width, settings.height);
+			slot.pScene.reset(CreateScene(settings.sceneName));
+			if (!slot.pTarget->IsValid() || !slot.pScene)
+			{
+				isReady = false;
+				break;
+			}
+
+			slot.pTimer = std::make_unique<Timer>();
+			slot.pScene->SetCameraInput(false);
+			// The first slot's scene is the prototype, the others only add their own transforms & BVHs on top of its meshes
+			if (&slot == &slots.front())
+				slot.pScene->Initialize();
+			else
+				slot.pScene->InitializeInstance(*slots.front().pScene);
+			slot.pTarget->GetRenderer().SetReflections(slot.pScene->GetReflectionsEnabled());
+		}
+
+		std::vector<FrameResult> results(frameCount);
+		float wallMs{};
+		if (isReady)
+		{
+			std::cout << "**ANIMATION** " << settings.sceneName << " frames " << settings.firstFrame << "-" << settings.lastFrame
+				<< " at " << settings.frameRate << " fps, " << slotCount << " in flight on " << coreCount << " cores\n";
+
+			// Frames are handed out in order as slots free up, so a slow frame doesn't hold up the others
+			std::atomic<int> nextFrame{ settings.firstFrame };
+			const Clock::time_point batchStart{ Clock::now() };
+			const auto renderFrames = [&](int slotIndex)
+				{
+					FrameSlot& slot{ slots[slotIndex] };
+					for (int frame{ nextFrame++ }; frame <= settings.lastFrame; frame = nextFrame++)
+					{
+						FrameResult& result{ results[frame - settings.firstFrame] };
+						result.slot = slotIndex;
+
+						const Clock::time_point updateStart{ Clock::now() };
+						slot.pTimer->SetTime(frame / settings.frameRate, 1.f / settings.frameRate);
+						slot.pScene->Update(slot.pTimer.get());
+						slot.pScene->SwapBuffers();
+
+						const Clock::time_point traceStart{ Clock::now() };
+						Renderer& renderer{ slot.pTarget->GetRenderer() };
+						renderer.Trace(slot.pScene.get());
+						renderer.SwapFrameBuffers();
+
+						const Clock::time_point writeStart{ Clock::now() };
+						renderer.ResolveFrame();
+						result.isWritten = ImageWriter::Write(renderer.CaptureFrame(settings.format,
+							ImageWriter::MakeFileName(settings.outputPrefix, static_cast<uint32_t>(frame), settings.format)));
+
+						const Clock::time_point end{ Clock::now() };
+						result.updateMs = MillisecondsBetween(updateStart, traceStart);
+						result.traceMs = MillisecondsBetween(traceStart, writeStart);
+						result.writeMs = MillisecondsBetween(writeStart, end);
+					}
+				};
+
+			// The first slot runs on this thread
+			std::vector<std::thread> threads{};
+			for (int slotIndex{ 1 }; slotIndex < slotCount; ++slotIndex)
+				threads.emplace_back(renderFrames, slotIndex);
+			renderFrames(0);
+			for (std::thread& thread : threads)
+				thread.join();
+			wallMs = MillisecondsBetween(batchStart, Clock::now());
+		}
+		else
+		{
+			std::cout << "Animation: can't render scene " << settings.sceneName << "\n";
+		}
+
+		// Back to front, the first slot's scene owns the meshes the others read
+		for (auto it{ slots.rbegin() }; it != slots.rend(); ++it)
+		{
+			it->pTarget.reset();
+			it->pScene.reset();
+		}
+		SDL_Quit();
+		if (!isReady)
+			return 1;
+
+		//--------- Report ---------
+		int writtenCount{};
+		float frameMsSum{};
+		for (int i{}; i < frameCount; ++i)
+		{
+			const FrameResult& result{ results[i] };
+			const float frameMs{ result.updateMs + result.traceMs + result.writeMs };
+			frameMsSum += frameMs;
+			writtenCount += result.isWritten;
+			std::cout << ">> Frame " << settings.firstFrame + i << " SLOT = " << result.slot << " UPDATE_MS = " << result.updateMs
+				<< " TRACE_MS = " << result.traceMs << " WRITE_MS = " << result.writeMs << " FRAME_MS = " << frameMs
+				<< (result.isWritten ? "" : " FAILED") << "\n";
+		}
+
+		// Overlap > 1 means frames in flight hid each other's serial parts
+		std::cout << ">> TOTAL_MS = " << wallMs << " FRAMES_PER_SECOND = " << frameCount * 1000.f / wallMs
+			<< " AVERAGE_FRAME_MS = " << frameMsSum / frameCount << " OVERLAP = " << frameMsSum / wallMs << "\n";
+		std::cout << writtenCount << " of " << frameCount << " frames written\n";
+		return writtenCount == frameCount ? 0 : 1;
+	}
+}
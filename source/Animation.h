@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+#include "ImageWriter.h"
+
+namespace dae
+{
+	namespace Animation
+	{
+		struct Settings
+		{
+			// One of the built-in scenes (see GetBuiltInScenes)
+			std::string sceneName{ "W4_ReferenceScene" };
+			// Inclusive, frame n shows the scene at n / frameRate seconds
+			int firstFrame{ 0 };
+			int lastFrame{ 59 };
+			float frameRate{ 30.f };
+
+			int width{ 640 };
+			int height{ 480 };
+			// Animation_00042.png
+			std::string outputPrefix{ "Animation" };
+			ImageFormat format{ ImageFormat::PNG };
+
+			// Frames traced at the same time, each with a renderer & animated scene state of its own (mesh buffers are shared). 0 picks one from the core count
+			int framesInFlight{ 0 };
+		};
+
+		/**
+		 * \brief Headless batch render of a frame range at a fixed time step
+		 * The scene is updated from the frame's time only (no wall clock, no camera input), so a frame always looks the same
+		 * no matter which other frames were rendered before it or on which worker
+		 * A frame's update, BVH rebuild & image encode are mostly serial, with several frames in flight another frame's tiles fill those gaps.
+		 * All of them share the one thread pool
+		 * Per frame & total timings go to the console
+		 * \return 0 when every frame was written, 1 otherwise (usable as a process exit code)
+		 */
+		int RenderBatch(const Settings& settings);
+	}
+}
@@ -94,5 +94,69 @@ namespace dae
 			return GeometryFunction_SchlickGGX(n, v, roughness) * GeometryFunction_SchlickGGX(n, l, roughness);
 		}
 
+		// Importance sampling for the path tracer, directions point away from the surface & n is on their side
+
+		/**
+		 * \brief Orthonormal basis around a normal (Duff et al. - Building an Orthonormal Basis, Revisited)
+		 */
+		static void GetBasis(const Vector3& n, Vector3& tangent, Vector3& bitangent)
+		{
+			const float sign{ std::copysign(1.0f, n.z) };
+			const float a{ -1.0f / (sign + n.z) };
+			const float b{ n.x * n.y * a };
+			tangent = Vector3{ 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+			bitangent = Vector3{ b, sign + n.y * n.y * a, -n.y };
+		}
+
+		/**
+		 * \brief Cosine weighted direction on the hemisphere, matches the Lambert cosine law
+		 * \param u1, u2 Uniform samples in [0, 1)
+		 * \return Direction with pdf CosineHemispherePdf
+		 */
+		static Vector3 SampleCosineHemisphere(const Vector3& n, float u1, float u2)
+		{
+			Vector3 tangent{}, bitangent{};
+			GetBasis(n, tangent, bitangent);
+			const float radius{ sqrtf(u1) };
+			const float phi{ PI_2 * u2 };
+			return tangent * (radius * cosf(phi)) + bitangent * (radius * sinf(phi)) + n * sqrtf(std::max(0.0f, 1.0f - u1));
+		}
+
+		static float CosineHemispherePdf(const Vector3& n, const Vector3& l)
+		{
+			return std::max(0.0f, Vector3::Dot(n, l)) * DIV_PI;
+		}
+
+		/**
+		 * \brief Half vector distributed like NormalDistribution_GGX * cos, same roughness remapping
+		 * \param u1, u2 Uniform samples in [0, 1)
+		 * \return Normalized half vector, reflect the view direction around it to get the light direction
+		 */
+		static Vector3 SampleGGXHalfVector(const Vector3& n, float roughness, float u1, float u2)
+		{
+			const float a{ roughness * roughness };
+			const float cosTheta{ sqrtf((1.0f - u1) / (1.0f + (a * a - 1.0f) * u1)) };
+			const float sinTheta{ sqrtf(std::max(0.0f, 1.0f - cosTheta * cosTheta)) };
+			const float phi{ PI_2 * u2 };
+
+			Vector3 tangent{}, bitangent{};
+			GetBasis(n, tangent, bitangent);
+			return tangent * (sinTheta * cosf(phi)) + bitangent * (sinTheta * sinf(phi)) + n * cosTheta;
+		}
+
+		/**
+		 * \param v Direction towards the viewer
+		 * \param l Sampled direction, v reflected around a SampleGGXHalfVector half vector
+		 * \return Pdf of l, D * nDotH / (4 * vDotH)
+		 */
+		static float GGXReflectionPdf(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
+		{
+			const Vector3 halfVector{ (v + l).Normalized() };
+			const float vDotH{ Vector3::Dot(v, halfVector) };
+			if (vDotH <= 0.0f)
+				return 0.0f;
+			return NormalDistribution_GGX(n, halfVector, roughness) * std::max(0.0f, Vector3::Dot(n, halfVector)) / (4.0f * vDotH);
+		}
+
 	}
 }
\ No newline at end of file
@@ -0,0 +1,539 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		// Triangles per parallel task for the flat passes
+		constexpr uint32_t g_ChunkSize{ 4096 };
+		// Subtrees smaller than this are built on the current thread, task overhead beats the gain below it
+		constexpr uint32_t g_ParallelThreshold{ 4096 };
+
+		// Binned SAH
+		constexpr uint32_t g_BinCount{ 16 };
+		constexpr float g_TraversalCost{ 1.f };
+		// Bigger leaves are always split, even when the SAH would rather keep them (lots of overlapping triangles)
+		constexpr uint32_t g_MaxLeafSize{ 8 };
+
+		// LBVH
+		constexpr uint32_t g_RadixBits{ 8 };
+		constexpr uint32_t g_RadixSize{ 1 << g_RadixBits };
+
+		template<typename Func>
+		void ParallelChunks(uint32_t count, Func&& func)
+		{
+			const uint32_t chunkCount{ (count + g_ChunkSize - 1) / g_ChunkSize };
+			concurrency::parallel_for(0u, chunkCount, [&](uint32_t chunk)
+				{
+					func(chunk, chunk * g_ChunkSize, std::min(count, (chunk + 1) * g_ChunkSize));
+				});
+		}
+
+		float SurfaceArea(const Vector3& minAABB, const Vector3& maxAABB)
+		{
+			const Vector3 extent{ maxAABB - minAABB };
+			if (extent.x < 0.f || extent.y < 0.f || extent.z < 0.f)
+				return 0.f;
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+
+		// Spreads the lower 10 bits so there are 2 zero bits between each of them
+		uint32_t ExpandBits(uint32_t v)
+		{
+			v = (v * 0x00010001u) & 0xFF0000FFu;
+			v = (v * 0x00000101u) & 0x0F00F00Fu;
+			v = (v * 0x00000011u) & 0xC30C30C3u;
+			v = (v * 0x00000005u) & 0x49249249u;
+			return v;
+		}
+	}
+
+	const char* ToString(BVHBuilder builder)
+	{
+		switch (builder)
+		{
+		case BVHBuilder::BinnedSAH: return "BinnedSAH";
+		case BVHBuilder::LBVH: return "LBVH";
+		default: return "None";
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, const BVHBuildReport& report)
+	{
+		os << "BVH (" << ToString(report.builder) << "): " << report.triangleCount << " triangles, build = " << report.buildMs << " ms"
+			<< " | " << report.nodeCount << " nodes, " << report.leafCount << " leaves (avg " << report.averageLeafSize << " triangles)"
+			<< ", depth = " << report.maxDepth << ", SAH cost = " << report.sahCost;
+		return os;
+	}
+
+	void BVH::Build(BVHBuilder builder, const Vector3* pPositions, const int* pIndices, uint32_t triangleCount)
+	{
+		const auto start{ std::chrono::high_resolution_clock::now() };
+
+		Clear();
+		m_Builder = builder;
+		if (builder == BVHBuilder::None || triangleCount == 0)
+			return;
+
+		PrepareTriangles(pPositions, pIndices, triangleCount);
+
+		// A binary tree with one triangle per leaf is as big as it gets
+		m_Nodes.resize(2 * triangleCount - 1);
+		if (builder == BVHBuilder::BinnedSAH)
+			BuildBinnedSAH();
+		else
+			BuildLBVH();
+		// Shrinking keeps the capacity, the next build reuses it
+		m_Nodes.resize(m_NodesUsed);
+
+		m_BuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void BVH::Clear()
+	{
+		m_Nodes.clear();
+		m_TriangleIndices.clear();
+		m_NodesUsed = 0;
+		m_BuildMs = 0.0;
+	}
+
+	void BVH::PrepareTriangles(const Vector3* pPositions, const int* pIndices, uint32_t triangleCount)
+	{
+		m_TriangleMin.resize(triangleCount);
+		m_TriangleMax.resize(triangleCount);
+		m_Centroids.resize(triangleCount);
+		m_TriangleIndices.resize(triangleCount);
+
+		ParallelChunks(triangleCount, [&](uint32_t, uint32_t first, uint32_t last)
+			{
+				for (uint32_t i{ first }; i < last; ++i)
+				{
+					const Vector3& v0{ pPositions[pIndices[3 * i]] };
+					const Vector3& v1{ pPositions[pIndices[3 * i + 1]] };
+					const Vector3& v2{ pPositions[pIndices[3 * i + 2]] };
+
+					m_TriangleMin[i] = Vector3::Min(v0, Vector3::Min(v1, v2));
+					m_TriangleMax[i] = Vector3::Max(v0, Vector3::Max(v1, v2));
+					m_Centroids[i] = (m_TriangleMin[i] + m_TriangleMax[i]) * 0.5f;
+					m_TriangleIndices[i] = i;
+				}
+			});
+	}
+
+#pragma region Binned SAH
+	void BVH::BuildBinnedSAH()
+	{
+		m_NodesUsed = 1;
+		SubdivideSAH(0, 0, static_cast<uint32_t>(m_TriangleIndices.size()), 0);
+	}
+
+	void BVH::SubdivideSAH(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+	{
+		// m_Nodes is sized up front, so this stays valid while other tasks fill in their part of the tree
+		BVHNode& node{ m_Nodes[nodeIndex] };
+
+		node.minAABB = { FLT_MAX, FLT_MAX, FLT_MAX };
+		node.maxAABB = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		Vector3 centroidMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+		Vector3 centroidMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i{ first }; i < first + count; ++i)
+		{
+			const uint32_t triangle{ m_TriangleIndices[i] };
+			node.minAABB = Vector3::Min(node.minAABB, m_TriangleMin[triangle]);
+			node.maxAABB = Vector3::Max(node.maxAABB, m_TriangleMax[triangle]);
+			centroidMin = Vector3::Min(centroidMin, m_Centroids[triangle]);
+			centroidMax = Vector3::Max(centroidMax, m_Centroids[triangle]);
+		}
+		node.leftFirst = first;
+		node.triangleCount = count;
+
+		if (count == 1 || depth + 1 >= MaxDepth)
+			return;
+
+		//--------- Find the cheapest bin boundary over all 3 axes ---------
+		struct Bin
+		{
+			Vector3 minAABB{ FLT_MAX, FLT_MAX, FLT_MAX };
+			Vector3 maxAABB{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			uint32_t count{};
+		};
+
+		// Costs aren't divided by the node's area, that way flat nodes (area 0) still compare correctly
+		float bestCost{ FLT_MAX };
+		int bestAxis{ -1 };
+		uint32_t bestSplit{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float extent{ centroidMax[axis] - centroidMin[axis] };
+			if (extent <= 0.f)
+				continue;
+
+			Bin bins[g_BinCount]{};
+			const float scale{ g_BinCount / extent };
+			for (uint32_t i{ first }; i < first + count; ++i)
+			{
+				const uint32_t triangle{ m_TriangleIndices[i] };
+				Bin& bin{ bins[std::min(static_cast<uint32_t>((m_Centroids[triangle][axis] - centroidMin[axis]) * scale), g_BinCount - 1)] };
+				bin.minAABB = Vector3::Min(bin.minAABB, m_TriangleMin[triangle]);
+				bin.maxAABB = Vector3::Max(bin.maxAABB, m_TriangleMax[triangle]);
+				++bin.count;
+			}
+
+			// Sweep from the left, then from the right, split s puts bins [0, s) on the left
+			float leftCost[g_BinCount]{};
+			uint32_t leftCount[g_BinCount]{};
+			Bin accumulated{};
+			for (uint32_t split{ 1 }; split < g_BinCount; ++split)
+			{
+				const Bin& bin{ bins[split - 1] };
+				accumulated.minAABB = Vector3::Min(accumulated.minAABB, bin.minAABB);
+				accumulated.maxAABB = Vector3::Max(accumulated.maxAABB, bin.maxAABB);
+				accumulated.count += bin.count;
+				leftCount[split] = accumulated.count;
+				leftCost[split] = accumulated.count * SurfaceArea(accumulated.minAABB, accumulated.maxAABB);
+			}
+
+			accumulated = {};
+			for (uint32_t split{ g_BinCount - 1 }; split > 0; --split)
+			{
+				const Bin& bin{ bins[split] };
+				accumulated.minAABB = Vector3::Min(accumulated.minAABB, bin.minAABB);
+				accumulated.maxAABB = Vector3::Max(accumulated.maxAABB, bin.maxAABB);
+				accumulated.count += bin.count;
+
+				if (leftCount[split] == 0 || accumulated.count == 0)
+					continue;
+
+				const float cost{ leftCost[split] + accumulated.count * SurfaceArea(accumulated.minAABB, accumulated.maxAABB) };
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		//--------- Split or keep as leaf ---------
+		const float nodeArea{ SurfaceArea(node.minAABB, node.maxAABB) };
+		const float leafCost{ count * nodeArea };
+		const float splitCost{ g_TraversalCost * nodeArea + bestCost };
+
+		uint32_t leftCount{};
+		if (bestAxis == -1)
+		{
+			// All centroids in one spot, nothing to bin, halve the list if it's too big to test as a whole
+			if (count <= g_MaxLeafSize)
+				return;
+			leftCount = count / 2;
+		}
+		else
+		{
+			if (splitCost >= leafCost && count <= g_MaxLeafSize)
+				return;
+
+			// Same bin computation as above, so the counts match the chosen split exactly
+			const float extent{ centroidMax[bestAxis] - centroidMin[bestAxis] };
+			const float scale{ g_BinCount / extent };
+			const auto middle{ std::partition(m_TriangleIndices.begin() + first, m_TriangleIndices.begin() + first + count, [&](uint32_t triangle)
+				{
+					return std::min(static_cast<uint32_t>((m_Centroids[triangle][bestAxis] - centroidMin[bestAxis]) * scale), g_BinCount - 1) < bestSplit;
+				}) };
+			leftCount = static_cast<uint32_t>(middle - (m_TriangleIndices.begin() + first));
+		}
+
+		const uint32_t leftIndex{ std::atomic_ref<uint32_t>{ m_NodesUsed }.fetch_add(2, std::memory_order_relaxed) };
+		node.leftFirst = leftIndex;
+		node.triangleCount = 0;
+
+		const uint32_t rightCount{ count - leftCount };
+		if (count >= g_ParallelThreshold)
+		{
+			concurrency::parallel_invoke(
+				[&] { SubdivideSAH(leftIndex, first, leftCount, depth + 1); },
+				[&] { SubdivideSAH(leftIndex + 1, first + leftCount, rightCount, depth + 1); });
+		}
+		else
+		{
+			SubdivideSAH(leftIndex, first, leftCount, depth + 1);
+			SubdivideSAH(leftIndex + 1, first + leftCount, rightCount, depth + 1);
+		}
+	}
+#pragma endregion
+
+#pragma region LBVH
+	void BVH::BuildLBVH()
+	{
+		const uint32_t triangleCount{ static_cast<uint32_t>(m_TriangleIndices.size()) };
+		const uint32_t chunkCount{ (triangleCount + g_ChunkSize - 1) / g_ChunkSize };
+
+		//--------- Centroid bounds ---------
+		std::vector<Vector3> chunkMin(chunkCount);
+		std::vector<Vector3> chunkMax(chunkCount);
+		ParallelChunks(triangleCount, [&](uint32_t chunk, uint32_t first, uint32_t last)
+			{
+				Vector3 centroidMin{ FLT_MAX, FLT_MAX, FLT_MAX };
+				Vector3 centroidMax{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				for (uint32_t i{ first }; i < last; ++i)
+				{
+					centroidMin = Vector3::Min(centroidMin, m_Centroids[i]);
+					centroidMax = Vector3::Max(centroidMax, m_Centroids[i]);
+				}
+				chunkMin[chunk] = centroidMin;
+				chunkMax[chunk] = centroidMax;
+			});
+
+		Vector3 centroidMin{ chunkMin[0] };
+		Vector3 centroidMax{ chunkMax[0] };
+		for (uint32_t chunk{ 1 }; chunk < chunkCount; ++chunk)
+		{
+			centroidMin = Vector3::Min(centroidMin, chunkMin[chunk]);
+			centroidMax = Vector3::Max(centroidMax, chunkMax[chunk]);
+		}
+
+		//--------- 30 bit Morton codes, 10 bits per axis ---------
+		Vector3 scale{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float extent{ centroidMax[axis] - centroidMin[axis] };
+			scale[axis] = extent > 0.f ? 1024.f / extent : 0.f;
+		}
+
+		m_MortonCodes.resize(triangleCount);
+		ParallelChunks(triangleCount, [&](uint32_t, uint32_t first, uint32_t last)
+			{
+				for (uint32_t i{ first }; i < last; ++i)
+				{
+					uint32_t code{};
+					for (int axis{}; axis < 3; ++axis)
+					{
+						const uint32_t cell{ std::min(static_cast<uint32_t>(std::max((m_Centroids[i][axis] - centroidMin[axis]) * scale[axis], 0.f)), 1023u) };
+						code |= ExpandBits(cell) << (2 - axis);
+					}
+					m_MortonCodes[i] = code;
+				}
+			});
+
+		SortMortonCodes();
+
+		if (triangleCount == 1)
+		{
+			m_Nodes[0] = { m_TriangleMin[m_TriangleIndices[0]], m_TriangleMax[m_TriangleIndices[0]], 0, 1 };
+			m_NodesUsed = 1;
+			return;
+		}
+
+		//--------- Hierarchy, every internal node finds its own range & split (Karras 2012) ---------
+		// Node i's children are stored at 2i + 1 & 2i + 2, every node except the root is a child of exactly one internal node
+		// so that fills [1, 2n - 1) without any gaps or synchronization
+		const uint32_t internalCount{ triangleCount - 1 };
+		m_Parents.resize(internalCount + triangleCount);
+		m_OutputIndices.resize(internalCount + triangleCount);
+		m_VisitCounts.assign(internalCount, 0);
+		m_OutputIndices[0] = 0;
+
+		ParallelChunks(internalCount, [&](uint32_t, uint32_t first, uint32_t last)
+			{
+				for (uint32_t i{ first }; i < last; ++i)
+					BuildLBVHNode(i);
+			});
+
+		//--------- Bounds, bottom up ---------
+		// The second child to arrive at a node merges both children's bounds, the first one stops there
+		ParallelChunks(triangleCount, [&](uint32_t, uint32_t first, uint32_t last)
+			{
+				for (uint32_t leaf{ first }; leaf < last; ++leaf)
+				{
+					uint32_t id{ internalCount + leaf };
+					const uint32_t triangle{ m_TriangleIndices[leaf] };
+					m_Nodes[m_OutputIndices[id]] = { m_TriangleMin[triangle], m_TriangleMax[triangle], leaf, 1 };
+
+					while (id != 0)
+					{
+						const uint32_t parent{ m_Parents[id] };
+						// acq_rel, so the sibling subtree written by the other thread is visible here
+						if (std::atomic_ref<uint32_t>{ m_VisitCounts[parent] }.fetch_add(1, std::memory_order_acq_rel) == 0)
+							break;
+
+						const BVHNode& left{ m_Nodes[2 * parent + 1] };
+						const BVHNode& right{ m_Nodes[2 * parent + 2] };
+						m_Nodes[m_OutputIndices[parent]] = { Vector3::Min(left.minAABB, right.minAABB), Vector3::Max(left.maxAABB, right.maxAABB), 2 * parent + 1, 0 };
+						id = parent;
+					}
+				}
+			});
+
+		m_NodesUsed = internalCount + triangleCount;
+	}
+
+	void BVH::SortMortonCodes()
+	{
+		// LSD radix sort of (code, triangle) pairs, 4 passes of 8 bits
+		// Every chunk counts its digits, an exclusive scan over (digit, chunk) gives each chunk its own stable output range
+		const uint32_t count{ static_cast<uint32_t>(m_MortonCodes.size()) };
+		const uint32_t chunkCount{ (count + g_ChunkSize - 1) / g_ChunkSize };
+
+		m_SortCodes.resize(count);
+		m_SortIndices.resize(count);
+		m_Histograms.resize(chunkCount * g_RadixSize);
+
+		uint32_t* pSourceCodes{ m_MortonCodes.data() };
+		uint32_t* pSourceIndices{ m_TriangleIndices.data() };
+		uint32_t* pDestinationCodes{ m_SortCodes.data() };
+		uint32_t* pDestinationIndices{ m_SortIndices.data() };
+
+		for (uint32_t shift{}; shift < 32; shift += g_RadixBits)
+		{
+			ParallelChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last)
+				{
+					uint32_t* pHistogram{ &m_Histograms[chunk * g_RadixSize] };
+					std::fill(pHistogram, pHistogram + g_RadixSize, 0);
+					for (uint32_t i{ first }; i < last; ++i)
+						++pHistogram[(pSourceCodes[i] >> shift) & (g_RadixSize - 1)];
+				});
+
+			uint32_t offset{};
+			for (uint32_t digit{}; digit < g_RadixSize; ++digit)
+			{
+				for (uint32_t chunk{}; chunk < chunkCount; ++chunk)
+				{
+					uint32_t& bucket{ m_Histograms[chunk * g_RadixSize + digit] };
+					const uint32_t bucketCount{ bucket };
+					bucket = offset;
+					offset += bucketCount;
+				}
+			}
+
+			ParallelChunks(count, [&](uint32_t chunk, uint32_t first, uint32_t last)
+				{
+					uint32_t* pOffsets{ &m_Histograms[chunk * g_RadixSize] };
+					for (uint32_t i{ first }; i < last; ++i)
+					{
+						const uint32_t destination{ pOffsets[(pSourceCodes[i] >> shift) & (g_RadixSize - 1)]++ };
+						pDestinationCodes[destination] = pSourceCodes[i];
+						pDestinationIndices[destination] = pSourceIndices[i];
+					}
+				});
+
+			std::swap(pSourceCodes, pDestinationCodes);
+			std::swap(pSourceIndices, pDestinationIndices);
+		}
+		// An even pass count leaves the sorted result back in m_MortonCodes & m_TriangleIndices
+		static_assert((32 / g_RadixBits) % 2 == 0);
+	}
+
+	void BVH::BuildLBVHNode(uint32_t internalIndex)
+	{
+		const int64_t count{ static_cast<int64_t>(m_MortonCodes.size()) };
+		const int64_t i{ internalIndex };
+
+		// Length of the common prefix of the keys at i & j, duplicate codes fall back on the index so every key is unique
+		const auto delta{ [&](int64_t j) -> int
+			{
+				if (j < 0 || j >= count)
+					return -1;
+				const uint32_t codeI{ m_MortonCodes[i] };
+				const uint32_t codeJ{ m_MortonCodes[j] };
+				if (codeI == codeJ)
+					return 32 + std::countl_zero(static_cast<uint32_t>(i ^ j));
+				return std::countl_zero(codeI ^ codeJ);
+			} };
+
+		// Direction of the range, towards the neighbour sharing the longest prefix
+		const int64_t direction{ delta(i + 1) - delta(i - 1) >= 0 ? 1 : -1 };
+		const int deltaMin{ delta(i - direction) };
+
+		// Upper bound for the range length, then binary search the exact other end
+		int64_t maxLength{ 2 };
+		while (delta(i + maxLength * direction) > deltaMin)
+			maxLength *= 2;
+
+		int64_t length{};
+		for (int64_t step{ maxLength / 2 }; step >= 1; step /= 2)
+		{
+			if (delta(i + (length + step) * direction) > deltaMin)
+				length += step;
+		}
+		const int64_t j{ i + length * direction };
+
+		// Binary search the split, the last key that still shares more than the range's common prefix with i
+		const int deltaNode{ delta(j) };
+		int64_t split{};
+		for (int64_t divisor{ 2 };; divisor *= 2)
+		{
+			const int64_t step{ (length + divisor - 1) / divisor };
+			if (delta(i + (split + step) * direction) > deltaNode)
+				split += step;
+			if (step == 1)
+				break;
+		}
+		const uint32_t gamma{ static_cast<uint32_t>(i + split * direction + std::min<int64_t>(direction, 0)) };
+
+		// Ranges of a single key are leaves
+		const uint32_t internalCount{ static_cast<uint32_t>(count - 1) };
+		const uint32_t leftId{ std::min(i, j) == int64_t(gamma) ? internalCount + gamma : gamma };
+		const uint32_t rightId{ std::max(i, j) == int64_t(gamma) + 1 ? internalCount + gamma + 1 : gamma + 1 };
+
+		m_Parents[leftId] = internalIndex;
+		m_Parents[rightId] = internalIndex;
+		m_OutputIndices[leftId] = 2 * internalIndex + 1;
+		m_OutputIndices[rightId] = 2 * internalIndex + 2;
+	}
+#pragma endregion
+
+	BVHBuildReport BVH::GetReport() const
+	{
+		BVHBuildReport report{};
+		report.builder = m_Builder;
+		report.buildMs = m_BuildMs;
+		report.triangleCount = static_cast<uint32_t>(m_TriangleIndices.size());
+		report.nodeCount = static_cast<uint32_t>(m_Nodes.size());
+		if (m_Nodes.empty())
+			return report;
+
+		const float rootArea{ SurfaceArea(m_Nodes[0].minAABB, m_Nodes[0].maxAABB) };
+		const double invRootArea{ rootArea > 0.f ? 1.0 / rootArea : 0.0 };
+		double sahCost{};
+
+		std::vector<std::pair<uint32_t, uint32_t>> stack{ { 0u, 1u } };
+		while (!stack.empty())
+		{
+			const auto [nodeIndex, depth] { stack.back() };
+			stack.pop_back();
+
+			const BVHNode& node{ m_Nodes[nodeIndex] };
+			const double relativeArea{ SurfaceArea(node.minAABB, node.maxAABB) * invRootArea };
+			report.maxDepth = std::max(report.maxDepth, depth);
+			if (node.IsLeaf())
+			{
+				++report.leafCount;
+				sahCost += relativeArea * node.triangleCount;
+				continue;
+			}
+
+			sahCost += relativeArea * g_TraversalCost;
+			stack.push_back({ node.leftFirst, depth + 1 });
+			stack.push_back({ node.leftFirst + 1, depth + 1 });
+		}
+
+		report.averageLeafSize = float(report.triangleCount) / report.leafCount;
+		report.sahCost = float(sahCost);
+		return report;
+	}
+
+	size_t BVH::GetMemoryBytes() const
+	{
+		size_t bytes{ m_Nodes.capacity() * sizeof(BVHNode) };
+		for (const std::vector<Vector3>* pBuffer : { &m_TriangleMin, &m_TriangleMax, &m_Centroids })
+			bytes += pBuffer->capacity() * sizeof(Vector3);
+		for (const std::vector<uint32_t>* pBuffer : { &m_TriangleIndices, &m_MortonCodes, &m_SortCodes, &m_SortIndices, &m_Histograms, &m_Parents, &m_OutputIndices, &m_VisitCounts })
+			bytes += pBuffer->capacity() * sizeof(uint32_t);
+		return bytes;
+	}
+}
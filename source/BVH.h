@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	// How a triangle mesh builds its hierarchy, picked per mesh
+	enum class BVHBuilder
+	{
+		None, // Test every triangle, fine for a handful of them
+		BinnedSAH, // Best trees, slower builds: static meshes, or dynamic ones that are traced a lot more than they move
+		LBVH // Morton code sort, builds several times faster at a lower tree quality: fully dynamic meshes
+	};
+
+	const char* ToString(BVHBuilder builder);
+
+	// Children are always stored next to each other, so an inner node only needs the index of the left one
+	struct BVHNode
+	{
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+		// Inner node: index of the left child (right child is leftFirst + 1), leaf: first entry in the triangle index list
+		uint32_t leftFirst{};
+		uint32_t triangleCount{};
+
+		bool IsLeaf() const { return triangleCount > 0; }
+	};
+
+	struct BVHBuildReport
+	{
+		BVHBuilder builder{};
+		double buildMs{};
+
+		uint32_t triangleCount{};
+		uint32_t nodeCount{};
+		uint32_t leafCount{};
+		uint32_t maxDepth{};
+		float averageLeafSize{};
+		// Expected cost of a random ray hitting the root (traversal & triangle test both cost 1), lower is better
+		float sahCost{};
+	};
+
+	std::ostream& operator<<(std::ostream& os, const BVHBuildReport& report);
+
+	/**
+	 * \brief Bounding volume hierarchy over the (already transformed) triangles of one mesh
+	 * Always rebuilt from scratch, both builders run in parallel & keep their buffers between builds
+	 * Traversed in GeometryUtils::HitTest_TriangleMesh
+	 */
+	class BVH final
+	{
+	public:
+		// Traversal keeps a fixed size stack, the builders never go deeper than this
+		// (an LBVH level always adds at least one bit to the shared prefix of its 30 bit code + triangle index keys)
+		static constexpr uint32_t MaxDepth{ 64 };
+
+		void Build(BVHBuilder builder, const Vector3* pPositions, const int* pIndices, uint32_t triangleCount);
+		void Clear();
+
+		bool Empty() const { return m_Nodes.empty(); }
+		const std::vector<BVHNode>& GetNodes() const { return m_Nodes; }
+		// Leaves point into this list, which holds triangle numbers (multiply by 3 for the mesh's index buffer)
+		const std::vector<uint32_t>& GetTriangleIndices() const { return m_TriangleIndices; }
+
+		// Walks the whole tree for the quality numbers, not meant for every frame
+		BVHBuildReport GetReport() const;
+		// Everything the BVH holds on to, build scratch included
+		size_t GetMemoryBytes() const;
+
+	private:
+		void PrepareTriangles(const Vector3* pPositions, const int* pIndices, uint32_t triangleCount);
+
+		void BuildBinnedSAH();
+		void SubdivideSAH(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+
+		void BuildLBVH();
+		void SortMortonCodes();
+		void BuildLBVHNode(uint32_t internalIndex);
+
+		BVHBuilder m_Builder{ BVHBuilder::None };
+		double m_BuildMs{};
+
+		std::vector<BVHNode> m_Nodes{};
+		std::vector<uint32_t> m_TriangleIndices{};
+		uint32_t m_NodesUsed{};
+
+		// Build scratch, kept between builds
+		std::vector<Vector3> m_TriangleMin{};
+		std::vector<Vector3> m_TriangleMax{};
+		std::vector<Vector3> m_Centroids{};
+		std::vector<uint32_t> m_MortonCodes{};
+		std::vector<uint32_t> m_SortCodes{};
+		std::vector<uint32_t> m_SortIndices{};
+		std::vector<uint32_t> m_Histograms{};
+		// LBVH: internal nodes [0, n - 1) then leaves [n - 1, 2n - 1)
+		std::vector<uint32_t> m_Parents{};
+		std::vector<uint32_t> m_OutputIndices{};
+		std::vector<uint32_t> m_VisitCounts{};
+	};
+}
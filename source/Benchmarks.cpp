@@ -0,0 +1,889 @@
+#include "Benchmarks.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Camera.h"
+#include "Headless.h"
+#include "Math.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "SphereGrid.h"
+#include "Utils.h"
+
+namespace dae
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		// Keeps results alive so the optimizer can't remove the benchmarked work
+		volatile float g_Sink{};
+
+		template<typename Func>
+		double MeasureNanoseconds(size_t iterations, Func&& func)
+		{
+			// Warm up once, then time
+			func(iterations / 10);
+			const auto start{ Clock::now() };
+			func(iterations);
+			const auto end{ Clock::now() };
+			return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(iterations);
+		}
+
+		// Scalar implementations as they were before the SIMD math layer, kept out-of-line like the old .cpp files
+		namespace scalar
+		{
+			struct Vector3 { float x, y, z; };
+			struct Vector4 { float x, y, z, w; };
+			struct Matrix { Vector4 data[4]; };
+
+#if defined(_MSC_VER)
+#define DAE_NOINLINE __declspec(noinline)
+#else
+#define DAE_NOINLINE __attribute__((noinline))
+#endif
+			DAE_NOINLINE float Dot(const Vector3& v1, const Vector3& v2)
+			{
+				return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+			}
+
+			DAE_NOINLINE Vector3 Cross(const Vector3& v1, const Vector3& v2)
+			{
+				return {
+					v1.y * v2.z - v1.z * v2.y,
+					v1.z * v2.x - v1.x * v2.z,
+					v1.x * v2.y - v1.y * v2.x
+				};
+			}
+
+			DAE_NOINLINE Vector3 Normalized(const Vector3& v)
+			{
+				const float m{ sqrtf(v.x * v.x + v.y * v.y + v.z * v.z) };
+				return { v.x / m, v.y / m, v.z / m };
+			}
+
+			DAE_NOINLINE Vector3 TransformPoint(const Matrix& m, const Vector3& p)
+			{
+				return {
+					m.data[0].x * p.x + m.data[1].x * p.y + m.data[2].x * p.z + m.data[3].x,
+					m.data[0].y * p.x + m.data[1].y * p.y + m.data[2].y * p.z + m.data[3].y,
+					m.data[0].z * p.x + m.data[1].z * p.y + m.data[2].z * p.z + m.data[3].z,
+				};
+			}
+
+			DAE_NOINLINE Matrix Multiply(const Matrix& a, const Matrix& b)
+			{
+				// Transpose + 16 dot products, like the old Matrix::operator*
+				Matrix t{};
+				const float* pB{ &b.data[0].x };
+				float* pT{ &t.data[0].x };
+				for (int r{}; r < 4; ++r)
+					for (int c{}; c < 4; ++c)
+						pT[r * 4 + c] = pB[c * 4 + r];
+
+				Matrix result{};
+				const float* pA{ &a.data[0].x };
+				float* pR{ &result.data[0].x };
+				for (int r{}; r < 4; ++r)
+					for (int c{}; c < 4; ++c)
+						pR[r * 4 + c] = pA[r * 4] * pT[c * 4] + pA[r * 4 + 1] * pT[c * 4 + 1] + pA[r * 4 + 2] * pT[c * 4 + 2] + pA[r * 4 + 3] * pT[c * 4 + 3];
+				return result;
+			}
+
+			DAE_NOINLINE Vector3 MultiplyAddColor(const Vector3& acc, const Vector3& c1, const Vector3& c2, float s)
+			{
+				return { acc.x + c1.x * c2.x * s, acc.y + c1.y * c2.y * s, acc.z + c1.z * c2.z * s };
+			}
+#undef DAE_NOINLINE
+		}
+
+		struct BenchmarkResult
+		{
+			std::string name{};
+			double scalarNs{};
+			double simdNs{};
+		};
+
+		struct IntersectionResult
+		{
+			std::string primitive{};
+			std::string variant{};
+			double nsPerTest{};
+			double hitRate{};
+			// Against the first variant of the same primitive
+			double agreement{};
+			float maxTDifference{};
+		};
+
+		template<typename Primitive>
+		struct IntersectionCase
+		{
+			Primitive primitive{};
+			Ray ray{};
+		};
+
+		// Rays start a few units away & aim near the primitive, so roughly half of them hit
+		Ray CreateRandomRay(std::mt19937& rng, const Vector3& target, float spread)
+		{
+			std::uniform_real_distribution<float> dist{ -1.f, 1.f };
+			const Vector3 origin{ Vector3{ dist(rng), dist(rng), dist(rng) }.Normalized() * 5.f };
+			const Vector3 aim{ target + Vector3{ dist(rng), dist(rng), dist(rng) } * spread };
+
+			Ray ray{};
+			ray.origin = origin;
+			ray.direction = (aim - origin).Normalized();
+			return ray;
+		}
+
+		template<typename Primitive, typename HitTest>
+		IntersectionResult MeasureIntersection(const char* pPrimitive, const char* pVariant, size_t iterations,
+			const std::vector<IntersectionCase<Primitive>>& cases, std::vector<HitCandidate>& hits, bool isReference, HitTest&& hitTest)
+		{
+			IntersectionResult result{ pPrimitive, pVariant };
+
+			const size_t mask{ cases.size() - 1 };
+			result.nsPerTest = MeasureNanoseconds(iterations, [&](size_t n)
+				{
+					size_t hitCount{};
+					for (size_t i{}; i < n; ++i)
+					{
+						HitCandidate hit{};
+						hitCount += hitTest(cases[i & mask].primitive, cases[i & mask].ray, hit);
+					}
+					g_Sink = static_cast<float>(hitCount);
+				});
+
+			// Separate, untimed pass for the correctness numbers
+			size_t hitCount{};
+			size_t agreeCount{};
+			for (size_t i{}; i < cases.size(); ++i)
+			{
+				HitCandidate hit{};
+				hitTest(cases[i].primitive, cases[i].ray, hit);
+				hitCount += hit.DidHit();
+
+				if (isReference)
+				{
+					hits[i] = hit;
+					continue;
+				}
+
+				const HitCandidate& reference{ hits[i] };
+				if (hit.DidHit() != reference.DidHit())
+					continue;
+				if (hit.DidHit())
+				{
+					const float tDifference{ std::abs(hit.t - reference.t) };
+					result.maxTDifference = std::max(result.maxTDifference, tDifference);
+					if (tDifference > 1e-3f * std::max(1.f, reference.t))
+						continue;
+				}
+				++agreeCount;
+			}
+
+			result.hitRate = double(hitCount) / cases.size();
+			result.agreement = isReference ? 1.0 : double(agreeCount) / cases.size();
+			return result;
+		}
+
+		// On c / (1 + c) like the display sees it, otherwise a handful of fireflies decide the whole score
+		double GetDisplayRmse(const std::vector<ColorRGB>& pixels, const std::vector<ColorRGB>& reference)
+		{
+			const auto compress = [](const ColorRGB& c) { return ColorRGB{ c.r / (1.f + c.r), c.g / (1.f + c.g), c.b / (1.f + c.b) }; };
+			double squaredError{};
+			for (size_t i{}; i < pixels.size(); ++i)
+			{
+				const ColorRGB difference{ compress(pixels[i]) - compress(reference[i]) };
+				squaredError += (difference.r * difference.r + difference.g * difference.g + difference.b * difference.b) / 3.0;
+			}
+			return std::sqrt(squaredError / pixels.size());
+		}
+
+		// One path traced frame into the window sized buffer, returns its linear colors
+		std::vector<ColorRGB> TracePathTraced(Renderer& renderer, Scene& scene, const Renderer::PathTracerSettings& settings)
+		{
+			renderer.SetPathTracerSettings(settings);
+			renderer.Trace(&scene);
+			renderer.SwapFrameBuffers();
+			return renderer.GetHdrBuffer();
+		}
+	}
+
+	void Benchmarks::RunMathBenchmark()
+	{
+		constexpr size_t dataSize{ 1024 };
+		constexpr size_t iterations{ 20'000'000 };
+		constexpr size_t mask{ dataSize - 1 };
+
+		std::mt19937 rng{ 1337 };
+		std::uniform_real_distribution<float> dist{ -10.f, 10.f };
+
+		std::vector<Vector3> vectors(dataSize);
+		std::vector<scalar::Vector3> scalarVectors(dataSize);
+		std::vector<ColorRGB> colors(dataSize);
+		std::vector<Matrix> matrices(dataSize);
+		std::vector<scalar::Matrix> scalarMatrices(dataSize);
+		for (size_t i{}; i < dataSize; ++i)
+		{
+			vectors[i] = { dist(rng), dist(rng), dist(rng) };
+			scalarVectors[i] = { vectors[i].x, vectors[i].y, vectors[i].z };
+			colors[i] = { std::abs(vectors[i].x), std::abs(vectors[i].y), std::abs(vectors[i].z) };
+
+			matrices[i] = Matrix::CreateRotationY(dist(rng)) * Matrix::CreateTranslation(vectors[i]);
+			for (int r{}; r < 4; ++r)
+				scalarMatrices[i].data[r] = { matrices[i][r].x, matrices[i][r].y, matrices[i][r].z, matrices[i][r].w };
+		}
+
+		std::vector<BenchmarkResult> results{};
+
+		results.push_back({ "Vector3::Dot",
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += scalar::Dot(scalarVectors[i & mask], scalarVectors[(i + 1) & mask]); g_Sink = acc; }),
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += Vector3::Dot(vectors[i & mask], vectors[(i + 1) & mask]); g_Sink = acc; }) });
+
+		results.push_back({ "Vector3::Cross",
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += scalar::Cross(scalarVectors[i & mask], scalarVectors[(i + 1) & mask]).y; g_Sink = acc; }),
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += Vector3::Cross(vectors[i & mask], vectors[(i + 1) & mask]).y; g_Sink = acc; }) });
+
+		results.push_back({ "Vector3::Normalized",
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += scalar::Normalized(scalarVectors[i & mask]).x; g_Sink = acc; }),
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += vectors[i & mask].Normalized().x; g_Sink = acc; }) });
+
+		results.push_back({ "Matrix::TransformPoint",
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += scalar::TransformPoint(scalarMatrices[i & mask], scalarVectors[(i + 1) & mask]).z; g_Sink = acc; }),
+			MeasureNanoseconds(iterations, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += matrices[i & mask].TransformPoint(vectors[(i + 1) & mask]).z; g_Sink = acc; }) });
+
+		results.push_back({ "Matrix::operator*",
+			MeasureNanoseconds(iterations / 4, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += scalar::Multiply(scalarMatrices[i & mask], scalarMatrices[(i + 1) & mask]).data[3].x; g_Sink = acc; }),
+			MeasureNanoseconds(iterations / 4, [&](size_t n) { float acc{}; for (size_t i{}; i < n; ++i) acc += (matrices[i & mask] * matrices[(i + 1) & mask])[3].x; g_Sink = acc; }) });
+
+		results.push_back({ "ColorRGB multiply-add",
+			MeasureNanoseconds(iterations, [&](size_t n) { scalar::Vector3 acc{}; for (size_t i{}; i < n; ++i) acc = scalar::MultiplyAddColor(acc, scalarVectors[i & mask], scalarVectors[(i + 1) & mask], 0.5f); g_Sink = acc.x; }),
+			MeasureNanoseconds(iterations, [&](size_t n) { ColorRGB acc{}; for (size_t i{}; i < n; ++i) acc += colors[i & mask] * colors[(i + 1) & mask] * 0.5f; g_Sink = acc.r; }) });
+
+		//print & file save
+		std::cout << "**MATH BENCHMARK**\n";
+		std::ofstream fileStream("benchmark_math.txt");
+		for (const BenchmarkResult& result : results)
+		{
+			const double speedup{ result.scalarNs / result.simdNs };
+			std::cout << ">> " << result.name << ": scalar = " << result.scalarNs << " ns, simd = " << result.simdNs << " ns, speedup = " << speedup << "x\n";
+			fileStream << result.name << " SCALAR_NS = " << result.scalarNs << " SIMD_NS = " << result.simdNs << " SPEEDUP = " << speedup << std::endl;
+		}
+		fileStream.close();
+	}
+
+	void Benchmarks::RunIntersectionBenchmark()
+	{
+		using namespace GeometryUtils;
+
+		// Power of 2 so the timing loops can wrap with a mask
+		constexpr size_t caseCount{ 1 << 20 };
+		constexpr size_t iterations{ 8'000'000 };
+
+		std::mt19937 rng{ 1337 };
+		std::uniform_real_distribution<float> dist{ -1.f, 1.f };
+		std::uniform_real_distribution<float> radiusDist{ 0.25f, 1.5f };
+
+		std::vector<IntersectionCase<Sphere>> sphereCases(caseCount);
+		std::vector<IntersectionCase<Plane>> planeCases(caseCount);
+		std::vector<IntersectionCase<Triangle>> triangleCases(caseCount);
+		for (size_t i{}; i < caseCount; ++i)
+		{
+			sphereCases[i].primitive.origin = { dist(rng), dist(rng), dist(rng) };
+			sphereCases[i].primitive.radius = radiusDist(rng);
+			sphereCases[i].ray = CreateRandomRay(rng, sphereCases[i].primitive.origin, 1.5f);
+
+			planeCases[i].primitive.origin = { dist(rng), dist(rng), dist(rng) };
+			planeCases[i].primitive.normal = Vector3{ dist(rng), dist(rng), dist(rng) }.Normalized();
+			planeCases[i].ray = CreateRandomRay(rng, planeCases[i].primitive.origin, 1.5f);
+
+			const Vector3 center{ dist(rng), dist(rng), dist(rng) };
+			triangleCases[i].primitive = Triangle{ center + Vector3{ dist(rng), dist(rng), dist(rng) },
+				center + Vector3{ dist(rng), dist(rng), dist(rng) }, center + Vector3{ dist(rng), dist(rng), dist(rng) } };
+			triangleCases[i].primitive.cullMode = TriangleCullMode::NoCulling;
+			// Random triangles are small & often thin, aim closer to get a useful hit rate
+			triangleCases[i].ray = CreateRandomRay(rng, center, 0.3f);
+		}
+
+		std::vector<HitCandidate> referenceHits(caseCount);
+		std::vector<IntersectionResult> results{};
+
+		// The templates are called directly, the global variant selection isn't involved
+		results.push_back(MeasureIntersection("Sphere", "Geometric", iterations, sphereCases, referenceHits, true,
+			[](const Sphere& sphere, const Ray& ray, HitCandidate& hit) { return HitTest_Sphere<SphereIntersection::Geometric>(sphere, ray, hit); }));
+		results.push_back(MeasureIntersection("Sphere", "Analytic", iterations, sphereCases, referenceHits, false,
+			[](const Sphere& sphere, const Ray& ray, HitCandidate& hit) { return HitTest_Sphere<SphereIntersection::Analytic>(sphere, ray, hit); }));
+
+		results.push_back(MeasureIntersection("Plane", "Default", iterations, planeCases, referenceHits, true,
+			[](const Plane& plane, const Ray& ray, HitCandidate& hit) { return HitTest_Plane<PlaneIntersection::Default>(plane, ray, hit); }));
+		results.push_back(MeasureIntersection("Plane", "Optimized", iterations, planeCases, referenceHits, false,
+			[](const Plane& plane, const Ray& ray, HitCandidate& hit) { return HitTest_Plane<PlaneIntersection::Optimized>(plane, ray, hit); }));
+
+		results.push_back(MeasureIntersection("Triangle", "MollerTrumbore", iterations, triangleCases, referenceHits, true,
+			[](const Triangle& triangle, const Ray& ray, HitCandidate& hit) { return HitTest_Triangle<TriangleIntersection::MollerTrumbore, TriangleCullMode::NoCulling, false>(triangle, ray, hit); }));
+		results.push_back(MeasureIntersection("Triangle", "EdgeFunction", iterations, triangleCases, referenceHits, false,
+			[](const Triangle& triangle, const Ray& ray, HitCandidate& hit) { return HitTest_Triangle<TriangleIntersection::EdgeFunction, TriangleCullMode::NoCulling, false>(triangle, ray, hit); }));
+
+		//print & file save
+		std::cout << "**INTERSECTION BENCHMARK**\n";
+		std::ofstream fileStream("benchmark_intersections.json");
+		fileStream << "{\n\t\"cases\": " << caseCount << ",\n\t\"iterations\": " << iterations << ",\n\t\"results\": [\n";
+		for (size_t i{}; i < results.size(); ++i)
+		{
+			const IntersectionResult& result{ results[i] };
+			std::cout << ">> " << result.primitive << " " << result.variant << ": " << result.nsPerTest << " ns/test, hit rate = " << result.hitRate * 100.0
+				<< "%, agreement = " << result.agreement * 100.0 << "%, max t difference = " << result.maxTDifference << "\n";
+			fileStream << "\t\t{ \"primitive\": \"" << result.primitive << "\", \"variant\": \"" << result.variant
+				<< "\", \"nsPerTest\": " << result.nsPerTest << ", \"hitRate\": " << result.hitRate
+				<< ", \"agreement\": " << result.agreement << ", \"maxTDifference\": " << result.maxTDifference
+				<< " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		fileStream << "\t]\n}\n";
+		fileStream.close();
+	}
+
+	void Benchmarks::RunSphereGridBenchmark()
+	{
+		constexpr size_t sphereCounts[]{ 1'000, 10'000, 100'000, 500'000 };
+		constexpr size_t gridRayCount{ 200'000 };
+		// Linear cost grows with the sphere count, cap the total amount of sphere tests
+		constexpr size_t maxLinearTests{ 200'000'000 };
+		constexpr int buildRuns{ 5 };
+
+		std::cout << "**SPHERE GRID BENCHMARK**\n";
+		std::ofstream fileStream("benchmark_spheres.txt");
+
+		for (const size_t sphereCount : sphereCounts)
+		{
+			// Constant density like a particle system, the field grows with the count
+			std::mt19937 rng{ 1337 };
+			const float halfSize{ 0.5f * std::cbrt(float(sphereCount)) * 0.25f };
+			std::uniform_real_distribution<float> position{ -halfSize, halfSize };
+			std::uniform_real_distribution<float> radius{ 0.04f, 0.08f };
+
+			std::vector<Sphere> spheres(sphereCount);
+			for (Sphere& sphere : spheres)
+			{
+				sphere.origin = { position(rng), position(rng), position(rng) };
+				sphere.radius = radius(rng);
+			}
+
+			// Rays start outside the field & aim somewhere inside it
+			std::uniform_real_distribution<float> direction{ -1.f, 1.f };
+			std::vector<Ray> rays(gridRayCount);
+			for (Ray& ray : rays)
+			{
+				ray.origin = Vector3{ direction(rng), direction(rng), direction(rng) }.Normalized() * (halfSize * 2.f);
+				ray.direction = (Vector3{ position(rng), position(rng), position(rng) } - ray.origin).Normalized();
+			}
+
+			// Median build time
+			SphereGrid grid{};
+			std::vector<double> buildTimes{};
+			for (int run{}; run < buildRuns; ++run)
+			{
+				const auto start{ Clock::now() };
+				grid.Build(spheres);
+				buildTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+			std::sort(buildTimes.begin(), buildTimes.end());
+			const double buildMs{ buildTimes[buildTimes.size() / 2] };
+
+			std::vector<HitCandidate> gridHits(gridRayCount);
+			const auto gridStart{ Clock::now() };
+			for (size_t i{}; i < gridRayCount; ++i)
+				grid.GetClosestHit(spheres, rays[i], gridHits[i]);
+			const double gridNs{ std::chrono::duration<double, std::nano>(Clock::now() - gridStart).count() / gridRayCount };
+
+			// Same loop as Scene::GetClosestHit without acceleration
+			const size_t linearRayCount{ std::clamp<size_t>(maxLinearTests / sphereCount, 1, gridRayCount) };
+			size_t agreeCount{};
+			const auto linearStart{ Clock::now() };
+			for (size_t i{}; i < linearRayCount; ++i)
+			{
+				Ray ray{ rays[i] };
+				HitCandidate hit{};
+				for (const Sphere& sphere : spheres)
+				{
+					if (GeometryUtils::HitTest_Sphere(sphere, ray, hit))
+						ray.max = hit.t;
+				}
+				agreeCount += hit.DidHit() == gridHits[i].DidHit() && (!hit.DidHit() || std::abs(hit.t - gridHits[i].t) < 1e-4f);
+			}
+			const double linearNs{ std::chrono::duration<double, std::nano>(Clock::now() - linearStart).count() / linearRayCount };
+
+			size_t hitCount{};
+			for (const HitCandidate& hit : gridHits)
+				hitCount += hit.DidHit();
+
+			const double agreement{ double(agreeCount) / linearRayCount };
+			const double speedup{ linearNs / gridNs };
+			std::cout << ">> " << sphereCount << " spheres: build = " << buildMs << " ms (" << grid.GetCellCount() << " cells, "
+				<< double(grid.GetReferenceCount()) / sphereCount << " refs/sphere), grid = " << gridNs << " ns/ray, linear = " << linearNs
+				<< " ns/ray, speedup = " << speedup << "x, hit rate = " << double(hitCount) / gridRayCount * 100.0 << "%, agreement = " << agreement * 100.0 << "%\n";
+			fileStream << sphereCount << "_SPHERES BUILD_MS = " << buildMs << " CELLS = " << grid.GetCellCount() << " GRID_NS = " << gridNs
+				<< " LINEAR_NS = " << linearNs << " SPEEDUP = " << speedup << " AGREEMENT = " << agreement << std::endl;
+		}
+		fileStream.close();
+	}
+
+	void Benchmarks::RunBVHBenchmark()
+	{
+		constexpr size_t rayCount{ 200'000 };
+		// Linear cost grows with the triangle count, cap the total amount of triangle tests
+		constexpr size_t maxLinearTests{ 200'000'000 };
+		constexpr int buildRuns{ 5 };
+		constexpr BVHBuilder builders[]{ BVHBuilder::BinnedSAH, BVHBuilder::LBVH };
+
+		struct BenchmarkMesh
+		{
+			std::string name{};
+			TriangleMesh mesh{};
+		};
+		std::vector<BenchmarkMesh> meshes{};
+
+		// The scene meshes
+		for (const std::string name : { "lowpoly_bunny2", "lowpoly_CompanionCube" })
+		{
+			std::vector<Vector3> positions{};
+			std::vector<Vector3> normals{};
+			std::vector<int> indices{};
+			if (Utils::ParseOBJ("Resources/" + name + ".obj", positions, normals, indices))
+				meshes.push_back({ name, TriangleMesh{ positions, indices, normals, TriangleCullMode::NoCulling } });
+		}
+
+		// Wavy height fields, big enough for the builders to use all cores
+		for (const int resolution : { 256, 724 })
+		{
+			std::vector<Vector3> positions{};
+			std::vector<int> indices{};
+			for (int z{}; z <= resolution; ++z)
+			{
+				for (int x{}; x <= resolution; ++x)
+				{
+					const float u{ float(x) / resolution };
+					const float v{ float(z) / resolution };
+					positions.emplace_back(u * 10.f - 5.f, std::sin(u * 25.f) * std::cos(v * 17.f) * 0.5f, v * 10.f - 5.f);
+				}
+			}
+			for (int z{}; z < resolution; ++z)
+			{
+				for (int x{}; x < resolution; ++x)
+				{
+					const int i{ z * (resolution + 1) + x };
+					indices.insert(indices.end(), { i, i + resolution + 1, i + 1, i + 1, i + resolution + 1, i + resolution + 2 });
+				}
+			}
+			meshes.push_back({ "heightfield_" + std::to_string(indices.size() / 3), TriangleMesh{ positions, indices, TriangleCullMode::NoCulling } });
+		}
+
+		std::cout << "**BVH BENCHMARK**\n";
+		std::ofstream fileStream("benchmark_bvh.txt");
+
+		for (BenchmarkMesh& benchmarkMesh : meshes)
+		{
+			TriangleMesh& mesh{ benchmarkMesh.mesh };
+			mesh.UpdateAABB();
+			mesh.UpdateTransforms();
+			mesh.SwapTransforms();
+			const uint32_t triangleCount{ static_cast<uint32_t>(mesh.indices.size() / 3) };
+
+			// Rays start outside the mesh's box & aim somewhere inside it
+			std::mt19937 rng{ 1337 };
+			const Vector3 center{ (mesh.transformedMinAABB + mesh.transformedMaxAABB) * 0.5f };
+			const Vector3 halfExtent{ (mesh.transformedMaxAABB - mesh.transformedMinAABB) * 0.5f };
+			std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+			std::vector<Ray> rays(rayCount);
+			for (Ray& ray : rays)
+			{
+				ray.origin = center + Vector3{ unit(rng), unit(rng), unit(rng) }.Normalized() * (halfExtent.Magnitude() * 2.f);
+				const Vector3 target{ center + Vector3{ unit(rng) * halfExtent.x, unit(rng) * halfExtent.y, unit(rng) * halfExtent.z } };
+				ray.direction = (target - ray.origin).Normalized();
+			}
+
+			// Reference hits without a BVH
+			const size_t linearRayCount{ std::clamp<size_t>(maxLinearTests / triangleCount, 1, rayCount) };
+			std::vector<HitCandidate> linearHits(linearRayCount);
+			const auto linearStart{ Clock::now() };
+			for (size_t i{}; i < linearRayCount; ++i)
+			{
+				Ray ray{ rays[i] };
+				GeometryUtils::HitTest_TriangleMesh(mesh, ray, linearHits[i]);
+			}
+			const double linearNs{ std::chrono::duration<double, std::nano>(Clock::now() - linearStart).count() / linearRayCount };
+			std::cout << ">> " << benchmarkMesh.name << " (" << triangleCount << " triangles): linear = " << linearNs << " ns/ray\n";
+			fileStream << benchmarkMesh.name << " LINEAR_NS = " << linearNs << std::endl;
+
+			for (const BVHBuilder builder : builders)
+			{
+				// Median build time
+				std::vector<double> buildTimes{};
+				for (int run{}; run < buildRuns; ++run)
+				{
+					mesh.bvh.Build(builder, mesh.transformedPositions.data(), mesh.indices.data(), triangleCount);
+					buildTimes.push_back(mesh.bvh.GetReport().buildMs);
+				}
+				std::sort(buildTimes.begin(), buildTimes.end());
+				BVHBuildReport report{ mesh.bvh.GetReport() };
+				report.buildMs = buildTimes[buildTimes.size() / 2];
+
+				std::vector<HitCandidate> hits(rayCount);
+				const auto start{ Clock::now() };
+				for (size_t i{}; i < rayCount; ++i)
+				{
+					Ray ray{ rays[i] };
+					GeometryUtils::HitTest_TriangleMesh(mesh, ray, hits[i]);
+				}
+				const double bvhNs{ std::chrono::duration<double, std::nano>(Clock::now() - start).count() / rayCount };
+
+				size_t agreeCount{};
+				for (size_t i{}; i < linearRayCount; ++i)
+					agreeCount += hits[i].DidHit() == linearHits[i].DidHit() && (!hits[i].DidHit() || std::abs(hits[i].t - linearHits[i].t) < 1e-4f);
+				const double agreement{ double(agreeCount) / linearRayCount };
+
+				std::cout << "   " << report << ", trace = " << bvhNs << " ns/ray, speedup = " << linearNs / bvhNs << "x, agreement = " << agreement * 100.0 << "%\n";
+				fileStream << benchmarkMesh.name << "_" << ToString(builder) << " BUILD_MS = " << report.buildMs << " NODES = " << report.nodeCount
+					<< " DEPTH = " << report.maxDepth << " SAH_COST = " << report.sahCost << " TRACE_NS = " << bvhNs << " AGREEMENT = " << agreement << std::endl;
+			}
+
+			// Compact copy of the same mesh, its hits land up to a snapping step away from the full precision ones
+			mesh.bvh.Build(BVHBuilder::BinnedSAH, mesh.transformedPositions.data(), mesh.indices.data(), triangleCount);
+			const MeshMemoryReport fullMemory{ mesh.GetMemoryReport() };
+
+			TriangleMesh compactMesh{};
+			compactMesh.cullMode = mesh.cullMode;
+			compactMesh.compact.Build(mesh.transformedPositions.data(), static_cast<uint32_t>(mesh.transformedPositions.size()),
+				mesh.indices.data(), mesh.transformedNormals.data(), triangleCount);
+			compactMesh.transformedMinAABB = compactMesh.compact.GetMinAABB();
+			compactMesh.transformedMaxAABB = compactMesh.compact.GetMaxAABB();
+			const MeshMemoryReport compactMemory{ compactMesh.GetMemoryReport() };
+
+			std::vector<HitCandidate> compactHits(rayCount);
+			const auto compactStart{ Clock::now() };
+			for (size_t i{}; i < rayCount; ++i)
+			{
+				Ray ray{ rays[i] };
+				GeometryUtils::HitTest_TriangleMesh(compactMesh, ray, compactHits[i]);
+			}
+			const double compactNs{ std::chrono::duration<double, std::nano>(Clock::now() - compactStart).count() / rayCount };
+
+			const float tolerance{ 1e-3f * halfExtent.Magnitude() };
+			size_t compactAgreeCount{};
+			for (size_t i{}; i < linearRayCount; ++i)
+				compactAgreeCount += compactHits[i].DidHit() == linearHits[i].DidHit() && (!compactHits[i].DidHit() || std::abs(compactHits[i].t - linearHits[i].t) < tolerance);
+			const double compactAgreement{ double(compactAgreeCount) / linearRayCount };
+
+			std::cout << "   " << fullMemory << "\n   " << compactMemory << ", " << double(fullMemory.GetTotalBytes()) / compactMemory.GetTotalBytes()
+				<< "x smaller, trace = " << compactNs << " ns/ray, agreement = " << compactAgreement * 100.0 << "%\n";
+			fileStream << benchmarkMesh.name << "_COMPACT FULL_BYTES = " << fullMemory.GetTotalBytes() << " COMPACT_BYTES = " << compactMemory.GetTotalBytes()
+				<< " TRACE_NS = " << compactNs << " AGREEMENT = " << compactAgreement << std::endl;
+
+			mesh.bvh.Clear();
+		}
+		fileStream.close();
+	}
+
+	void Benchmarks::RunMultiViewBenchmark(const std::string& sceneName)
+	{
+		constexpr int runs{ 5 };
+
+		std::cout << "**MULTI VIEW BENCHMARK** " << sceneName << "\n";
+
+		WithHeadlessScene(sceneName, 64, 64, [&](Scene& scene, Renderer& renderer)
+			{
+				renderer.SetReflections(scene.GetReflectionsEnabled());
+				const Camera& sceneCamera{ scene.GetCamera() };
+				// Same basis as CalculateCameraToWorld, the scene camera's own right & up are only filled in on its render copy
+				const Vector3 right{ Vector3::Cross(Vector3::UnitY, sceneCamera.forward).Normalized() };
+				const Vector3 up{ Vector3::Cross(sceneCamera.forward, right).Normalized() };
+
+				const auto makeCamera = [&](const Vector3& offset, const Vector3& forward, float fov)
+					{
+						Camera camera{ sceneCamera.origin + offset, fov };
+						camera.forward = forward.Normalized();
+						return camera;
+					};
+
+				struct Layout
+				{
+					std::string name{};
+					std::vector<Camera> cameras{};
+					int width{};
+					int height{};
+				};
+				std::vector<Layout> layouts{};
+
+				// Eyes 6.4 cm apart
+				const Vector3 eyeOffset{ right * 0.032f };
+				layouts.push_back({ "Stereo", { makeCamera(-eyeOffset, sceneCamera.forward, sceneCamera.fovAngle),
+					makeCamera(eyeOffset, sceneCamera.forward, sceneCamera.fovAngle) }, 640, 480 });
+
+				// Up & down are tilted a hair off the Y axis, the camera basis is built from a cross with UnitY
+				Layout cubemap{ "Cubemap", {}, 256, 256 };
+				for (const Vector3& forward : { Vector3::UnitX, -Vector3::UnitX, Vector3{ 0.f, 1.f, 1e-4f }, Vector3{ 0.f, -1.f, 1e-4f }, Vector3::UnitZ, -Vector3::UnitZ })
+					cubemap.cameras.push_back(makeCamera({}, forward, 90.f));
+				layouts.push_back(cubemap);
+
+				// 3x3 security cameras spread around the scene camera, all looking the same way
+				Layout grid{ "Grid", {}, 320, 240 };
+				for (int y{ -1 }; y <= 1; ++y)
+				{
+					for (int x{ -1 }; x <= 1; ++x)
+						grid.cameras.push_back(makeCamera(right * (x * 2.f) + up * (y * 1.f), sceneCamera.forward, sceneCamera.fovAngle));
+				}
+				layouts.push_back(grid);
+
+				std::ofstream fileStream("benchmark_views.txt");
+				for (const Layout& layout : layouts)
+				{
+					const size_t viewCount{ layout.cameras.size() };
+					std::vector<Renderer::ViewTarget> separateTargets(viewCount, Renderer::ViewTarget{ layout.width, layout.height });
+					std::vector<Renderer::ViewTarget> sharedTargets(viewCount, Renderer::ViewTarget{ layout.width, layout.height });
+
+					// One view per call is what a Trace per camera does, each waits for its own slowest tile
+					std::vector<double> separateTimes{};
+					std::vector<double> sharedTimes{};
+					for (int run{}; run < runs; ++run)
+					{
+						const auto separateStart{ Clock::now() };
+						for (size_t i{}; i < viewCount; ++i)
+						{
+							std::vector<Renderer::ViewTarget> target{ std::move(separateTargets[i]) };
+							renderer.TraceViews(&scene, { layout.cameras[i] }, target);
+							separateTargets[i] = std::move(target.front());
+						}
+						separateTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - separateStart).count());
+
+						const auto sharedStart{ Clock::now() };
+						renderer.TraceViews(&scene, layout.cameras, sharedTargets);
+						sharedTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - sharedStart).count());
+					}
+					std::sort(separateTimes.begin(), separateTimes.end());
+					std::sort(sharedTimes.begin(), sharedTimes.end());
+					const double separateMs{ separateTimes[runs / 2] };
+					const double sharedMs{ sharedTimes[runs / 2] };
+
+					bool isIdentical{ true };
+					for (size_t i{}; i < viewCount; ++i)
+					{
+						isIdentical &= std::equal(separateTargets[i].pixels.begin(), separateTargets[i].pixels.end(), sharedTargets[i].pixels.begin(),
+							[](const ColorRGB& a, const ColorRGB& b) { return a.r == b.r && a.g == b.g && a.b == b.b; });
+					}
+
+					std::cout << ">> " << layout.name << ": " << viewCount << " views of " << layout.width << "x" << layout.height << ", separate = " << separateMs
+						<< " ms, shared = " << sharedMs << " ms, speedup = " << separateMs / sharedMs << "x" << (isIdentical ? "" : ", PIXELS DIFFER") << "\n";
+					fileStream << layout.name << " VIEWS = " << viewCount << " SEPARATE_MS = " << separateMs << " SHARED_MS = " << sharedMs
+						<< " SPEEDUP = " << separateMs / sharedMs << " IDENTICAL = " << isIdentical << std::endl;
+				}
+			});
+	}
+
+	void Benchmarks::RunPathTerminationBenchmark(const std::string& sceneName)
+	{
+		constexpr int runs{ 5 };
+		constexpr int width{ 640 };
+		constexpr int height{ 480 };
+		// Frames averaged per configuration, each with other random numbers like temporal accumulation does
+		constexpr int accumulatedFrames{ 16 };
+
+		std::cout << "**PATH TERMINATION BENCHMARK** " << sceneName << "\n";
+
+		WithHeadlessScene(sceneName, 64, 64, [&](Scene& scene, Renderer& renderer)
+			{
+				renderer.SetReflections(true);
+				const std::vector<Camera> cameras{ scene.GetCamera() };
+
+				struct Configuration
+				{
+					std::string name{};
+					Renderer::PathSettings settings{};
+				};
+				// Every bounce up to the maximum depth is the reference, the others should get close to it for less
+				const Renderer::PathSettings defaults{};
+				const Configuration configurations[]
+				{
+					{ "Reference", { defaults.maxBounces, defaults.maxBounces, 0.f, defaults.reflectionFalloff } },
+					{ "Fixed3", { 3, 3, 0.f, defaults.reflectionFalloff } },
+					{ "Cutoff", { defaults.maxBounces, defaults.maxBounces, defaults.minContribution, defaults.reflectionFalloff } },
+					{ "Roulette", { defaults.maxBounces, defaults.rouletteStartBounce, 0.f, defaults.reflectionFalloff } },
+					{ "CutoffRoulette", defaults }
+				};
+
+				// Mean absolute difference per pixel & channel
+				const auto getMeanDifference = [](const std::vector<ColorRGB>& pixels, const std::vector<ColorRGB>& reference)
+					{
+						double difference{};
+						for (size_t i{}; i < pixels.size(); ++i)
+						{
+							const ColorRGB& a{ pixels[i] };
+							const ColorRGB& b{ reference[i] };
+							difference += (std::abs(a.r - b.r) + std::abs(a.g - b.g) + std::abs(a.b - b.b)) / 3.0;
+						}
+						return difference / pixels.size();
+					};
+
+				std::ofstream fileStream("benchmark_paths.txt");
+				std::vector<ColorRGB> reference{};
+				for (const Configuration& configuration : configurations)
+				{
+					renderer.SetPathSettings(configuration.settings);
+					std::vector<Renderer::ViewTarget> targets{ Renderer::ViewTarget{ width, height } };
+					std::vector<double> times{};
+					for (int run{}; run < runs; ++run)
+					{
+						const auto start{ Clock::now() };
+						renderer.TraceViews(&scene, cameras, targets);
+						times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+					}
+					std::sort(times.begin(), times.end());
+					const double traceMs{ times[runs / 2] };
+
+					const std::vector<ColorRGB> pixels{ targets.front().pixels };
+					if (reference.empty())
+						reference = pixels;
+
+					// Mean brightness shows whether anything got lost on average
+					double brightness{};
+					double referenceBrightness{};
+					for (size_t i{}; i < pixels.size(); ++i)
+					{
+						brightness += (pixels[i].r + pixels[i].g + pixels[i].b) / 3.0;
+						referenceBrightness += (reference[i].r + reference[i].g + reference[i].b) / 3.0;
+					}
+					const double energy{ brightness / referenceBrightness };
+
+					// Per pixel, the noise of a single frame has to average out over frames, only the bias of the cutoffs may stay
+					std::vector<ColorRGB> accumulated(pixels.size());
+					for (int frame{}; frame < accumulatedFrames; ++frame)
+					{
+						targets.front().firstSample = uint32_t(frame);
+						renderer.TraceViews(&scene, cameras, targets);
+						for (size_t i{}; i < pixels.size(); ++i)
+							accumulated[i] += targets.front().pixels[i] / float(accumulatedFrames);
+					}
+					const double meanDifference{ getMeanDifference(pixels, reference) };
+					const double accumulatedDifference{ getMeanDifference(accumulated, reference) };
+					// Noisy & unbiased configurations only, the cutoffs stay off by their (fixed) bias however many frames are averaged
+					const bool isUnbiased{ configuration.settings.maxBounces == defaults.maxBounces && configuration.settings.minContribution == 0.f };
+					const bool doesConverge{ !isUnbiased || meanDifference == 0.0 || accumulatedDifference <= meanDifference * 0.5 };
+
+					std::cout << ">> " << configuration.name << ": trace = " << traceMs << " ms, mean difference = " << meanDifference
+						<< ", after " << accumulatedFrames << " frames = " << accumulatedDifference << ", energy = " << energy * 100.0 << "% of the reference"
+						<< (doesConverge ? "" : ", PER PIXEL ERROR DOESN'T AVERAGE OUT") << "\n";
+					fileStream << configuration.name << " TRACE_MS = " << traceMs << " MEAN_DIFFERENCE = " << meanDifference
+						<< " ACCUMULATED_DIFFERENCE = " << accumulatedDifference << " ENERGY = " << energy << " CONVERGES = " << doesConverge << std::endl;
+				}
+			});
+	}
+
+	void Benchmarks::RunPathTracerBenchmark(const std::string& sceneName)
+	{
+		constexpr int width{ 320 };
+		constexpr int height{ 240 };
+		constexpr int referenceSamples{ 256 };
+		constexpr int sampleCounts[]{ 1, 4, 16, 64 };
+
+		std::cout << "**PATH TRACER BENCHMARK** " << sceneName << "\n";
+
+		WithHeadlessScene(sceneName, width, height, [&](Scene& scene, Renderer& renderer)
+			{
+				renderer.SetIntegrator(Renderer::Integrator::PathTracer);
+
+				// Another seed than the measured images, or their noise would partly match the reference
+				std::cout << "Reference at " << referenceSamples << " spp...\n";
+				const std::vector<ColorRGB> reference{ TracePathTraced(renderer, scene, { referenceSamples, true, 1000 }) };
+				std::ofstream fileStream("benchmark_pathtracer.txt");
+				fileStream << "REFERENCE_SPP = " << referenceSamples << " SAMPLES_PER_SECOND = " << renderer.GetLastSamplesPerSecond() << std::endl;
+
+				for (const int samplesPerPixel : sampleCounts)
+				{
+					for (const bool useSobol : { false, true })
+					{
+						const std::vector<ColorRGB> pixels{ TracePathTraced(renderer, scene, { samplesPerPixel, useSobol, 0 }) };
+						const float samplesPerSecond{ renderer.GetLastSamplesPerSecond() };
+						const double rmse{ GetDisplayRmse(pixels, reference) };
+
+						const char* sequenceName{ useSobol ? "Sobol" : "Random" };
+						std::cout << ">> " << samplesPerPixel << " spp " << sequenceName << ": RMSE = " << rmse << ", "
+							<< samplesPerSecond / 1'000'000.f << " Msamples/s\n";
+						fileStream << samplesPerPixel << "_SPP_" << sequenceName << " RMSE = " << rmse << " SAMPLES_PER_SECOND = " << samplesPerSecond << std::endl;
+					}
+				}
+
+				// Tiles in reverse, as if the workers picked them up in a completely different order
+				const std::vector<ColorRGB> inOrder{ TracePathTraced(renderer, scene, { 4, true, 0 }) };
+				std::vector<uint32_t> tiles(renderer.GetTileCount());
+				for (uint32_t i{}; i < tiles.size(); ++i)
+					tiles[i] = uint32_t(tiles.size()) - 1 - i;
+				renderer.TraceTiles(&scene, tiles);
+				renderer.SwapFrameBuffers();
+				const std::vector<ColorRGB>& reversed{ renderer.GetHdrBuffer() };
+				const bool isDeterministic{ std::equal(inOrder.begin(), inOrder.end(), reversed.begin(),
+					[](const ColorRGB& a, const ColorRGB& b) { return a.r == b.r && a.g == b.g && a.b == b.b; }) };
+				std::cout << ">> Tile order " << (isDeterministic ? "doesn't change the image" : "CHANGES THE IMAGE") << "\n";
+				fileStream << "DETERMINISTIC = " << isDeterministic << std::endl;
+			});
+	}
+
+	void Benchmarks::RunDenoiserBenchmark(const std::string& sceneName)
+	{
+		constexpr int width{ 320 };
+		constexpr int height{ 240 };
+		constexpr int referenceSamples{ 256 };
+		constexpr int sampleCounts[]{ 1, 4 };
+		constexpr int accumulatedFrames{ 8 };
+
+		std::cout << "**DENOISER BENCHMARK** " << sceneName << "\n";
+
+		WithHeadlessScene(sceneName, width, height, [&](Scene& scene, Renderer& renderer)
+			{
+				renderer.SetIntegrator(Renderer::Integrator::PathTracer);
+
+				std::cout << "Reference at " << referenceSamples << " spp...\n";
+				const std::vector<ColorRGB> reference{ TracePathTraced(renderer, scene, { referenceSamples, true, 1000 }) };
+				std::ofstream fileStream("benchmark_denoiser.txt");
+				fileStream << "REFERENCE_SPP = " << referenceSamples << " WIDTH = " << width << " HEIGHT = " << height << std::endl;
+
+				for (const int samplesPerPixel : sampleCounts)
+				{
+					// Same seed both times, so the denoiser gets exactly the noisy image it's compared against
+					renderer.SetDenoiser(false);
+					const std::vector<ColorRGB> noisy{ TracePathTraced(renderer, scene, { samplesPerPixel, true, 0 }) };
+					renderer.SetDenoiser(true);
+					const std::vector<ColorRGB> denoised{ TracePathTraced(renderer, scene, { samplesPerPixel, true, 0 }) };
+
+					const double noisyRmse{ GetDisplayRmse(noisy, reference) };
+					const double denoisedRmse{ GetDisplayRmse(denoised, reference) };
+					std::cout << ">> " << samplesPerPixel << " spp: RMSE noisy = " << noisyRmse << ", denoised = " << denoisedRmse
+						<< " | TRACE_MS = " << renderer.GetLastTraceTime() << " DENOISE_MS = " << renderer.GetLastDenoiseTime() << "\n";
+					fileStream << samplesPerPixel << "_SPP NOISY_RMSE = " << noisyRmse << " DENOISED_RMSE = " << denoisedRmse
+						<< " TRACE_MS = " << renderer.GetLastTraceTime() << " DENOISE_MS = " << renderer.GetLastDenoiseTime() << std::endl;
+				}
+
+				// Static camera, so every pixel keeps its history & the frames average out before the filter
+				DenoiserSettings settings{ renderer.GetDenoiserSettings() };
+				settings.temporalAccumulation = true;
+				renderer.SetDenoiserSettings(settings);
+				float denoiseMs{};
+				std::vector<ColorRGB> accumulated{};
+				for (int frame{}; frame < accumulatedFrames; ++frame)
+				{
+					accumulated = TracePathTraced(renderer, scene, { 1, true, 0 });
+					denoiseMs += renderer.GetLastDenoiseTime();
+				}
+				const double accumulatedRmse{ GetDisplayRmse(accumulated, reference) };
+				std::cout << ">> 1 spp, " << accumulatedFrames << " frames accumulated: RMSE = " << accumulatedRmse
+					<< " | DENOISE_MS = " << denoiseMs / accumulatedFrames << "\n";
+				fileStream << "1_SPP_ACCUMULATED_" << accumulatedFrames << " RMSE = " << accumulatedRmse << " DENOISE_MS = " << denoiseMs / accumulatedFrames << std::endl;
+			});
+	}
+}
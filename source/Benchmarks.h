@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	// Headless benchmarks, started from the command line (see main.cpp)
+	// Results are printed and saved next to benchmark.txt
+	namespace Benchmarks
+	{
+		// Compares the SIMD math layer against the previous scalar Vector3/Matrix/ColorRGB implementations
+		void RunMathBenchmark();
+
+		// Feeds randomized rays through every sphere, plane & triangle intersection variant
+		// Reports ns/test, hit rate & agreement with the first variant of each primitive, saved to benchmark_intersections.json
+		void RunIntersectionBenchmark();
+
+		// Build time & closest hit cost of the SphereGrid against testing every sphere, for growing sphere fields
+		// Saved to benchmark_spheres.txt
+		void RunSphereGridBenchmark();
+
+		// Build time, tree quality & closest hit cost of both BVH builders on the scene meshes & bigger generated ones,
+		// then memory & closest hit cost of the CompactMesh version, saved to benchmark_bvh.txt
+		void RunBVHBenchmark();
+
+		// Stereo pair, cubemap & camera grid of a built-in scene traced as separate renders & as one TraceViews call,
+		// checks both give the same pixels, saved to benchmark_views.txt
+		void RunMultiViewBenchmark(const std::string& sceneName);
+
+		// Trace time & image difference of fixed depth, cutoff & Russian roulette path termination against following every
+		// bounce to the maximum depth, & whether the per pixel error of the unbiased ones averages out over frames, saved to benchmark_paths.txt
+		void RunPathTerminationBenchmark(const std::string& sceneName);
+
+		// Error of the path tracer against a high sample count reference for growing sample counts, Sobol against random numbers,
+		// with samples per second & a check that the tile order doesn't change the image, saved to benchmark_pathtracer.txt
+		void RunPathTracerBenchmark(const std::string& sceneName);
+
+		// Error of 1 & 4 spp path traced images against a high sample count reference before & after the denoiser,
+		// and of a few accumulated 1 spp frames, with trace & denoise times apart, saved to benchmark_denoiser.txt
+		void RunDenoiserBenchmark(const std::string& sceneName);
+	}
+}
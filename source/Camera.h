@@ -24,9 +24,10 @@ namespace dae
 		Vector3 origin{};
 		float fovAngle{};
 		float fovRatio{};
-		const float movementSpeed{ 7.0f };
-		const float rotationSpeed{ 20.0f };
-		const float keyboardRotationSpeed{ 80.0f };
+		// Static so cameras stay copyable, the scene hands the renderer a copy per frame
+		static constexpr float movementSpeed{ 7.0f };
+		static constexpr float rotationSpeed{ 20.0f };
+		static constexpr float keyboardRotationSpeed{ 80.0f };
 
 		Vector3 forward{ Vector3::UnitZ };
 		Vector3 up{ Vector3::UnitY };
@@ -36,8 +37,6 @@ namespace dae
 		float totalYaw{ 0.f };
 		
 		Matrix cameraToWorld{};
-		
-		bool updateRayDirections{ true };  // If true, raydirections will have to be updated
 
 		void SetFov(float angle)
 		{
@@ -57,8 +56,6 @@ namespace dae
 			const Matrix finalRotation = Matrix::CreateRotationX(totalPitch * TO_RADIANS) * Matrix::CreateRotationY(totalYaw * TO_RADIANS);
 			forward = finalRotation.TransformVector(Vector3::UnitZ);
 			forward.Normalize();
-
-			updateRayDirections = true;
 		}
 
 		Matrix CalculateCameraToWorld()
@@ -190,9 +187,38 @@ namespace dae
 				const Matrix finalRotation = Matrix::CreateRotationX(totalPitch * TO_RADIANS) * Matrix::CreateRotationY(totalYaw * TO_RADIANS);
 				forward = finalRotation.TransformVector(Vector3::UnitZ);
 				forward.Normalize();
-
-				updateRayDirections = true;
 			}
 		}
 	};
+
+	// Generates primary ray directions on the fly from the camera basis
+	// Direction(px, py) = topLeft + px * columnDelta + py * rowDelta (unnormalized), so walking a row is a single add per pixel
+	struct CameraRayGenerator
+	{
+		CameraRayGenerator(const Camera& camera, int width, int height, float aspectRatio)
+		{
+			const Vector3 right{ camera.cameraToWorld.GetAxisX() };
+			const Vector3 up{ camera.cameraToWorld.GetAxisY() };
+			const Vector3 forward{ camera.cameraToWorld.GetAxisZ() };
+
+			// Same mapping as cx = ((2 * (px + 0.5) / width) - 1) * aspectRatio * fovRatio, cy = (1 - (2 * (py + 0.5) / height)) * fovRatio
+			const float columnStep{ 2.0f / float(width) * aspectRatio * camera.fovRatio };
+			const float rowStep{ 2.0f / float(height) * camera.fovRatio };
+			columnDelta = right * columnStep;
+			rowDelta = up * -rowStep;
+			topLeft = forward
+				+ right * ((0.5f * columnStep) - aspectRatio * camera.fovRatio)
+				+ up * (camera.fovRatio - (0.5f * rowStep));
+		}
+
+		// Unnormalized direction of the first pixel of a row segment, step with columnDelta from there
+		Vector3 GetDirection(uint32_t px, uint32_t py) const
+		{
+			return topLeft + columnDelta * float(px) + rowDelta * float(py);
+		}
+
+		Vector3 topLeft{};
+		Vector3 columnDelta{};
+		Vector3 rowDelta{};
+	};
 }
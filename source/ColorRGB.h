@@ -1,13 +1,25 @@
 #pragma once
 #include "MathHelpers.h"
+#include "SIMD.h"
 
 namespace dae
 {
-	struct ColorRGB
+	// Padded to 16 bytes & aligned like Vector3, the operators run on SSE registers at runtime and stay constexpr
+	struct alignas(16) ColorRGB
 	{
 		float r{};
 		float g{};
 		float b{};
+		float padding{}; // Unused 4th lane, keeps loads/stores aligned
+
+		__m128 Load() const { return simd::Load(&r); }
+
+		static ColorRGB FromRegister(__m128 v)
+		{
+			ColorRGB c;
+			simd::Store(&c.r, v);
+			return c;
+		}
 
 		void MaxToOne()
 		{
@@ -16,136 +28,110 @@ namespace dae
 				*this /= maxValue;
 		}
 
-		static ColorRGB Lerp(const ColorRGB& c1, const ColorRGB& c2, float factor)
+		static constexpr ColorRGB Lerp(const ColorRGB& c1, const ColorRGB& c2, float factor)
 		{
 			return { Lerpf(c1.r, c2.r, factor), Lerpf(c1.g, c2.g, factor), Lerpf(c1.b, c2.b, factor) };
 		}
 
 		#pragma region ColorRGB (Member) Operators
-		const ColorRGB& operator+=(const ColorRGB& c)
-		{
-			r += c.r;
-			g += c.g;
-			b += c.b;
-
-			return *this;
-		}
-
-		const ColorRGB& operator+(const ColorRGB& c)
-		{
-			return *this += c;
-		}
-
-		ColorRGB operator+(const ColorRGB& c) const
+		// Ignores the padding lane, SIMD results can leave anything in there
+		constexpr bool operator==(const ColorRGB& c) const
 		{
-			return { r + c.r, g + c.g, b + c.b };
+			return r == c.r && g == c.g && b == c.b;
 		}
 
-		const ColorRGB& operator-=(const ColorRGB& c)
+		constexpr ColorRGB operator+(const ColorRGB& c) const
 		{
-			r -= c.r;
-			g -= c.g;
-			b -= c.b;
-
-			return *this;
+			if (std::is_constant_evaluated())
+				return { r + c.r, g + c.g, b + c.b };
+			return FromRegister(_mm_add_ps(Load(), c.Load()));
 		}
 
-		const ColorRGB& operator-(const ColorRGB& c)
+		constexpr ColorRGB operator-(const ColorRGB& c) const
 		{
-			return *this -= c;
+			if (std::is_constant_evaluated())
+				return { r - c.r, g - c.g, b - c.b };
+			return FromRegister(_mm_sub_ps(Load(), c.Load()));
 		}
 
-		ColorRGB operator-(const ColorRGB& c) const
+		constexpr ColorRGB operator*(const ColorRGB& c) const
 		{
-			return { r - c.r, g - c.g, b - c.b };
+			if (std::is_constant_evaluated())
+				return { r * c.r, g * c.g, b * c.b };
+			return FromRegister(_mm_mul_ps(Load(), c.Load()));
 		}
 
-		const ColorRGB& operator*=(const ColorRGB& c)
+		constexpr ColorRGB operator/(const ColorRGB& c) const
 		{
-			r *= c.r;
-			g *= c.g;
-			b *= c.b;
-
-			return *this;
+			if (std::is_constant_evaluated())
+				return { r / c.r, g / c.g, b / c.b };
+			// Keep the padding lane at 0 instead of 0/0
+			const __m128 divisor{ _mm_or_ps(c.Load(), _mm_castsi128_ps(_mm_set_epi32(0x3F800000, 0, 0, 0))) };
+			return FromRegister(_mm_div_ps(Load(), divisor));
 		}
 
-		const ColorRGB& operator*(const ColorRGB& c)
+		constexpr ColorRGB operator*(float s) const
 		{
-			return *this *= c;
+			if (std::is_constant_evaluated())
+				return { r * s, g * s, b * s };
+			return FromRegister(_mm_mul_ps(Load(), simd::Splat(s)));
 		}
 
-		ColorRGB operator*(const ColorRGB& c) const
+		constexpr ColorRGB operator/(float s) const
 		{
-			return { r * c.r, g * c.g, b * c.b };
+			if (std::is_constant_evaluated())
+				return { r / s, g / s, b / s };
+			return FromRegister(_mm_div_ps(Load(), simd::Splat(s)));
 		}
 
-		const ColorRGB& operator/=(const ColorRGB& c)
+		constexpr const ColorRGB& operator+=(const ColorRGB& c)
 		{
-			r /= c.r;
-			g /= c.g;
-			b /= c.b;
-
-			return *this;
+			return *this = *this + c;
 		}
 
-		const ColorRGB& operator/(const ColorRGB& c)
+		constexpr const ColorRGB& operator-=(const ColorRGB& c)
 		{
-			return *this /= c;
+			return *this = *this - c;
 		}
 
-		const ColorRGB& operator*=(float s)
+		constexpr const ColorRGB& operator*=(const ColorRGB& c)
 		{
-			r *= s;
-			g *= s;
-			b *= s;
-
-			return *this;
+			return *this = *this * c;
 		}
 
-		const ColorRGB& operator*(float s)
-		{
-			//return { r * s, g * s, b * s };
-			return *this *= s;
-		}
-		
-		ColorRGB operator*(float s) const
+		constexpr const ColorRGB& operator/=(const ColorRGB& c)
 		{
-			return { r * s, g * s,b * s };
+			return *this = *this / c;
 		}
 
-		const ColorRGB& operator/=(float s)
+		constexpr const ColorRGB& operator*=(float s)
 		{
-			r /= s;
-			g /= s;
-			b /= s;
-
-			return *this;
+			return *this = *this * s;
 		}
 
-		const ColorRGB& operator/(float s)
+		constexpr const ColorRGB& operator/=(float s)
 		{
-			//return { r / s, g / s, b / s };
-			return *this /= s;
+			return *this = *this / s;
 		}
 		#pragma endregion
 	};
 
 	//ColorRGB (Global) Operators
-	inline ColorRGB operator*(float s, const ColorRGB& c)
+	constexpr ColorRGB operator*(float s, const ColorRGB& c)
 	{
 		return c * s;
 	}
 
 	namespace colors
 	{
-		static ColorRGB Red{ 1,0,0 };
-		static ColorRGB Blue{ 0,0,1 };
-		static ColorRGB Green{ 0,1,0 };
-		static ColorRGB Yellow{ 1,1,0 };
-		static ColorRGB Cyan{ 0,1,1 };
-		static ColorRGB Magenta{ 1,0,1 };
-		static ColorRGB White{ 1,1,1 };
-		static ColorRGB Black{ 0,0,0 };
-		static ColorRGB Gray{ 0.5f,0.5f,0.5f };
+		inline constexpr ColorRGB Red{ 1,0,0 };
+		inline constexpr ColorRGB Blue{ 0,0,1 };
+		inline constexpr ColorRGB Green{ 0,1,0 };
+		inline constexpr ColorRGB Yellow{ 1,1,0 };
+		inline constexpr ColorRGB Cyan{ 0,1,1 };
+		inline constexpr ColorRGB Magenta{ 1,0,1 };
+		inline constexpr ColorRGB White{ 1,1,1 };
+		inline constexpr ColorRGB Black{ 0,0,0 };
+		inline constexpr ColorRGB Gray{ 0.5f,0.5f,0.5f };
 	}
-}
\ No newline at end of file
+}
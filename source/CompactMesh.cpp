@@ -0,0 +1,302 @@
+#include "CompactMesh.h"
+
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		// Vertices per parallel task
+		constexpr uint32_t g_ChunkSize{ 4096 };
+		constexpr uint32_t g_MaxLeafSize{ UINT8_MAX };
+
+		float SurfaceArea(const Vector3& minAABB, const Vector3& maxAABB)
+		{
+			const Vector3 extent{ maxAABB - minAABB };
+			return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+		}
+	}
+
+	std::ostream& operator<<(std::ostream& os, const MeshMemoryReport& report)
+	{
+		constexpr double toKiB{ 1.0 / 1024.0 };
+		os << (report.isCompact ? "Compact mesh: " : "Mesh: ") << report.vertexCount << " vertices, " << report.triangleCount << " triangles"
+			<< " | " << report.GetTotalBytes() * toKiB << " KiB (positions " << report.positionBytes * toKiB
+			<< ", normals " << report.normalBytes * toKiB << ", indices " << report.indexBytes * toKiB << ", BVH " << report.bvhBytes * toKiB << ")";
+		return os;
+	}
+
+	void CompactMesh::Build(const Vector3* pPositions, uint32_t vertexCount, const int* pIndices, const Vector3* pNormals, uint32_t triangleCount, BVHBuilder builder)
+	{
+		m_Nodes.clear();
+		m_Positions.clear();
+		m_Normals.clear();
+		m_Indices.clear();
+		if (triangleCount == 0)
+			return;
+
+		//--------- Positions ---------
+		m_MinAABB = { FLT_MAX, FLT_MAX, FLT_MAX };
+		m_MaxAABB = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i{}; i < vertexCount; ++i)
+		{
+			m_MinAABB = Vector3::Min(m_MinAABB, pPositions[i]);
+			m_MaxAABB = Vector3::Max(m_MaxAABB, pPositions[i]);
+		}
+
+		m_Origin = m_MinAABB;
+		Vector3 invStep{};
+		for (int axis{}; axis < 3; ++axis)
+		{
+			const float extent{ m_MaxAABB[axis] - m_MinAABB[axis] };
+			m_Step[axis] = extent / UINT16_MAX;
+			invStep[axis] = extent > 0.f ? UINT16_MAX / extent : 0.f;
+		}
+
+		// The BVH is built over the snapped positions, so its boxes hold the triangles that actually get traced
+		m_Positions.resize(vertexCount);
+		std::vector<Vector3> snappedPositions(vertexCount);
+		const uint32_t chunkCount{ (vertexCount + g_ChunkSize - 1) / g_ChunkSize };
+		concurrency::parallel_for(0u, chunkCount, [&](uint32_t chunk)
+			{
+				const uint32_t end{ std::min(vertexCount, (chunk + 1) * g_ChunkSize) };
+				for (uint32_t i{ chunk * g_ChunkSize }; i < end; ++i)
+				{
+					uint16_t quantized[3]{};
+					for (int axis{}; axis < 3; ++axis)
+						quantized[axis] = static_cast<uint16_t>(std::clamp(std::lround((pPositions[i][axis] - m_Origin[axis]) * invStep[axis]), 0l, long(UINT16_MAX)));
+					m_Positions[i] = { quantized[0], quantized[1], quantized[2] };
+					snappedPositions[i] = GetPosition(i);
+				}
+			});
+
+		for (int axis{}; axis < 3; ++axis)
+			m_MaxAABB[axis] = m_Origin[axis] + UINT16_MAX * m_Step[axis];
+
+		BVH bvh{};
+		bvh.Build(builder == BVHBuilder::None ? BVHBuilder::BinnedSAH : builder, snappedPositions.data(), pIndices, triangleCount);
+
+		//--------- Triangles in leaf order ---------
+		const std::vector<uint32_t>& triangleOrder{ bvh.GetTriangleIndices() };
+		m_Indices.resize(3 * size_t(triangleCount));
+		m_Normals.resize(triangleCount);
+		for (uint32_t i{}; i < triangleCount; ++i)
+		{
+			const uint32_t triangle{ triangleOrder[i] };
+			m_Indices[3 * i] = pIndices[3 * triangle];
+			m_Indices[3 * i + 1] = pIndices[3 * triangle + 1];
+			m_Indices[3 * i + 2] = pIndices[3 * triangle + 2];
+			m_Normals[i] = EncodeOctahedral(pNormals[triangle]);
+		}
+
+		//--------- Wide nodes ---------
+		std::vector<CompactBVHNode> wideNodes{};
+		const std::vector<BVHNode>& binaryNodes{ bvh.GetNodes() };
+		if (binaryNodes[0].IsLeaf())
+			CreateLeafNode(binaryNodes[0].leftFirst, binaryNodes[0].triangleCount, wideNodes);
+		else
+			CollapseNode(binaryNodes, 0, wideNodes);
+		m_Nodes.assign(wideNodes.begin(), wideNodes.end());
+	}
+
+	uint32_t CompactMesh::CollapseNode(const std::vector<BVHNode>& binaryNodes, uint32_t binaryIndex, std::vector<CompactBVHNode>& wideNodes) const
+	{
+		// Pull grandchildren up until there are 4 children, always opening the biggest inner child
+		uint32_t children[CompactBVHNode::MaxChildren]{ binaryNodes[binaryIndex].leftFirst, binaryNodes[binaryIndex].leftFirst + 1 };
+		int childCount{ 2 };
+		while (childCount < CompactBVHNode::MaxChildren)
+		{
+			int biggest{ -1 };
+			float biggestArea{ -1.f };
+			for (int child{}; child < childCount; ++child)
+			{
+				const BVHNode& node{ binaryNodes[children[child]] };
+				const float area{ SurfaceArea(node.minAABB, node.maxAABB) };
+				if (!node.IsLeaf() && area > biggestArea)
+				{
+					biggest = child;
+					biggestArea = area;
+				}
+			}
+			if (biggest == -1)
+				break;
+
+			const uint32_t opened{ children[biggest] };
+			children[biggest] = binaryNodes[opened].leftFirst;
+			children[childCount++] = binaryNodes[opened].leftFirst + 1;
+		}
+
+		// Reserve the slot first, so parents always come before their children (root at 0)
+		const uint32_t wideIndex{ static_cast<uint32_t>(wideNodes.size()) };
+		wideNodes.emplace_back();
+
+		ChildInfo childInfos[CompactBVHNode::MaxChildren]{};
+		for (int child{}; child < childCount; ++child)
+		{
+			const BVHNode& node{ binaryNodes[children[child]] };
+			ChildInfo& info{ childInfos[child] };
+			info.minAABB = node.minAABB;
+			info.maxAABB = node.maxAABB;
+
+			if (!node.IsLeaf())
+				info.index = CollapseNode(binaryNodes, children[child], wideNodes);
+			else if (node.triangleCount > g_MaxLeafSize)
+				info.index = CreateLeafNode(node.leftFirst, node.triangleCount, wideNodes);
+			else
+			{
+				info.index = node.leftFirst;
+				info.triangleCount = node.triangleCount;
+			}
+		}
+
+		QuantizeNode(wideNodes[wideIndex], childInfos, childCount);
+		return wideIndex;
+	}
+
+	uint32_t CompactMesh::CreateLeafNode(uint32_t first, uint32_t count, std::vector<CompactBVHNode>& wideNodes) const
+	{
+		// Leaves only have 8 bits for their size, bigger ones (single leaf meshes, or the builders' depth limit) get split up
+		const uint32_t wideIndex{ static_cast<uint32_t>(wideNodes.size()) };
+		wideNodes.emplace_back();
+
+		const uint32_t chunkSize{ (count + CompactBVHNode::MaxChildren - 1) / CompactBVHNode::MaxChildren };
+		ChildInfo childInfos[CompactBVHNode::MaxChildren]{};
+		int childCount{};
+		for (uint32_t chunkFirst{ first }; chunkFirst < first + count; chunkFirst += chunkSize)
+		{
+			ChildInfo& info{ childInfos[childCount++] };
+			const uint32_t chunkCount{ std::min(chunkSize, first + count - chunkFirst) };
+			GetTriangleBounds(chunkFirst, chunkCount, info.minAABB, info.maxAABB);
+
+			if (chunkCount > g_MaxLeafSize)
+				info.index = CreateLeafNode(chunkFirst, chunkCount, wideNodes);
+			else
+			{
+				info.index = chunkFirst;
+				info.triangleCount = chunkCount;
+			}
+		}
+
+		QuantizeNode(wideNodes[wideIndex], childInfos, childCount);
+		return wideIndex;
+	}
+
+	void CompactMesh::QuantizeNode(CompactBVHNode& node, const ChildInfo* pChildren, int childCount)
+	{
+		Vector3 nodeMin{ pChildren[0].minAABB };
+		Vector3 nodeMax{ pChildren[0].maxAABB };
+		for (int child{ 1 }; child < childCount; ++child)
+		{
+			nodeMin = Vector3::Min(nodeMin, pChildren[child].minAABB);
+			nodeMax = Vector3::Max(nodeMax, pChildren[child].maxAABB);
+		}
+
+		node.childCount = static_cast<uint8_t>(childCount);
+		for (int axis{}; axis < 3; ++axis)
+		{
+			node.origin[axis] = nodeMin[axis];
+
+			// Smallest power of 2 step that still reaches the node's max in 255 steps
+			const float extent{ nodeMax[axis] - nodeMin[axis] };
+			int exponent{ extent > 0.f ? static_cast<int>(std::ceil(std::log2(extent / UINT8_MAX))) : -126 };
+			exponent = std::clamp(exponent, -126, 127);
+			node.exponent[axis] = static_cast<int8_t>(exponent);
+			// Rounding in the decode can land just short of the max, one step bigger fixes that
+			while (exponent < 127 && node.origin[axis] + UINT8_MAX * node.GetStep(axis) < nodeMax[axis])
+				node.exponent[axis] = static_cast<int8_t>(++exponent);
+
+			const float step{ node.GetStep(axis) };
+			for (int child{}; child < childCount; ++child)
+			{
+				node.quantizedMin[axis][child] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::floor((pChildren[child].minAABB[axis] - node.origin[axis]) / step)), 0, int(UINT8_MAX)));
+				node.quantizedMax[axis][child] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::ceil((pChildren[child].maxAABB[axis] - node.origin[axis]) / step)), 0, int(UINT8_MAX)));
+			}
+		}
+
+		// Check against the exact decode traversal uses & widen where rounding made a box too small
+		for (int child{}; child < childCount; ++child)
+		{
+			Vector3 decodedMin{};
+			Vector3 decodedMax{};
+			node.GetChildBounds(child, decodedMin, decodedMax);
+			for (int axis{}; axis < 3; ++axis)
+			{
+				while (node.quantizedMin[axis][child] > 0 && decodedMin[axis] > pChildren[child].minAABB[axis])
+				{
+					--node.quantizedMin[axis][child];
+					node.GetChildBounds(child, decodedMin, decodedMax);
+				}
+				while (node.quantizedMax[axis][child] < UINT8_MAX && decodedMax[axis] < pChildren[child].maxAABB[axis])
+				{
+					++node.quantizedMax[axis][child];
+					node.GetChildBounds(child, decodedMin, decodedMax);
+				}
+			}
+
+			node.childIndex[child] = pChildren[child].index;
+			node.triangleCount[child] = static_cast<uint8_t>(pChildren[child].triangleCount);
+		}
+	}
+
+	void CompactMesh::GetTriangleBounds(uint32_t first, uint32_t count, Vector3& minAABB, Vector3& maxAABB) const
+	{
+		minAABB = { FLT_MAX, FLT_MAX, FLT_MAX };
+		maxAABB = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i{ 3 * first }; i < 3 * (first + count); ++i)
+		{
+			const Vector3 position{ GetPosition(m_Indices[i]) };
+			minAABB = Vector3::Min(minAABB, position);
+			maxAABB = Vector3::Max(maxAABB, position);
+		}
+	}
+
+	MeshMemoryReport CompactMesh::GetMemoryReport() const
+	{
+		MeshMemoryReport report{};
+		report.isCompact = true;
+		report.vertexCount = m_Positions.size();
+		report.triangleCount = m_Normals.size();
+		report.positionBytes = m_Positions.capacity() * sizeof(QuantizedPosition);
+		report.normalBytes = m_Normals.capacity() * sizeof(uint32_t);
+		report.indexBytes = m_Indices.capacity() * sizeof(uint32_t);
+		report.bvhBytes = m_Nodes.capacity() * sizeof(CompactBVHNode);
+		return report;
+	}
+
+	void CompactMesh::Clear()
+	{
+		m_Nodes.clear();
+		m_Nodes.shrink_to_fit();
+		m_Positions.clear();
+		m_Positions.shrink_to_fit();
+		m_Normals.clear();
+		m_Normals.shrink_to_fit();
+		m_Indices.clear();
+		m_Indices.shrink_to_fit();
+		m_MinAABB = m_MaxAABB = m_Origin = m_Step = {};
+	}
+
+	uint32_t CompactMesh::EncodeOctahedral(const Vector3& normal)
+	{
+		const float l1Norm{ std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) };
+		// Degenerate triangles have no normal, they decode as +z
+		if (!(l1Norm > 0.f))
+			return 0;
+
+		float u{ normal.x / l1Norm };
+		float v{ normal.y / l1Norm };
+		if (normal.z < 0.f)
+		{
+			const float foldedU{ (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f) };
+			const float foldedV{ (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f) };
+			u = foldedU;
+			v = foldedV;
+		}
+
+		const auto toSnorm{ [](float value)
+			{
+				return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f))));
+			} };
+		return toSnorm(u) | (toSnorm(v) << 16);
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+
+#include "BVH.h"
+#include "Math.h"
+
+namespace dae
+{
+	// Bytes a mesh keeps alive, split up by what they're for
+	struct MeshMemoryReport
+	{
+		bool isCompact{};
+		size_t vertexCount{};
+		size_t triangleCount{};
+
+		size_t positionBytes{};
+		size_t normalBytes{};
+		size_t indexBytes{};
+		size_t bvhBytes{};
+
+		size_t GetTotalBytes() const { return positionBytes + normalBytes + indexBytes + bvhBytes; }
+	};
+
+	std::ostream& operator<<(std::ostream& os, const MeshMemoryReport& report);
+
+	// 4 wide node in one cache line, the child boxes are stored in 8 bits per side relative to the node's own box
+	// A decoded child box always encloses the real one, so quantizing only costs some extra box hits, never a missed triangle
+	struct CompactBVHNode
+	{
+		static constexpr int MaxChildren{ 4 };
+
+		float origin[3]{}; // Lower corner of the node
+		int8_t exponent[3]{}; // Per axis, one step of the quantized child bounds is 2^exponent
+		uint8_t childCount{};
+		// [axis][child], an axis of all children is next to each other
+		uint8_t quantizedMin[3][MaxChildren]{};
+		uint8_t quantizedMax[3][MaxChildren]{};
+		// Inner child: node index, leaf child: first triangle
+		uint32_t childIndex[MaxChildren]{};
+		// 0 for inner children
+		uint8_t triangleCount[MaxChildren]{};
+		uint8_t padding[4]{};
+
+		float GetStep(int axis) const
+		{
+			// Power of 2 steps keep the decode exact up to the final add
+			return std::bit_cast<float>(static_cast<uint32_t>(exponent[axis] + 127) << 23);
+		}
+
+		void GetChildBounds(int child, Vector3& minAABB, Vector3& maxAABB) const
+		{
+			for (int axis{}; axis < 3; ++axis)
+			{
+				const float step{ GetStep(axis) };
+				minAABB[axis] = origin[axis] + quantizedMin[axis][child] * step;
+				maxAABB[axis] = origin[axis] + quantizedMax[axis][child] * step;
+			}
+		}
+	};
+	static_assert(sizeof(CompactBVHNode) == 64);
+
+	// Position as 16 bit fractions of the mesh's bounding box
+	struct QuantizedPosition
+	{
+		uint16_t x{};
+		uint16_t y{};
+		uint16_t z{};
+	};
+
+	/**
+	 * \brief Read-only, bandwidth friendly copy of a mesh for big static assets
+	 * Positions are 6 instead of 16 bytes, normals 4 instead of 16 (octahedral), BVH nodes 16 bytes per child instead of 48,
+	 * & the triangles are stored in leaf order so traversal needs no triangle index list
+	 * Positions snap to 1/65535th of the mesh's extent per axis, shared vertices snap the same way so the mesh stays watertight
+	 * Traversed in GeometryUtils::HitTest_TriangleMesh
+	 */
+	class CompactMesh final
+	{
+	public:
+		CompactMesh() = default;
+		explicit CompactMesh(std::pmr::memory_resource* pResource) :
+			m_Nodes(pResource), m_Positions(pResource), m_Normals(pResource), m_Indices(pResource)
+		{
+		}
+
+		// Positions & (per triangle) normals in world space, the builder decides the BVH the wide nodes are collapsed from
+		void Build(const Vector3* pPositions, uint32_t vertexCount, const int* pIndices, const Vector3* pNormals, uint32_t triangleCount,
+			BVHBuilder builder = BVHBuilder::BinnedSAH);
+
+		bool Empty() const { return m_Nodes.empty(); }
+		// Gives the buffers back to their memory resource
+		void Clear();
+		uint32_t GetVertexCount() const { return static_cast<uint32_t>(m_Positions.size()); }
+		uint32_t GetTriangleCount() const { return static_cast<uint32_t>(m_Normals.size()); }
+
+		const std::pmr::vector<CompactBVHNode>& GetNodes() const { return m_Nodes; }
+		// 3 per triangle, in leaf order
+		const std::pmr::vector<uint32_t>& GetIndices() const { return m_Indices; }
+
+		Vector3 GetPosition(uint32_t vertex) const
+		{
+			const QuantizedPosition& position{ m_Positions[vertex] };
+			return { m_Origin.x + position.x * m_Step.x, m_Origin.y + position.y * m_Step.y, m_Origin.z + position.z * m_Step.z };
+		}
+
+		Vector3 GetNormal(uint32_t triangle) const { return DecodeOctahedral(m_Normals[triangle]); }
+
+		const Vector3& GetMinAABB() const { return m_MinAABB; }
+		const Vector3& GetMaxAABB() const { return m_MaxAABB; }
+
+		MeshMemoryReport GetMemoryReport() const;
+
+		// Unit vector as 2 16 bit snorms: projected onto an octahedron, the lower half folded over the upper one
+		static uint32_t EncodeOctahedral(const Vector3& normal);
+		static Vector3 DecodeOctahedral(uint32_t encoded)
+		{
+			float u{ static_cast<int16_t>(encoded & 0xFFFF) / 32767.f };
+			float v{ static_cast<int16_t>(encoded >> 16) / 32767.f };
+			const float z{ 1.f - std::abs(u) - std::abs(v) };
+			if (z < 0.f)
+			{
+				const float foldedU{ (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f) };
+				const float foldedV{ (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f) };
+				u = foldedU;
+				v = foldedV;
+			}
+			return Vector3{ u, v, z }.Normalized();
+		}
+
+	private:
+		struct ChildInfo
+		{
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			uint32_t index{};
+			uint32_t triangleCount{};
+		};
+
+		// Both return the index of the new wide node, built in a heap vector so the arena only gets the final size
+		uint32_t CollapseNode(const std::vector<BVHNode>& binaryNodes, uint32_t binaryIndex, std::vector<CompactBVHNode>& wideNodes) const;
+		uint32_t CreateLeafNode(uint32_t first, uint32_t count, std::vector<CompactBVHNode>& wideNodes) const;
+		static void QuantizeNode(CompactBVHNode& node, const ChildInfo* pChildren, int childCount);
+		void GetTriangleBounds(uint32_t first, uint32_t count, Vector3& minAABB, Vector3& maxAABB) const;
+
+		std::pmr::vector<CompactBVHNode> m_Nodes{};
+		std::pmr::vector<QuantizedPosition> m_Positions{};
+		std::pmr::vector<uint32_t> m_Normals{};
+		std::pmr::vector<uint32_t> m_Indices{};
+
+		// Decoded position = origin + quantized * step, per axis
+		Vector3 m_Origin{};
+		Vector3 m_Step{};
+		Vector3 m_MinAABB{};
+		Vector3 m_MaxAABB{};
+	};
+}
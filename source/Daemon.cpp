@@ -0,0 +1,610 @@
+#include "Daemon.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "SDL.h"
+
+#include "Camera.h"
+#include "Headless.h"
+#include "ImageWriter.h"
+#include "Network.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+namespace dae
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		enum class MessageType : uint32_t
+		{
+			Submit, // Client -> daemon: JobRequest
+			JobDone, // Daemon -> client: JobResult
+			StatsRequest, // Client -> daemon
+			Stats, // Daemon -> client: text
+			Shutdown // Client -> daemon, answered with the final Stats
+		};
+
+		static_assert(std::is_trivially_copyable_v<Daemon::JobRequest>);
+		static_assert(std::is_trivially_copyable_v<Daemon::JobResult>);
+
+		struct Job
+		{
+			uint64_t id{};
+			uint64_t connectionId{};
+			Daemon::JobRequest request{};
+			Clock::time_point received{};
+		};
+
+		// Highest priority on top, then the oldest job
+		struct JobOrder
+		{
+			bool operator()(const Job& a, const Job& b) const
+			{
+				return a.request.priority != b.request.priority ? a.request.priority < b.request.priority : a.id > b.id;
+			}
+		};
+
+		struct CompletedJob
+		{
+			uint64_t connectionId{};
+			Daemon::JobResult result{};
+		};
+
+		struct Connection
+		{
+			uint64_t id{};
+			Network::Socket socket{};
+		};
+
+		struct CachedScene
+		{
+			std::string name{};
+			uint64_t contentHash{};
+			std::unique_ptr<Scene> pScene{};
+			// Jobs without a camera of their own get this one back
+			Camera initialCamera{};
+			uint64_t lastUsedJob{};
+		};
+
+		// One hidden window & renderer per resolution
+		struct LatencyStats
+		{
+			// Only the most recent samples, a daemon can run for days
+			static constexpr size_t MaxSamples{ 4096 };
+			std::vector<float> samples{};
+			size_t next{};
+			double sum{};
+			uint64_t count{};
+			float max{};
+
+			void Add(float value)
+			{
+				if (samples.size() < MaxSamples)
+					samples.push_back(value);
+				else
+					samples[next++ % MaxSamples] = value;
+				sum += value;
+				++count;
+				max = std::max(max, value);
+			}
+
+			float GetPercentile(float percentile) const
+			{
+				if (samples.empty())
+					return 0.f;
+				std::vector<float> sorted{ samples };
+				const size_t index{ std::min(sorted.size() - 1, static_cast<size_t>(percentile * sorted.size())) };
+				std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+				return sorted[index];
+			}
+
+			float GetMean() const { return count > 0 ? static_cast<float>(sum / count) : 0.f; }
+		};
+
+		std::ostream& operator<<(std::ostream& os, const LatencyStats& stats)
+		{
+			return os << "mean " << stats.GetMean() << ", p50 " << stats.GetPercentile(0.5f) << ", p95 " << stats.GetPercentile(0.95f) << ", max " << stats.max;
+		}
+
+		// FNV-1a
+		uint64_t HashBytes(const void* pData, size_t size, uint64_t hash = 14695981039346656037ull)
+		{
+			const uint8_t* pBytes{ static_cast<const uint8_t*>(pData) };
+			for (size_t i{}; i < size; ++i)
+				hash = (hash ^ pBytes[i]) * 1099511628211ull;
+			return hash;
+		}
+
+		// Name & the contents of every file the scene reads, a missing file hashes as its path only
+		uint64_t HashSceneInputs(const std::string& sceneName, const std::vector<std::string>& resourceFiles)
+		{
+			uint64_t hash{ HashBytes(sceneName.data(), sceneName.size()) };
+			std::vector<char> contents{};
+			for (const std::string& fileName : resourceFiles)
+			{
+				hash = HashBytes(fileName.data(), fileName.size(), hash);
+				std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+				if (!file)
+					continue;
+				contents.resize(static_cast<size_t>(file.tellg()));
+				file.seekg(0);
+				file.read(contents.data(), contents.size());
+				hash = HashBytes(contents.data(), contents.size(), hash);
+			}
+			return hash;
+		}
+
+		bool GetImageFormat(const std::string& fileName, ImageFormat& format)
+		{
+			std::string extension{ std::filesystem::path(fileName).extension().string() };
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			for (ImageFormat candidate : { ImageFormat::PNG, ImageFormat::PPM, ImageFormat::PFM, ImageFormat::EXR })
+			{
+				if (extension == std::string(".") + ImageWriter::GetExtension(candidate))
+				{
+					format = candidate;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		float MillisecondsBetween(Clock::time_point start, Clock::time_point end)
+		{
+			return std::chrono::duration<float, std::milli>(end - start).count();
+		}
+
+		class DaemonServer final
+		{
+		public:
+			explicit DaemonServer(const Daemon::Settings& settings) : m_Settings{ settings } {}
+			~DaemonServer();
+
+			DaemonServer(const DaemonServer&) = delete;
+			DaemonServer(DaemonServer&&) noexcept = delete;
+			DaemonServer& operator=(const DaemonServer&) = delete;
+			DaemonServer& operator=(DaemonServer&&) noexcept = delete;
+
+			bool Start();
+			// Renders jobs on the calling thread (SDL wants its windows on the main thread) until a shutdown drained the queue
+			void RunJobs();
+			std::string GetStats();
+
+		private:
+			void NetworkThread();
+			void HandleMessage(Connection& connection, const Network::MessageHeader& header, const std::vector<uint8_t>& payload);
+			void DeliverResults();
+
+			Daemon::JobResult RenderJob(const Job& job);
+			CachedScene* GetScene(const std::string& name, uint64_t jobId, bool& isHit);
+			Renderer* GetRenderer(int width, int height);
+
+			const Daemon::Settings m_Settings;
+			Network::Socket m_Listener{};
+			std::thread m_NetworkThread{};
+			std::atomic<bool> m_IsNetworkDone{ false };
+
+			// Only touched by the network thread
+			std::vector<Connection> m_Connections{};
+			std::vector<uint64_t> m_ShutdownConnections{};
+			uint64_t m_NextConnectionId{};
+
+			// Only touched by the job thread
+			std::map<std::string, std::vector<std::string>> m_SceneResources{};
+			std::map<std::pair<int, int>, std::unique_ptr<HeadlessRenderer>> m_RenderTargets{};
+
+			// Shared, behind m_Mutex
+			std::mutex m_Mutex{};
+			std::condition_variable m_JobAdded{};
+			std::priority_queue<Job, std::vector<Job>, JobOrder> m_Queue{};
+			std::vector<CompletedJob> m_Completed{};
+			bool m_IsStopping{};
+			uint64_t m_NextJobId{ 1 };
+			// The job thread reads it without the lock, only changes go through it
+			std::vector<CachedScene> m_Scenes{};
+
+			uint64_t m_JobsReceived{};
+			uint64_t m_JobsRejected{};
+			uint64_t m_JobsCompleted{};
+			uint64_t m_JobsFailed{};
+			size_t m_MaxQueueDepth{};
+			uint64_t m_CacheHits{};
+			uint64_t m_CacheMisses{};
+			uint64_t m_CacheStale{};
+			uint64_t m_CacheEvictions{};
+			LatencyStats m_TotalLatency{};
+			LatencyStats m_QueueLatency{};
+			LatencyStats m_RenderLatency{};
+		};
+
+		DaemonServer::~DaemonServer()
+		{
+			m_IsNetworkDone = true;
+			if (m_NetworkThread.joinable())
+				m_NetworkThread.join();
+
+			m_RenderTargets.clear();
+
+			m_Listener.Close();
+			std::error_code error{};
+			std::filesystem::remove(m_Settings.socketPath, error);
+		}
+
+		bool DaemonServer::Start()
+		{
+			if (!m_Listener.ListenLocal(m_Settings.socketPath))
+				return false;
+			m_NetworkThread = std::thread{ &DaemonServer::NetworkThread, this };
+			return true;
+		}
+
+#pragma region Network
+		void DaemonServer::NetworkThread()
+		{
+			Network::MessageHeader header{};
+			std::vector<uint8_t> payload{};
+			while (!m_IsNetworkDone)
+			{
+				std::vector<const Network::Socket*> sockets{ &m_Listener };
+				for (const Connection& connection : m_Connections)
+					sockets.push_back(&connection.socket);
+
+				// Short timeout, finished jobs are picked up in between
+				for (size_t i : Network::WaitForAny(sockets, 10))
+				{
+					if (i == 0)
+					{
+						Connection connection{ m_NextConnectionId++, m_Listener.Accept() };
+						if (connection.socket.IsValid())
+							m_Connections.push_back(std::move(connection));
+						continue;
+					}
+
+					Connection& connection{ m_Connections[i - 1] };
+					if (connection.socket.ReadMessage(header, payload))
+						HandleMessage(connection, header, payload);
+					else
+						connection.socket.Close(); // Its jobs still run, the results just have nowhere to go
+				}
+
+				std::erase_if(m_Connections, [](const Connection& connection) { return !connection.socket.IsValid(); });
+				DeliverResults();
+			}
+
+			// Last results of the drained queue & the final stats for whoever asked for the shutdown
+			DeliverResults();
+			const std::string stats{ GetStats() };
+			for (const Connection& connection : m_Connections)
+			{
+				if (std::find(m_ShutdownConnections.begin(), m_ShutdownConnections.end(), connection.id) != m_ShutdownConnections.end())
+					connection.socket.WriteMessage(uint32_t(MessageType::Stats), stats.data(), stats.size());
+			}
+			m_Connections.clear();
+		}
+
+		void DaemonServer::HandleMessage(Connection& connection, const Network::MessageHeader& header, const std::vector<uint8_t>& payload)
+		{
+			switch (static_cast<MessageType>(header.type))
+			{
+			case MessageType::Submit:
+			{
+				Job job{};
+				job.connectionId = connection.id;
+				job.received = Clock::now();
+				bool isValid{ payload.size() == sizeof(job.request) };
+				if (isValid)
+				{
+					std::memcpy(&job.request, payload.data(), sizeof(job.request));
+					job.request.sceneName[sizeof(job.request.sceneName) - 1] = '\0';
+					job.request.outputFile[sizeof(job.request.outputFile) - 1] = '\0';
+					ImageFormat format{};
+					isValid = job.request.width > 0 && job.request.width <= 8192 && job.request.height > 0 && job.request.height <= 8192
+						&& GetImageFormat(job.request.outputFile, format);
+				}
+
+				{
+					const std::lock_guard lock{ m_Mutex };
+					// No new work once a shutdown was asked for
+					if (isValid && !m_IsStopping)
+					{
+						job.id = m_NextJobId++;
+						++m_JobsReceived;
+						m_Queue.push(job);
+						m_MaxQueueDepth = std::max(m_MaxQueueDepth, m_Queue.size());
+						m_JobAdded.notify_one();
+						return;
+					}
+					++m_JobsRejected;
+				}
+				const Daemon::JobResult result{};
+				connection.socket.WriteMessage(uint32_t(MessageType::JobDone), &result, sizeof(result));
+				break;
+			}
+			case MessageType::StatsRequest:
+			{
+				const std::string stats{ GetStats() };
+				connection.socket.WriteMessage(uint32_t(MessageType::Stats), stats.data(), stats.size());
+				break;
+			}
+			case MessageType::Shutdown:
+			{
+				m_ShutdownConnections.push_back(connection.id);
+				const std::lock_guard lock{ m_Mutex };
+				m_IsStopping = true;
+				m_JobAdded.notify_one();
+				break;
+			}
+			default:
+				connection.socket.Close();
+				break;
+			}
+		}
+
+		void DaemonServer::DeliverResults()
+		{
+			std::vector<CompletedJob> completed{};
+			{
+				const std::lock_guard lock{ m_Mutex };
+				completed.swap(m_Completed);
+			}
+
+			for (const CompletedJob& job : completed)
+			{
+				const auto connectionIt{ std::find_if(m_Connections.begin(), m_Connections.end(),
+					[&](const Connection& connection) { return connection.id == job.connectionId; }) };
+				if (connectionIt != m_Connections.end())
+					connectionIt->socket.WriteMessage(uint32_t(MessageType::JobDone), &job.result, sizeof(job.result));
+			}
+		}
+#pragma endregion
+
+#pragma region Jobs
+		void DaemonServer::RunJobs()
+		{
+			for (;;)
+			{
+				Job job{};
+				{
+					std::unique_lock lock{ m_Mutex };
+					m_JobAdded.wait(lock, [this] { return !m_Queue.empty() || m_IsStopping; });
+					if (m_Queue.empty())
+						break;
+					job = m_Queue.top();
+					m_Queue.pop();
+				}
+
+				const Daemon::JobResult result{ RenderJob(job) };
+				std::cout << ">> Job " << result.jobId << " " << job.request.sceneName << " " << job.request.width << "x" << job.request.height
+					<< " PRIORITY = " << job.request.priority << " CACHE = " << (result.cacheHit ? "HIT" : "MISS")
+					<< " QUEUE_MS = " << result.queueMs << " LOAD_MS = " << result.loadMs << " RENDER_MS = " << result.renderMs
+					<< " TOTAL_MS = " << result.totalMs << " RESULT = " << (result.succeeded ? "OK" : "FAILED") << "\n";
+
+				const std::lock_guard lock{ m_Mutex };
+				if (result.succeeded)
+					++m_JobsCompleted;
+				else
+					++m_JobsFailed;
+				m_TotalLatency.Add(result.totalMs);
+				m_QueueLatency.Add(result.queueMs);
+				m_RenderLatency.Add(result.renderMs);
+				m_Completed.push_back({ job.connectionId, result });
+			}
+
+			m_IsNetworkDone = true;
+			m_NetworkThread.join();
+
+			std::ofstream statsFile(m_Settings.statsFile);
+			statsFile << GetStats();
+		}
+
+		Daemon::JobResult DaemonServer::RenderJob(const Job& job)
+		{
+			const Clock::time_point start{ Clock::now() };
+			Daemon::JobResult result{};
+			result.jobId = job.id;
+			result.queueMs = MillisecondsBetween(job.received, start);
+
+			CachedScene* pCached{ GetScene(job.request.sceneName, job.id, result.cacheHit) };
+			Renderer* pRenderer{ pCached ? GetRenderer(job.request.width, job.request.height) : nullptr };
+			const Clock::time_point loaded{ Clock::now() };
+			result.loadMs = result.cacheHit ? 0.f : MillisecondsBetween(start, loaded);
+
+			if (pRenderer)
+			{
+				Scene* pScene{ pCached->pScene.get() };
+				Camera& camera{ pScene->GetCamera() };
+				camera = pCached->initialCamera;
+				if (job.request.overrideCamera)
+				{
+					camera.origin = job.request.cameraOrigin;
+					camera.totalPitch = job.request.cameraPitch;
+					camera.SetYaw(job.request.cameraYaw);
+					camera.SetFov(job.request.cameraFov);
+				}
+				pScene->SwapBuffers();
+
+				pRenderer->SetReflections(pScene->GetReflectionsEnabled());
+				// Present fills the window surface, 8 bit formats are captured from there
+				pRenderer->Render(pScene);
+
+				ImageFormat format{};
+				GetImageFormat(job.request.outputFile, format);
+				result.succeeded = ImageWriter::Write(pRenderer->CaptureFrame(format, job.request.outputFile));
+			}
+
+			const Clock::time_point end{ Clock::now() };
+			result.renderMs = MillisecondsBetween(loaded, end);
+			result.totalMs = MillisecondsBetween(job.received, end);
+			return result;
+		}
+
+		CachedScene* DaemonServer::GetScene(const std::string& name, uint64_t jobId, bool& isHit)
+		{
+			// Rehashing the inputs every job is what catches edited files, still far cheaper than parsing them again
+			const auto resourcesIt{ m_SceneResources.find(name) };
+			const uint64_t contentHash{ HashSceneInputs(name, resourcesIt != m_SceneResources.end() ? resourcesIt->second : std::vector<std::string>{}) };
+
+			std::unique_lock lock{ m_Mutex };
+			for (CachedScene& cached : m_Scenes)
+			{
+				if (cached.name == name && cached.contentHash == contentHash)
+				{
+					++m_CacheHits;
+					isHit = true;
+					cached.lastUsedJob = jobId;
+					return &cached;
+				}
+			}
+
+			++m_CacheMisses;
+			isHit = false;
+			const size_t staleCount{ std::erase_if(m_Scenes, [&](const CachedScene& cached) { return cached.name == name; }) };
+			m_CacheStale += staleCount;
+			lock.unlock();
+
+			CachedScene cached{};
+			cached.name = name;
+			cached.pScene.reset(CreateScene(name));
+			if (!cached.pScene)
+				return nullptr;
+			cached.pScene->Initialize();
+			cached.pScene->SwapBuffers();
+			cached.initialCamera = cached.pScene->GetCamera();
+			cached.lastUsedJob = jobId;
+			// Now the files are known, the next lookup hashes their contents too
+			m_SceneResources[name] = cached.pScene->GetResourceFiles();
+			cached.contentHash = HashSceneInputs(name, m_SceneResources[name]);
+
+			lock.lock();
+			if (m_Scenes.size() >= m_Settings.maxCachedScenes && !m_Scenes.empty())
+			{
+				m_Scenes.erase(std::min_element(m_Scenes.begin(), m_Scenes.end(),
+					[](const CachedScene& a, const CachedScene& b) { return a.lastUsedJob < b.lastUsedJob; }));
+				++m_CacheEvictions;
+			}
+			m_Scenes.push_back(std::move(cached));
+			return &m_Scenes.back();
+		}
+
+		Renderer* DaemonServer::GetRenderer(int width, int height)
+		{
+			std::unique_ptr<HeadlessRenderer>& pTarget{ m_RenderTargets[{ width, height }] };
+			// A window that failed before gets another try
+			if (!pTarget || !pTarget->IsValid())
+				pTarget = std::make_unique<HeadlessRenderer>("RayTracer - Daemon", width, height);
+			return pTarget->IsValid() ? &pTarget->GetRenderer() : nullptr;
+		}
+#pragma endregion
+
+		std::string DaemonServer::GetStats()
+		{
+			const std::lock_guard lock{ m_Mutex };
+			const uint64_t lookups{ m_CacheHits + m_CacheMisses };
+			std::ostringstream stats{};
+			stats << "Jobs: received " << m_JobsReceived << ", completed " << m_JobsCompleted << ", failed " << m_JobsFailed << ", rejected " << m_JobsRejected << "\n"
+				<< "Queue depth: " << m_Queue.size() << ", max " << m_MaxQueueDepth << "\n"
+				<< "Total ms: " << m_TotalLatency << "\n"
+				<< "Queue ms: " << m_QueueLatency << "\n"
+				<< "Render ms: " << m_RenderLatency << "\n"
+				<< "Scene cache: " << m_Scenes.size() << " scenes, hits " << m_CacheHits << ", misses " << m_CacheMisses
+				<< " (" << m_CacheStale << " stale), evictions " << m_CacheEvictions
+				<< ", hit rate " << (lookups > 0 ? 100.f * m_CacheHits / lookups : 0.f) << "%\n";
+			return stats.str();
+		}
+
+		// Client side: one request, one answer
+		bool Request(const std::string& socketPath, MessageType type, const void* pPayload, size_t size, MessageType answerType, std::vector<uint8_t>& answer)
+		{
+			Network::Socket connection{};
+			Network::MessageHeader header{};
+			if (!connection.ConnectLocal(socketPath))
+			{
+				std::cout << "No render daemon at " << socketPath << "\n";
+				return false;
+			}
+			return connection.WriteMessage(uint32_t(type), pPayload, size) && connection.ReadMessage(header, answer) && header.type == uint32_t(answerType);
+		}
+	}
+
+	int Daemon::Run(const Settings& settings)
+	{
+		if (!Network::Startup())
+			return 1;
+		SDL_Init(SDL_INIT_VIDEO);
+
+		int exitCode{ 1 };
+		{
+			DaemonServer server{ settings };
+			if (server.Start())
+			{
+				std::cout << "**DAEMON** listening on " << settings.socketPath << "\n";
+				server.RunJobs();
+				std::cout << server.GetStats();
+				exitCode = 0;
+			}
+			else
+			{
+				std::cout << "Daemon: can't listen on " << settings.socketPath << "\n";
+			}
+		}
+
+		SDL_Quit();
+		Network::Cleanup();
+		return exitCode;
+	}
+
+	int Daemon::Submit(const std::string& socketPath, const JobRequest& request)
+	{
+		Network::Startup();
+		std::vector<uint8_t> answer{};
+		JobResult result{};
+		if (Request(socketPath, MessageType::Submit, &request, sizeof(request), MessageType::JobDone, answer) && answer.size() == sizeof(result))
+			std::memcpy(&result, answer.data(), sizeof(result));
+		Network::Cleanup();
+
+		std::cout << "Job " << result.jobId << ": " << (result.succeeded ? "written to " + std::string(request.outputFile) : std::string("failed"))
+			<< " (cache " << (result.cacheHit ? "hit" : "miss") << ", queue " << result.queueMs << " ms, load " << result.loadMs
+			<< " ms, render " << result.renderMs << " ms, total " << result.totalMs << " ms)\n";
+		return result.succeeded ? 0 : 1;
+	}
+
+	int Daemon::PrintStats(const std::string& socketPath)
+	{
+		Network::Startup();
+		std::vector<uint8_t> answer{};
+		const bool hasAnswered{ Request(socketPath, MessageType::StatsRequest, nullptr, 0, MessageType::Stats, answer) };
+		Network::Cleanup();
+
+		std::cout << std::string(answer.begin(), answer.end());
+		return hasAnswered ? 0 : 1;
+	}
+
+	int Daemon::Stop(const std::string& socketPath)
+	{
+		Network::Startup();
+		std::vector<uint8_t> answer{};
+		const bool hasAnswered{ Request(socketPath, MessageType::Shutdown, nullptr, 0, MessageType::Stats, answer) };
+		Network::Cleanup();
+
+		std::cout << std::string(answer.begin(), answer.end());
+		return hasAnswered ? 0 : 1;
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "Math.h"
+
+namespace dae
+{
+	namespace Daemon
+	{
+		struct Settings
+		{
+			std::string socketPath{ "raytracer.sock" };
+			// Initialized scenes (parsed meshes, built BVHs) kept in memory, the least recently used one goes first
+			size_t maxCachedScenes{ 4 };
+			// Written on shutdown
+			std::string statsFile{ "daemon_stats.txt" };
+		};
+
+		// Sent as is, both ends are the same build
+		struct JobRequest
+		{
+			char sceneName[64]{}; // One of GetBuiltInScenes
+			char outputFile[260]{}; // Format from the extension: .png, .ppm, .pfm or .exr
+			int32_t width{ 640 };
+			int32_t height{ 480 };
+			// Higher runs first, equal priorities in the order they came in
+			int32_t priority{};
+
+			// Otherwise the scene's own camera
+			bool overrideCamera{};
+			Vector3 cameraOrigin{};
+			float cameraYaw{}; // Degrees
+			float cameraPitch{}; // Degrees
+			float cameraFov{ 45.f }; // Degrees
+		};
+
+		struct JobResult
+		{
+			uint64_t jobId{};
+			bool succeeded{};
+			bool cacheHit{};
+			float queueMs{}; // Waiting for its turn
+			float loadMs{}; // Building the scene, 0 on a cache hit
+			float renderMs{}; // Trace & image write
+			float totalMs{}; // Received to done
+		};
+
+		/**
+		 * \brief Long running render server on a Unix domain socket
+		 * Jobs are queued by priority & run one after the other, each one spreads its tiles over the shared thread pool
+		 * Initialized scenes are cached by a hash of their name & the contents of every file they load,
+		 * an edited OBJ makes the next job rebuild the scene instead of rendering the old one
+		 * Job latency, queue depth & cache hit rates are available through PrintStats & written to the stats file on shutdown
+		 * \return process exit code
+		 */
+		int Run(const Settings& settings);
+
+		// Client side, each returns a process exit code
+		// Blocks until the job is done
+		int Submit(const std::string& socketPath, const JobRequest& request);
+		int PrintStats(const std::string& socketPath);
+		// The daemon finishes the queued jobs first, then prints its final stats
+		int Stop(const std::string& socketPath);
+	}
+}
@@ -1,19 +1,27 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
+#include <memory_resource>
+#include <ppl.h>
 
+#include "BVH.h"
+#include "CompactMesh.h"
 #include "Math.h"
 #include "vector"
 #include <iostream>
 
 namespace dae
 {
+	// Index into the scene's MaterialRegistry
+	using MaterialId = uint32_t;
+
 #pragma region GEOMETRY
 	struct Sphere
 	{
 		Vector3 origin{};
 		float radius{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	struct Plane
@@ -21,7 +29,7 @@ namespace dae
 		Vector3 origin{};
 		Vector3 normal{};		
 
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	enum class TriangleCullMode
@@ -54,37 +62,60 @@ namespace dae
 		Vector3 normal{};
 
 		TriangleCullMode cullMode{};
-		unsigned char materialIndex{};
+		MaterialId materialIndex{};
 	};
 
+	// All buffers allocate from the given resource, scenes pass their GeometryArena
 	struct TriangleMesh
 	{
 		TriangleMesh() = default;
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), cullMode(_cullMode)
+		explicit TriangleMesh(std::pmr::memory_resource* pResource) :
+			positions(pResource), normals(pResource), indices(pResource),
+			transformedPositions(pResource), transformedNormals(pResource),
+			pendingPositions(pResource), pendingNormals(pResource), compact(pResource)
 		{
+		}
+
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, TriangleCullMode _cullMode,
+			std::pmr::memory_resource* pResource = std::pmr::get_default_resource()) :
+			TriangleMesh(pResource)
+		{
+			positions.assign(_positions.begin(), _positions.end());
+			indices.assign(_indices.begin(), _indices.end());
+			cullMode = _cullMode;
+
 			//Calculate Normals
 			CalculateNormals();
 
 			//Update Transforms
 			UpdateTransforms();
+			SwapTransforms();
 		}
 
-		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode) :
-			positions(_positions), indices(_indices), normals(_normals), cullMode(_cullMode)
+		TriangleMesh(const std::vector<Vector3>& _positions, const std::vector<int>& _indices, const std::vector<Vector3>& _normals, TriangleCullMode _cullMode,
+			std::pmr::memory_resource* pResource = std::pmr::get_default_resource()) :
+			TriangleMesh(pResource)
 		{
+			positions.assign(_positions.begin(), _positions.end());
+			indices.assign(_indices.begin(), _indices.end());
+			normals.assign(_normals.begin(), _normals.end());
+			cullMode = _cullMode;
+
 			UpdateTransforms();
+			SwapTransforms();
 		}
 
 		
 
-		std::vector<Vector3> positions{};
-		std::vector<Vector3> normals{};
-		std::vector<int> indices{};
-		unsigned char materialIndex{};
+		std::pmr::vector<Vector3> positions{};
+		std::pmr::vector<Vector3> normals{};
+		std::pmr::vector<int> indices{};
+		MaterialId materialIndex{};
 
 		TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
 		bool doSlabTest{ true };
+		// Rebuilt in every UpdateTransforms, set before the first one (BVH::GetReport helps picking)
+		BVHBuilder bvhBuilder{ BVHBuilder::None };
 
 		Matrix rotationTransform{};
 		Matrix translationTransform{};
@@ -99,8 +130,46 @@ namespace dae
 		Vector3 transformedMaxAABB{};
 
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		std::pmr::vector<Vector3> transformedPositions{};
+		std::pmr::vector<Vector3> transformedNormals{};
+		// Over the transformed triangles, empty without a builder
+		BVH bvh{};
+
+		// Back buffer for the transformed data, UpdateTransforms writes here while the renderer may still read the front buffer
+		// SwapTransforms publishes it, so next frame's transforms can be computed while the current frame is traced
+		// Both are sized once, after that UpdateTransforms only overwrites them (no allocations per frame)
+		std::pmr::vector<Vector3> pendingPositions{};
+		std::pmr::vector<Vector3> pendingNormals{};
+		Vector3 pendingMinAABB{};
+		Vector3 pendingMaxAABB{};
+		BVH pendingBVH{};
+		bool hasPendingTransforms{ false };
+
+		// Replaces all of the above when not empty, see Scene::AddCompactTriangleMesh
+		CompactMesh compact{};
+
+		// Meshes of a scene instance (Scene::InitializeInstance) read positions, normals, indices & the compact mesh from here
+		// & leave their own empty, only the transformed data & the BVH are per instance
+		const TriangleMesh* pSourceMesh{};
+
+		const std::pmr::vector<Vector3>& GetPositions() const { return pSourceMesh ? pSourceMesh->positions : positions; }
+		const std::pmr::vector<Vector3>& GetNormals() const { return pSourceMesh ? pSourceMesh->normals : normals; }
+		const std::pmr::vector<int>& GetIndices() const { return pSourceMesh ? pSourceMesh->indices : indices; }
+		const CompactMesh& GetCompact() const { return pSourceMesh ? pSourceMesh->compact : compact; }
+
+		// The source has to outlive this mesh & never change its buffers again
+		void ShareSource(const TriangleMesh& source)
+		{
+			// Released into the scene's pool, the next allocations reuse the memory
+			positions.clear();
+			positions.shrink_to_fit();
+			normals.clear();
+			normals.shrink_to_fit();
+			indices.clear();
+			indices.shrink_to_fit();
+			compact.Clear();
+			pSourceMesh = &source;
+		}
 
 
 		void Translate(const Vector3& translation)
@@ -164,29 +233,82 @@ namespace dae
 
 		void UpdateTransforms()
 		{
+			// Compact meshes have their transform baked in
+			if (!GetCompact().Empty())
+				return;
+
+			const std::pmr::vector<Vector3>& sourcePositions{ GetPositions() };
+			const std::pmr::vector<Vector3>& sourceNormals{ GetNormals() };
+			const std::pmr::vector<int>& sourceIndices{ GetIndices() };
+
 			//Calculate Final Transform 
 			// First scale, then rotate, then translate
 			const auto finalTransform = scaleTransform * rotationTransform * translationTransform;
 
+			// Vertices per task, big meshes get transformed on all cores
+			constexpr size_t chunkSize{ 8192 };
+
 			// Loop over every position & apply the transformation
-			transformedPositions.clear();
-			transformedPositions.reserve(positions.size());
-			for (const Vector3& p : positions)
-			{
-				transformedPositions.emplace_back(finalTransform.TransformPoint(p));
-			}
+			pendingPositions.resize(sourcePositions.size());
+			concurrency::parallel_for(size_t{}, (sourcePositions.size() + chunkSize - 1) / chunkSize, [&](size_t chunk)
+				{
+					const size_t end{ std::min(sourcePositions.size(), (chunk + 1) * chunkSize) };
+					for (size_t i{ chunk * chunkSize }; i < end; ++i)
+						pendingPositions[i] = finalTransform.TransformPoint(sourcePositions[i]);
+				});
 
 
-			//Transform Normals (normals > transformedNormals)
+			//Transform Normals (normals > pendingNormals)
 			//...
-			transformedNormals.clear();
-			transformedNormals.reserve(normals.size());
-			for (const Vector3& n : normals)
+			pendingNormals.resize(sourceNormals.size());
+			concurrency::parallel_for(size_t{}, (sourceNormals.size() + chunkSize - 1) / chunkSize, [&](size_t chunk)
+				{
+					const size_t end{ std::min(sourceNormals.size(), (chunk + 1) * chunkSize) };
+					for (size_t i{ chunk * chunkSize }; i < end; ++i)
+						pendingNormals[i] = rotationTransform.TransformVector(sourceNormals[i]);
+				});
+
+			UpdateTransformedAABB(finalTransform);
+
+			// Built over the new positions, so it gets swapped in together with them
+			pendingBVH.Build(bvhBuilder, pendingPositions.data(), sourceIndices.data(), static_cast<uint32_t>(sourceIndices.size() / 3));
+			hasPendingTransforms = true;
+		}
+
+		// Makes the last UpdateTransforms visible to the renderer, only call when no frame is being traced
+		void SwapTransforms()
+		{
+			if (!hasPendingTransforms)
+				return;
+
+			// Swapping keeps both allocations alive, so steady state updates don't allocate
+			transformedPositions.swap(pendingPositions);
+			transformedNormals.swap(pendingNormals);
+			std::swap(bvh, pendingBVH);
+			transformedMinAABB = pendingMinAABB;
+			transformedMaxAABB = pendingMaxAABB;
+			hasPendingTransforms = false;
+		}
+
+		MeshMemoryReport GetMemoryReport() const
+		{
+			// Shared source buffers count towards the prototype's mesh only
+			if (!GetCompact().Empty())
 			{
-				transformedNormals.emplace_back(rotationTransform.TransformVector(n));
+				MeshMemoryReport report{ GetCompact().GetMemoryReport() };
+				if (pSourceMesh)
+					report.positionBytes = report.normalBytes = report.indexBytes = report.bvhBytes = 0;
+				return report;
 			}
 
-			UpdateTransformedAABB(finalTransform);
+			MeshMemoryReport report{};
+			report.vertexCount = GetPositions().size();
+			report.triangleCount = GetIndices().size() / 3;
+			report.positionBytes = (positions.capacity() + transformedPositions.capacity() + pendingPositions.capacity()) * sizeof(Vector3);
+			report.normalBytes = (normals.capacity() + transformedNormals.capacity() + pendingNormals.capacity()) * sizeof(Vector3);
+			report.indexBytes = indices.capacity() * sizeof(int);
+			report.bvhBytes = bvh.GetMemoryBytes() + pendingBVH.GetMemoryBytes();
+			return report;
 		}
 
 		void UpdateAABB()
@@ -197,7 +319,7 @@ namespace dae
 			maxAABB = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
 
 			// Loop over every position, compare with the current min & max, and update it with the new min / max
-			for (const Vector3& p : positions)
+			for (const Vector3& p : GetPositions())
 			{
 				minAABB = Vector3::Min(minAABB, p);
 				maxAABB = Vector3::Max(maxAABB, p);
@@ -238,8 +360,8 @@ namespace dae
 			tAABB = finalTransform.TransformPoint(minAABB.x, maxAABB.y, minAABB.z);
 			tMinAABB = Vector3::Min(tAABB, tMinAABB);
 			tMaxAABB = Vector3::Max(tAABB, tMaxAABB);
-			transformedMinAABB = tMinAABB;
-			transformedMaxAABB = tMaxAABB;			
+			pendingMinAABB = tMinAABB;
+			pendingMaxAABB = tMaxAABB;
 		}
 	};
 #pragma endregion
@@ -270,6 +392,32 @@ namespace dae
 		float max{ FLT_MAX };
 	};
 
+	enum class PrimitiveType
+	{
+		None,
+		Plane,
+		Sphere,
+		Triangle
+	};
+
+	// What traversal keeps of the closest hit so far, 24 bytes instead of HitRecord's 48
+	// Point, normal & material are only worked out for the final hit (GeometryUtils::ResolveHit), not for every candidate that gets beaten later
+	struct HitCandidate
+	{
+		float t{ FLT_MAX };
+		// Plane/sphere in the scene's list, or the triangle in its mesh (in the compact mesh's order if it has one)
+		uint32_t primitiveIndex{};
+		// Mesh the triangle belongs to
+		uint32_t instanceIndex{};
+		// Barycentrics of v1 & v2, triangles only
+		float u{};
+		float v{};
+
+		PrimitiveType type{ PrimitiveType::None };
+
+		bool DidHit() const { return type != PrimitiveType::None; }
+	};
+
 	struct HitRecord
 	{
 		Vector3 origin{};
@@ -277,7 +425,7 @@ namespace dae
 		float t = FLT_MAX;
 
 		bool didHit{ false };
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 #pragma endregion
 }
\ No newline at end of file
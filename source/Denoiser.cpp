@@ -0,0 +1,295 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		// B3 spline, the 5x5 kernel is the outer product of this with itself
+		constexpr float g_Kernel[5]{ 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+		// Keeps black channels from blowing up the division, they're multiplied back with the same value
+		constexpr float g_MinAlbedo{ 0.01f };
+		// History is thrown away where the surface moved more than this (relative depth) or turned more than this (normal dot)
+		constexpr float g_MaxHistoryDepthChange{ 0.05f };
+		constexpr float g_MinHistoryNormalDot{ 0.9f };
+		// Taps further off than e^-30 count for nothing anyway, without the cap their weights go denormal & every add on them crawls
+		constexpr float g_MaxExponent{ 30.f };
+
+		constexpr int g_TapCount{ 25 };
+		constexpr int g_CenterTap{ 12 };
+
+		// Everything one à-trous pass needs, shared by all rows
+		struct FilterPass
+		{
+			const ColorRGB* pSource{};
+			// c / (1 + c) of the source, for the color distances
+			const ColorRGB* pCompressed{};
+			ColorRGB* pDestination{};
+			const FeatureBuffers* pFeatures{};
+			int width{};
+			int height{};
+			int stepWidth{};
+			float colorWeight{};
+			float normalPower{};
+			float depthSigma{};
+			float kernelWeights[g_TapCount]{};
+			// 1 / distance of every tap in pixels, 0 for the center which has no depth change to scale
+			float inverseDistances[g_TapCount]{};
+		};
+
+		// x, y & z (or r, g & b) of 4 consecutive Vector3s or ColorRGBs, one register each
+		void LoadTransposed(const float* p, __m128& x, __m128& y, __m128& z)
+		{
+			__m128 row0{ simd::Load(p) }, row1{ simd::Load(p + 4) }, row2{ simd::Load(p + 8) }, row3{ simd::Load(p + 12) };
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			x = row0;
+			y = row1;
+			z = row2;
+		}
+
+		// Any pixel, taps off the image are skipped
+		void FilterPixel(const FilterPass& pass, int x, int y)
+		{
+			const FeatureBuffers& features{ *pass.pFeatures };
+			const int pixelIndex{ x + y * pass.width };
+			const float depth{ features.depths[pixelIndex] };
+			// The sky has no noise to remove
+			if (depth <= 0.f)
+			{
+				pass.pDestination[pixelIndex] = pass.pSource[pixelIndex];
+				return;
+			}
+
+			const __m128 center{ pass.pCompressed[pixelIndex].Load() };
+			const __m128 normal{ features.normals[pixelIndex].Load() };
+			const float depthScale{ 1.f / (pass.depthSigma * depth) };
+
+			// The center always counts fully, so the weights can't all be 0 (e.g. on a normal averaged to nothing at a silhouette)
+			__m128 weightSum{ simd::Splat(pass.kernelWeights[g_CenterTap]) };
+			__m128 sum{ _mm_mul_ps(pass.pSource[pixelIndex].Load(), weightSum) };
+			for (int tap{}; tap < g_TapCount; ++tap)
+			{
+				const int sampleX{ x + (tap % 5 - 2) * pass.stepWidth };
+				const int sampleY{ y + (tap / 5 - 2) * pass.stepWidth };
+				const int sampleIndex{ sampleX + sampleY * pass.width };
+				if (tap == g_CenterTap || sampleX < 0 || sampleX >= pass.width || sampleY < 0 || sampleY >= pass.height || features.depths[sampleIndex] <= 0.f)
+					continue;
+
+				// Color, normal & depth terms multiply, so their exponents add up & one exp per tap does it
+				const __m128 difference{ _mm_sub_ps(center, pass.pCompressed[sampleIndex].Load()) };
+				const float normalDot{ simd::Dot3(normal, features.normals[sampleIndex].Load()) };
+				const float exponent{ simd::Dot3(difference, difference) * pass.colorWeight
+					+ pass.normalPower * std::max(0.f, 1.f - normalDot)
+					+ std::abs(depth - features.depths[sampleIndex]) * depthScale * pass.inverseDistances[tap] };
+				const __m128 weight{ _mm_mul_ps(simd::Splat(pass.kernelWeights[tap]), simd::Exp(simd::Splat(-std::min(exponent, g_MaxExponent)))) };
+				sum = simd::MulAdd(pass.pSource[sampleIndex].Load(), weight, sum);
+				weightSum = _mm_add_ps(weightSum, weight);
+			}
+			pass.pDestination[pixelIndex] = ColorRGB::FromRegister(_mm_div_ps(sum, weightSum));
+		}
+
+		// Same as FilterPixel for x to x + 3, one pixel per lane. Every tap has to be inside the row
+		void FilterQuad(const FilterPass& pass, int x, int y)
+		{
+			const FeatureBuffers& features{ *pass.pFeatures };
+			const int pixelIndex{ x + y * pass.width };
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ simd::Splat(1.f) };
+			const __m128 absMask{ _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)) };
+
+			const __m128 depth{ _mm_loadu_ps(&features.depths[pixelIndex]) };
+			const __m128 depthScale{ _mm_div_ps(one, _mm_mul_ps(simd::Splat(pass.depthSigma), _mm_max_ps(depth, simd::Splat(FLT_MIN)))) };
+			__m128 centerR, centerG, centerB;
+			LoadTransposed(&pass.pCompressed[pixelIndex].r, centerR, centerG, centerB);
+			__m128 normalX, normalY, normalZ;
+			LoadTransposed(&features.normals[pixelIndex].x, normalX, normalY, normalZ);
+
+			__m128 weightSum{ simd::Splat(pass.kernelWeights[g_CenterTap]) };
+			__m128 sumR, sumG, sumB;
+			LoadTransposed(&pass.pSource[pixelIndex].r, sumR, sumG, sumB);
+			sumR = _mm_mul_ps(sumR, weightSum);
+			sumG = _mm_mul_ps(sumG, weightSum);
+			sumB = _mm_mul_ps(sumB, weightSum);
+
+			for (int tap{}; tap < g_TapCount; ++tap)
+			{
+				const int sampleY{ y + (tap / 5 - 2) * pass.stepWidth };
+				if (tap == g_CenterTap || sampleY < 0 || sampleY >= pass.height)
+					continue;
+				const int sampleIndex{ x + (tap % 5 - 2) * pass.stepWidth + sampleY * pass.width };
+
+				const __m128 sampleDepth{ _mm_loadu_ps(&features.depths[sampleIndex]) };
+				__m128 sampleR, sampleG, sampleB;
+				LoadTransposed(&pass.pCompressed[sampleIndex].r, sampleR, sampleG, sampleB);
+				const __m128 differenceR{ _mm_sub_ps(centerR, sampleR) };
+				const __m128 differenceG{ _mm_sub_ps(centerG, sampleG) };
+				const __m128 differenceB{ _mm_sub_ps(centerB, sampleB) };
+				const __m128 colorDistance{ simd::MulAdd(differenceB, differenceB, simd::MulAdd(differenceG, differenceG, _mm_mul_ps(differenceR, differenceR))) };
+
+				__m128 sampleNormalX, sampleNormalY, sampleNormalZ;
+				LoadTransposed(&features.normals[sampleIndex].x, sampleNormalX, sampleNormalY, sampleNormalZ);
+				const __m128 normalDot{ simd::MulAdd(normalZ, sampleNormalZ, simd::MulAdd(normalY, sampleNormalY, _mm_mul_ps(normalX, sampleNormalX))) };
+
+				__m128 exponent{ _mm_mul_ps(colorDistance, simd::Splat(pass.colorWeight)) };
+				exponent = simd::MulAdd(simd::Splat(pass.normalPower), _mm_max_ps(zero, _mm_sub_ps(one, normalDot)), exponent);
+				exponent = simd::MulAdd(_mm_and_ps(_mm_sub_ps(depth, sampleDepth), absMask), _mm_mul_ps(depthScale, simd::Splat(pass.inverseDistances[tap])), exponent);
+
+				// Sky samples drop out
+				const __m128 weight{ _mm_and_ps(_mm_mul_ps(simd::Splat(pass.kernelWeights[tap]), simd::Exp(_mm_sub_ps(zero, _mm_min_ps(exponent, simd::Splat(g_MaxExponent))))), _mm_cmpgt_ps(sampleDepth, zero)) };
+				LoadTransposed(&pass.pSource[sampleIndex].r, sampleR, sampleG, sampleB);
+				sumR = simd::MulAdd(sampleR, weight, sumR);
+				sumG = simd::MulAdd(sampleG, weight, sumG);
+				sumB = simd::MulAdd(sampleB, weight, sumB);
+				weightSum = _mm_add_ps(weightSum, weight);
+			}
+
+			const __m128 inverseWeightSum{ _mm_div_ps(one, weightSum) };
+			__m128 r{ _mm_mul_ps(sumR, inverseWeightSum) }, g{ _mm_mul_ps(sumG, inverseWeightSum) }, b{ _mm_mul_ps(sumB, inverseWeightSum) }, a{ zero };
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			const __m128 filtered[4]{ r, g, b, a };
+			alignas(16) float depths[4];
+			simd::Store(depths, depth);
+			for (int lane{}; lane < 4; ++lane)
+			{
+				// The sky has no noise to remove
+				pass.pDestination[pixelIndex + lane] = depths[lane] > 0.f ? ColorRGB::FromRegister(filtered[lane]) : pass.pSource[pixelIndex + lane];
+			}
+		}
+
+		void FilterRow(const FilterPass& pass, int y)
+		{
+			// Away from the left & right edge 4 pixels go at once
+			const int border{ 2 * pass.stepWidth };
+			for (int x{}; x < pass.width;)
+			{
+				if (x >= border && x + 3 + border < pass.width)
+				{
+					FilterQuad(pass, x, y);
+					x += 4;
+				}
+				else
+				{
+					FilterPixel(pass, x, y);
+					++x;
+				}
+			}
+		}
+	}
+
+	void Denoiser::Filter(ColorRGB* pPixels, const FeatureBuffers& features, int width, int height, const DenoiserSettings& settings)
+	{
+		const size_t pixelCount{ size_t(width) * height };
+		assert(features.depths.size() == pixelCount);
+		m_Illumination.resize(pixelCount);
+		m_Scratch.resize(pixelCount);
+		m_Compressed.resize(pixelCount);
+
+		const __m128 minAlbedo{ simd::Splat(g_MinAlbedo) };
+		concurrency::parallel_for(0, height,
+			[&](int y)
+			{
+				for (int pixelIndex{ y * width }; pixelIndex < (y + 1) * width; ++pixelIndex)
+				{
+					if (features.depths[pixelIndex] > 0.f)
+						m_Illumination[pixelIndex] = ColorRGB::FromRegister(_mm_div_ps(pPixels[pixelIndex].Load(), _mm_max_ps(features.albedo[pixelIndex].Load(), minAlbedo)));
+					else
+						m_Illumination[pixelIndex] = pPixels[pixelIndex];
+				}
+			});
+
+		if (settings.temporalAccumulation)
+			Accumulate(features, width, height, settings);
+
+		ColorRGB* pSource{ m_Illumination.data() };
+		ColorRGB* pDestination{ m_Scratch.data() };
+		for (int iteration{}; iteration < settings.iterations; ++iteration)
+		{
+			FilterPass pass{ pSource, m_Compressed.data(), pDestination, &features, width, height, 1 << iteration };
+			// Halves every pass, there's less noise left to tell apart from real edges
+			const float colorSigma{ settings.colorSigma / float(pass.stepWidth) };
+			pass.colorWeight = 1.f / std::max(colorSigma * colorSigma, FLT_EPSILON);
+			pass.normalPower = settings.normalPower;
+			pass.depthSigma = settings.depthSigma;
+			for (int tap{}; tap < g_TapCount; ++tap)
+			{
+				const int dx{ tap % 5 - 2 };
+				const int dy{ tap / 5 - 2 };
+				pass.kernelWeights[tap] = g_Kernel[dx + 2] * g_Kernel[dy + 2];
+				if (tap != g_CenterTap)
+					pass.inverseDistances[tap] = 1.f / (pass.stepWidth * std::sqrt(float(dx * dx + dy * dy)));
+			}
+
+			concurrency::parallel_for(0, height,
+				[&](int y)
+				{
+					// c / (1 + c) once per pixel instead of once per tap
+					const __m128 one{ simd::Splat(1.f) };
+					for (int pixelIndex{ y * width }; pixelIndex < (y + 1) * width; ++pixelIndex)
+					{
+						const __m128 color{ pSource[pixelIndex].Load() };
+						m_Compressed[pixelIndex] = ColorRGB::FromRegister(_mm_div_ps(color, _mm_add_ps(color, one)));
+					}
+				});
+			concurrency::parallel_for(0, height,
+				[&](int y)
+				{
+					FilterRow(pass, y);
+				});
+			std::swap(pSource, pDestination);
+		}
+
+		concurrency::parallel_for(0, height,
+			[&](int y)
+			{
+				for (int pixelIndex{ y * width }; pixelIndex < (y + 1) * width; ++pixelIndex)
+				{
+					if (features.depths[pixelIndex] > 0.f)
+						pPixels[pixelIndex] = ColorRGB::FromRegister(_mm_mul_ps(pSource[pixelIndex].Load(), _mm_max_ps(features.albedo[pixelIndex].Load(), minAlbedo)));
+					else
+						pPixels[pixelIndex] = pSource[pixelIndex];
+				}
+			});
+	}
+
+	void Denoiser::Accumulate(const FeatureBuffers& features, int width, int height, const DenoiserSettings& settings)
+	{
+		const size_t pixelCount{ size_t(width) * height };
+		if (m_HistoryLength.size() != pixelCount)
+		{
+			m_History.assign(pixelCount, ColorRGB{});
+			m_HistoryNormals.assign(pixelCount, Vector3{});
+			m_HistoryDepths.assign(pixelCount, 0.f);
+			m_HistoryLength.assign(pixelCount, 0);
+		}
+
+		// No motion vectors, a pixel only keeps its history while it still sees the same surface
+		concurrency::parallel_for(0, height,
+			[&](int y)
+			{
+				for (int pixelIndex{ y * width }; pixelIndex < (y + 1) * width; ++pixelIndex)
+				{
+					const float depth{ features.depths[pixelIndex] };
+					const Vector3& normal{ features.normals[pixelIndex] };
+					const bool isSameSurface{ m_HistoryLength[pixelIndex] > 0 && depth > 0.f
+						&& std::abs(depth - m_HistoryDepths[pixelIndex]) < g_MaxHistoryDepthChange * depth
+						&& Vector3::Dot(normal, m_HistoryNormals[pixelIndex]) > g_MinHistoryNormalDot };
+
+					uint16_t& length{ m_HistoryLength[pixelIndex] };
+					length = isSameSurface ? uint16_t(std::min(length + 1, 0xFFFF)) : uint16_t(1);
+
+					// Plain average until the history is long enough, then an exponential moving average
+					const float alpha{ std::max(settings.temporalAlpha, 1.f / length) };
+					ColorRGB& history{ m_History[pixelIndex] };
+					history = isSameSurface ? history + (m_Illumination[pixelIndex] - history) * alpha : m_Illumination[pixelIndex];
+					m_Illumination[pixelIndex] = history;
+					m_HistoryNormals[pixelIndex] = normal;
+					m_HistoryDepths[pixelIndex] = depth;
+				}
+			});
+	}
+}
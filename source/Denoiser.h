@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	// Per pixel surface data of the first hit, what the denoiser tells edges from noise with
+	// Misses have a zero normal & depth, their albedo is the sky color
+	struct FeatureBuffers
+	{
+		std::vector<ColorRGB> albedo{};
+		std::vector<Vector3> normals{};
+		// Distance along the primary ray
+		std::vector<float> depths{};
+
+		void Resize(size_t pixelCount)
+		{
+			albedo.resize(pixelCount);
+			normals.resize(pixelCount);
+			depths.resize(pixelCount);
+		}
+	};
+
+	struct DenoiserSettings
+	{
+		// Filter passes, pass i skips 2^i pixels between its taps, 5 passes reach 64 pixels wide
+		int iterations{ 5 };
+		// How different two (albedo divided) colors can be & still get mixed, halves every pass as the noise goes down
+		float colorSigma{ 1.f };
+		// Higher keeps creases sharper, weight is about dot(n, n')^normalPower
+		float normalPower{ 128.f };
+		// Allowed depth change per pixel of distance, relative to the center depth
+		float depthSigma{ 0.02f };
+
+		// Blends in the previous frames where the surface didn't change, the new frame weighs at least temporalAlpha
+		bool temporalAccumulation{ false };
+		float temporalAlpha{ 0.1f };
+	};
+
+	/**
+	 * \brief Edge-avoiding à-trous wavelet filter (Dammertz et al., Edge-Avoiding À-Trous Wavelet Transform for fast Global Illumination Filtering)
+	 * Post pass over the linear float framebuffer, rows run in parallel & 4 neighbouring pixels go through the SSE lanes together, weights included
+	 * Colors are divided by the albedo before filtering & multiplied back after, so material & texture edges stay sharp
+	 * and only the lighting gets blurred
+	 */
+	class Denoiser final
+	{
+	public:
+		// pPixels is filtered in place, the features have to be the ones traced with it
+		void Filter(ColorRGB* pPixels, const FeatureBuffers& features, int width, int height, const DenoiserSettings& settings);
+		// Next frame starts without history, e.g. after a cut or a resize
+		void ResetHistory() { m_HistoryLength.clear(); }
+
+	private:
+		void Accumulate(const FeatureBuffers& features, int width, int height, const DenoiserSettings& settings);
+
+		// Albedo divided colors, ping-ponged between the passes
+		std::vector<ColorRGB> m_Illumination{};
+		std::vector<ColorRGB> m_Scratch{};
+		std::vector<ColorRGB> m_Compressed{};
+
+		// Accumulated illumination of the previous frames & what was seen at each pixel then
+		std::vector<ColorRGB> m_History{};
+		std::vector<Vector3> m_HistoryNormals{};
+		std::vector<float> m_HistoryDepths{};
+		std::vector<uint16_t> m_HistoryLength{};
+	};
+}
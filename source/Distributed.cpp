@@ -0,0 +1,475 @@
+#include "Distributed.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+#include "SDL.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include "Camera.h"
+#include "Headless.h"
+#include "Network.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+namespace dae
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		enum class MessageType : uint32_t
+		{
+			Setup, // Coordinator -> worker, once: SetupMessage
+			Ready, // Worker -> coordinator, scene loaded: its process index (from the command line)
+			Tile, // Coordinator -> worker: tile index
+			TileResult, // Worker -> coordinator: TileResultHeader + packed rgb floats
+			Shutdown, // Coordinator -> worker
+			TileError // Worker -> coordinator: tile index it can't trace (out of range for its frame)
+		};
+
+		// Everything a worker needs to render the exact same frame, the scene itself is rebuilt from its name
+		struct SetupMessage
+		{
+			char sceneName[64]{};
+			int32_t width{};
+			int32_t height{};
+			Camera camera{};
+			Renderer::LightingMode lightingMode{};
+			bool shadowsEnabled{};
+			bool reflectionsEnabled{};
+		};
+		static_assert(std::is_trivially_copyable_v<SetupMessage>);
+
+		struct TileResultHeader
+		{
+			uint32_t tileIndex{};
+			uint32_t pixelCount{};
+		};
+
+		struct WorkerConnection
+		{
+			int id{};
+			Network::Socket socket{};
+			bool isReady{};
+			// Connections come in any order, the Ready message says which spawned process this is
+			HANDLE process{};
+			// Tiles sent but not returned yet, go back in the queue when the worker is lost
+			std::vector<uint32_t> tilesInFlight{};
+			Clock::time_point lastMessage{};
+			uint32_t tilesDone{};
+			bool isLost{};
+		};
+
+		// Colors go over the wire without the SIMD padding
+		void PackPixels(uint32_t tileIndex, const std::vector<ColorRGB>& pixels, std::vector<uint8_t>& payload)
+		{
+			const TileResultHeader header{ tileIndex, static_cast<uint32_t>(pixels.size()) };
+			payload.resize(sizeof(header) + pixels.size() * 3 * sizeof(float));
+			std::memcpy(payload.data(), &header, sizeof(header));
+			uint8_t* pData{ payload.data() + sizeof(header) };
+			for (const ColorRGB& pixel : pixels)
+			{
+				std::memcpy(pData, &pixel.r, 3 * sizeof(float));
+				pData += 3 * sizeof(float);
+			}
+		}
+
+		// False for a malformed payload
+		bool UnpackPixels(const std::vector<uint8_t>& payload, TileResultHeader& header, std::vector<ColorRGB>& pixels)
+		{
+			if (payload.size() < sizeof(header))
+				return false;
+			std::memcpy(&header, payload.data(), sizeof(header));
+			if (payload.size() != sizeof(header) + size_t(header.pixelCount) * 3 * sizeof(float))
+				return false;
+
+			pixels.resize(header.pixelCount);
+			const uint8_t* pData{ payload.data() + sizeof(header) };
+			for (ColorRGB& pixel : pixels)
+			{
+				std::memcpy(&pixel.r, pData, 3 * sizeof(float));
+				pData += 3 * sizeof(float);
+			}
+			return true;
+		}
+
+		// Same executable in worker mode, shares the console so its messages show up in between
+		HANDLE SpawnWorker(uint16_t port, uint32_t processIndex)
+		{
+			char exePath[MAX_PATH]{};
+			if (GetModuleFileNameA(nullptr, exePath, MAX_PATH) == 0)
+				return nullptr;
+
+			std::string commandLine{ "\"" + std::string(exePath) + "\" --worker 127.0.0.1 " + std::to_string(port) + " " + std::to_string(processIndex) };
+			STARTUPINFOA startupInfo{};
+			startupInfo.cb = sizeof(startupInfo);
+			PROCESS_INFORMATION processInfo{};
+			if (!CreateProcessA(exePath, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+				return nullptr;
+
+			CloseHandle(processInfo.hThread);
+			return processInfo.hProcess;
+		}
+
+		void DropWorker(WorkerConnection& worker, const char* reason, std::deque<uint32_t>& pendingTiles)
+		{
+			std::cout << "Worker " << worker.id << " lost (" << reason << "), " << worker.tilesInFlight.size() << " tiles requeued\n";
+			// Front of the queue, they've been waiting the longest
+			pendingTiles.insert(pendingTiles.begin(), worker.tilesInFlight.begin(), worker.tilesInFlight.end());
+			worker.tilesInFlight.clear();
+			worker.socket.Close();
+			worker.isLost = true;
+		}
+
+		int MillisecondsSince(Clock::time_point start)
+		{
+			return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+		}
+	}
+
+	int Distributed::RunCoordinator(const Settings& settings)
+	{
+		if (!Network::Startup())
+		{
+			std::cout << "Distributed: failed to start networking\n";
+			return 1;
+		}
+		SDL_Init(SDL_INIT_VIDEO);
+
+		std::unique_ptr<HeadlessRenderer> pTarget{ std::make_unique<HeadlessRenderer>("RayTracer - Coordinator", settings.width, settings.height) };
+		const std::unique_ptr<Scene> pScene{ CreateScene(settings.sceneName) };
+		Network::Socket listener{};
+		if (!pTarget->IsValid() || !pScene || settings.sceneName.size() >= sizeof(SetupMessage::sceneName) || !listener.Listen(settings.port))
+		{
+			std::cout << "Distributed: failed to set up the coordinator for scene " << settings.sceneName << "\n";
+			pTarget.reset();
+			SDL_Quit();
+			Network::Cleanup();
+			return 1;
+		}
+
+		std::cout << "**DISTRIBUTED**\n";
+		Renderer* const pRenderer{ &pTarget->GetRenderer() };
+		pScene->Initialize();
+		pRenderer->SetReflections(pScene->GetReflectionsEnabled());
+		pScene->SwapBuffers();
+
+		SetupMessage setup{};
+		std::memcpy(setup.sceneName, settings.sceneName.c_str(), settings.sceneName.size());
+		setup.width = settings.width;
+		setup.height = settings.height;
+		setup.camera = pScene->GetRenderCamera();
+		setup.lightingMode = pRenderer->GetLightingMode();
+		setup.shadowsEnabled = pRenderer->GetShadows();
+		setup.reflectionsEnabled = pRenderer->GetReflections();
+
+		//--------- Spawn & connect the workers ---------
+		const Clock::time_point frameStart{ Clock::now() };
+		std::vector<HANDLE> processes{};
+		for (int i{}; i < settings.workerCount; ++i)
+		{
+			if (const HANDLE process{ SpawnWorker(listener.GetPort(), static_cast<uint32_t>(processes.size())) })
+				processes.push_back(process);
+			else
+				std::cout << "Failed to spawn worker " << i << "\n";
+		}
+
+		std::vector<WorkerConnection> workers{};
+		while (workers.size() < processes.size() && MillisecondsSince(frameStart) < settings.setupTimeoutMs
+			&& listener.WaitReadable(settings.setupTimeoutMs - MillisecondsSince(frameStart)))
+		{
+			WorkerConnection worker{};
+			worker.id = static_cast<int>(workers.size());
+			worker.socket = listener.Accept();
+			worker.lastMessage = Clock::now();
+			if (worker.socket.WriteMessage(uint32_t(MessageType::Setup), &setup, sizeof(setup)))
+				workers.push_back(std::move(worker));
+		}
+		listener.Close();
+		std::cout << workers.size() << " of " << settings.workerCount << " workers connected\n";
+
+		//--------- Deal out tiles until every one came back ---------
+		const uint32_t tileCount{ pRenderer->GetTileCount() };
+		std::deque<uint32_t> pendingTiles(tileCount);
+		std::iota(pendingTiles.begin(), pendingTiles.end(), 0u);
+		std::vector<bool> isTileDone(tileCount);
+		uint32_t tilesDone{};
+		uint32_t localTiles{};
+		bool hasKilledWorker{};
+
+		Network::MessageHeader header{};
+		std::vector<uint8_t> payload{};
+		std::vector<ColorRGB> tilePixels{};
+		Clock::time_point traceStart{};
+		while (tilesDone < tileCount)
+		{
+			for (WorkerConnection& worker : workers)
+			{
+				while (worker.socket.IsValid() && worker.isReady && worker.tilesInFlight.size() < size_t(settings.tilesInFlight) && !pendingTiles.empty())
+				{
+					// An idle worker only starts owing us something from here on
+					if (worker.tilesInFlight.empty())
+						worker.lastMessage = Clock::now();
+
+					const uint32_t tileIndex{ pendingTiles.front() };
+					pendingTiles.pop_front();
+					worker.tilesInFlight.push_back(tileIndex);
+					if (!worker.socket.WriteMessage(uint32_t(MessageType::Tile), &tileIndex, sizeof(tileIndex)))
+						DropWorker(worker, "send failed", pendingTiles);
+				}
+			}
+
+			std::vector<WorkerConnection*> liveWorkers{};
+			std::vector<const Network::Socket*> sockets{};
+			for (WorkerConnection& worker : workers)
+			{
+				if (worker.socket.IsValid())
+				{
+					liveWorkers.push_back(&worker);
+					sockets.push_back(&worker.socket);
+				}
+			}
+
+			if (liveWorkers.empty())
+			{
+				// Nobody left to hand work to, finish the frame here
+				std::cout << "No workers left, tracing the remaining " << pendingTiles.size() << " tiles locally\n";
+				const std::vector<uint32_t> remainingTiles(pendingTiles.begin(), pendingTiles.end());
+				pRenderer->TraceTiles(pScene.get(), remainingTiles);
+				for (uint32_t tileIndex : remainingTiles)
+				{
+					if (!isTileDone[tileIndex])
+					{
+						isTileDone[tileIndex] = true;
+						++tilesDone;
+						++localTiles;
+					}
+				}
+				pendingTiles.clear();
+				break;
+			}
+
+			for (size_t i : Network::WaitForAny(sockets, 50))
+			{
+				WorkerConnection& worker{ *liveWorkers[i] };
+				// Something arrived, but a worker that hangs halfway through a tile result mustn't stall everyone else
+				if (!worker.socket.ReadMessage(header, payload, settings.workerTimeoutMs))
+				{
+					DropWorker(worker, "disconnected or stalled", pendingTiles);
+					continue;
+				}
+				worker.lastMessage = Clock::now();
+
+				if (header.type == uint32_t(MessageType::Ready))
+				{
+					uint32_t processIndex{ UINT32_MAX };
+					if (payload.size() == sizeof(processIndex))
+						std::memcpy(&processIndex, payload.data(), sizeof(processIndex));
+					if (processIndex >= processes.size())
+					{
+						DropWorker(worker, "unexpected message", pendingTiles);
+						continue;
+					}
+					worker.process = processes[processIndex];
+					worker.isReady = true;
+					if (traceStart == Clock::time_point{})
+						traceStart = Clock::now();
+					continue;
+				}
+
+				// Its frame doesn't match ours, handing it more tiles would just fail again
+				if (header.type == uint32_t(MessageType::TileError))
+				{
+					uint32_t tileIndex{};
+					if (payload.size() == sizeof(tileIndex))
+						std::memcpy(&tileIndex, payload.data(), sizeof(tileIndex));
+					std::cout << "Worker " << worker.id << " can't trace tile " << tileIndex << "\n";
+					DropWorker(worker, "rejected a tile", pendingTiles);
+					continue;
+				}
+
+				TileResultHeader result{};
+				const auto tileIt{ header.type == uint32_t(MessageType::TileResult) && UnpackPixels(payload, result, tilePixels)
+					? std::find(worker.tilesInFlight.begin(), worker.tilesInFlight.end(), result.tileIndex) : worker.tilesInFlight.end() };
+				if (tileIt == worker.tilesInFlight.end() || result.pixelCount != pRenderer->GetTilePixelCount(result.tileIndex))
+				{
+					DropWorker(worker, "unexpected message", pendingTiles);
+					continue;
+				}
+
+				worker.tilesInFlight.erase(tileIt);
+				pRenderer->WriteTile(result.tileIndex, tilePixels);
+				if (!isTileDone[result.tileIndex])
+				{
+					isTileDone[result.tileIndex] = true;
+					++tilesDone;
+					++worker.tilesDone;
+				}
+			}
+
+			// Silence only counts against a worker that's loading or owes us tiles
+			for (WorkerConnection& worker : workers)
+			{
+				const int timeoutMs{ worker.isReady ? settings.workerTimeoutMs : settings.setupTimeoutMs };
+				if (worker.socket.IsValid() && (!worker.isReady || !worker.tilesInFlight.empty()) && MillisecondsSince(worker.lastMessage) > timeoutMs)
+					DropWorker(worker, "timed out", pendingTiles);
+			}
+
+			if (!hasKilledWorker && settings.killWorkerAfterTiles >= 0 && tilesDone >= uint32_t(settings.killWorkerAfterTiles))
+			{
+				// One that owes tiles, otherwise there's nothing to recover
+				const auto workerIt{ std::find_if(workers.begin(), workers.end(),
+					[](const WorkerConnection& worker) { return worker.socket.IsValid() && !worker.tilesInFlight.empty(); }) };
+				if (workerIt != workers.end())
+				{
+					std::cout << "Killing worker " << workerIt->id << " after " << tilesDone << " tiles\n";
+					TerminateProcess(workerIt->process, 1);
+					hasKilledWorker = true;
+				}
+			}
+		}
+		const int traceMs{ traceStart == Clock::time_point{} ? 0 : MillisecondsSince(traceStart) };
+		const int frameMs{ MillisecondsSince(frameStart) };
+
+		//--------- Shut down the workers ---------
+		for (WorkerConnection& worker : workers)
+		{
+			if (worker.socket.IsValid())
+				worker.socket.WriteMessage(uint32_t(MessageType::Shutdown));
+			worker.socket.Close();
+		}
+		for (const HANDLE process : processes)
+		{
+			if (WaitForSingleObject(process, 5000) != WAIT_OBJECT_0)
+				TerminateProcess(process, 1);
+			CloseHandle(process);
+		}
+
+		//--------- Report & compare against a local render ---------
+		pRenderer->SwapFrameBuffers();
+		const std::vector<ColorRGB> distributedPixels{ pRenderer->GetHdrBuffer() };
+		if (!settings.outputFile.empty())
+			ImageWriter::Write(pRenderer->CaptureFrame(ImageFormat::EXR, settings.outputFile));
+
+		pRenderer->Trace(pScene.get());
+		pRenderer->SwapFrameBuffers();
+		const std::vector<ColorRGB>& localPixels{ pRenderer->GetHdrBuffer() };
+		size_t mismatchCount{};
+		for (size_t i{}; i < localPixels.size(); ++i)
+		{
+			if (std::memcmp(&localPixels[i].r, &distributedPixels[i].r, 3 * sizeof(float)) != 0)
+				++mismatchCount;
+		}
+
+		for (const WorkerConnection& worker : workers)
+			std::cout << ">> Worker " << worker.id << " TILES = " << worker.tilesDone << (worker.isLost ? " LOST" : "") << "\n";
+		std::cout << ">> Local TILES = " << localTiles << "\n";
+		std::cout << ">> " << settings.sceneName << " TILES = " << tileCount << " FRAME_MS = " << frameMs << " TRACE_MS = " << traceMs
+			<< " LOCAL_TRACE_MS = " << pRenderer->GetLastTraceTime() << " MISMATCHED_PIXELS = " << mismatchCount << "\n";
+
+		const bool hasPassed{ tilesDone == tileCount && mismatchCount == 0 };
+		std::cout << (hasPassed ? "Distributed frame matches the local render\n" : "Distributed frame FAILED\n");
+
+		pTarget.reset();
+		SDL_Quit();
+		Network::Cleanup();
+		return hasPassed ? 0 : 1;
+	}
+
+	int Distributed::RunWorker(const std::string& host, uint16_t port, uint32_t processIndex)
+	{
+		if (!Network::Startup())
+			return 1;
+
+		Network::Socket connection{};
+		Network::MessageHeader header{};
+		std::vector<uint8_t> payload{};
+		SetupMessage setup{};
+		if (!connection.Connect(host, port) || !connection.ReadMessage(header, payload)
+			|| header.type != uint32_t(MessageType::Setup) || payload.size() != sizeof(setup))
+		{
+			std::cout << "Worker: no setup from " << host << ":" << port << "\n";
+			Network::Cleanup();
+			return 1;
+		}
+		std::memcpy(&setup, payload.data(), sizeof(setup));
+		setup.sceneName[sizeof(setup.sceneName) - 1] = '\0';
+
+		SDL_Init(SDL_INIT_VIDEO);
+		std::unique_ptr<HeadlessRenderer> pTarget{ std::make_unique<HeadlessRenderer>("RayTracer - Worker", setup.width, setup.height) };
+		const std::unique_ptr<Scene> pScene{ CreateScene(setup.sceneName) };
+		int exitCode{ 1 };
+		if (pTarget->IsValid() && pScene)
+		{
+			Renderer* const pRenderer{ &pTarget->GetRenderer() };
+			pRenderer->SetLightingMode(setup.lightingMode);
+			pRenderer->SetShadows(setup.shadowsEnabled);
+			pRenderer->SetReflections(setup.reflectionsEnabled);
+
+			pScene->Initialize();
+			pScene->GetCamera() = setup.camera;
+			pScene->SwapBuffers();
+
+			const uint32_t tileCount{ pRenderer->GetTileCount() };
+			std::vector<uint32_t> tiles{};
+			std::vector<ColorRGB> tilePixels{};
+			bool isRunning{ connection.WriteMessage(uint32_t(MessageType::Ready), &processIndex, sizeof(processIndex)) };
+			while (isRunning)
+			{
+				// Take every tile that's already waiting & trace them side by side
+				tiles.clear();
+				do
+				{
+					uint32_t tileIndex{};
+					if (!connection.ReadMessage(header, payload) || header.type != uint32_t(MessageType::Tile) || payload.size() != sizeof(tileIndex))
+					{
+						exitCode = header.type == uint32_t(MessageType::Shutdown) ? 0 : 1;
+						isRunning = false;
+						break;
+					}
+					std::memcpy(&tileIndex, payload.data(), sizeof(tileIndex));
+					if (tileIndex < tileCount)
+						tiles.push_back(tileIndex);
+					else if (!connection.WriteMessage(uint32_t(MessageType::TileError), &tileIndex, sizeof(tileIndex)))
+					{
+						isRunning = false;
+						break;
+					}
+				} while (connection.WaitReadable(0));
+
+				pRenderer->TraceTiles(pScene.get(), tiles);
+				for (uint32_t tileIndex : tiles)
+				{
+					pRenderer->ReadTile(tileIndex, tilePixels);
+					PackPixels(tileIndex, tilePixels, payload);
+					if (!connection.WriteMessage(uint32_t(MessageType::TileResult), payload.data(), payload.size()))
+					{
+						isRunning = false;
+						break;
+					}
+				}
+			}
+		}
+		else
+		{
+			std::cout << "Worker: can't render scene " << setup.sceneName << "\n";
+		}
+
+		connection.Close();
+		pTarget.reset();
+		SDL_Quit();
+		Network::Cleanup();
+		return exitCode;
+	}
+}
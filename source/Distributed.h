@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace dae
+{
+	namespace Distributed
+	{
+		struct Settings
+		{
+			// One of the built-in scenes (see GetBuiltInScenes), workers build their own copy from the name
+			std::string sceneName{ "W4_ReferenceScene" };
+			int width{ 640 };
+			int height{ 480 };
+
+			int workerCount{ 3 };
+			uint16_t port{ 0 }; // 0 picks a free one
+			// Tiles handed to a worker before it has to return one, hides the round trip without hoarding work
+			int tilesInFlight{ 2 };
+			// A worker that stays silent this long while it owes tiles, or stops halfway through a message, is written off
+			int workerTimeoutMs{ 10000 };
+			// Scene loading can take a while (OBJ parsing, BVH builds)
+			int setupTimeoutMs{ 60000 };
+			// Kills a worker that owes tiles after this many returned tiles, to exercise the recovery path. -1 disables
+			int killWorkerAfterTiles{ -1 };
+			// Optional, written as an HDR image
+			std::string outputFile{};
+		};
+
+		/**
+		 * \brief Renders one frame split over local worker processes
+		 * Spawns the workers (this executable with --worker), sends them the scene & camera once, then deals out tiles on demand,
+		 * so faster workers end up with more of them. Tiles of a worker that disconnects or times out go back in the queue,
+		 * when no worker is left the coordinator traces the rest itself
+		 * The result is checked against a local render of the same frame, every pixel has to match exactly
+		 * \return 0 when the frame is complete & identical to the local one, 1 otherwise (usable as a process exit code)
+		 */
+		int RunCoordinator(const Settings& settings);
+
+		// Connects to a coordinator & traces tiles until it says stop or goes away
+		// processIndex is the coordinator's spawn order, sent back so it knows which process is behind the connection
+		int RunWorker(const std::string& host, uint16_t port, uint32_t processIndex);
+	}
+}
@@ -0,0 +1,167 @@
+#include "FramePipeline.h"
+
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+#include "Tracing.h"
+
+namespace dae
+{
+	namespace
+	{
+		float ToMilliseconds(std::chrono::steady_clock::duration duration)
+		{
+			return std::chrono::duration<float, std::milli>(duration).count();
+		}
+	}
+
+	FramePipeline::FramePipeline(Renderer* pRenderer, Scene* pScene, bool isPipelined) :
+		m_pRenderer(pRenderer),
+		m_pScene(pScene),
+		m_IsPipelined(isPipelined)
+	{
+	}
+
+	FramePipeline::~FramePipeline()
+	{
+		// Never leave a trace running on a scene that's about to be deleted
+		if (m_InFlightTrace.valid())
+			m_InFlightTrace.wait();
+	}
+
+	void FramePipeline::Frame(Timer* pTimer)
+	{
+		const Clock::time_point frameStart{ Clock::now() };
+		if (m_Totals.frameCount > 0)
+			m_Totals.frameTime += ToMilliseconds(frameStart - m_LastFrameStart);
+		m_LastFrameStart = frameStart;
+		++m_Totals.frameCount;
+
+		//--------- Update ---------
+		// Only writes the scene's back buffers, so this overlaps the frame in flight
+		const Clock::time_point updateStart{ Clock::now() };
+		{
+			TRACE_SCOPE("Scene::Update");
+			m_pScene->Update(pTimer);
+		}
+		m_Totals.updateTime += ToMilliseconds(Clock::now() - updateStart);
+
+		if (!m_IsPipelined || m_TraceBudget > 0.f)
+		{
+			m_pScene->SwapBuffers();
+			if (m_TraceBudget > 0.f)
+			{
+				const Renderer::BudgetReport report{ m_pRenderer->TraceWithBudget(m_pScene, m_TraceBudget) };
+				m_Totals.coverage += report.GetCoverage();
+				++m_Totals.budgetedFrames;
+				m_Totals.completeFrames += report.IsComplete();
+			}
+			else
+			{
+				m_pRenderer->Trace(m_pScene);
+			}
+			m_Totals.traceTime += m_pRenderer->GetLastTraceTime();
+			m_Totals.denoiseTime += m_pRenderer->GetLastDenoiseTime();
+			m_Totals.samplesPerSecond += m_pRenderer->GetLastSamplesPerSecond();
+			m_pRenderer->SwapFrameBuffers();
+			PresentFrame(updateStart);
+			return;
+		}
+
+		//--------- Wait for frame N ---------
+		const bool hasFrameInFlight{ m_InFlightTrace.valid() };
+		const Clock::time_point inFlightUpdateStart{ m_InFlightUpdateStart };
+		if (hasFrameInFlight)
+		{
+			TRACE_SCOPE("WaitForTrace");
+			const Clock::time_point stallStart{ Clock::now() };
+			m_InFlightTrace.get();
+			m_Totals.stallTime += ToMilliseconds(Clock::now() - stallStart);
+			m_Totals.traceTime += m_pRenderer->GetLastTraceTime();
+			m_Totals.denoiseTime += m_pRenderer->GetLastDenoiseTime();
+			m_Totals.samplesPerSecond += m_pRenderer->GetLastSamplesPerSecond();
+			m_pRenderer->SwapFrameBuffers();
+		}
+
+		//--------- Trace frame N+1 ---------
+		// Nothing reads the scene's front buffers anymore, publish the update & start the next frame
+		{
+			TRACE_SCOPE("Scene::SwapBuffers");
+			m_pScene->SwapBuffers();
+		}
+		m_InFlightTrace = m_pRenderer->TraceAsync(m_pScene);
+		m_InFlightUpdateStart = updateStart;
+
+		//--------- Present frame N ---------
+		if (hasFrameInFlight)
+			PresentFrame(inFlightUpdateStart);
+	}
+
+	void FramePipeline::Finish()
+	{
+		if (!m_InFlightTrace.valid())
+			return;
+
+		m_InFlightTrace.get();
+		m_Totals.traceTime += m_pRenderer->GetLastTraceTime();
+		m_Totals.denoiseTime += m_pRenderer->GetLastDenoiseTime();
+		m_Totals.samplesPerSecond += m_pRenderer->GetLastSamplesPerSecond();
+		m_pRenderer->SwapFrameBuffers();
+		PresentFrame(m_InFlightUpdateStart);
+	}
+
+	void FramePipeline::SetPipelined(bool isPipelined)
+	{
+		if (m_IsPipelined && !isPipelined)
+			Finish();
+		m_IsPipelined = isPipelined;
+	}
+
+	void FramePipeline::SetTraceBudget(float budgetMs)
+	{
+		// The frame in flight was started without a deadline
+		if (budgetMs > 0.f)
+			Finish();
+		m_TraceBudget = budgetMs;
+	}
+
+	FramePipelineStats FramePipeline::GetStats() const
+	{
+		FramePipelineStats stats{};
+		stats.frameCount = m_Totals.frameCount;
+		if (m_Totals.frameCount == 0)
+			return stats;
+
+		const float frameCount{ float(m_Totals.frameCount) };
+		stats.frameTime = m_Totals.frameCount > 1 ? m_Totals.frameTime / (frameCount - 1.f) : 0.f;
+		stats.latency = m_LatencyCount > 0 ? m_Totals.latency / float(m_LatencyCount) : 0.f;
+		stats.updateTime = m_Totals.updateTime / frameCount;
+		stats.traceTime = m_Totals.traceTime / frameCount;
+		stats.denoiseTime = m_Totals.denoiseTime / frameCount;
+		stats.samplesPerSecond = m_Totals.samplesPerSecond / frameCount;
+		stats.presentTime = m_Totals.presentTime / frameCount;
+		stats.stallTime = m_Totals.stallTime / frameCount;
+		stats.budgetedFrames = m_Totals.budgetedFrames;
+		stats.completeFrames = m_Totals.completeFrames;
+		stats.coverage = m_Totals.budgetedFrames > 0 ? m_Totals.coverage / float(m_Totals.budgetedFrames) : 0.f;
+		return stats;
+	}
+
+	void FramePipeline::ResetStats()
+	{
+		m_Totals = {};
+		m_LatencyCount = 0;
+	}
+
+	void FramePipeline::PresentFrame(Clock::time_point updateStart)
+	{
+		TRACE_SCOPE("Present");
+		const Clock::time_point presentStart{ Clock::now() };
+		m_pRenderer->Present();
+		const Clock::time_point presentEnd{ Clock::now() };
+
+		m_Totals.presentTime += ToMilliseconds(presentEnd - presentStart);
+		m_Totals.latency += ToMilliseconds(presentEnd - updateStart);
+		++m_LatencyCount;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <future>
+
+namespace dae
+{
+	class Renderer;
+	class Scene;
+	class Timer;
+
+	// Averages over the frames since the last ResetStats, all in milliseconds
+	struct FramePipelineStats
+	{
+		float frameTime{}; // Wall time between two Frame calls, 1000 / frameTime = throughput
+		float latency{}; // From the start of the Update that produced a frame until that frame is presented
+		float updateTime{};
+		float traceTime{};
+		float denoiseTime{}; // Post pass after the trace, on the same thread
+		float samplesPerSecond{}; // Renderer::GetLastSamplesPerSecond, read once each frame is done
+		float presentTime{};
+		float stallTime{}; // Main thread waiting for the in-flight trace
+		uint32_t frameCount{};
+		// Only counts frames traced with a budget
+		float coverage{}; // Share of the pixels traced before the deadline
+		uint32_t budgetedFrames{};
+		uint32_t completeFrames{}; // Every pixel traced in time
+
+		// Sum of the stages over the wall time, > 1 means the stages overlap
+		float GetOverlap() const { return frameTime > 0.f ? (updateTime + traceTime + denoiseTime + presentTime) / frameTime : 0.f; }
+	};
+
+	// Drives Update > Trace > Present for a scene & renderer
+	// Pipelined, frame N+1 is updated while frame N is traced, and frame N is presented while N+1 is traced
+	// This relies on the scene & renderer being double buffered (Scene::SwapBuffers, Renderer::SwapFrameBuffers)
+	class FramePipeline final
+	{
+	public:
+		FramePipeline(Renderer* pRenderer, Scene* pScene, bool isPipelined = true);
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline(FramePipeline&&) noexcept = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+		FramePipeline& operator=(FramePipeline&&) noexcept = delete;
+
+		// Runs one iteration of the loop, main thread only (updates read SDL input, presenting touches the window)
+		void Frame(Timer* pTimer);
+		// Waits for the frame in flight and presents it
+		void Finish();
+
+		bool IsPipelined() const { return m_IsPipelined; }
+		void SetPipelined(bool isPipelined);
+		void TogglePipelined() { SetPipelined(!m_IsPipelined); }
+
+		// Traces every frame with Renderer::TraceWithBudget, 0 turns it off. A budgeted frame runs sequentially, the deadline covers the whole trace
+		void SetTraceBudget(float budgetMs);
+		float GetTraceBudget() const { return m_TraceBudget; }
+
+		FramePipelineStats GetStats() const;
+		void ResetStats();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void PresentFrame(Clock::time_point updateStart);
+
+		Renderer* m_pRenderer{};
+		Scene* m_pScene{};
+		bool m_IsPipelined{};
+		float m_TraceBudget{};
+
+		std::future<void> m_InFlightTrace{};
+		Clock::time_point m_InFlightUpdateStart{};
+		Clock::time_point m_LastFrameStart{};
+
+		// Running sums, divided in GetStats
+		FramePipelineStats m_Totals{};
+		uint32_t m_LatencyCount{};
+	};
+}
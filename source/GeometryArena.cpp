@@ -0,0 +1,60 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+
+namespace dae
+{
+	std::ostream& operator<<(std::ostream& os, const GeometryMemoryReport& report)
+	{
+		constexpr double toKiB{ 1.0 / 1024.0 };
+		os << "Geometry: " << report.meshCount << " meshes, " << report.vertexCount << " vertices, " << report.triangleCount << " triangles"
+			<< " | in use: " << report.bytesInUse * toKiB << " KiB (peak " << report.peakBytesInUse * toKiB << " KiB)"
+			<< ", reserved: " << report.bytesReserved * toKiB << " KiB"
+			<< ", allocations: " << report.allocationCount;
+		return os;
+	}
+
+	void* GeometryArena::CountingResource::do_allocate(size_t bytes, size_t alignment)
+	{
+		void* p{ m_pUpstream->allocate(bytes, alignment) };
+		bytesInUse += bytes;
+		peakBytesInUse = std::max(peakBytesInUse, bytesInUse);
+		++allocationCount;
+		return p;
+	}
+
+	void GeometryArena::CountingResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+	{
+		m_pUpstream->deallocate(p, bytes, alignment);
+		bytesInUse -= bytes;
+	}
+
+	GeometryArena::GeometryArena(size_t initialChunkSize) :
+		m_Arena(initialChunkSize, &m_HeapCounter),
+		// Blocks up to 64 KiB get recycled by the pool, bigger ones (large meshes) come straight from the arena
+		m_Pool(std::pmr::pool_options{ 0, 64 * 1024 }, &m_Arena)
+	{
+	}
+
+	void GeometryArena::Reset()
+	{
+		m_Pool.release();
+		m_Arena.release();
+
+		m_Counter.bytesInUse = 0;
+		m_Counter.peakBytesInUse = 0;
+		m_Counter.allocationCount = 0;
+		m_HeapCounter.peakBytesInUse = 0;
+		m_HeapCounter.allocationCount = 0;
+	}
+
+	GeometryMemoryReport GeometryArena::GetReport() const
+	{
+		GeometryMemoryReport report{};
+		report.bytesInUse = m_Counter.bytesInUse;
+		report.peakBytesInUse = m_Counter.peakBytesInUse;
+		report.allocationCount = m_Counter.allocationCount;
+		report.bytesReserved = m_HeapCounter.bytesInUse;
+		return report;
+	}
+}
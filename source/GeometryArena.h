@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+
+namespace dae
+{
+	struct GeometryMemoryReport
+	{
+		size_t bytesInUse{}; // Live mesh buffers
+		size_t peakBytesInUse{};
+		size_t bytesReserved{}; // Chunks taken from the heap, what the scene really costs
+		size_t allocationCount{};
+
+		size_t meshCount{};
+		size_t vertexCount{};
+		size_t triangleCount{};
+	};
+
+	std::ostream& operator<<(std::ostream& os, const GeometryMemoryReport& report);
+
+	/**
+	 * \brief Scene owned memory for all mesh buffers: a pool (reuses freed blocks while meshes are built)
+	 * on top of a monotonic arena (big contiguous chunks), so mesh data ends up packed together instead of spread over the heap
+	 * Reset drops everything in one go, only call it once no container allocated from it is alive anymore
+	 * Not thread safe, allocate from the main thread only (Initialize/Update, never from the render workers)
+	 */
+	class GeometryArena final
+	{
+	public:
+		explicit GeometryArena(size_t initialChunkSize = 1 << 20);
+		~GeometryArena() = default;
+
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena(GeometryArena&&) noexcept = delete;
+		GeometryArena& operator=(const GeometryArena&) = delete;
+		GeometryArena& operator=(GeometryArena&&) noexcept = delete;
+
+		std::pmr::memory_resource* GetResource() { return &m_Counter; }
+		void Reset();
+
+		// Only fills in the memory part, the scene adds the mesh counts
+		GeometryMemoryReport GetReport() const;
+
+	private:
+		// Pass-through resource that keeps byte counts for the report
+		class CountingResource final : public std::pmr::memory_resource
+		{
+		public:
+			explicit CountingResource(std::pmr::memory_resource* pUpstream) : m_pUpstream(pUpstream) {}
+
+			size_t bytesInUse{};
+			size_t peakBytesInUse{};
+			size_t allocationCount{};
+
+		private:
+			std::pmr::memory_resource* m_pUpstream{};
+
+			void* do_allocate(size_t bytes, size_t alignment) override;
+			void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+			bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		};
+
+		CountingResource m_HeapCounter{ std::pmr::new_delete_resource() };
+		std::pmr::monotonic_buffer_resource m_Arena;
+		std::pmr::unsynchronized_pool_resource m_Pool;
+		CountingResource m_Counter{ &m_Pool };
+	};
+}
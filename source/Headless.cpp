@@ -0,0 +1,55 @@
+#include "Headless.h"
+
+#include <iostream>
+
+#include "SDL.h"
+
+#include "Scene.h"
+
+namespace dae
+{
+	HeadlessRenderer::HeadlessRenderer(const std::string& title, int width, int height) :
+		m_pWindow{ SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_HIDDEN) }
+	{
+		if (m_pWindow)
+			m_pRenderer = std::make_unique<Renderer>(m_pWindow);
+	}
+
+	HeadlessRenderer::~HeadlessRenderer()
+	{
+		// The renderer draws into the window's surface, it has to go first
+		m_pRenderer.reset();
+		if (m_pWindow)
+			SDL_DestroyWindow(m_pWindow);
+	}
+
+	bool WithHeadlessScene(const std::string& sceneName, int width, int height, const std::function<void(Scene&, Renderer&)>& function)
+	{
+		const std::unique_ptr<Scene> pScene{ CreateScene(sceneName) };
+		if (!pScene)
+		{
+			std::cout << "Unknown scene " << sceneName << "\n";
+			return false;
+		}
+
+		SDL_Init(SDL_INIT_VIDEO);
+		bool isValid{};
+		{
+			const HeadlessRenderer target{ "RayTracer - " + sceneName, width, height };
+			isValid = target.IsValid();
+			if (isValid)
+			{
+				pScene->SetCameraInput(false);
+				pScene->Initialize();
+				pScene->SwapBuffers();
+				function(*pScene, target.GetRenderer());
+			}
+			else
+			{
+				std::cout << "Failed to create a window for " << sceneName << "\n";
+			}
+		}
+		SDL_Quit();
+		return isValid;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Renderer.h"
+
+struct SDL_Window;
+
+namespace dae
+{
+	class Scene;
+
+	/**
+	 * \brief Renderer for the modes without a visible window (benchmarks, regression, daemon, workers, animation)
+	 * The renderer presents to a window surface, a hidden one is enough. SDL has to be initialized by the caller
+	 */
+	class HeadlessRenderer final
+	{
+	public:
+		HeadlessRenderer(const std::string& title, int width, int height);
+		~HeadlessRenderer();
+
+		HeadlessRenderer(const HeadlessRenderer&) = delete;
+		HeadlessRenderer(HeadlessRenderer&&) noexcept = delete;
+		HeadlessRenderer& operator=(const HeadlessRenderer&) = delete;
+		HeadlessRenderer& operator=(HeadlessRenderer&&) noexcept = delete;
+
+		// False when the window couldn't be created, there's no renderer then
+		bool IsValid() const { return m_pRenderer != nullptr; }
+		Renderer& GetRenderer() const { return *m_pRenderer; }
+
+	private:
+		SDL_Window* m_pWindow{};
+		std::unique_ptr<Renderer> m_pRenderer{};
+	};
+
+	// Starts SDL, builds the scene & a HeadlessRenderer, then runs function(scene, renderer) with the scene initialized & its first frame swapped in
+	// False (after printing why) when the scene doesn't exist or the window can't be created
+	bool WithHeadlessScene(const std::string& sceneName, int width, int height, const std::function<void(Scene&, Renderer&)>& function);
+}
@@ -0,0 +1,505 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Tracing.h"
+
+namespace dae
+{
+	namespace
+	{
+#pragma region Byte Helpers
+		void AppendBigEndian32(std::vector<uint8_t>& out, uint32_t value)
+		{
+			out.push_back(static_cast<uint8_t>(value >> 24));
+			out.push_back(static_cast<uint8_t>(value >> 16));
+			out.push_back(static_cast<uint8_t>(value >> 8));
+			out.push_back(static_cast<uint8_t>(value));
+		}
+
+		template<typename T>
+		void AppendLittleEndian(std::vector<uint8_t>& out, T value)
+		{
+			// All our targets are little endian, so a plain copy is enough
+			const size_t offset{ out.size() };
+			out.resize(offset + sizeof(T));
+			std::memcpy(out.data() + offset, &value, sizeof(T));
+		}
+
+		void AppendString(std::vector<uint8_t>& out, const char* str, bool includeTerminator)
+		{
+			const size_t length{ strlen(str) + (includeTerminator ? 1 : 0) };
+			out.insert(out.end(), str, str + length);
+		}
+
+		bool WriteFile(const std::string& fileName, const std::vector<uint8_t>& bytes)
+		{
+			std::ofstream file(fileName, std::ios::binary);
+			if (!file)
+				return false;
+			file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+			return file.good();
+		}
+#pragma endregion
+
+#pragma region Checksums
+		uint32_t CRC32(const uint8_t* pData, size_t size, uint32_t crc = 0)
+		{
+			static const std::array<uint32_t, 256> table = []
+				{
+					std::array<uint32_t, 256> result{};
+					for (uint32_t n{}; n < 256; ++n)
+					{
+						uint32_t c{ n };
+						for (int k{}; k < 8; ++k)
+							c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+						result[n] = c;
+					}
+					return result;
+				}();
+
+			crc = ~crc;
+			for (size_t i{}; i < size; ++i)
+				crc = table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+			return ~crc;
+		}
+
+		uint32_t Adler32(const uint8_t* pData, size_t size)
+		{
+			uint32_t a{ 1 };
+			uint32_t b{ 0 };
+			// 5552 is the largest block that can't overflow b before the modulo
+			while (size > 0)
+			{
+				const size_t blockSize{ std::min<size_t>(size, 5552) };
+				for (size_t i{}; i < blockSize; ++i)
+				{
+					a += pData[i];
+					b += a;
+				}
+				a %= 65521;
+				b %= 65521;
+				pData += blockSize;
+				size -= blockSize;
+			}
+			return (b << 16) | a;
+		}
+#pragma endregion
+
+#pragma region Deflate
+		// Minimal deflate encoder: greedy LZ77 with a single-entry hash table and the fixed Huffman codes
+		// Not as small as zlib's output, but fast and plenty for rendered frames with large flat areas
+		class BitWriter final
+		{
+		public:
+			explicit BitWriter(std::vector<uint8_t>& out) : m_Out(out) {}
+
+			void Write(uint32_t bits, int count)
+			{
+				m_Buffer |= static_cast<uint64_t>(bits) << m_Count;
+				m_Count += count;
+				while (m_Count >= 8)
+				{
+					m_Out.push_back(static_cast<uint8_t>(m_Buffer));
+					m_Buffer >>= 8;
+					m_Count -= 8;
+				}
+			}
+
+			// Huffman codes are stored most significant bit first
+			void WriteReversed(uint32_t code, int count)
+			{
+				uint32_t reversed{};
+				for (int i{}; i < count; ++i)
+					reversed |= ((code >> i) & 1) << (count - 1 - i);
+				Write(reversed, count);
+			}
+
+			void Flush()
+			{
+				if (m_Count > 0)
+					m_Out.push_back(static_cast<uint8_t>(m_Buffer));
+				m_Buffer = 0;
+				m_Count = 0;
+			}
+
+		private:
+			std::vector<uint8_t>& m_Out;
+			uint64_t m_Buffer{};
+			int m_Count{};
+		};
+
+		void WriteFixedLiteral(BitWriter& writer, uint32_t literal)
+		{
+			if (literal <= 143)
+				writer.WriteReversed(0x30 + literal, 8);
+			else if (literal <= 255)
+				writer.WriteReversed(0x190 + (literal - 144), 9);
+			else if (literal <= 279)
+				writer.WriteReversed(literal - 256, 7);
+			else
+				writer.WriteReversed(0xC0 + (literal - 280), 8);
+		}
+
+		void WriteMatch(BitWriter& writer, uint32_t length, uint32_t distance)
+		{
+			static constexpr uint16_t lengthBase[29]{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static constexpr uint8_t lengthExtra[29]{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static constexpr uint16_t distanceBase[30]{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static constexpr uint8_t distanceExtra[30]{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+			int lengthCode{ 28 };
+			while (lengthBase[lengthCode] > length)
+				--lengthCode;
+			WriteFixedLiteral(writer, 257 + lengthCode);
+			writer.Write(length - lengthBase[lengthCode], lengthExtra[lengthCode]);
+
+			int distanceCode{ 29 };
+			while (distanceBase[distanceCode] > distance)
+				--distanceCode;
+			writer.WriteReversed(distanceCode, 5);
+			writer.Write(distance - distanceBase[distanceCode], distanceExtra[distanceCode]);
+		}
+
+		std::vector<uint8_t> ZlibCompress(const std::vector<uint8_t>& data)
+		{
+			constexpr uint32_t windowSize{ 32768 };
+			constexpr uint32_t minMatch{ 3 };
+			constexpr uint32_t maxMatch{ 258 };
+			constexpr int hashBits{ 15 };
+
+			std::vector<uint8_t> out{};
+			out.reserve(data.size() / 4 + 64);
+			out.push_back(0x78); // CMF: deflate, 32K window
+			out.push_back(0x01); // FLG: fastest compression, checksum ok
+
+			BitWriter writer{ out };
+			writer.Write(1, 1); // BFINAL
+			writer.Write(1, 2); // BTYPE = fixed Huffman
+
+			std::vector<int32_t> hashTable(size_t{ 1 } << hashBits, -1);
+			const uint32_t size{ static_cast<uint32_t>(data.size()) };
+			uint32_t pos{};
+			while (pos < size)
+			{
+				uint32_t bestLength{};
+				uint32_t bestDistance{};
+				if (pos + minMatch <= size)
+				{
+					const uint32_t hash{ ((data[pos] << 16 | data[pos + 1] << 8 | data[pos + 2]) * 2654435761u) >> (32 - hashBits) };
+					const int32_t candidate{ hashTable[hash] };
+					hashTable[hash] = static_cast<int32_t>(pos);
+
+					if (candidate >= 0 && pos - candidate <= windowSize)
+					{
+						const uint32_t maxLength{ std::min(maxMatch, size - pos) };
+						uint32_t length{};
+						while (length < maxLength && data[candidate + length] == data[pos + length])
+							++length;
+						if (length >= minMatch)
+						{
+							bestLength = length;
+							bestDistance = pos - candidate;
+						}
+					}
+				}
+
+				if (bestLength > 0)
+				{
+					WriteMatch(writer, bestLength, bestDistance);
+					pos += bestLength;
+				}
+				else
+				{
+					WriteFixedLiteral(writer, data[pos]);
+					++pos;
+				}
+			}
+			WriteFixedLiteral(writer, 256); // End of block
+			writer.Flush();
+
+			AppendBigEndian32(out, Adler32(data.data(), data.size()));
+			return out;
+		}
+#pragma endregion
+
+		void AppendPNGChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+		{
+			AppendBigEndian32(out, static_cast<uint32_t>(data.size()));
+			const size_t typeOffset{ out.size() };
+			AppendString(out, type, false);
+			out.insert(out.end(), data.begin(), data.end());
+			AppendBigEndian32(out, CRC32(out.data() + typeOffset, out.size() - typeOffset));
+		}
+	}
+
+	ImageWriter::ImageWriter(size_t maxQueuedFrames) :
+		m_MaxQueuedFrames(maxQueuedFrames)
+	{
+		m_Thread = std::thread(&ImageWriter::WriterThread, this);
+	}
+
+	ImageWriter::~ImageWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_QueueChanged.notify_all();
+		m_Thread.join();
+	}
+
+	void ImageWriter::Enqueue(Frame&& frame)
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		if (m_Queue.size() >= m_MaxQueuedFrames)
+		{
+			// Backpressure: wait for the writer to catch up instead of buffering more frames
+			++m_BackpressureStalls;
+			m_QueueChanged.wait(lock, [this] { return m_Queue.size() < m_MaxQueuedFrames; });
+		}
+		m_Queue.emplace_back(std::move(frame));
+		lock.unlock();
+		m_QueueChanged.notify_all();
+	}
+
+	void ImageWriter::Flush()
+	{
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_QueueChanged.wait(lock, [this] { return m_Queue.empty() && !m_IsBusy; });
+	}
+
+	void ImageWriter::WriterThread()
+	{
+		Tracing::SetThreadName("ImageWriter");
+		while (true)
+		{
+			Frame frame{};
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_QueueChanged.wait(lock, [this] { return !m_Queue.empty() || m_IsStopping; });
+
+				// Drain the queue before stopping so no queued frame is lost
+				if (m_Queue.empty())
+					return;
+
+				frame = std::move(m_Queue.front());
+				m_Queue.pop_front();
+				m_IsBusy = true;
+			}
+			m_QueueChanged.notify_all();
+
+			bool isWritten{};
+			{
+				TRACE_SCOPE("ImageWriter::Write");
+				isWritten = Write(frame);
+			}
+			if (isWritten)
+				++m_FramesWritten;
+			else
+			{
+				++m_FramesFailed;
+				std::cout << "Failed to write " << frame.fileName << "\n";
+			}
+
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				m_IsBusy = false;
+			}
+			m_QueueChanged.notify_all();
+		}
+	}
+
+	const char* ImageWriter::GetExtension(ImageFormat format)
+	{
+		switch (format)
+		{
+		default:
+		case ImageFormat::PNG:
+			return "png";
+		case ImageFormat::PPM:
+			return "ppm";
+		case ImageFormat::PFM:
+			return "pfm";
+		case ImageFormat::EXR:
+			return "exr";
+		}
+	}
+
+	std::string ImageWriter::MakeFileName(const std::string& prefix, uint32_t frameNumber, ImageFormat format)
+	{
+		char number[16]{};
+		snprintf(number, sizeof(number), "%05u", frameNumber);
+		return prefix + "_" + number + "." + GetExtension(format);
+	}
+
+	bool ImageWriter::Write(const Frame& frame)
+	{
+		switch (frame.format)
+		{
+		default:
+		case ImageFormat::PNG:
+			return WritePNG(frame);
+		case ImageFormat::PPM:
+			return WritePPM(frame);
+		case ImageFormat::PFM:
+			return WritePFM(frame);
+		case ImageFormat::EXR:
+			return WriteEXR(frame);
+		}
+	}
+
+	bool ImageWriter::WritePNG(const Frame& frame)
+	{
+		assert(frame.ldrPixels.size() == size_t(frame.width) * frame.height * 3);
+
+		// Every scanline starts with its filter type, 'Sub' (1) predicts each byte from the pixel to its left
+		const size_t rowSize{ size_t(frame.width) * 3 };
+		std::vector<uint8_t> filtered{};
+		filtered.reserve((rowSize + 1) * frame.height);
+		for (int y{}; y < frame.height; ++y)
+		{
+			const uint8_t* pRow{ frame.ldrPixels.data() + y * rowSize };
+			filtered.push_back(1);
+			for (size_t i{}; i < rowSize; ++i)
+				filtered.push_back(static_cast<uint8_t>(pRow[i] - (i >= 3 ? pRow[i - 3] : 0)));
+		}
+
+		std::vector<uint8_t> header{};
+		AppendBigEndian32(header, frame.width);
+		AppendBigEndian32(header, frame.height);
+		header.push_back(8); // Bit depth
+		header.push_back(2); // Color type: RGB
+		header.push_back(0); // Compression: deflate
+		header.push_back(0); // Filter method
+		header.push_back(0); // No interlacing
+
+		std::vector<uint8_t> png{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		AppendPNGChunk(png, "IHDR", header);
+		AppendPNGChunk(png, "IDAT", ZlibCompress(filtered));
+		AppendPNGChunk(png, "IEND", {});
+
+		return WriteFile(frame.fileName, png);
+	}
+
+	bool ImageWriter::WritePPM(const Frame& frame)
+	{
+		assert(frame.ldrPixels.size() == size_t(frame.width) * frame.height * 3);
+
+		const std::string header{ "P6\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n255\n" };
+		std::vector<uint8_t> ppm(header.begin(), header.end());
+		ppm.insert(ppm.end(), frame.ldrPixels.begin(), frame.ldrPixels.end());
+
+		return WriteFile(frame.fileName, ppm);
+	}
+
+	bool ImageWriter::WritePFM(const Frame& frame)
+	{
+		assert(frame.hdrPixels.size() == size_t(frame.width) * frame.height * 3);
+
+		// Negative scale means little endian, rows are stored bottom to top
+		const std::string header{ "PF\n" + std::to_string(frame.width) + " " + std::to_string(frame.height) + "\n-1.0\n" };
+		std::vector<uint8_t> pfm(header.begin(), header.end());
+
+		const size_t rowSize{ size_t(frame.width) * 3 * sizeof(float) };
+		const size_t offset{ pfm.size() };
+		pfm.resize(offset + rowSize * frame.height);
+		for (int y{}; y < frame.height; ++y)
+		{
+			const float* pRow{ frame.hdrPixels.data() + size_t(frame.height - 1 - y) * frame.width * 3 };
+			std::memcpy(pfm.data() + offset + y * rowSize, pRow, rowSize);
+		}
+
+		return WriteFile(frame.fileName, pfm);
+	}
+
+	bool ImageWriter::WriteEXR(const Frame& frame)
+	{
+		assert(frame.hdrPixels.size() == size_t(frame.width) * frame.height * 3);
+
+		std::vector<uint8_t> exr{};
+		AppendLittleEndian<uint32_t>(exr, 20000630); // Magic number
+		AppendLittleEndian<uint32_t>(exr, 2); // Version 2, single part scanline
+
+		// Attributes: name\0 type\0 size value
+		// Channels have to be sorted alphabetically, pixel type 2 = FLOAT
+		AppendString(exr, "channels", true);
+		AppendString(exr, "chlist", true);
+		AppendLittleEndian<uint32_t>(exr, 3 * 18 + 1);
+		for (const char* pChannel : { "B", "G", "R" })
+		{
+			AppendString(exr, pChannel, true);
+			AppendLittleEndian<int32_t>(exr, 2); // pixel type
+			AppendLittleEndian<uint32_t>(exr, 0); // pLinear + reserved
+			AppendLittleEndian<int32_t>(exr, 1); // xSampling
+			AppendLittleEndian<int32_t>(exr, 1); // ySampling
+		}
+		exr.push_back(0);
+
+		AppendString(exr, "compression", true);
+		AppendString(exr, "compression", true);
+		AppendLittleEndian<uint32_t>(exr, 1);
+		exr.push_back(0); // NO_COMPRESSION
+
+		for (const char* pWindow : { "dataWindow", "displayWindow" })
+		{
+			AppendString(exr, pWindow, true);
+			AppendString(exr, "box2i", true);
+			AppendLittleEndian<uint32_t>(exr, 16);
+			AppendLittleEndian<int32_t>(exr, 0);
+			AppendLittleEndian<int32_t>(exr, 0);
+			AppendLittleEndian<int32_t>(exr, frame.width - 1);
+			AppendLittleEndian<int32_t>(exr, frame.height - 1);
+		}
+
+		AppendString(exr, "lineOrder", true);
+		AppendString(exr, "lineOrder", true);
+		AppendLittleEndian<uint32_t>(exr, 1);
+		exr.push_back(0); // INCREASING_Y
+
+		AppendString(exr, "pixelAspectRatio", true);
+		AppendString(exr, "float", true);
+		AppendLittleEndian<uint32_t>(exr, 4);
+		AppendLittleEndian<float>(exr, 1.f);
+
+		AppendString(exr, "screenWindowCenter", true);
+		AppendString(exr, "v2f", true);
+		AppendLittleEndian<uint32_t>(exr, 8);
+		AppendLittleEndian<float>(exr, 0.f);
+		AppendLittleEndian<float>(exr, 0.f);
+
+		AppendString(exr, "screenWindowWidth", true);
+		AppendString(exr, "float", true);
+		AppendLittleEndian<uint32_t>(exr, 4);
+		AppendLittleEndian<float>(exr, 1.f);
+
+		exr.push_back(0); // End of header
+
+		// Offset table, one entry per scanline (uncompressed blocks hold a single line)
+		const uint32_t lineDataSize{ static_cast<uint32_t>(frame.width * 3 * sizeof(float)) };
+		const uint64_t firstLineOffset{ exr.size() + sizeof(uint64_t) * frame.height };
+		for (int y{}; y < frame.height; ++y)
+			AppendLittleEndian<uint64_t>(exr, firstLineOffset + uint64_t(y) * (8 + lineDataSize));
+
+		// Scanlines: y, data size, then every channel of the line in B, G, R order
+		for (int y{}; y < frame.height; ++y)
+		{
+			AppendLittleEndian<int32_t>(exr, y);
+			AppendLittleEndian<uint32_t>(exr, lineDataSize);
+			const float* pRow{ frame.hdrPixels.data() + size_t(y) * frame.width * 3 };
+			for (int channel{ 2 }; channel >= 0; --channel)
+			{
+				for (int x{}; x < frame.width; ++x)
+					AppendLittleEndian<float>(exr, pRow[x * 3 + channel]);
+			}
+		}
+
+		return WriteFile(frame.fileName, exr);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		PNG, // 8-bit RGB
+		PPM, // 8-bit RGB, binary P6
+		PFM, // 32-bit float RGB (HDR)
+		EXR  // 32-bit float RGB, uncompressed scanlines (HDR)
+	};
+
+	// Background image encoder with a bounded queue
+	// Enqueue() blocks while the queue is full so a fast renderer can't pile up unbounded frames in memory
+	class ImageWriter final
+	{
+	public:
+		struct Frame
+		{
+			int width{};
+			int height{};
+			ImageFormat format{ ImageFormat::PNG };
+			std::string fileName{};
+
+			std::vector<uint8_t> ldrPixels{}; // RGB8, top row first (PNG, PPM)
+			std::vector<float> hdrPixels{}; // RGB32F, top row first (PFM, EXR)
+		};
+
+		explicit ImageWriter(size_t maxQueuedFrames = 4);
+		~ImageWriter();
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		void Enqueue(Frame&& frame);
+		// Blocks until every queued frame is on disk
+		void Flush();
+
+		uint32_t GetFramesWritten() const { return m_FramesWritten; }
+		uint32_t GetFramesFailed() const { return m_FramesFailed; }
+		// Amount of times Enqueue had to wait for the writer thread
+		uint32_t GetBackpressureStalls() const { return m_BackpressureStalls; }
+
+		static bool IsHDR(ImageFormat format) { return format == ImageFormat::PFM || format == ImageFormat::EXR; }
+		static const char* GetExtension(ImageFormat format);
+		// prefix_00042.png
+		static std::string MakeFileName(const std::string& prefix, uint32_t frameNumber, ImageFormat format);
+
+		// Synchronous encoders, used by the writer thread
+		static bool Write(const Frame& frame);
+
+	private:
+		void WriterThread();
+
+		static bool WritePNG(const Frame& frame);
+		static bool WritePPM(const Frame& frame);
+		static bool WritePFM(const Frame& frame);
+		static bool WriteEXR(const Frame& frame);
+
+		const size_t m_MaxQueuedFrames{};
+
+		std::deque<Frame> m_Queue{};
+		std::mutex m_Mutex{};
+		std::condition_variable m_QueueChanged{};
+		bool m_IsBusy{ false };
+		bool m_IsStopping{ false };
+
+		std::atomic<uint32_t> m_FramesWritten{};
+		std::atomic<uint32_t> m_FramesFailed{};
+		std::atomic<uint32_t> m_BackpressureStalls{};
+
+		std::thread m_Thread{};
+	};
+}
@@ -1,4 +1,9 @@
 #pragma once
+#include <bit>
+#include <initializer_list>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
@@ -6,27 +11,45 @@
 namespace dae
 {
 #pragma region Material BASE
+	// Materials are plain copyable values stored by value in the MaterialRegistry, no virtual calls or heap objects
+	// Every material provides:
+	//   ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
+	//     hitRecord: current hitrecord, l: light direction, v: view direction
+	//   float GetReflectivity() const
+	//   ColorRGB GetAlbedo() const
+	//     base color of the surface, for the denoiser's feature buffers
+	//   Vector3 SampleDirection(n, wo, u1, u2) const & float GetPdf(n, wo, wi) const
+	//     importance sampling for the path tracer, wo & wi point away from the surface, the base class samples the cosine lobe
+	//   size_t GetHash() const + operator==, used to deduplicate identical materials
 	class Material
 	{
 	public:
-		Material() = default;
-		virtual ~Material() = default;
-
-		Material(const Material&) = delete;
-		Material(Material&&) noexcept = delete;
-		Material& operator=(const Material&) = delete;
-		Material& operator=(Material&&) noexcept = delete;
-
-		/**
-		 * \brief Function used to calculate the correct color for the specific material and its parameters
-		 * \param hitRecord current hitrecord
-		 * \param l light direction
-		 * \param v view direction
-		 * \return color
-		 */
-
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
-		virtual float GetReflectivity() { return 0.0f; }
+		float GetReflectivity() const { return 0.0f; }
+		bool operator==(const Material&) const = default;
+
+		// Diffuse materials bounce like Lambert's cosine law
+		Vector3 SampleDirection(const Vector3& n, const Vector3& wo, float u1, float u2) const
+		{
+			return BRDF::SampleCosineHemisphere(n, u1, u2);
+		}
+
+		float GetPdf(const Vector3& n, const Vector3& wo, const Vector3& wi) const
+		{
+			return BRDF::CosineHemispherePdf(n, wi);
+		}
+
+	protected:
+		static size_t HashParameters(size_t type, std::initializer_list<float> parameters)
+		{
+			// FNV-1a over the bit patterns, -0 & +0 hash differently but that only costs a missed dedup
+			size_t hash{ 14695981039346656037ull ^ type };
+			for (float parameter : parameters)
+			{
+				hash ^= std::bit_cast<uint32_t>(parameter);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
 	};
 #pragma endregion
 
@@ -40,16 +63,21 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord, const Vector3& l, const Vector3& v) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			return m_Color;
 		}
 
+		ColorRGB GetAlbedo() const { return m_Color; }
+
 		void SetColor(const ColorRGB& color)
 		{
 			m_Color = color;
 		}
 
+		size_t GetHash() const { return HashParameters(0, { m_Color.r, m_Color.g, m_Color.b }); }
+		bool operator==(const Material_SolidColor&) const = default;
+
 	private:
 		ColorRGB m_Color{ colors::White };
 	};
@@ -58,7 +86,7 @@ namespace dae
 #pragma region Material LAMBERT
 	//LAMBERT
 	//=======
-	class Material_Lambert : public Material
+	class Material_Lambert final : public Material
 	{
 	public:
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
@@ -66,12 +94,17 @@ namespace dae
 		{
 		}
 
-		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
 		}
 
-	protected:
+		ColorRGB GetAlbedo() const { return m_DiffuseColor * m_DiffuseReflectance; }
+
+		size_t GetHash() const { return HashParameters(1, { m_DiffuseColor.r, m_DiffuseColor.g, m_DiffuseColor.b, m_DiffuseReflectance }); }
+		bool operator==(const Material_Lambert&) const = default;
+
+	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
 	};
@@ -91,12 +124,20 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor)
 				+ BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
 		}
 
+		ColorRGB GetAlbedo() const { return m_DiffuseColor * m_DiffuseReflectance; }
+
+		size_t GetHash() const
+		{
+			return HashParameters(2, { m_DiffuseColor.r, m_DiffuseColor.g, m_DiffuseColor.b, m_DiffuseReflectance, m_SpecularReflectance, m_PhongExponent });
+		}
+		bool operator==(const Material_LambertPhong&) const = default;
+
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
@@ -115,7 +156,7 @@ namespace dae
 		{
 		}
 
-		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
+		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) const
 		{
 			// Calculate Specular (CookTorrance BRDF)			
 			const ColorRGB baseReflectivity{ m_Metalness == 0 ? ColorRGB{0.04f, 0.04f, 0.04f} : m_Albedo };  // f0 (used for fresnel)
@@ -135,15 +176,118 @@ namespace dae
 			return specularColor + diffuseColor;
 		}
 
-		virtual float GetReflectivity() override
+		float GetReflectivity() const
 		{
 			return (1.0f - m_Roughness) * m_Metalness;
 		}
 
+		// Metals tint their reflections with it, so it's the base color either way
+		ColorRGB GetAlbedo() const { return m_Albedo; }
+
+		// One sample picks the GGX specular lobe or the diffuse cosine lobe, the pdf covers both so either pick is weighted right
+		// u1 picks the lobe & is stretched back to [0, 1) for it, so well spread samples stay well spread within each lobe
+		Vector3 SampleDirection(const Vector3& n, const Vector3& wo, float u1, float u2) const
+		{
+			const float specularProbability{ GetSpecularProbability() };
+			if (u1 >= specularProbability)
+				return BRDF::SampleCosineHemisphere(n, std::min((u1 - specularProbability) / (1.0f - specularProbability), 0.99999994f), u2);
+			return Vector3::Reflect(-wo, BRDF::SampleGGXHalfVector(n, m_Roughness, u1 / specularProbability, u2));
+		}
+
+		float GetPdf(const Vector3& n, const Vector3& wo, const Vector3& wi) const
+		{
+			const float specularProbability{ GetSpecularProbability() };
+			return specularProbability * BRDF::GGXReflectionPdf(n, wo, wi, m_Roughness)
+				+ (1.0f - specularProbability) * BRDF::CosineHemispherePdf(n, wi);
+		}
+
+		size_t GetHash() const { return HashParameters(3, { m_Albedo.r, m_Albedo.g, m_Albedo.b, m_Metalness, m_Roughness }); }
+		bool operator==(const Material_CookTorrence&) const = default;
+
 	private:
+		// Metals have no diffuse part, dielectrics split evenly so small highlights still get found
+		float GetSpecularProbability() const { return m_Metalness > 0.0f ? 1.0f : 0.5f; }
+
 		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
 		float m_Metalness{ 1.0f };
 		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
 	};
 #pragma endregion
+
+#pragma region Material REGISTRY
+	using MaterialVariant = std::variant<Material_SolidColor, Material_Lambert, Material_LambertPhong, Material_CookTorrence>;
+
+	/**
+	 * \brief Owns all materials of a scene in one contiguous array, indexed by 32 bit MaterialIds
+	 * Adding a material identical to an existing one returns the existing id, unless it's added as unique (e.g. to animate it)
+	 */
+	class MaterialRegistry final
+	{
+	public:
+		template<typename MaterialType>
+		MaterialId Add(const MaterialType& material, bool isUnique = false)
+		{
+			const size_t hash{ material.GetHash() };
+			if (!isUnique)
+			{
+				const auto [first, last] { m_Lookup.equal_range(hash) };
+				for (auto it{ first }; it != last; ++it)
+				{
+					const MaterialType* pExisting{ std::get_if<MaterialType>(&m_Materials[it->second]) };
+					if (pExisting && *pExisting == material)
+						return it->second;
+				}
+			}
+
+			const MaterialId id{ static_cast<MaterialId>(m_Materials.size()) };
+			m_Materials.emplace_back(material);
+			if (!isUnique)
+				m_Lookup.emplace(hash, id);
+			return id;
+		}
+
+		ColorRGB Shade(MaterialId id, const HitRecord& hitRecord, const Vector3& l, const Vector3& v) const
+		{
+			return std::visit([&](const auto& material) { return material.Shade(hitRecord, l, v); }, m_Materials[id]);
+		}
+
+		float GetReflectivity(MaterialId id) const
+		{
+			return std::visit([](const auto& material) { return material.GetReflectivity(); }, m_Materials[id]);
+		}
+
+		ColorRGB GetAlbedo(MaterialId id) const
+		{
+			return std::visit([](const auto& material) { return material.GetAlbedo(); }, m_Materials[id]);
+		}
+
+		Vector3 SampleDirection(MaterialId id, const Vector3& n, const Vector3& wo, float u1, float u2) const
+		{
+			return std::visit([&](const auto& material) { return material.SampleDirection(n, wo, u1, u2); }, m_Materials[id]);
+		}
+
+		float GetPdf(MaterialId id, const Vector3& n, const Vector3& wo, const Vector3& wi) const
+		{
+			return std::visit([&](const auto& material) { return material.GetPdf(n, wo, wi); }, m_Materials[id]);
+		}
+
+		// Editing a shared (deduplicated) material changes every object using it, add it as unique instead
+		template<typename MaterialType>
+		MaterialType& Get(MaterialId id) { return std::get<MaterialType>(m_Materials[id]); }
+		const MaterialVariant& Get(MaterialId id) const { return m_Materials[id]; }
+
+		size_t Size() const { return m_Materials.size(); }
+		void Reserve(size_t capacity) { m_Materials.reserve(capacity); }
+		void Clear()
+		{
+			m_Materials.clear();
+			m_Lookup.clear();
+		}
+
+	private:
+		std::vector<MaterialVariant> m_Materials{};
+		// Parameter hash -> id, only for shareable materials
+		std::unordered_multimap<size_t, MaterialId> m_Lookup{};
+	};
+#pragma endregion
 }
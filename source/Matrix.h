@@ -1,53 +1,238 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+
 #include "Vector3.h"
 #include "Vector4.h"
 
 namespace dae {
+	// Header-only, the rows are aligned Vector4's so every transform is a handful of SSE multiply-adds
 	struct Matrix
 	{
-		Matrix() = default;
-		Matrix(
+		constexpr Matrix() = default;
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-		const Matrix& Transpose();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		constexpr Matrix(const Matrix& m) = default;
+		constexpr Matrix& operator=(const Matrix& m) = default;
+
+		Vector3 TransformVector(const Vector3& v) const
+		{
+			// x * xAxis + y * yAxis + z * zAxis
+			const __m128 p{ v.Load() };
+			const __m128 xx{ _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)) };
+			const __m128 yy{ _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)) };
+			const __m128 zz{ _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)) };
+
+			__m128 result{ _mm_mul_ps(xx, data[0].Load()) };
+			result = simd::MulAdd(yy, data[1].Load(), result);
+			result = simd::MulAdd(zz, data[2].Load(), result);
+			return Vector3{ _mm_and_ps(result, XYZMask()) };
+		}
+
+		Vector3 TransformVector(float x, float y, float z) const
+		{
+			return TransformVector(Vector3{ x, y, z });
+		}
+
+		Vector3 TransformPoint(const Vector3& p) const
+		{
+			// x * xAxis + y * yAxis + z * zAxis + T
+			const __m128 v{ p.Load() };
+			const __m128 xx{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)) };
+			const __m128 yy{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)) };
+			const __m128 zz{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)) };
+
+			__m128 result{ simd::MulAdd(xx, data[0].Load(), data[3].Load()) };
+			result = simd::MulAdd(yy, data[1].Load(), result);
+			result = simd::MulAdd(zz, data[2].Load(), result);
+			return Vector3{ _mm_and_ps(result, XYZMask()) };
+		}
+
+		Vector3 TransformPoint(float x, float y, float z) const
+		{
+			return TransformPoint(Vector3{ x, y, z });
+		}
+
+		const Matrix& Transpose()
+		{
+			__m128 r0{ data[0].Load() };
+			__m128 r1{ data[1].Load() };
+			__m128 r2{ data[2].Load() };
+			__m128 r3{ data[3].Load() };
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			data[0] = Vector4{ r0 };
+			data[1] = Vector4{ r1 };
+			data[2] = Vector4{ r2 };
+			data[3] = Vector4{ r3 };
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const { return data[0]; }
+		constexpr Vector3 GetAxisY() const { return data[1]; }
+		constexpr Vector3 GetAxisZ() const { return data[2]; }
+		constexpr Vector3 GetTranslation() const { return data[3]; }
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			return CreateTranslation(Vector3{ x, y, z });
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			// Input is in radians
+			// Returns Rotation Matrix that rotates around the X axis
+			const float c{ cosf(pitch) };
+			const float s{ sinf(pitch) };
+			return {
+				{ 1, 0, 0 , 0 },
+				{ 0, c, -s, 0 },
+				{ 0, s, c , 0 },
+				{ 0, 0, 0 , 1 }
+			};
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			// Input is in radians
+			// Returns Rotation Matrix that rotates around the Y axis
+			const float c{ cosf(yaw) };
+			const float s{ sinf(yaw) };
+			return {
+				{ c, 0, -s, 0 },
+				{ 0, 1, 0 , 0 },
+				{ s, 0, c , 0 },
+				{ 0, 0, 0 , 1 }
+			};
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			// Input is in radians
+			// Returns Rotation Matrix that rotates around the Z axis
+			const float c{ cosf(roll) };
+			const float s{ sinf(roll) };
+			return {
+				{ c , s, 0, 0 },
+				{ -s, c, 0, 0 },
+				{ 0 , 0, 1, 0 },
+				{ 0 , 0, 0, 1 }
+			};
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			return CreateRotationX(r.x) * CreateRotationY(r.y) * CreateRotationZ(r.z);
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			return {
+				{ sx,  0,  0,  0},
+				{  0, sy,  0,  0},
+				{  0,  0, sz,  0},
+				{  0,  0,  0,  1}
+			};
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+#pragma region Operator Overloads
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr const Vector4& operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Matrix operator*(const Matrix& m) const
+		{
+			if (std::is_constant_evaluated())
+			{
+				Matrix result{};
+				for (int r{ 0 }; r < 4; ++r)
+				{
+					for (int c{ 0 }; c < 4; ++c)
+					{
+						result[r][c] = data[r][0] * m[0][c] + data[r][1] * m[1][c] + data[r][2] * m[2][c] + data[r][3] * m[3][c];
+					}
+				}
+				return result;
+			}
+
+			// Every result row is a linear combination of the rows of m, so no transpose is needed
+			const __m128 m0{ m.data[0].Load() };
+			const __m128 m1{ m.data[1].Load() };
+			const __m128 m2{ m.data[2].Load() };
+			const __m128 m3{ m.data[3].Load() };
+
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				const __m128 row{ data[r].Load() };
+				__m128 out{ _mm_mul_ps(_mm_shuffle_ps(row, row, _MM_SHUFFLE(0, 0, 0, 0)), m0) };
+				out = simd::MulAdd(_mm_shuffle_ps(row, row, _MM_SHUFFLE(1, 1, 1, 1)), m1, out);
+				out = simd::MulAdd(_mm_shuffle_ps(row, row, _MM_SHUFFLE(2, 2, 2, 2)), m2, out);
+				out = simd::MulAdd(_mm_shuffle_ps(row, row, _MM_SHUFFLE(3, 3, 3, 3)), m3, out);
+				result.data[r] = Vector4{ out };
+			}
+			return result;
+		}
+
+		constexpr const Matrix& operator*=(const Matrix& m)
+		{
+			*this = *this * m;
+			return *this;
+		}
+#pragma endregion
 
 	private:
+		static __m128 XYZMask()
+		{
+			return _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		}
 
 		//Row-Major Matrix
 		Vector4 data[4]
@@ -63,4 +248,4 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,289 @@
+#include "Network.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		std::mutex g_StartupMutex{};
+		int g_StartupCount{};
+
+		// Time left until the deadline, -1 (forever) stays -1 & a passed deadline still allows a non-blocking check
+		int GetRemainingMs(int timeoutMs, Clock::time_point start)
+		{
+			if (timeoutMs < 0)
+				return -1;
+			const auto elapsedMs{ std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() };
+			return static_cast<int>(std::max<long long>(timeoutMs - elapsedMs, 0));
+		}
+
+		// Nagle would hold back small messages (tile requests) waiting for more data, local sockets just ignore this
+		void DisableNagle(SOCKET handle)
+		{
+			const BOOL noDelay{ TRUE };
+			setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+		}
+
+		bool MakeLocalAddress(const std::string& path, sockaddr_un& address)
+		{
+			if (path.empty() || path.size() >= sizeof(address.sun_path))
+				return false;
+			address.sun_family = AF_UNIX;
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+			return true;
+		}
+	}
+
+	bool Network::Startup()
+	{
+		const std::lock_guard lock{ g_StartupMutex };
+		if (g_StartupCount == 0)
+		{
+			WSADATA data{};
+			if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+				return false;
+		}
+		++g_StartupCount;
+		return true;
+	}
+
+	void Network::Cleanup()
+	{
+		const std::lock_guard lock{ g_StartupMutex };
+		if (g_StartupCount > 0 && --g_StartupCount == 0)
+			WSACleanup();
+	}
+
+#pragma region Socket
+	Network::Socket::~Socket()
+	{
+		Close();
+	}
+
+	Network::Socket::Socket(Socket&& other) noexcept :
+		m_Handle{ std::exchange(other.m_Handle, InvalidHandle) }
+	{
+	}
+
+	Network::Socket& Network::Socket::operator=(Socket&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Close();
+			m_Handle = std::exchange(other.m_Handle, InvalidHandle);
+		}
+		return *this;
+	}
+
+	bool Network::Socket::Listen(uint16_t port)
+	{
+		Close();
+		const SOCKET handle{ socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) };
+		if (handle == INVALID_SOCKET)
+			return false;
+		m_Handle = static_cast<uintptr_t>(handle);
+
+		sockaddr_in address{};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+			|| listen(handle, SOMAXCONN) == SOCKET_ERROR)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool Network::Socket::Connect(const std::string& host, uint16_t port)
+	{
+		Close();
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		addrinfo* pResult{};
+		if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &pResult) != 0)
+			return false;
+
+		for (const addrinfo* pAddress{ pResult }; pAddress; pAddress = pAddress->ai_next)
+		{
+			const SOCKET handle{ socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol) };
+			if (handle == INVALID_SOCKET)
+				continue;
+			if (connect(handle, pAddress->ai_addr, static_cast<int>(pAddress->ai_addrlen)) == 0)
+			{
+				DisableNagle(handle);
+				m_Handle = static_cast<uintptr_t>(handle);
+				break;
+			}
+			closesocket(handle);
+		}
+		freeaddrinfo(pResult);
+		return IsValid();
+	}
+
+	bool Network::Socket::ListenLocal(const std::string& path)
+	{
+		Close();
+		sockaddr_un address{};
+		if (!MakeLocalAddress(path, address))
+			return false;
+		// Binding fails on an existing file, a previous run that crashed leaves one behind
+		std::error_code error{};
+		std::filesystem::remove(path, error);
+
+		const SOCKET handle{ socket(AF_UNIX, SOCK_STREAM, 0) };
+		if (handle == INVALID_SOCKET)
+			return false;
+		m_Handle = static_cast<uintptr_t>(handle);
+		if (bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+			|| listen(handle, SOMAXCONN) == SOCKET_ERROR)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	bool Network::Socket::ConnectLocal(const std::string& path)
+	{
+		Close();
+		sockaddr_un address{};
+		if (!MakeLocalAddress(path, address))
+			return false;
+
+		const SOCKET handle{ socket(AF_UNIX, SOCK_STREAM, 0) };
+		if (handle == INVALID_SOCKET)
+			return false;
+		if (connect(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+		{
+			closesocket(handle);
+			return false;
+		}
+		m_Handle = static_cast<uintptr_t>(handle);
+		return true;
+	}
+
+	Network::Socket Network::Socket::Accept() const
+	{
+		const SOCKET handle{ accept(static_cast<SOCKET>(m_Handle), nullptr, nullptr) };
+		if (handle == INVALID_SOCKET)
+			return {};
+		DisableNagle(handle);
+		return Socket{ static_cast<uintptr_t>(handle) };
+	}
+
+	void Network::Socket::Close()
+	{
+		if (!IsValid())
+			return;
+		closesocket(static_cast<SOCKET>(m_Handle));
+		m_Handle = InvalidHandle;
+	}
+
+	uint16_t Network::Socket::GetPort() const
+	{
+		sockaddr_in address{};
+		int size{ sizeof(address) };
+		if (getsockname(static_cast<SOCKET>(m_Handle), reinterpret_cast<sockaddr*>(&address), &size) == SOCKET_ERROR)
+			return 0;
+		return ntohs(address.sin_port);
+	}
+
+	bool Network::Socket::Send(const void* pData, size_t size) const
+	{
+		const char* pBytes{ static_cast<const char*>(pData) };
+		while (size > 0)
+		{
+			const int sent{ send(static_cast<SOCKET>(m_Handle), pBytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0) };
+			if (sent <= 0)
+				return false;
+			pBytes += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	bool Network::Socket::Receive(void* pData, size_t size, int timeoutMs) const
+	{
+		const Clock::time_point start{ Clock::now() };
+		char* pBytes{ static_cast<char*>(pData) };
+		while (size > 0)
+		{
+			if (timeoutMs >= 0 && !WaitReadable(GetRemainingMs(timeoutMs, start)))
+				return false;
+
+			// 0 is a closed connection, so a message cut short fails just like an error does
+			const int received{ recv(static_cast<SOCKET>(m_Handle), pBytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0) };
+			if (received <= 0)
+				return false;
+			pBytes += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	bool Network::Socket::WaitReadable(int timeoutMs) const
+	{
+		return !WaitForAny({ this }, timeoutMs).empty();
+	}
+
+	bool Network::Socket::WriteMessage(uint32_t type, const void* pPayload, size_t size) const
+	{
+		if (size > MaxMessageSize)
+			return false;
+		const MessageHeader header{ type, static_cast<uint32_t>(size) };
+		return Send(&header, sizeof(header)) && (size == 0 || Send(pPayload, size));
+	}
+
+	bool Network::Socket::ReadMessage(MessageHeader& header, std::vector<uint8_t>& payload, int timeoutMs) const
+	{
+		const Clock::time_point start{ Clock::now() };
+		if (!Receive(&header, sizeof(header), timeoutMs) || header.size > MaxMessageSize)
+			return false;
+		payload.resize(header.size);
+		return header.size == 0 || Receive(payload.data(), header.size, GetRemainingMs(timeoutMs, start));
+	}
+#pragma endregion
+
+	std::vector<size_t> Network::WaitForAny(const std::vector<const Socket*>& sockets, int timeoutMs)
+	{
+		// Winsock's fd_set is a plain list, FD_SETSIZE is 64 by default which is plenty here
+		fd_set readSet{};
+		FD_ZERO(&readSet);
+		for (const Socket* pSocket : sockets)
+		{
+			if (pSocket->IsValid())
+				FD_SET(static_cast<SOCKET>(pSocket->m_Handle), &readSet);
+		}
+
+		timeval timeout{ timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+		std::vector<size_t> readable{};
+		if (select(0, &readSet, nullptr, nullptr, timeoutMs < 0 ? nullptr : &timeout) <= 0)
+			return readable;
+
+		for (size_t i{}; i < sockets.size(); ++i)
+		{
+			if (sockets[i]->IsValid() && FD_ISSET(static_cast<SOCKET>(sockets[i]->m_Handle), &readSet))
+				readable.push_back(i);
+		}
+		return readable;
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dae
+{
+	namespace Network
+	{
+		// Winsock has to be running before the first socket, counted so every user can simply pair these
+		bool Startup();
+		void Cleanup();
+
+		// In front of every message, both ends are the same build so it goes over the wire as is
+		struct MessageHeader
+		{
+			uint32_t type{};
+			uint32_t size{}; // Payload bytes following the header
+		};
+
+		// Anything bigger is treated as a corrupt stream
+		constexpr uint32_t MaxMessageSize{ 256u << 20 };
+
+		/**
+		 * \brief Blocking stream socket, closed when it goes out of scope
+		 * Keeps the native handle as an integer so users don't pull in the Winsock headers
+		 */
+		class Socket final
+		{
+		public:
+			Socket() = default;
+			~Socket();
+
+			Socket(const Socket&) = delete;
+			Socket(Socket&& other) noexcept;
+			Socket& operator=(const Socket&) = delete;
+			Socket& operator=(Socket&& other) noexcept;
+
+			// Loopback only, port 0 lets the OS pick a free one (see GetPort)
+			bool Listen(uint16_t port);
+			bool Connect(const std::string& host, uint16_t port);
+			// Unix domain socket (Windows 10 1803 & up), a stale socket file at the path is replaced
+			bool ListenLocal(const std::string& path);
+			bool ConnectLocal(const std::string& path);
+			// Blocks until a client connects, invalid socket on failure
+			Socket Accept() const;
+			void Close();
+
+			bool IsValid() const { return m_Handle != InvalidHandle; }
+			uint16_t GetPort() const;
+
+			// All or nothing, false once the connection is broken
+			bool Send(const void* pData, size_t size) const;
+			// Also false when the whole size didn't arrive within the timeout, -1 waits forever
+			bool Receive(void* pData, size_t size, int timeoutMs = -1) const;
+			// True when a read won't block (data, a closed connection or a pending Accept), -1 waits forever
+			bool WaitReadable(int timeoutMs) const;
+
+			bool WriteMessage(uint32_t type, const void* pPayload = nullptr, size_t size = 0) const;
+			// The timeout covers header & payload, a peer that stalls halfway through a message can't hold the reader up
+			bool ReadMessage(MessageHeader& header, std::vector<uint8_t>& payload, int timeoutMs = -1) const;
+
+		private:
+			friend std::vector<size_t> WaitForAny(const std::vector<const Socket*>& sockets, int timeoutMs);
+
+			static constexpr uintptr_t InvalidHandle{ ~uintptr_t{} };
+
+			explicit Socket(uintptr_t handle) : m_Handle{ handle } {}
+
+			uintptr_t m_Handle{ InvalidHandle };
+		};
+
+		// Indices of the sockets a read won't block on, empty after the timeout
+		std::vector<size_t> WaitForAny(const std::vector<const Socket*>& sockets, int timeoutMs);
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+namespace dae
+{
+	// Random numbers that only depend on their inputs (pixel, sample, dimension), never on the thread or the order of the tiles,
+	// so images stay deterministic no matter how the work is spread over the workers
+	namespace Random
+	{
+		// PCG output permutation used as an integer hash (Jarzynski & Olano, Hash Functions for GPU Rendering)
+		constexpr uint32_t Hash(uint32_t value)
+		{
+			const uint32_t state{ value * 747796405u + 2891336453u };
+			const uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+			return (word >> 22u) ^ word;
+		}
+
+		constexpr uint32_t Hash(uint32_t a, uint32_t b)
+		{
+			return Hash(a ^ Hash(b));
+		}
+
+		// [0, 1) from the top 24 bits, every result is exactly representable
+		constexpr float ToUnitFloat(uint32_t bits)
+		{
+			return float(bits >> 8) * (1.f / 16777216.f);
+		}
+
+		// Uniform [0, 1) for a seed (e.g. the pixel) & a dimension (e.g. the bounce)
+		constexpr float GetFloat(uint32_t seed, uint32_t dimension)
+		{
+			return ToUnitFloat(Hash(seed, dimension));
+		}
+
+		// PCG32 (O'Neill, pcg-random.org), every sequence (e.g. pixel & sample) gets a stream of its own
+		// Lives on the stack of whoever uses it, so there's nothing shared between threads to lock
+		class PCG32 final
+		{
+		public:
+			constexpr PCG32(uint64_t seed, uint64_t sequence) :
+				m_Increment{ (sequence << 1u) | 1u }
+			{
+				NextUint();
+				m_State += seed;
+				NextUint();
+			}
+
+			constexpr uint32_t NextUint()
+			{
+				const uint64_t oldState{ m_State };
+				m_State = oldState * 6364136223846793005ull + m_Increment;
+				const uint32_t xorShifted{ uint32_t(((oldState >> 18u) ^ oldState) >> 27u) };
+				const uint32_t rotation{ uint32_t(oldState >> 59u) };
+				return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31u));
+			}
+
+			constexpr float NextFloat()
+			{
+				return ToUnitFloat(NextUint());
+			}
+
+		private:
+			uint64_t m_State{};
+			uint64_t m_Increment{};
+		};
+
+		constexpr uint32_t ReverseBits(uint32_t value)
+		{
+			value = (value << 16u) | (value >> 16u);
+			value = ((value & 0x00ff00ffu) << 8u) | ((value & 0xff00ff00u) >> 8u);
+			value = ((value & 0x0f0f0f0fu) << 4u) | ((value & 0xf0f0f0f0u) >> 4u);
+			value = ((value & 0x33333333u) << 2u) | ((value & 0xccccccccu) >> 2u);
+			value = ((value & 0x55555555u) << 1u) | ((value & 0xaaaaaaaau) >> 1u);
+			return value;
+		}
+
+		// Owen scrambling by hashing (Burley, Practical Hash-based Owen Scrambling), keeps the stratification of the points
+		constexpr uint32_t NestedUniformScramble(uint32_t value, uint32_t seed)
+		{
+			value = ReverseBits(value);
+			value += seed;
+			value ^= value * 0x6c50b47cu;
+			value ^= value * 0xb82f1e52u;
+			value ^= value * 0xc7afe638u;
+			value ^= value * 0x8d22f6e6u;
+			return ReverseBits(value);
+		}
+
+		// The second Sobol dimension XORs direction number i (v ^= v >> 1 from the top bit) in for every set bit i of the index
+		// That's linear in the bits, so the 32 steps fold into 4 lookups of one byte each
+		constexpr auto MakeSobolSecondDimensionTables()
+		{
+			std::array<std::array<uint32_t, 256>, 4> tables{};
+			uint32_t directions[32]{};
+			directions[0] = 1u << 31u;
+			for (int bit{ 1 }; bit < 32; ++bit)
+				directions[bit] = directions[bit - 1] ^ (directions[bit - 1] >> 1u);
+
+			for (int byte{}; byte < 4; ++byte)
+			{
+				for (uint32_t value{}; value < 256; ++value)
+				{
+					for (int bit{}; bit < 8; ++bit)
+					{
+						if (value & (1u << bit))
+							tables[byte][value] ^= directions[byte * 8 + bit];
+					}
+				}
+			}
+			return tables;
+		}
+		inline constexpr std::array<std::array<uint32_t, 256>, 4> g_SobolSecondDimension{ MakeSobolSecondDimensionTables() };
+
+		/**
+		 * \brief Point of a 2D Sobol sequence in [0, 1)^2, scrambled & shuffled per seed
+		 * Every pixel & every pair of dimensions (pixel jitter, first bounce, ...) passes its own seed, so the pairs aren't correlated
+		 * The first n points of any seed are well spread over the square, the error drops a lot faster than with random numbers
+		 */
+		inline void GetSobol2D(uint32_t index, uint32_t seed, float& x, float& y)
+		{
+			index = NestedUniformScramble(index, seed);
+
+			// First two Sobol dimensions, van der Corput & the byte tables of the second one
+			uint32_t sobolX{ ReverseBits(index) };
+			uint32_t sobolY{ g_SobolSecondDimension[0][index & 0xffu] ^ g_SobolSecondDimension[1][(index >> 8u) & 0xffu]
+				^ g_SobolSecondDimension[2][(index >> 16u) & 0xffu] ^ g_SobolSecondDimension[3][index >> 24u] };
+
+			sobolX = NestedUniformScramble(sobolX, Hash(seed));
+			sobolY = NestedUniformScramble(sobolY, Hash(seed + 1u));
+			x = ToUnitFloat(sobolX);
+			y = ToUnitFloat(sobolY);
+		}
+	}
+}
@@ -0,0 +1,166 @@
+#include "RayStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <ppl.h>
+
+namespace dae
+{
+	namespace
+	{
+		// One slot per worker thread, cache line aligned so threads don't fight over the same line
+		struct alignas(64) ThreadSlot
+		{
+			RayCounters counters{};
+			bool isUsed{};
+		};
+
+		// Handed out the first time a thread finishes a pixel & kept for the rest of the program,
+		// the lock only guards the list, the slots themselves are only written by their own thread
+		std::mutex g_ThreadSlotsMutex{};
+		std::vector<std::unique_ptr<ThreadSlot>> g_ThreadSlots{};
+
+		ThreadSlot& AddThreadSlot()
+		{
+			const std::lock_guard lock{ g_ThreadSlotsMutex };
+			return *g_ThreadSlots.emplace_back(std::make_unique<ThreadSlot>());
+		}
+
+		ThreadSlot& GetThreadSlot()
+		{
+			static thread_local ThreadSlot& slot{ AddThreadSlot() };
+			return slot;
+		}
+
+		uint32_t GetCounter(const RayCounters& counters, HeatmapMode mode)
+		{
+			switch (mode)
+			{
+			case HeatmapMode::Rays:
+				return counters.GetRays();
+			case HeatmapMode::Triangles:
+				return counters.triangleTests;
+			default:
+				return counters.GetCost();
+			}
+		}
+
+		// Blue > cyan > green > yellow > red
+		ColorRGB GetHeatColor(float t)
+		{
+			constexpr ColorRGB stops[5]{ { 0.f, 0.f, 1.f }, { 0.f, 1.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+			const float scaled{ std::clamp(t, 0.f, 1.f) * 4.f };
+			const int index{ std::min(static_cast<int>(scaled), 3) };
+			const float fraction{ scaled - index };
+			return stops[index] * (1.f - fraction) + stops[index + 1] * fraction;
+		}
+	}
+
+	void RayStats::BeginFrame()
+	{
+		const std::lock_guard lock{ g_ThreadSlotsMutex };
+		for (const std::unique_ptr<ThreadSlot>& pSlot : g_ThreadSlots)
+		{
+			pSlot->counters = {};
+			pSlot->isUsed = false;
+		}
+	}
+
+	RayCounters RayStats::EndPixel()
+	{
+		RayCounters& pixelCounters{ GetPixelCounters() };
+		const RayCounters result{ pixelCounters };
+		pixelCounters = {};
+
+		ThreadSlot& slot{ GetThreadSlot() };
+		slot.counters += result;
+		slot.isUsed = true;
+		return result;
+	}
+
+	std::vector<RayCounters> RayStats::GetThreadTotals()
+	{
+		const std::lock_guard lock{ g_ThreadSlotsMutex };
+		std::vector<RayCounters> totals{};
+		for (const std::unique_ptr<ThreadSlot>& pSlot : g_ThreadSlots)
+		{
+			if (pSlot->isUsed)
+				totals.push_back(pSlot->counters);
+		}
+		return totals;
+	}
+
+	void RayStats::WriteHeatmap(const std::vector<RayCounters>& pixelStats, ColorRGB* pDestination, HeatmapMode mode)
+	{
+		uint32_t maxValue{ 1 };
+		for (const RayCounters& counters : pixelStats)
+			maxValue = std::max(maxValue, GetCounter(counters, mode));
+
+		// Log scale, a handful of expensive pixels would flatten everything else otherwise
+		const float scale{ 1.f / logf(1.f + maxValue) };
+		concurrency::parallel_for(size_t{}, pixelStats.size(),
+			[&](size_t i)
+			{
+				pDestination[i] = GetHeatColor(logf(1.f + GetCounter(pixelStats[i], mode)) * scale);
+			});
+	}
+
+	void RayStats::WriteFrameSummary(std::ostream& stream, uint32_t frameNumber, float traceTime, const std::vector<RayCounters>& pixelStats)
+	{
+		RayCounters total{};
+		uint32_t maxPixelCost{};
+		for (const RayCounters& counters : pixelStats)
+		{
+			total += counters;
+			maxPixelCost = std::max(maxPixelCost, counters.GetCost());
+		}
+
+		// Load balance, how far the busiest thread is above the average
+		const std::vector<RayCounters> threadTotals{ GetThreadTotals() };
+		uint32_t minThreadCost{ UINT32_MAX };
+		uint32_t maxThreadCost{};
+		for (const RayCounters& counters : threadTotals)
+		{
+			minThreadCost = std::min(minThreadCost, counters.GetCost());
+			maxThreadCost = std::max(maxThreadCost, counters.GetCost());
+		}
+		const float avgThreadCost{ threadTotals.empty() ? 0.f : float(total.GetCost()) / threadTotals.size() };
+
+		stream << "FRAME = " << frameNumber
+			<< " TRACE_MS = " << traceTime
+			<< " PRIMARY_RAYS = " << total.primaryRays
+			<< " SHADOW_RAYS = " << total.shadowRays
+			<< " REFLECTION_RAYS = " << total.reflectionRays
+			<< " PRIMITIVE_TESTS = " << total.primitiveTests
+			<< " TRIANGLE_TESTS = " << total.triangleTests
+			<< " SLAB_TESTS = " << total.slabTests
+			<< " TRAVERSAL_STEPS = " << total.traversalSteps
+			<< " AVG_PIXEL_COST = " << (pixelStats.empty() ? 0.f : float(total.GetCost()) / pixelStats.size())
+			<< " MAX_PIXEL_COST = " << maxPixelCost
+			<< " THREADS = " << threadTotals.size()
+			<< " MIN_THREAD_COST = " << (threadTotals.empty() ? 0 : minThreadCost)
+			<< " MAX_THREAD_COST = " << maxThreadCost
+			<< " THREAD_IMBALANCE = " << (avgThreadCost > 0.f ? maxThreadCost / avgThreadCost : 0.f)
+			<< std::endl;
+	}
+
+	const char* RayStats::GetName(HeatmapMode mode)
+	{
+		switch (mode)
+		{
+		case HeatmapMode::Off:
+			return "Off";
+		case HeatmapMode::Cost:
+			return "Cost";
+		case HeatmapMode::Rays:
+			return "Rays";
+		case HeatmapMode::Triangles:
+			return "Triangles";
+		default:
+			return "Unknown";
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "ColorRGB.h"
+
+// Per pixel & per thread traversal counters, only debug builds count by default
+// Define RAY_STATS to count in release, without it every RAY_STATS_ADD compiles to nothing
+// Counting only feeds the heatmap, the per frame summary file needs --ray-stats=file on top
+#if defined(_DEBUG)
+#define RAY_STATS
+#endif
+
+#if defined(RAY_STATS)
+#define RAY_STATS_ADD(counter, amount) (dae::RayStats::GetPixelCounters().counter += static_cast<uint32_t>(amount))
+#else
+#define RAY_STATS_ADD(counter, amount) ((void)0)
+#endif
+
+namespace dae
+{
+	struct RayCounters
+	{
+		uint32_t primaryRays{};
+		uint32_t shadowRays{};
+		uint32_t reflectionRays{};
+		uint32_t primitiveTests{}; // Planes & spheres
+		uint32_t triangleTests{};
+		uint32_t slabTests{};
+		uint32_t traversalSteps{}; // Triangle lists walked after a successful slab test
+
+		RayCounters& operator+=(const RayCounters& other)
+		{
+			primaryRays += other.primaryRays;
+			shadowRays += other.shadowRays;
+			reflectionRays += other.reflectionRays;
+			primitiveTests += other.primitiveTests;
+			triangleTests += other.triangleTests;
+			slabTests += other.slabTests;
+			traversalSteps += other.traversalSteps;
+			return *this;
+		}
+
+		uint32_t GetRays() const { return primaryRays + shadowRays + reflectionRays; }
+		// Rough cost estimate, every test or step counts as one unit
+		uint32_t GetCost() const { return primitiveTests + triangleTests + slabTests + traversalSteps; }
+	};
+
+	enum class HeatmapMode
+	{
+		Off,
+		Cost, // All intersection work
+		Rays, // Rays cast per pixel
+		Triangles // Triangle tests only
+	};
+
+	namespace RayStats
+	{
+		constexpr bool IsEnabled()
+		{
+#if defined(RAY_STATS)
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		// Counters of the pixel the calling thread is working on
+		inline RayCounters& GetPixelCounters()
+		{
+			static thread_local RayCounters counters{};
+			return counters;
+		}
+
+		// Resets the per thread totals, call before the workers start on a frame
+		void BeginFrame();
+		// Adds the current pixel to the calling thread's totals, returns its counters & resets them for the next pixel
+		RayCounters EndPixel();
+		// Totals of every thread that worked on the frame
+		std::vector<RayCounters> GetThreadTotals();
+
+		// Overwrites pDestination with a false color (blue > red, log scale) of the selected counter
+		void WriteHeatmap(const std::vector<RayCounters>& pixelStats, ColorRGB* pDestination, HeatmapMode mode);
+		// One line per frame: totals, per pixel maximum & the spread between threads
+		void WriteFrameSummary(std::ostream& stream, uint32_t frameNumber, float traceTime, const std::vector<RayCounters>& pixelStats);
+
+		const char* GetName(HeatmapMode mode);
+	}
+}
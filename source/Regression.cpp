@@ -0,0 +1,587 @@
+#include "Regression.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <ppl.h>
+#include <vector>
+
+#include "SDL.h"
+
+#include "Headless.h"
+#include "ImageWriter.h"
+#include "Random.h"
+#include "Renderer.h"
+#include "Scene.h"
+
+namespace dae
+{
+	namespace
+	{
+		struct CameraPose
+		{
+			const char* name{};
+			Vector3 offset{};
+			float yawOffset{};
+		};
+
+		struct ImageMetrics
+		{
+			float rmse{};
+			float psnr{};
+			float ssim{};
+		};
+
+		// Offsets from the scene's own camera, so every scene gets the same poses
+		constexpr CameraPose g_Poses[]
+		{
+			{ "Default", {}, 0.f },
+			{ "Offset", { 0.75f, 0.5f, -1.f }, 12.f },
+		};
+
+#pragma region Image IO
+		// Minimal inflate, just enough to read the references back (ImageWriter only writes fixed Huffman blocks,
+		// but all three block types are handled so references re-saved by an image editor still load)
+		class BitReader final
+		{
+		public:
+			BitReader(const uint8_t* pData, size_t size) : m_pData{ pData }, m_BitCount{ size * 8 } {}
+
+			uint32_t Read(int count)
+			{
+				uint32_t bits{};
+				for (int i{}; i < count; ++i)
+				{
+					if (m_Position >= m_BitCount)
+					{
+						m_HasOverrun = true;
+						return 0;
+					}
+					bits |= ((m_pData[m_Position >> 3] >> (m_Position & 7)) & 1u) << i;
+					++m_Position;
+				}
+				return bits;
+			}
+
+			void AlignToByte() { m_Position = (m_Position + 7) & ~size_t{ 7 }; }
+			bool HasOverrun() const { return m_HasOverrun; }
+
+		private:
+			const uint8_t* m_pData{};
+			size_t m_BitCount{};
+			size_t m_Position{};
+			bool m_HasOverrun{};
+		};
+
+		// Canonical Huffman code, decoded one bit at a time from the code lengths alone
+		struct HuffmanTable
+		{
+			uint16_t counts[16]{};
+			uint16_t symbols[288]{};
+
+			HuffmanTable(const uint8_t* pLengths, int symbolCount)
+			{
+				for (int symbol{}; symbol < symbolCount; ++symbol)
+					++counts[pLengths[symbol]];
+				counts[0] = 0;
+
+				uint16_t offsets[16]{};
+				for (int length{ 1 }; length < 15; ++length)
+					offsets[length + 1] = offsets[length] + counts[length];
+				for (int symbol{}; symbol < symbolCount; ++symbol)
+				{
+					if (pLengths[symbol] != 0)
+						symbols[offsets[pLengths[symbol]]++] = static_cast<uint16_t>(symbol);
+				}
+			}
+
+			int Decode(BitReader& reader) const
+			{
+				int code{}, first{}, index{};
+				for (int length{ 1 }; length < 16; ++length)
+				{
+					code |= reader.Read(1);
+					const int count{ counts[length] };
+					if (code - first < count)
+						return symbols[index + code - first];
+					index += count;
+					first = (first + count) << 1;
+					code <<= 1;
+				}
+				return -1;
+			}
+		};
+
+		bool Inflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+		{
+			static constexpr uint16_t lengthBase[29]{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static constexpr uint8_t lengthExtra[29]{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static constexpr uint16_t distanceBase[30]{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static constexpr uint8_t distanceExtra[30]{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+			static constexpr uint8_t codeLengthOrder[19]{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			// 2 byte zlib header up front, the trailing Adler32 isn't checked (the image comparison catches corruption anyway)
+			if (data.size() < 6 || (data[0] & 0x0F) != 8)
+				return false;
+			BitReader reader{ data.data() + 2, data.size() - 2 };
+
+			bool isFinal{};
+			while (!isFinal)
+			{
+				isFinal = reader.Read(1) != 0;
+				const uint32_t blockType{ reader.Read(2) };
+				if (blockType == 0)
+				{
+					// Stored: byte aligned length, its one's complement & the raw bytes
+					reader.AlignToByte();
+					const uint32_t length{ reader.Read(16) };
+					reader.Read(16);
+					for (uint32_t i{}; i < length; ++i)
+						out.push_back(static_cast<uint8_t>(reader.Read(8)));
+					if (reader.HasOverrun())
+						return false;
+					continue;
+				}
+				if (blockType == 3)
+					return false;
+
+				// Literal/length code lengths followed by the distance ones
+				uint8_t lengths[320]{};
+				int literalCount{ 288 };
+				int distanceCount{ 30 };
+				if (blockType == 1)
+				{
+					for (int symbol{}; symbol < 288; ++symbol)
+						lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+					for (int symbol{}; symbol < 30; ++symbol)
+						lengths[288 + symbol] = 5;
+				}
+				else
+				{
+					literalCount = static_cast<int>(reader.Read(5)) + 257;
+					distanceCount = static_cast<int>(reader.Read(5)) + 1;
+					const int codeLengthCount{ static_cast<int>(reader.Read(4)) + 4 };
+
+					uint8_t codeLengths[19]{};
+					for (int i{}; i < codeLengthCount; ++i)
+						codeLengths[codeLengthOrder[i]] = static_cast<uint8_t>(reader.Read(3));
+					const HuffmanTable codeLengthTable{ codeLengths, 19 };
+
+					int index{};
+					while (index < literalCount + distanceCount)
+					{
+						const int symbol{ codeLengthTable.Decode(reader) };
+						if (symbol < 0 || reader.HasOverrun())
+							return false;
+						if (symbol < 16)
+						{
+							lengths[index++] = static_cast<uint8_t>(symbol);
+							continue;
+						}
+
+						// 16 repeats the previous length, 17 & 18 are runs of zeros
+						uint8_t repeated{};
+						int repeat{};
+						if (symbol == 16)
+						{
+							if (index == 0)
+								return false;
+							repeated = lengths[index - 1];
+							repeat = 3 + static_cast<int>(reader.Read(2));
+						}
+						else if (symbol == 17)
+							repeat = 3 + static_cast<int>(reader.Read(3));
+						else
+							repeat = 11 + static_cast<int>(reader.Read(7));
+
+						if (index + repeat > literalCount + distanceCount)
+							return false;
+						while (repeat-- > 0)
+							lengths[index++] = repeated;
+					}
+				}
+
+				const HuffmanTable literalTable{ lengths, literalCount };
+				const HuffmanTable distanceTable{ lengths + literalCount, distanceCount };
+				while (true)
+				{
+					const int symbol{ literalTable.Decode(reader) };
+					if (symbol < 0 || reader.HasOverrun())
+						return false;
+					if (symbol < 256)
+					{
+						out.push_back(static_cast<uint8_t>(symbol));
+						continue;
+					}
+					if (symbol == 256)
+						break;
+
+					const int lengthCode{ symbol - 257 };
+					if (lengthCode >= 29)
+						return false;
+					const uint32_t length{ lengthBase[lengthCode] + reader.Read(lengthExtra[lengthCode]) };
+
+					const int distanceCode{ distanceTable.Decode(reader) };
+					if (distanceCode < 0 || distanceCode >= 30)
+						return false;
+					const uint32_t distance{ distanceBase[distanceCode] + reader.Read(distanceExtra[distanceCode]) };
+					if (distance > out.size())
+						return false;
+
+					// Byte by byte, the match may overlap the bytes it produces
+					const size_t start{ out.size() - distance };
+					for (uint32_t i{}; i < length; ++i)
+						out.push_back(out[start + i]);
+				}
+			}
+			return !reader.HasOverrun();
+		}
+
+		uint32_t ReadBigEndian32(const uint8_t* pData)
+		{
+			return uint32_t(pData[0]) << 24 | uint32_t(pData[1]) << 16 | uint32_t(pData[2]) << 8 | uint32_t(pData[3]);
+		}
+
+		// 8 bit RGB, non-interlaced PNGs only, which is what ImageWriter produces
+		bool LoadPNG(const std::string& fileName, int& width, int& height, std::vector<uint8_t>& pixels)
+		{
+			std::ifstream file(fileName, std::ios::binary);
+			const std::vector<uint8_t> png{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+			constexpr uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			if (png.size() < 8 || !std::equal(std::begin(signature), std::end(signature), png.begin()))
+				return false;
+
+			// Chunks: length, type, data & a CRC, only the header & the image data matter here
+			width = height = 0;
+			std::vector<uint8_t> compressed{};
+			size_t offset{ 8 };
+			while (offset + 12 <= png.size())
+			{
+				const uint32_t length{ ReadBigEndian32(&png[offset]) };
+				if (length > png.size() - offset - 12)
+					return false;
+
+				const std::string type(reinterpret_cast<const char*>(&png[offset + 4]), 4);
+				const uint8_t* pChunk{ png.data() + offset + 8 };
+				if (type == "IHDR")
+				{
+					if (length < 13 || pChunk[8] != 8 || pChunk[9] != 2 || pChunk[12] != 0)
+						return false;
+					width = static_cast<int>(ReadBigEndian32(pChunk));
+					height = static_cast<int>(ReadBigEndian32(pChunk + 4));
+				}
+				else if (type == "IDAT")
+					compressed.insert(compressed.end(), pChunk, pChunk + length);
+				else if (type == "IEND")
+					break;
+
+				offset += 12 + length;
+			}
+
+			std::vector<uint8_t> filtered{};
+			if (width <= 0 || height <= 0 || !Inflate(compressed, filtered))
+				return false;
+			const size_t rowSize{ size_t(width) * 3 };
+			if (filtered.size() < (rowSize + 1) * height)
+				return false;
+
+			// Undo the per scanline filters, each predicts from the already decoded left, up & up-left bytes
+			pixels.resize(rowSize * height);
+			for (int y{}; y < height; ++y)
+			{
+				const uint8_t* pFiltered{ filtered.data() + y * (rowSize + 1) };
+				uint8_t* pRow{ pixels.data() + y * rowSize };
+				const uint8_t* pAbove{ y > 0 ? pRow - rowSize : nullptr };
+				const uint8_t filterType{ *pFiltered++ };
+				if (filterType > 4)
+					return false;
+
+				for (size_t i{}; i < rowSize; ++i)
+				{
+					const int left{ i >= 3 ? pRow[i - 3] : 0 };
+					const int up{ pAbove ? pAbove[i] : 0 };
+					const int upLeft{ pAbove && i >= 3 ? pAbove[i - 3] : 0 };
+
+					int prediction{};
+					switch (filterType)
+					{
+					case 1:
+						prediction = left;
+						break;
+					case 2:
+						prediction = up;
+						break;
+					case 3:
+						prediction = (left + up) / 2;
+						break;
+					case 4:
+					{
+						// Paeth
+						const int estimate{ left + up - upLeft };
+						const int leftDistance{ std::abs(estimate - left) };
+						const int upDistance{ std::abs(estimate - up) };
+						const int upLeftDistance{ std::abs(estimate - upLeft) };
+						prediction = leftDistance <= upDistance && leftDistance <= upLeftDistance ? left
+							: upDistance <= upLeftDistance ? up : upLeft;
+						break;
+					}
+					default:
+						break;
+					}
+					pRow[i] = static_cast<uint8_t>(pFiltered[i] + prediction);
+				}
+			}
+			return true;
+		}
+
+		std::map<std::string, float> LoadBaseline(const std::string& fileName)
+		{
+			std::map<std::string, float> baseline{};
+			std::ifstream file(fileName);
+			std::string line{};
+			while (std::getline(file, line))
+			{
+				// name RELATIVE_TIME = value
+				std::istringstream stream{ line };
+				std::string name{}, key{}, equals{};
+				float value{};
+				if (stream >> name >> key >> equals >> value)
+					baseline[name] = value;
+			}
+			return baseline;
+		}
+#pragma endregion
+
+#pragma region Timing
+		// Fixed amount of renderer independent work, spread over the thread pool like a frame's tiles
+		// Trace times are stored relative to it, so a baseline recorded on another machine, thread count or build still holds
+		// (a change that makes the renderer itself slower shows, a faster or slower machine doesn't)
+		float MeasureCalibrationTime(int runs)
+		{
+			constexpr uint32_t taskCount{ 256 };
+			constexpr uint32_t hashesPerTask{ 20000 };
+
+			std::vector<uint32_t> results(taskCount);
+			std::vector<float> times{};
+			for (int run{}; run < runs; ++run)
+			{
+				const auto start{ std::chrono::steady_clock::now() };
+				concurrency::parallel_for(0u, taskCount, [&](uint32_t task)
+					{
+						// A dependency chain, can't be vectorized or folded away
+						uint32_t value{ task };
+						for (uint32_t i{}; i < hashesPerTask; ++i)
+							value = Random::Hash(value);
+						results[task] = value;
+					});
+				times.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+			}
+			return *std::min_element(times.begin(), times.end());
+		}
+#pragma endregion
+
+#pragma region Metrics
+		float GetLuminance(const uint8_t* pPixel)
+		{
+			return (0.299f * pPixel[0] + 0.587f * pPixel[1] + 0.114f * pPixel[2]) / 255.f;
+		}
+
+		// Mean SSIM on luminance over 8x8 windows with a stride of 4
+		float CalculateSSIM(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height)
+		{
+			constexpr int windowSize{ 8 };
+			constexpr int stride{ 4 };
+			constexpr float c1{ 0.01f * 0.01f };
+			constexpr float c2{ 0.03f * 0.03f };
+			constexpr float sampleCount{ windowSize * windowSize };
+
+			double ssimSum{};
+			int windowCount{};
+			for (int wy{}; wy + windowSize <= height; wy += stride)
+			{
+				for (int wx{}; wx + windowSize <= width; wx += stride)
+				{
+					float sumA{}, sumB{}, sumAA{}, sumBB{}, sumAB{};
+					for (int y{ wy }; y < wy + windowSize; ++y)
+					{
+						for (int x{ wx }; x < wx + windowSize; ++x)
+						{
+							const size_t index{ (size_t(y) * width + x) * 3 };
+							const float la{ GetLuminance(&a[index]) };
+							const float lb{ GetLuminance(&b[index]) };
+							sumA += la;
+							sumB += lb;
+							sumAA += la * la;
+							sumBB += lb * lb;
+							sumAB += la * lb;
+						}
+					}
+
+					const float meanA{ sumA / sampleCount };
+					const float meanB{ sumB / sampleCount };
+					const float varianceA{ sumAA / sampleCount - meanA * meanA };
+					const float varianceB{ sumBB / sampleCount - meanB * meanB };
+					const float covariance{ sumAB / sampleCount - meanA * meanB };
+
+					ssimSum += ((2.f * meanA * meanB + c1) * (2.f * covariance + c2))
+						/ ((meanA * meanA + meanB * meanB + c1) * (varianceA + varianceB + c2));
+					++windowCount;
+				}
+			}
+			return windowCount > 0 ? static_cast<float>(ssimSum / windowCount) : 1.f;
+		}
+
+		ImageMetrics Compare(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int width, int height)
+		{
+			double squaredError{};
+			for (size_t i{}; i < a.size(); ++i)
+			{
+				const double difference{ (a[i] - b[i]) / 255.0 };
+				squaredError += difference * difference;
+			}
+
+			ImageMetrics metrics{};
+			metrics.rmse = static_cast<float>(std::sqrt(squaredError / a.size()));
+			// Identical images have an infinite PSNR, clamp so the report stays readable
+			metrics.psnr = metrics.rmse > 0.f ? std::min(20.f * log10f(1.f / metrics.rmse), 100.f) : 100.f;
+			metrics.ssim = CalculateSSIM(a, b, width, height);
+			return metrics;
+		}
+#pragma endregion
+	}
+
+	int Regression::Run(const Settings& settings)
+	{
+		SDL_Init(SDL_INIT_VIDEO);
+
+		std::filesystem::create_directories(settings.referenceDirectory);
+		const std::string baselineFileName{ settings.referenceDirectory + "baseline.txt" };
+		std::map<std::string, float> baseline{ LoadBaseline(baselineFileName) };
+
+		std::cout << "**REGRESSION**\n";
+		std::ofstream report("regression.txt");
+		int failCount{};
+
+		for (const SceneEntry& sceneEntry : GetBuiltInScenes())
+		{
+			for (const CameraPose& pose : g_Poses)
+			{
+				const std::string name{ std::string(sceneEntry.name) + "_" + pose.name };
+
+				// Fresh renderer & scene per case, no state leaks between them
+				const HeadlessRenderer target{ "RayTracer - Regression", 640, 480 };
+				if (!target.IsValid())
+				{
+					std::cout << ">> " << name << " RESULT = FAIL_WINDOW\n";
+					report << name << " RESULT = FAIL_WINDOW" << std::endl;
+					++failCount;
+					continue;
+				}
+				Renderer* const pRenderer{ &target.GetRenderer() };
+				const std::unique_ptr<Scene> pScene{ sceneEntry.create() };
+				pScene->Initialize();
+				// All shading comes from the lights, an unlit scene (W1) is black from every pose & can't catch anything
+				if (pScene->GetLights().empty())
+				{
+					std::cout << ">> " << sceneEntry.name << " SKIPPED (no lights)\n";
+					report << sceneEntry.name << " SKIPPED" << std::endl;
+					break;
+				}
+				pRenderer->SetReflections(pScene->GetReflectionsEnabled());
+
+				Camera& camera{ pScene->GetCamera() };
+				camera.origin += pose.offset;
+				camera.SetYaw(camera.totalYaw + pose.yawOffset);
+				pScene->SwapBuffers();
+
+				// Fastest of a few runs, anything else running on the machine only ever adds time
+				std::vector<float> traceTimes{};
+				for (int run{}; run < settings.timedRuns; ++run)
+				{
+					pRenderer->Render(pScene.get());
+					traceTimes.push_back(pRenderer->GetLastTraceTime());
+				}
+				const float traceTime{ *std::min_element(traceTimes.begin(), traceTimes.end()) };
+				// Right next to the trace, so both see the same clocks & load
+				const float calibrationTime{ MeasureCalibrationTime(settings.timedRuns) };
+				const float relativeTime{ traceTime / calibrationTime };
+
+				ImageWriter::Frame frame{ pRenderer->CaptureFrame(ImageFormat::PNG, settings.referenceDirectory + name + ".png") };
+
+				std::string result{ "PASS" };
+				ImageMetrics metrics{};
+				float baselineTime{ relativeTime };
+				if (settings.updateReferences)
+				{
+					result = "UPDATED";
+					ImageWriter::Write(frame);
+					baseline[name] = relativeTime;
+				}
+				else
+				{
+					std::vector<uint8_t> referencePixels{};
+					int referenceWidth{}, referenceHeight{};
+					const auto baselineIt{ baseline.find(name) };
+
+					// A missing reference means the case isn't checked at all, which must not pass silently
+					if (!LoadPNG(frame.fileName, referenceWidth, referenceHeight, referencePixels) || baselineIt == baseline.end())
+					{
+						result = "FAIL_MISSING";
+					}
+					else if (referenceWidth != frame.width || referenceHeight != frame.height)
+					{
+						result = "FAIL_SIZE";
+					}
+					else
+					{
+						metrics = Compare(frame.ldrPixels, referencePixels, frame.width, frame.height);
+						baselineTime = baselineIt->second;
+						if (metrics.psnr < settings.minPSNR || metrics.ssim < settings.minSSIM)
+							result = "FAIL_IMAGE";
+						else if (relativeTime > baselineTime * (1.f + settings.timeTolerance) + settings.timeMargin / calibrationTime)
+							result = "FAIL_TIME";
+					}
+				}
+
+				// Keep the failing image next to the report for inspection
+				if (result.rfind("FAIL", 0) == 0)
+				{
+					++failCount;
+					frame.fileName = "regression_" + name + ".png";
+					frame.format = ImageFormat::PNG;
+					ImageWriter::Write(frame);
+				}
+
+				std::ostringstream line{};
+				line << name << " RMSE = " << metrics.rmse << " PSNR = " << metrics.psnr << " SSIM = " << metrics.ssim
+					<< " TRACE_MS = " << traceTime << " CALIBRATION_MS = " << calibrationTime << " RELATIVE_TIME = " << relativeTime
+					<< " BASELINE_RELATIVE_TIME = " << baselineTime << " RESULT = " << result;
+				std::cout << ">> " << line.str() << "\n";
+				report << line.str() << std::endl;
+			}
+		}
+
+		// Only an explicit update touches the timings, so slow drifts still get caught
+		if (settings.updateReferences)
+		{
+			std::ofstream baselineFile(baselineFileName);
+			for (const auto& [name, time] : baseline)
+				baselineFile << name << " RELATIVE_TIME = " << time << "\n";
+		}
+
+		std::cout << (failCount == 0 ? "All passed\n" : std::to_string(failCount) + " failed\n");
+		report << "FAILED = " << failCount << std::endl;
+
+		SDL_Quit();
+		return failCount == 0 ? 0 : 1;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+
+namespace dae
+{
+	namespace Regression
+	{
+		struct Settings
+		{
+			std::string referenceDirectory{ "Resources/Reference/" };
+			// Replace the stored images & timings by the current ones instead of comparing, the only way to create missing ones
+			bool updateReferences{ false };
+
+			float minPSNR{ 40.f }; // dB
+			float minSSIM{ 0.99f };
+			// Allowed slowdown against the baseline, relative + an absolute margin for very fast scenes (in ms of this run)
+			float timeTolerance{ 0.15f };
+			float timeMargin{ 1.f }; // ms
+			int timedRuns{ 5 };
+		};
+
+		/**
+		 * \brief Headless golden image check: renders every built-in scene with lights at fixed camera poses (no scene updates, so fully deterministic),
+		 * compares against the stored references (RMSE, PSNR, SSIM) & the fastest of a few trace times against the stored baseline
+		 * Times are relative to a fixed calibration workload measured in the same run, so the baseline carries over between machines
+		 * A missing reference or timing fails the case, --update (re)creates them. Results go to the console & regression.txt
+		 * \return 0 when everything passed, 1 otherwise (usable as a process exit code)
+		 */
+		int Run(const Settings& settings);
+	}
+}
@@ -9,9 +9,14 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "RayStats.h"
+#include "Tracing.h"
+#include "Random.h"
 #include <thread>
 #include "camera.h"
+#include <chrono>
 #include <future>
+#include <numeric>
 #include <ppl.h>
 
 using namespace dae;
@@ -20,6 +25,40 @@ using namespace dae;
 //#define ASYNC
 #define PARALLEL_FOR
 
+struct Renderer::TraceView
+{
+	Camera camera{};
+	CameraRayGenerator rayGenerator;
+	ColorRGB* pPixels{};
+	// Per pixel counters with RAY_STATS, nullptr drops them
+	RayCounters* pPixelStats{};
+	// First hits for the denoiser, nullptr when they're not needed
+	FeatureBuffers* pFeatures{};
+	uint32_t width{};
+	uint32_t height{};
+	uint32_t tilesX{};
+	uint32_t tileCount{};
+	// Sample index the random numbers start at, moves on every accumulated frame so each frame gets new noise
+	uint32_t firstSample{};
+	PathTracerSettings pathTracer{};
+};
+
+namespace
+{
+	// Block size of TraceWithBudget's coarse pass, every refinement halves it. Has to divide the tile size
+	constexpr uint32_t g_CoarseStep{ 8 };
+	// Tiles in the center of the image get up to this much extra priority over the corners
+	constexpr float g_CenterWeight{ 1.f };
+	// Keeps flat tiles in the queue, they're refined last instead of never
+	constexpr float g_MinTileDetail{ 0.01f };
+
+	// Compressed luminance, so a blown out highlight doesn't outrank every edge in the image
+	float GetPerceivedLuminance(const ColorRGB& color)
+	{
+		const float luminance{ 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b };
+		return luminance / (1.f + luminance);
+	}
+}
 
 Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow),
@@ -29,25 +68,87 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 	m_AspectRatio = m_Width / float(m_Height);
+	for (std::vector<ColorRGB>& hdrBuffer : m_HdrBuffers)
+		hdrBuffer.resize(m_Width * m_Height);
+	m_pHdrPixels = m_HdrBuffers[m_TraceBufferIndex].data();
+#if defined(RAY_STATS)
+	m_PixelStats.resize(m_Width * m_Height);
+	m_pPixelStats = m_PixelStats.data();
+#endif
 	assert(RunTests());
 }
 
 void Renderer::Render(Scene* pScene)
 {
-	Camera& camera = pScene->GetCamera();
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
-	camera.CalculateCameraToWorld();
+	Trace(pScene);
+	SwapFrameBuffers();
+	Present();
+}
 
-	// Only update raydirections if the camera has moved
-	if (camera.updateRayDirections)
-	{
-		RecalculateRayDirections(camera);
-		camera.updateRayDirections = false;
-	}
+void Renderer::Trace(Scene* pScene)
+{
+	TraceFrame(pScene, GetFrameSettings());
+}
+
+std::future<void> Renderer::TraceAsync(Scene* pScene)
+{
+	// Copied here on the main thread, its key handlers keep writing the members while the frame is in flight
+	const FrameSettings settings{ GetFrameSettings() };
+	return std::async(std::launch::async, [=, this] { TraceFrame(pScene, settings); });
+}
 
-	const uint32_t numPixels = m_Width * m_Height;
+Renderer::FrameSettings Renderer::GetFrameSettings() const
+{
+	return FrameSettings{ GetRenderPixelKernel(), m_Integrator, m_PathTracerSettings, m_HeatmapMode, m_DenoiserEnabled, m_DenoiserSettings };
+}
+
+void Renderer::SwapFrameBuffers()
+{
+	m_TraceBufferIndex ^= 1;
+	m_pHdrPixels = m_HdrBuffers[m_TraceBufferIndex].data();
+}
+
+void Renderer::Present()
+{
+	ResolveFrame();
+
+	//Update SDL Surface
+	TRACE_SCOPE("SDL_UpdateWindowSurface");
+	SDL_UpdateWindowSurface(m_pWindow);
+}
+
+void Renderer::ResolveFrame()
+{
+	// Tone map, encode & quantize the HDR framebuffer into the surface
+	// Heatmap colors are already display values, they only need quantizing
+	static constexpr ToneMappingSettings heatmapToneMapping{ ToneMappingOperator::MaxToOne, 1.f, false, false };
+	const bool isHeatmap{ m_IsHeatmapBuffer[m_TraceBufferIndex ^ 1] };
+	TRACE_SCOPE("ToneMapping::Resolve");
+	ToneMapping::Resolve(GetHdrBuffer().data(), m_pBufferPixels, m_Width, m_Height, m_pBuffer->format, isHeatmap ? heatmapToneMapping : m_ToneMapping);
+}
+
+void Renderer::TraceFrame(Scene* pScene, const FrameSettings& settings)
+{
+	TRACE_SCOPE("Renderer::Trace");
+	const auto traceStart{ std::chrono::steady_clock::now() };
+	++m_FrameNumber;
+#if defined(RAY_STATS)
+	RayStats::BeginFrame();
+#endif
 
+	Camera& camera = pScene->GetRenderCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+	const RenderPixelFunc renderPixel{ settings.renderPixel };
+	const HeatmapMode heatmapMode{ settings.heatmapMode };
+	const bool isDenoising{ settings.isDenoising };
+	// Accumulating frames need fresh samples, otherwise every frame has the same noise
+	const bool isAccumulating{ isDenoising && settings.denoiser.temporalAccumulation };
+	const uint32_t firstSample{ isAccumulating ? m_FrameNumber * uint32_t(std::max(1, settings.pathTracer.samplesPerPixel)) : 0u };
+	if (!isAccumulating)
+		m_Denoiser.ResetHistory();
+	const TraceView view{ MakeTraceView(camera, m_pHdrPixels, m_pPixelStats, GetFeatureTarget(isDenoising), m_Width, m_Height, firstSample, settings.pathTracer) };
+	const uint32_t numTiles{ view.tileCount };
 
 
 #if defined(ASYNC)
@@ -58,34 +159,34 @@ void Renderer::Render(Scene* pScene)
 	// Vector to keep track of all the async futures
 	std::vector<std::future<void>> async_futures{};
 
-	// Calculate how many pixels per task
-	const uint32_t pixelsPerTask{ numPixels / numCores };
-	uint32_t unassignedPixels{ numPixels % numCores }; // Pixels that are not assigned to a task
-	uint32_t currPixelIndex{ 0 };
+	// Calculate how many tiles per task
+	const uint32_t tilesPerTask{ numTiles / numCores };
+	uint32_t unassignedTiles{ numTiles % numCores }; // Tiles that are not assigned to a task
+	uint32_t currTileIndex{ 0 };
 
 	// Create a task for each core
 	for (uint32_t coreId{ 0 }; coreId < numCores; ++coreId)
 	{
-		uint32_t taskSize = pixelsPerTask;
-		if (unassignedPixels > 0)
+		uint32_t taskSize = tilesPerTask;
+		if (unassignedTiles > 0)
 		{
 			++taskSize;
-			--unassignedPixels;
+			--unassignedTiles;
 		}
 
 		async_futures.push_back(
-			std::async(std::launch::async, [=, this]
+			std::async(std::launch::async, [=, this, &view]
 				{
-					const uint32_t endPixel = currPixelIndex + taskSize;
-					for (uint32_t pixelIndex{ currPixelIndex }; pixelIndex < endPixel; ++pixelIndex)
+					const uint32_t endTile = currTileIndex + taskSize;
+					for (uint32_t tileIndex{ currTileIndex }; tileIndex < endTile; ++tileIndex)
 					{
-						RenderPixel(pScene, pixelIndex, camera.fovRatio, m_AspectRatio, camera, lights, materials);
+						RenderTile(pScene, view, tileIndex, renderPixel, lights, materials);
 					}
 				}
 			)
 		);
 
-		currPixelIndex += taskSize;
+		currTileIndex += taskSize;
 	}
 
 	// Wait for all tasks to be finished
@@ -104,17 +205,17 @@ void Renderer::Render(Scene* pScene)
 	//concurrency::parallel_for()
 
 
-	concurrency::parallel_for(0u, numPixels,
-		[=, this](int pixelIndex)
+	concurrency::parallel_for(0u, numTiles,
+		[=, this, &view](int tileIndex)
 		{
-			RenderPixel(pScene, pixelIndex, camera.fovRatio, m_AspectRatio, camera, lights, materials);
+			RenderTile(pScene, view, tileIndex, renderPixel, lights, materials);
 		});
 
 #else
 	// SYNCHRONOUS EXECUTION
-	for (uint32_t pixelIndex{}; pixelIndex < numPixels; ++pixelIndex)
+	for (uint32_t tileIndex{}; tileIndex < numTiles; ++tileIndex)
 	{
-		RenderPixel(pScene, pixelIndex, camera.fovRatio, m_AspectRatio, camera, lights, materials);
+		RenderTile(pScene, view, tileIndex, renderPixel, lights, materials);
 	}
 
 #endif
@@ -123,27 +224,443 @@ void Renderer::Render(Scene* pScene)
 
 
 	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	m_LastTraceTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - traceStart).count();
+	const float samplesPerPixel{ settings.integrator == Integrator::PathTracer ? float(std::max(1, settings.pathTracer.samplesPerPixel)) : 1.f };
+	m_LastSamplesPerSecond = m_LastTraceTime > 0.f ? samplesPerPixel * m_Width * m_Height / (m_LastTraceTime * 0.001f) : 0.f;
+
+	m_LastDenoiseTime = 0.f;
+	if (isDenoising)
+	{
+		TRACE_SCOPE("Denoiser::Filter");
+		const auto denoiseStart{ std::chrono::steady_clock::now() };
+		m_Denoiser.Filter(m_pHdrPixels, m_Features, m_Width, m_Height, settings.denoiser);
+		m_LastDenoiseTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - denoiseStart).count();
+	}
+
+#if defined(RAY_STATS)
+	TRACE_SCOPE("RayStats");
+	if (m_RayStatsFile.is_open())
+		RayStats::WriteFrameSummary(m_RayStatsFile, m_FrameNumber, m_LastTraceTime, m_PixelStats);
+
+	// Replace the shaded frame by the false color view
+	if (heatmapMode != HeatmapMode::Off)
+		RayStats::WriteHeatmap(m_PixelStats, m_pHdrPixels, heatmapMode);
+#endif
+	m_IsHeatmapBuffer[m_TraceBufferIndex] = RayStats::IsEnabled() && heatmapMode != HeatmapMode::Off;
+}
+
+uint32_t Renderer::GetTileCount() const
+{
+	const uint32_t tilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+	const uint32_t tilesY{ (m_Height + m_TileSize - 1) / m_TileSize };
+	return tilesX * tilesY;
+}
+
+void Renderer::GetTileBounds(uint32_t tileIndex, uint32_t& startX, uint32_t& startY, uint32_t& endX, uint32_t& endY) const
+{
+	const uint32_t tilesX{ (m_Width + m_TileSize - 1) / m_TileSize };
+	startX = (tileIndex % tilesX) * m_TileSize;
+	startY = (tileIndex / tilesX) * m_TileSize;
+	endX = std::min(startX + m_TileSize, uint32_t(m_Width));
+	endY = std::min(startY + m_TileSize, uint32_t(m_Height));
+}
+
+uint32_t Renderer::GetTilePixelCount(uint32_t tileIndex) const
+{
+	uint32_t startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+	return (endX - startX) * (endY - startY);
+}
+
+void Renderer::TraceTiles(Scene* pScene, const std::vector<uint32_t>& tileIndices)
+{
+	TRACE_SCOPE("Renderer::TraceTiles");
+	// Same setup as TraceFrame, so the tiles come out exactly as they would in a full frame
+	Camera& camera = pScene->GetRenderCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+	const TraceView view{ MakeTraceView(camera, m_pHdrPixels, m_pPixelStats, GetFeatureTarget(m_DenoiserEnabled), m_Width, m_Height, 0u, m_PathTracerSettings) };
+	const RenderPixelFunc renderPixel{ GetRenderPixelKernel() };
+
+	concurrency::parallel_for(size_t{}, tileIndices.size(),
+		[&](size_t i)
+		{
+			RenderTile(pScene, view, tileIndices[i], renderPixel, lights, materials);
+		});
+}
+
+void Renderer::TraceViews(Scene* pScene, const std::vector<Camera>& cameras, std::vector<ViewTarget>& targets) const
+{
+	TRACE_SCOPE("Renderer::TraceViews");
+	assert(cameras.size() == targets.size());
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+	const RenderPixelFunc renderPixel{ GetRenderPixelKernel() };
+
+	std::vector<Camera> viewCameras{ cameras };
+	std::vector<TraceView> views{};
+	views.reserve(cameras.size());
+	uint32_t maxTileCount{};
+	for (size_t i{}; i < cameras.size(); ++i)
+	{
+		ViewTarget& target{ targets[i] };
+		target.pixels.resize(size_t(target.width) * target.height);
+		views.push_back(MakeTraceView(viewCameras[i], target.pixels.data(), nullptr, nullptr, target.width, target.height, target.firstSample, m_PathTracerSettings));
+		maxTileCount = std::max(maxTileCount, views.back().tileCount);
+	}
+
+	// Tile 0 of every view, then tile 1 of every view, ... Views of different sizes just run out of tiles sooner
+	std::vector<std::pair<uint32_t, uint32_t>> work{};
+	for (uint32_t tileIndex{}; tileIndex < maxTileCount; ++tileIndex)
+	{
+		for (uint32_t viewIndex{}; viewIndex < views.size(); ++viewIndex)
+		{
+			if (tileIndex < views[viewIndex].tileCount)
+				work.emplace_back(viewIndex, tileIndex);
+		}
+	}
+
+	concurrency::parallel_for(size_t{}, work.size(),
+		[&](size_t i)
+		{
+			RenderTile(pScene, views[work[i].first], work[i].second, renderPixel, lights, materials);
+		});
+}
+
+void Renderer::ReadTile(uint32_t tileIndex, std::vector<ColorRGB>& pixels) const
+{
+	uint32_t startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+	pixels.clear();
+	for (uint32_t py{ startY }; py < endY; ++py)
+		pixels.insert(pixels.end(), m_pHdrPixels + startX + py * m_Width, m_pHdrPixels + endX + py * m_Width);
+}
+
+void Renderer::WriteTile(uint32_t tileIndex, const std::vector<ColorRGB>& pixels)
+{
+	uint32_t startX{}, startY{}, endX{}, endY{};
+	GetTileBounds(tileIndex, startX, startY, endX, endY);
+	assert(pixels.size() == (endX - startX) * (endY - startY));
+	const ColorRGB* pSource{ pixels.data() };
+	for (uint32_t py{ startY }; py < endY; ++py, pSource += endX - startX)
+		std::copy(pSource, pSource + (endX - startX), m_pHdrPixels + startX + py * m_Width);
+}
+
+Renderer::BudgetReport Renderer::RenderWithBudget(Scene* pScene, float budgetMs)
+{
+	const BudgetReport report{ TraceWithBudget(pScene, budgetMs) };
+	SwapFrameBuffers();
+	Present();
+	return report;
+}
+
+Renderer::BudgetReport Renderer::TraceWithBudget(Scene* pScene, float budgetMs)
+{
+	TRACE_SCOPE("Renderer::TraceWithBudget");
+	assert(m_TileSize % g_CoarseStep == 0);
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point traceStart{ Clock::now() };
+	const auto getElapsedMs = [&traceStart] { return std::chrono::duration<float, std::milli>(Clock::now() - traceStart).count(); };
+	++m_FrameNumber;
+
+	Camera& camera = pScene->GetRenderCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+	// No features, most pixels are copies & the denoiser doesn't run on budgeted frames
+	const TraceView view{ MakeTraceView(camera, m_pHdrPixels, m_pPixelStats, nullptr, m_Width, m_Height, 0u, m_PathTracerSettings) };
+	const RenderPixelFunc renderPixel{ GetRenderPixelKernel() };
+
+	BudgetReport report{ budgetMs };
+	report.pixelCount = uint32_t(m_Width * m_Height);
+	report.tileCount = view.tileCount;
+
+	struct TileState
+	{
+		uint32_t step{ g_CoarseStep };
+		float priority{};
+		// Traced by the last refinement
+		uint32_t newPixels{};
+	};
+	std::vector<TileState> tiles(view.tileCount);
+
+	//--------- Coarse pass ---------
+	// Always done in full, even if it alone takes longer than the budget, there has to be something to show
+	concurrency::parallel_for(0u, view.tileCount,
+		[&](uint32_t tileIndex)
+		{
+			TileState& tile{ tiles[tileIndex] };
+			tile.newPixels = RefineTile(pScene, view, tileIndex, g_CoarseStep, renderPixel, lights, materials);
+			tile.priority = GetTilePriority(view, tileIndex, g_CoarseStep);
+		});
+	report.coarseMs = getElapsedMs();
+
+	//--------- Refinement ---------
+	// Highest priority tiles first, in batches that fill the worker pool
+	// A batch only starts if the pixel rate so far says it'll finish before the deadline
+	const auto isLowerPriority = [&tiles](uint32_t a, uint32_t b) { return tiles[a].priority < tiles[b].priority; };
+	std::vector<uint32_t> queue(view.tileCount);
+	std::iota(queue.begin(), queue.end(), 0u);
+	std::make_heap(queue.begin(), queue.end(), isLowerPriority);
+
+	uint32_t tracedPixels{};
+	for (const TileState& tile : tiles)
+		tracedPixels += tile.newPixels;
+
+	const size_t batchSize{ std::max(1u, std::thread::hardware_concurrency()) * size_t{ 2 } };
+	std::vector<uint32_t> batch{};
+	while (!queue.empty())
+	{
+		const float elapsedMs{ getElapsedMs() };
+		const float msPerPixel{ elapsedMs / std::max(1u, tracedPixels) };
+		float batchPixels{};
+		batch.clear();
+		while (!queue.empty() && batch.size() < batchSize)
+		{
+			// Going from step to step / 2 traces 3 of every 4 pixels on the finer grid
+			const uint32_t step{ tiles[queue.front()].step };
+			const float refinePixels{ 3.f * GetTilePixelCount(queue.front()) / float(step * step) };
+			if (elapsedMs + (batchPixels + refinePixels) * msPerPixel > budgetMs)
+				break;
+
+			std::pop_heap(queue.begin(), queue.end(), isLowerPriority);
+			batch.push_back(queue.back());
+			queue.pop_back();
+			batchPixels += refinePixels;
+		}
+		if (batch.empty())
+			break;
+
+		concurrency::parallel_for(size_t{}, batch.size(),
+			[&](size_t i)
+			{
+				TileState& tile{ tiles[batch[i]] };
+				tile.step /= 2;
+				tile.newPixels = RefineTile(pScene, view, batch[i], tile.step, renderPixel, lights, materials);
+				tile.priority = GetTilePriority(view, batch[i], tile.step);
+			});
+
+		for (const uint32_t tileIndex : batch)
+		{
+			tracedPixels += tiles[tileIndex].newPixels;
+			if (tiles[tileIndex].step > 1)
+			{
+				queue.push_back(tileIndex);
+				std::push_heap(queue.begin(), queue.end(), isLowerPriority);
+			}
+		}
+	}
+
+	report.elapsedMs = getElapsedMs();
+	report.tracedPixels = tracedPixels;
+	for (const TileState& tile : tiles)
+	{
+		report.finishedTiles += tile.step == 1;
+		report.coarsestStep = std::max(report.coarsestStep, tile.step);
+	}
+	m_LastTraceTime = report.elapsedMs;
+	m_IsHeatmapBuffer[m_TraceBufferIndex] = false;
+	return report;
+}
+
+Renderer::TraceView Renderer::MakeTraceView(Camera& camera, ColorRGB* pPixels, RayCounters* pPixelStats, FeatureBuffers* pFeatures, int width, int height,
+	uint32_t firstSample, const PathTracerSettings& pathTracerSettings) const
+{
+	camera.CalculateCameraToWorld();
+	const uint32_t tilesX{ (width + m_TileSize - 1) / m_TileSize };
+	// Primary rays are generated per tile from the camera basis, nothing to rebuild when the camera moves
+	return TraceView{ camera, CameraRayGenerator{ camera, width, height, width / float(height) },
+		pPixels, pPixelStats, pFeatures, uint32_t(width), uint32_t(height), tilesX, tilesX * ((height + m_TileSize - 1) / m_TileSize), firstSample, pathTracerSettings };
+}
+
+FeatureBuffers* Renderer::GetFeatureTarget(bool isDenoising)
+{
+	if (!m_FeatureBuffersEnabled && !isDenoising)
+		return nullptr;
+	m_Features.Resize(size_t(m_Width) * m_Height);
+	return &m_Features;
+}
+
+void Renderer::RenderTile(Scene* pScene, const TraceView& view, uint32_t tileIndex, RenderPixelFunc renderPixel,
+	const std::vector<Light>& lights, const MaterialRegistry& materials) const
+{
+	TRACE_SCOPE("Tile");
+	const uint32_t startX{ (tileIndex % view.tilesX) * m_TileSize };
+	const uint32_t startY{ (tileIndex / view.tilesX) * m_TileSize };
+	const uint32_t endX{ std::min(startX + m_TileSize, view.width) };
+	const uint32_t endY{ std::min(startY + m_TileSize, view.height) };
+
+	for (uint32_t py{ startY }; py < endY; ++py)
+	{
+		// Start every row from the exact direction, so the per pixel adds can't drift over more than a tile
+		Vector3 direction{ view.rayGenerator.GetDirection(startX, py) };
+		for (uint32_t px{ startX }; px < endX; ++px)
+		{
+			const uint32_t pixelIndex{ px + py * view.width };
+			view.pPixels[pixelIndex] = (this->*renderPixel)(pScene, pixelIndex, direction.Normalized(), view, lights, materials);
+#if defined(RAY_STATS)
+			const RayCounters pixelStats{ RayStats::EndPixel() };
+			if (view.pPixelStats)
+				view.pPixelStats[pixelIndex] = pixelStats;
+#endif
+			direction += view.rayGenerator.columnDelta;
+		}
+	}
+}
+
+uint32_t Renderer::RefineTile(Scene* pScene, const TraceView& view, uint32_t tileIndex, uint32_t step, RenderPixelFunc renderPixel,
+	const std::vector<Light>& lights, const MaterialRegistry& materials) const
+{
+	TRACE_SCOPE("RefineTile");
+	const uint32_t startX{ (tileIndex % view.tilesX) * m_TileSize };
+	const uint32_t startY{ (tileIndex / view.tilesX) * m_TileSize };
+	const uint32_t endX{ std::min(startX + m_TileSize, view.width) };
+	const uint32_t endY{ std::min(startY + m_TileSize, view.height) };
+	// Samples on the twice as coarse grid are already there, except in the coarse pass
+	const uint32_t previousStep{ step == g_CoarseStep ? 0 : step * 2 };
+
+	uint32_t tracedPixels{};
+	for (uint32_t py{ startY }; py < endY; py += step)
+	{
+		const bool isPreviousRow{ previousStep > 0 && (py - startY) % previousStep == 0 };
+		// Walked pixel by pixel like RenderTile, so the directions & colors come out the same
+		Vector3 direction{ view.rayGenerator.GetDirection(startX, py) };
+		for (uint32_t px{ startX }; px < endX; ++px, direction += view.rayGenerator.columnDelta)
+		{
+			if ((px - startX) % step != 0 || (isPreviousRow && (px - startX) % previousStep == 0))
+				continue;
+
+			const uint32_t pixelIndex{ px + py * view.width };
+			view.pPixels[pixelIndex] = (this->*renderPixel)(pScene, pixelIndex, direction.Normalized(), view, lights, materials);
+#if defined(RAY_STATS)
+			const RayCounters pixelStats{ RayStats::EndPixel() };
+			if (view.pPixelStats)
+				view.pPixelStats[pixelIndex] = pixelStats;
+#endif
+			++tracedPixels;
+		}
+	}
+
+	if (step > 1)
+	{
+		for (uint32_t py{ startY }; py < endY; ++py)
+		{
+			const ColorRGB* pSampleRow{ view.pPixels + (startY + (py - startY) / step * step) * view.width };
+			for (uint32_t px{ startX }; px < endX; ++px)
+				view.pPixels[px + py * view.width] = pSampleRow[startX + (px - startX) / step * step];
+		}
+	}
+	return tracedPixels;
 }
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+float Renderer::GetTilePriority(const TraceView& view, uint32_t tileIndex, uint32_t step) const
 {
-	const uint32_t px{ pixelIndex % m_Width };
-	const uint32_t py{ pixelIndex / m_Width };
+	const uint32_t startX{ (tileIndex % view.tilesX) * m_TileSize };
+	const uint32_t startY{ (tileIndex / view.tilesX) * m_TileSize };
+	const uint32_t endX{ std::min(startX + m_TileSize, view.width) };
+	const uint32_t endY{ std::min(startY + m_TileSize, view.height) };
+
+	// Edges show up as big jumps between neighbouring samples, noise & texture as variance
+	float maxEdge{};
+	float sum{};
+	float sumSquared{};
+	uint32_t sampleCount{};
+	for (uint32_t py{ startY }; py < endY; py += step)
+	{
+		for (uint32_t px{ startX }; px < endX; px += step)
+		{
+			const float luminance{ GetPerceivedLuminance(view.pPixels[px + py * view.width]) };
+			if (px > startX)
+				maxEdge = std::max(maxEdge, std::abs(luminance - GetPerceivedLuminance(view.pPixels[px - step + py * view.width])));
+			if (py > startY)
+				maxEdge = std::max(maxEdge, std::abs(luminance - GetPerceivedLuminance(view.pPixels[px + (py - step) * view.width])));
+			sum += luminance;
+			sumSquared += luminance * luminance;
+			++sampleCount;
+		}
+	}
+	const float mean{ sum / sampleCount };
+	const float variance{ std::max(0.f, sumSquared / sampleCount - mean * mean) };
 
-	const Vector3& rayDirection{ m_RayDirections[pixelIndex] };
+	// 1 in the center, 0 in the corners
+	const float dx{ (startX + endX) * 0.5f / view.width - 0.5f };
+	const float dy{ (startY + endY) * 0.5f / view.height - 0.5f };
+	const float centerFactor{ 1.f - std::min(1.f, std::sqrt(dx * dx + dy * dy) / 0.7071f) };
 
-	float multiplier = 1.0f;
+	// A bigger block filled from one sample hides more, so coarse tiles win from fine ones with the same detail
+	return (maxEdge + std::sqrt(variance) + g_MinTileDetail) * float(step * step) * (1.f + g_CenterWeight * centerFactor);
+}
 
-	Ray viewRay{ camera.origin,  rayDirection };
+void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, const TraceView& view, const std::vector<Light>& lights, const MaterialRegistry& materials) const
+{
+	const uint32_t px{ pixelIndex % view.width };
+	const uint32_t py{ pixelIndex / view.width };
+	const float fov{ view.camera.fovRatio };
+	const float aspectRatio{ view.width / float(view.height) };
+	const float cx{ ((2.0f * (px + 0.5f) / float(view.width)) - 1.0f) * aspectRatio * fov };
+	const float cy{ (1.0f - ((2.0f * (py + 0.5f)) / float(view.height))) * fov };
+	const Vector3 rayDirection{ view.camera.cameraToWorld.TransformVector(Vector3{cx, cy, 1}).Normalized() };
+
+	view.pPixels[pixelIndex] = (this->*GetRenderPixelKernel())(pScene, pixelIndex, rayDirection, view, lights, materials);
+#if defined(RAY_STATS)
+	const RayCounters pixelStats{ RayStats::EndPixel() };
+	if (view.pPixelStats)
+		view.pPixelStats[pixelIndex] = pixelStats;
+#endif
+}
+
+Renderer::RenderPixelFunc Renderer::GetRenderPixelKernel() const
+{
+	if (m_Integrator == Integrator::PathTracer)
+		return m_ShadowsEnabled ? &Renderer::PathTraceKernel<true> : &Renderer::PathTraceKernel<false>;
+
+	// Indexed by [lightingMode][shadows][reflections]
+	static constexpr RenderPixelFunc kernels[4][2][2]
+	{
+		{
+			{ &Renderer::RenderPixelKernel<LightingMode::ObservedArea, false, false>, &Renderer::RenderPixelKernel<LightingMode::ObservedArea, false, true> },
+			{ &Renderer::RenderPixelKernel<LightingMode::ObservedArea, true, false>, &Renderer::RenderPixelKernel<LightingMode::ObservedArea, true, true> }
+		},
+		{
+			{ &Renderer::RenderPixelKernel<LightingMode::Radiance, false, false>, &Renderer::RenderPixelKernel<LightingMode::Radiance, false, true> },
+			{ &Renderer::RenderPixelKernel<LightingMode::Radiance, true, false>, &Renderer::RenderPixelKernel<LightingMode::Radiance, true, true> }
+		},
+		{
+			{ &Renderer::RenderPixelKernel<LightingMode::BRDF, false, false>, &Renderer::RenderPixelKernel<LightingMode::BRDF, false, true> },
+			{ &Renderer::RenderPixelKernel<LightingMode::BRDF, true, false>, &Renderer::RenderPixelKernel<LightingMode::BRDF, true, true> }
+		},
+		{
+			{ &Renderer::RenderPixelKernel<LightingMode::Combined, false, false>, &Renderer::RenderPixelKernel<LightingMode::Combined, false, true> },
+			{ &Renderer::RenderPixelKernel<LightingMode::Combined, true, false>, &Renderer::RenderPixelKernel<LightingMode::Combined, true, true> }
+		}
+	};
+
+	return kernels[static_cast<int>(m_CurrentLightingMode)][m_ShadowsEnabled][m_ReflectionsEnabled];
+}
+
+template<Renderer::LightingMode lightingMode, bool shadowsEnabled, bool reflectionsEnabled>
+ColorRGB Renderer::RenderPixelKernel(Scene* pScene, uint32_t pixelIndex, const Vector3& rayDirection, const TraceView& view, const std::vector<Light>& lights, const MaterialRegistry& materials) const
+{
+	Ray viewRay{ view.camera.origin,  rayDirection };
 
 	ColorRGB finalColor{};
-	float reflectivity{};
-	for (int bounce{}; bounce < m_Bounces; bounce++)
+	// Product of the reflectivities & falloff along the path, decides when it's not worth following anymore
+	float throughput{ 1.f };
+	// Makes up for the paths the roulette ended, what the current bounce adds is weighted by throughput * rouletteWeight
+	float rouletteWeight{ 1.f };
+	for (int bounce{}; bounce < m_PathSettings.maxBounces; bounce++)
 	{
 		HitRecord closestHit{};
+		if (bounce == 0)
+			RAY_STATS_ADD(primaryRays, 1);
+		else
+			RAY_STATS_ADD(reflectionRays, 1);
 		pScene->GetClosestHit(viewRay, closestHit);  // Checks EVERY object in the scene and returns the closest one hit.
+		if (bounce == 0 && view.pFeatures)
+		{
+			view.pFeatures->albedo[pixelIndex] = closestHit.didHit ? materials.GetAlbedo(closestHit.materialIndex) : colors::White;
+			view.pFeatures->normals[pixelIndex] = closestHit.didHit ? closestHit.normal : Vector3{};
+			view.pFeatures->depths[pixelIndex] = closestHit.didHit ? closestHit.t : 0.f;
+		}
 		if (closestHit.didHit)
 		{
 			for (const Light& light : lights)
@@ -158,90 +675,239 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float
 				const float observedArea{ Vector3::Dot(closestHit.normal, directionToLight) };
 
 				// Check if shadowed
-				if (m_ShadowsEnabled && pScene->DoesHit(lightRay))
-					continue;  // Skip if point can't see the light
-
-				// Calculate radiance color (light intensity)
-				const ColorRGB radianceColor{ LightUtils::GetRadiance(light, closestHit.origin) };
-				const ColorRGB BRDF{ materials[closestHit.materialIndex]->Shade(closestHit, -directionToLight, rayDirection) };  // Shade takes direction from light so inverse
-
+				if constexpr (shadowsEnabled)
+				{
+					RAY_STATS_ADD(shadowRays, 1);
+					if (pScene->DoesHit(lightRay))
+						continue;  // Skip if point can't see the light
+				}
 
-				switch (m_CurrentLightingMode)
+				if constexpr (lightingMode == LightingMode::ObservedArea)
 				{
-				case dae::Renderer::LightingMode::ObservedArea:
 					if ((observedArea < 0))
 						continue;  // Skip if observedarea is negative
 					finalColor += ColorRGB{ observedArea, observedArea, observedArea };
-					break;
-				case dae::Renderer::LightingMode::Radiance:
-					finalColor += radianceColor;
-					break;
-				case dae::Renderer::LightingMode::BRDF:
-					finalColor += BRDF;
-					break;
-				case dae::Renderer::LightingMode::Combined:
+				}
+				else if constexpr (lightingMode == LightingMode::Radiance)
+				{
+					// Calculate radiance color (light intensity)
+					finalColor += LightUtils::GetRadiance(light, closestHit.origin);
+				}
+				else if constexpr (lightingMode == LightingMode::BRDF)
+				{
+					finalColor += materials.Shade(closestHit.materialIndex, closestHit, -directionToLight, rayDirection);  // Shade takes direction from light so inverse
+				}
+				else
+				{
 					if ((observedArea < 0))
-						continue;  // Skip if observedarea is negative					
+						continue;  // Skip if observedarea is negative
 
-					if (bounce > 0)
-					{
-						finalColor += radianceColor * BRDF * observedArea * reflectivity * multiplier;
-					}
-					else
-					{
-						finalColor += radianceColor * BRDF * observedArea;
-					}
-					break;
+					const ColorRGB radianceColor{ LightUtils::GetRadiance(light, closestHit.origin) };
+					const ColorRGB BRDF{ materials.Shade(closestHit.materialIndex, closestHit, -directionToLight, rayDirection) };  // Shade takes direction from light so inverse
+
+					finalColor += radianceColor * BRDF * observedArea * (throughput * rouletteWeight);
 				}
 			}
 
-			if (m_ReflectionsEnabled)
-				reflectivity = materials[closestHit.materialIndex]->GetReflectivity();  // Set reflecitivity of current object & update for later ones
-			multiplier *= 0.7f;
+			if constexpr (!reflectionsEnabled)
+				break;
+
+			throughput *= materials.GetReflectivity(closestHit.materialIndex) * m_PathSettings.reflectionFalloff;
 			viewRay.origin = closestHit.origin + closestHit.normal * 0.0001f;
 			viewRay.direction = Vector3::Reflect(viewRay.direction, closestHit.normal);
-			if (!m_ReflectionsEnabled || reflectivity < FLT_EPSILON)
+			// Always ends on a surface that doesn't reflect, even with the cutoff at 0
+			if (throughput < std::max(m_PathSettings.minContribution, FLT_EPSILON))
 				break;
+
+			// Russian roulette, a dim path mostly ends here & the few that go on count for the ones that didn't
+			// The debug modes don't weight their bounces, so they only stop at the cutoff
+			if constexpr (lightingMode == LightingMode::Combined)
+			{
+				if (bounce + 1 >= m_PathSettings.rouletteStartBounce)
+				{
+					const float survival{ std::min(1.f, throughput * rouletteWeight) };
+					// Seeded with the frame's samples too, a decision that's the same every frame would never average out
+					if (Random::GetFloat(Random::Hash(pixelIndex, view.firstSample), uint32_t(bounce)) >= survival)
+						break;
+					rouletteWeight /= survival;
+				}
+			}
 		}
 		else
 		{
 			const ColorRGB skyColor{ colors::White };
-			finalColor += skyColor;
+			if constexpr (lightingMode == LightingMode::Combined)
+				finalColor += skyColor * (throughput * rouletteWeight);
+			else
+				finalColor += skyColor;
+			// Nothing left to bounce off
+			break;
 		}
+	}
+	return finalColor;
+}
+
+template<bool shadowsEnabled>
+ColorRGB Renderer::PathTraceKernel(Scene* pScene, uint32_t pixelIndex, const Vector3& rayDirection, const TraceView& view, const std::vector<Light>& lights, const MaterialRegistry& materials) const
+{
+	const uint32_t px{ pixelIndex % view.width };
+	const uint32_t py{ pixelIndex / view.width };
+	// Decorrelates the pixels, a pixel gets the same samples whichever thread traces it
+	const uint32_t pixelSeed{ Random::Hash(pixelIndex, view.pathTracer.seed) };
+	const bool useSobol{ view.pathTracer.useSobol };
+	const int samplesPerPixel{ std::max(1, view.pathTracer.samplesPerPixel) };
+	const ColorRGB skyColor{ colors::White };
+
+	ColorRGB pixelColor{};
+	// First hits averaged over the samples, the jitter anti-aliases them like the color
+	ColorRGB albedoSum{};
+	Vector3 normalSum{};
+	float depthSum{};
+	for (int sample{}; sample < samplesPerPixel; ++sample)
+	{
+		// Continues the sequence of the previous frames while they're being accumulated
+		const uint32_t sampleIndex{ view.firstSample + uint32_t(sample) };
+		// Its own stream per sample for the roulette, and for everything when the Sobol points are off
+		Random::PCG32 rng{ pixelSeed, uint64_t(sampleIndex) };
+		const auto get2D = [&](uint32_t dimension, float& u1, float& u2)
+			{
+				if (useSobol)
+				{
+					Random::GetSobol2D(sampleIndex, Random::Hash(pixelSeed, dimension), u1, u2);
+				}
+				else
+				{
+					u1 = rng.NextFloat();
+					u2 = rng.NextFloat();
+				}
+			};
+
+		// Anywhere in the pixel, GetDirection is the center
+		float jitterX{}, jitterY{};
+		get2D(0, jitterX, jitterY);
+		const Vector3 jitteredDirection{ view.rayGenerator.GetDirection(px, py)
+			+ view.rayGenerator.columnDelta * (jitterX - 0.5f) + view.rayGenerator.rowDelta * (jitterY - 0.5f) };
+		Ray ray{ view.camera.origin, jitteredDirection.Normalized() };
+
+		ColorRGB radiance{};
+		ColorRGB throughput{ 1.f, 1.f, 1.f };
+		for (int bounce{}; bounce < m_PathSettings.maxBounces; ++bounce)
+		{
+			HitRecord closestHit{};
+			if (bounce == 0)
+				RAY_STATS_ADD(primaryRays, 1);
+			else
+				RAY_STATS_ADD(reflectionRays, 1);
+			pScene->GetClosestHit(ray, closestHit);
+			if (!closestHit.didHit)
+			{
+				if (bounce == 0)
+					albedoSum += skyColor;
+				radiance += throughput * skyColor;
+				break;
+			}
 
-		//Update Color in Buffer
+			// Shade the side the ray came from
+			const Vector3 wo{ -ray.direction };
+			if (Vector3::Dot(closestHit.normal, wo) < 0.f)
+				closestHit.normal = -closestHit.normal;
+			if (bounce == 0)
+			{
+				albedoSum += materials.GetAlbedo(closestHit.materialIndex);
+				normalSum += closestHit.normal;
+				depthSum += closestHit.t;
+			}
+			const Vector3 offsetOrigin{ closestHit.origin + closestHit.normal * 0.0001f };
 
+			// Point & directional lights can't be hit by a bounce, so every hit samples them directly
+			for (const Light& light : lights)
+			{
+				Vector3 directionToLight{ LightUtils::GetDirectionToLight(light, closestHit.origin) };
+				const float lightDistance{ directionToLight.Normalize() };
+				const float observedArea{ Vector3::Dot(closestHit.normal, directionToLight) };
+				if (observedArea <= 0.f)
+					continue;
 
-	}
-	finalColor.MaxToOne();
-	m_pBufferPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+				if constexpr (shadowsEnabled)
+				{
+					RAY_STATS_ADD(shadowRays, 1);
+					Ray lightRay{ offsetOrigin, directionToLight, 0.0f, lightDistance };
+					if (pScene->DoesHit(lightRay))
+						continue;
+				}
 
-}
+				const ColorRGB BRDF{ materials.Shade(closestHit.materialIndex, closestHit, -directionToLight, -wo) };  // Shade takes direction from light so inverse
+				radiance += throughput * LightUtils::GetRadiance(light, closestHit.origin) * BRDF * observedArea;
+			}
 
+			// Next direction from the material, weighted by BRDF * cos / pdf so the sampling doesn't skew the average
+			float u1{}, u2{};
+			get2D(1 + bounce, u1, u2);
+			const Vector3 wi{ materials.SampleDirection(closestHit.materialIndex, closestHit.normal, wo, u1, u2) };
+			const float cosine{ Vector3::Dot(closestHit.normal, wi) };
+			const float pdf{ cosine > 0.f ? materials.GetPdf(closestHit.materialIndex, closestHit.normal, wo, wi) : 0.f };
+			if (pdf <= 0.f)
+				break;
+			throughput *= materials.Shade(closestHit.materialIndex, closestHit, -wi, -wo) * (cosine / pdf);
+			ray = Ray{ offsetOrigin, wi };
 
-void Renderer::RecalculateRayDirections(Camera& camera)
-{
-	m_RayDirections.clear();
+			// Same termination as the Whitted bounces, on the brightest channel
+			const float maxThroughput{ std::max(throughput.r, std::max(throughput.g, throughput.b)) };
+			if (maxThroughput < std::max(m_PathSettings.minContribution, FLT_EPSILON))
+				break;
+			if (bounce + 1 >= m_PathSettings.rouletteStartBounce)
+			{
+				const float survival{ std::min(1.f, maxThroughput) };
+				if (rng.NextFloat() >= survival)
+					break;
+				throughput /= survival;
+			}
+		}
+		pixelColor += radiance;
+	}
 
-	const uint32_t pixelAmount = m_Width * m_Height;
-	m_RayDirections.reserve(pixelAmount);
-	for (uint32_t pixelIndex{}; pixelIndex < pixelAmount; ++pixelIndex)
+	if (view.pFeatures)
 	{
-		const uint32_t px{ pixelIndex % m_Width };
-		const uint32_t py{ pixelIndex / m_Width };
-		const float cx{ ((2.0f * (px + 0.5f) / float(m_Width)) - 1.0f) * m_AspectRatio * camera.fovRatio };
-		const float cy{ (1.0f - ((2.0f * (py + 0.5f)) / float(m_Height))) * camera.fovRatio };
-		const Vector3 rayDirection{ camera.cameraToWorld.TransformVector(Vector3{cx, cy, 1}).Normalized() };
-		m_RayDirections.emplace_back(rayDirection);
+		view.pFeatures->albedo[pixelIndex] = albedoSum / float(samplesPerPixel);
+		// Unit length where anything was hit, a silhouette pixel still gets the normal of the surface it's mostly on
+		const float normalLength{ normalSum.Magnitude() };
+		view.pFeatures->normals[pixelIndex] = normalLength > 0.f ? normalSum / normalLength : Vector3{};
+		view.pFeatures->depths[pixelIndex] = depthSum / float(samplesPerPixel);
 	}
+	return pixelColor / float(samplesPerPixel);
 }
 
-bool Renderer::SaveBufferToImage() const
+
+ImageWriter::Frame Renderer::CaptureFrame(ImageFormat format, const std::string& fileName) const
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	ImageWriter::Frame frame{ m_Width, m_Height, format, fileName };
+	const std::vector<ColorRGB>& hdrBuffer{ GetHdrBuffer() };
+	const size_t numPixels{ hdrBuffer.size() };
+
+	if (ImageWriter::IsHDR(format))
+	{
+		frame.hdrPixels.resize(numPixels * 3);
+		for (size_t i{}; i < numPixels; ++i)
+		{
+			frame.hdrPixels[i * 3] = hdrBuffer[i].r;
+			frame.hdrPixels[i * 3 + 1] = hdrBuffer[i].g;
+			frame.hdrPixels[i * 3 + 2] = hdrBuffer[i].b;
+		}
+	}
+	else
+	{
+		// Unpack the surface pixels, so the file matches what's on screen
+		const SDL_PixelFormat* pFormat{ m_pBuffer->format };
+		frame.ldrPixels.resize(numPixels * 3);
+		for (size_t i{}; i < numPixels; ++i)
+		{
+			const uint32_t pixel{ m_pBufferPixels[i] };
+			frame.ldrPixels[i * 3] = static_cast<uint8_t>(pixel >> pFormat->Rshift);
+			frame.ldrPixels[i * 3 + 1] = static_cast<uint8_t>(pixel >> pFormat->Gshift);
+			frame.ldrPixels[i * 3 + 2] = static_cast<uint8_t>(pixel >> pFormat->Bshift);
+		}
+	}
+	return frame;
 }
 
 void dae::Renderer::CycleLightingMode()
@@ -267,6 +933,59 @@ void dae::Renderer::CycleLightingMode()
 	}
 }
 
+void Renderer::ToggleIntegrator()
+{
+	m_Integrator = m_Integrator == Integrator::Whitted ? Integrator::PathTracer : Integrator::Whitted;
+	std::cout << (m_Integrator == Integrator::PathTracer ? "Integrator: PathTracer, " + std::to_string(m_PathTracerSettings.samplesPerPixel) + " spp\n" : "Integrator: Whitted\n");
+}
+
+void Renderer::ToggleDenoiser()
+{
+	m_DenoiserEnabled = !m_DenoiserEnabled;
+	std::cout << (m_DenoiserEnabled ? "Denoiser: On\n" : "Denoiser: Off\n");
+}
+
+void Renderer::ToggleTemporalAccumulation()
+{
+	m_DenoiserSettings.temporalAccumulation = !m_DenoiserSettings.temporalAccumulation;
+	std::cout << (m_DenoiserSettings.temporalAccumulation ? "Temporal accumulation: On\n" : "Temporal accumulation: Off\n");
+}
+
+void Renderer::CycleToneMapping()
+{
+	m_ToneMapping.toneMapping = static_cast<ToneMappingOperator>((static_cast<int>(m_ToneMapping.toneMapping) + 1) % 3);
+	std::cout << "ToneMapping: " << ToneMapping::GetName(m_ToneMapping.toneMapping) << "\n";
+}
+
+void Renderer::CycleHeatmapMode()
+{
+	if (!RayStats::IsEnabled())
+	{
+		std::cout << "Heatmap: ray stats are compiled out, define RAY_STATS in RayStats.h\n";
+		return;
+	}
+
+	m_HeatmapMode = static_cast<HeatmapMode>((static_cast<int>(m_HeatmapMode) + 1) % 4);
+	std::cout << "Heatmap: " << RayStats::GetName(m_HeatmapMode) << "\n";
+}
+
+bool Renderer::SetRayStatsFile(const std::string& path)
+{
+	if (!RayStats::IsEnabled())
+	{
+		std::cerr << "Ray stats are compiled out, define RAY_STATS in RayStats.h to write " << path << "\n";
+		return false;
+	}
+
+	m_RayStatsFile.open(path);
+	if (!m_RayStatsFile.is_open())
+	{
+		std::cerr << "Can't open " << path << " for the ray stats\n";
+		return false;
+	}
+	return true;
+}
+
 bool Renderer::RunTests()
 {
 	// Test dot & cross product for vector3 & vector4
@@ -274,6 +993,11 @@ bool Renderer::RunTests()
 	assert(int(roundf(Vector3::Dot(Vector3::UnitX, -Vector3::UnitX))) == -1);  // Should be -1 -> opposite direction
 	assert(int(roundf(Vector3::Dot(Vector3::UnitX, Vector3::UnitY))) == 0);  // Should be 0 -> perpendicular direction
 
+	// The math layer is constexpr, so these are checked at compile time
+	static_assert(Vector3::Dot(Vector3::UnitX, Vector3::UnitY) == 0.f);
+	static_assert(Vector3::Cross(Vector3::UnitX, Vector3::UnitY).z == 1.f);
+	static_assert(Matrix::CreateTranslation(1.f, 2.f, 3.f).GetTranslation().y == 2.f);
+
 
 	return true;
 }
\ No newline at end of file
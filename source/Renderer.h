@@ -1,8 +1,15 @@
 #pragma once
 
 #include <cstdint>
+#include <fstream>
+#include <future>
+#include <string>
 #include <vector>
 #include "Math.h"
+#include "Denoiser.h"
+#include "ToneMapping.h"
+#include "ImageWriter.h"
+#include "RayStats.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -11,11 +18,25 @@ namespace dae
 	class Scene;
 	struct Camera;
 	struct Light;
-	class Material;
+	class MaterialRegistry;
 
 	class Renderer final
 	{
 	public:
+		enum class LightingMode
+		{
+			ObservedArea, // Lambert cosine law
+			Radiance, // Incident Radiance
+			BRDF, // Scattering of the light
+			Combined // ObservedArea & Radiance & BRDF
+		};
+
+		enum class Integrator
+		{
+			Whitted, // Direct lighting & perfect mirror reflections, the lighting mode & reflection toggle apply
+			PathTracer // Global illumination, bounces importance sample the material BRDFs
+		};
+
 		Renderer(SDL_Window* pWindow);
 		~Renderer() = default;
 
@@ -24,39 +45,230 @@ namespace dae
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
+		// Trace, swap & present in one go. The scene's SwapBuffers has to be called after its Update
 		void Render(Scene* pScene);
+
+		// Traces into the back HDR buffer using the scene's render camera
+		void Trace(Scene* pScene);
+		// Same as Trace, but on a worker thread. The kernel is picked up front, so settings can be toggled while the frame is in flight
+		std::future<void> TraceAsync(Scene* pScene);
+		// The last traced buffer becomes the one to present, the next trace goes to the other one
+		void SwapFrameBuffers();
+		// Tone maps the front HDR buffer into the window surface and shows it, main thread only
+		void Present();
+		// Only the tone mapping part of Present, the surface is then ready for CaptureFrame without showing anything. Any thread
+		void ResolveFrame();
+		// Duration of the last trace in milliseconds, without the denoiser
+		float GetLastTraceTime() const { return m_LastTraceTime; }
+		// Duration of the denoiser pass of the last trace in milliseconds, 0 when it's off
+		float GetLastDenoiseTime() const { return m_LastDenoiseTime; }
 		
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, 
-			const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+		// Tiles are numbered row by row, the last row & column can be partial
+		uint32_t GetTileCount() const;
+		// Pixels of the tile clamped to the image
+		uint32_t GetTilePixelCount(uint32_t tileIndex) const;
+		// Traces the given tiles (in parallel) into the back HDR buffer, bit for bit the same as those tiles of a full Trace
+		void TraceTiles(Scene* pScene, const std::vector<uint32_t>& tileIndices);
+		// Copy one tile of the back HDR buffer out & in, row by row, so tiles traced elsewhere can be put together
+		void ReadTile(uint32_t tileIndex, std::vector<ColorRGB>& pixels) const;
+		void WriteTile(uint32_t tileIndex, const std::vector<ColorRGB>& pixels);
+
+		// Output of one camera of TraceViews, the caller picks the size
+		struct ViewTarget
+		{
+			int width{};
+			int height{};
+			// Where the view's random numbers start, different values give independent noise (e.g. frames to accumulate)
+			uint32_t firstSample{};
+			// Linear, unclamped colors, resized to width * height
+			std::vector<ColorRGB> pixels{};
+		};
+		// Traces the scene from every camera in one pass, cameras[i] into targets[i] (stereo pairs, cubemap faces, camera grids)
+		// Lights, materials & the kernel are looked up once and the tiles of all views go through a single parallel_for,
+		// so there's no per view barrier & the same tile of neighbouring views runs back to back while that part of the scene is in cache
+		// Each view is bit for bit what Trace gives from that camera at that size. Takes the current settings, ignores the heatmap
+		void TraceViews(Scene* pScene, const std::vector<Camera>& cameras, std::vector<ViewTarget>& targets) const;
+
+		// What TraceWithBudget got done before its deadline
+		struct BudgetReport
+		{
+			float budgetMs{};
+			// Can overshoot the budget by the coarse pass, which always runs, or by a badly estimated batch
+			float elapsedMs{};
+			float coarseMs{};
+			// Primary rays traced, the other pixels are copies of the nearest traced one
+			uint32_t tracedPixels{};
+			uint32_t pixelCount{};
+			// Tiles traced at full resolution
+			uint32_t finishedTiles{};
+			uint32_t tileCount{};
+			// Largest block still filled from a single sample, 1 once every pixel is traced
+			uint32_t coarsestStep{};
+
+			bool IsComplete() const { return coarsestStep == 1; }
+			float GetCoverage() const { return pixelCount > 0 ? float(tracedPixels) / pixelCount : 0.f; }
+		};
+		// Traces into the back HDR buffer until the budget runs out, the result is the best image so far
+		// A coarse pass (one sample per 8x8 block) comes first, then tiles are refined a level at a time, sharpest edges,
+		// highest variance & closest to the center first. A finished tile is bit for bit the same as in a full Trace
+		BudgetReport TraceWithBudget(Scene* pScene, float budgetMs);
+		// TraceWithBudget, swap & present in one go, like Render
+		BudgetReport RenderWithBudget(Scene* pScene, float budgetMs);
+
+		// Copies the last frame into a writer frame, HDR formats take the linear buffer, LDR formats the tone mapped one
+		ImageWriter::Frame CaptureFrame(ImageFormat format, const std::string& fileName) const;
+
+		// When the reflection bounces of a pixel stop
+		struct PathSettings
+		{
+			// Surfaces hit per pixel, the first one included
+			int maxBounces{ 16 };
+			// Bounces before this one always run, after it a path survives with the odds of its throughput (Combined lighting only)
+			// Survivors are weighted up by those odds, so on average the image is the same as without the roulette
+			int rouletteStartBounce{ 3 };
+			// Paths whose accumulated reflectivity drops below this stop, whatever they'd still add is dropped
+			float minContribution{ 0.01f };
+			// Lost on every reflection on top of the surface's reflectivity
+			float reflectionFalloff{ 0.7f };
+		};
+		void SetPathSettings(const PathSettings& settings) { m_PathSettings = settings; }
+		const PathSettings& GetPathSettings() const { return m_PathSettings; }
+
+		// The path tracer ends its paths with the PathSettings too, except for the reflection falloff
+		struct PathTracerSettings
+		{
+			int samplesPerPixel{ 4 };
+			// Owen scrambled Sobol points for the pixel jitter & bounces, otherwise plain PCG random numbers (to compare against)
+			bool useSobol{ true };
+			// Another noise pattern, the image for a seed is the same on any thread count
+			uint32_t seed{};
+		};
+		void SetPathTracerSettings(const PathTracerSettings& settings) { m_PathTracerSettings = settings; }
+		const PathTracerSettings& GetPathTracerSettings() const { return m_PathTracerSettings; }
+		void SetIntegrator(Integrator integrator) { m_Integrator = integrator; }
+		Integrator GetIntegrator() const { return m_Integrator; }
+		void ToggleIntegrator();
+		// Camera samples (paths) per second of the last Trace, written by the trace thread so only read it once the frame is done
+		float GetLastSamplesPerSecond() const { return m_LastSamplesPerSecond; }
+
+		// Albedo, normal & depth of the first hit of every pixel, written by Trace & TraceTiles while enabled (or while denoising)
+		// They belong to the last traced frame, not the presented one
+		void SetFeatureBuffers(bool isEnabled) { m_FeatureBuffersEnabled = isEnabled; }
+		bool GetFeatureBuffersEnabled() const { return m_FeatureBuffersEnabled || m_DenoiserEnabled; }
+		const FeatureBuffers& GetFeatureBuffers() const { return m_Features; }
 
-		bool SaveBufferToImage() const;
+		// Filters every traced frame in the back buffer before it's swapped, so low sample counts look converged
+		void SetDenoiser(bool isEnabled) { m_DenoiserEnabled = isEnabled; }
+		bool GetDenoiser() const { return m_DenoiserEnabled; }
+		void ToggleDenoiser();
+		// Temporal accumulation also makes the path tracer pick new samples every frame, otherwise it would repeat the same noise
+		void SetDenoiserSettings(const DenoiserSettings& settings) { m_DenoiserSettings = settings; }
+		const DenoiserSettings& GetDenoiserSettings() const { return m_DenoiserSettings; }
+		void ToggleTemporalAccumulation();
 
 		void CycleLightingMode();
+		void CycleToneMapping();
+		// Debug view of the traversal counters instead of the shaded image, needs RAY_STATS
+		void CycleHeatmapMode();
+		// Appends one line of counters per traced frame, nothing is written unless this is called
+		bool SetRayStatsFile(const std::string& path);
+		void ToggleSRGBEncoding() { m_ToneMapping.sRGBEncoding = !m_ToneMapping.sRGBEncoding; }
 		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
 		void ToggleReflections() { m_ReflectionsEnabled = !m_ReflectionsEnabled; }
 		void SetReflections(bool value) { m_ReflectionsEnabled = value; }
-		const std::vector<Vector3>& GetRayDirections() const { return m_RayDirections; }
-		void RecalculateRayDirections(Camera& camera);
+		bool GetReflections() const { return m_ReflectionsEnabled; }
+		void SetShadows(bool value) { m_ShadowsEnabled = value; }
+		bool GetShadows() const { return m_ShadowsEnabled; }
+		void SetLightingMode(LightingMode mode) { m_CurrentLightingMode = mode; }
+		LightingMode GetLightingMode() const { return m_CurrentLightingMode; }
+		// Linear, unclamped colors of the last presented frame
+		const std::vector<ColorRGB>& GetHdrBuffer() const { return m_HdrBuffers[m_TraceBufferIndex ^ 1]; }
 
 	private:
+		// Camera, ray generator & pixels of one image being traced, the window's back buffer or a TraceViews target
+		struct TraceView;
+
+		// Lighting mode & feature toggles are template parameters so the per-light & per-bounce checks compile away
+		template<LightingMode lightingMode, bool shadowsEnabled, bool reflectionsEnabled>
+		ColorRGB RenderPixelKernel(Scene* pScene, uint32_t pixelIndex, const Vector3& rayDirection,
+			const TraceView& view, const std::vector<Light>& lights, const MaterialRegistry& materials) const;
+		// Averages PathTracerSettings::samplesPerPixel jittered paths, the incoming direction is the pixel center & unused
+		template<bool shadowsEnabled>
+		ColorRGB PathTraceKernel(Scene* pScene, uint32_t pixelIndex, const Vector3& rayDirection,
+			const TraceView& view, const std::vector<Light>& lights, const MaterialRegistry& materials) const;
+
+		using RenderPixelFunc = ColorRGB (Renderer::*)(Scene*, uint32_t, const Vector3&,
+			const TraceView&, const std::vector<Light>&, const MaterialRegistry&) const;
+		// Runtime dispatch to the specialized kernel for the current settings, Render() picks the kernel once per frame instead
+		// The view is built once by the caller (MakeTraceView), not per pixel
+		void RenderPixel(Scene* pScene, uint32_t pixelIndex, const TraceView& view,
+			const std::vector<Light>& lights, const MaterialRegistry& materials) const;
+		TraceView MakeTraceView(Camera& camera, ColorRGB* pPixels, RayCounters* pPixelStats, FeatureBuffers* pFeatures, int width, int height,
+			uint32_t firstSample, const PathTracerSettings& pathTracerSettings) const;
+		// Where Trace writes the first hits, nullptr when nothing needs them
+		FeatureBuffers* GetFeatureTarget(bool isDenoising);
+
+		// Picks the fully specialized kernel for LightingMode x shadows x reflections, or the path tracer
+		RenderPixelFunc GetRenderPixelKernel() const;
+		// Everything the main thread can toggle, copied by the caller so a frame on another thread never reads the members
+		struct FrameSettings
+		{
+			RenderPixelFunc renderPixel{};
+			Integrator integrator{};
+			PathTracerSettings pathTracer{};
+			HeatmapMode heatmapMode{};
+			bool isDenoising{};
+			DenoiserSettings denoiser{};
+		};
+		FrameSettings GetFrameSettings() const;
+		void TraceFrame(Scene* pScene, const FrameSettings& settings);
+		// Square block of pixels, the unit of work handed to a worker
+		void GetTileBounds(uint32_t tileIndex, uint32_t& startX, uint32_t& startY, uint32_t& endX, uint32_t& endY) const;
+		void RenderTile(Scene* pScene, const TraceView& view, uint32_t tileIndex, RenderPixelFunc renderPixel,
+			const std::vector<Light>& lights, const MaterialRegistry& materials) const;
+		// Traces the pixels of a tile on the step grid that the previous (twice as coarse) level didn't have,
+		// then fills every step x step block from its top left sample. Returns the number of pixels traced
+		uint32_t RefineTile(Scene* pScene, const TraceView& view, uint32_t tileIndex, uint32_t step, RenderPixelFunc renderPixel,
+			const std::vector<Light>& lights, const MaterialRegistry& materials) const;
+		// How much refining the tile past step would likely change it, for TraceWithBudget's queue
+		float GetTilePriority(const TraceView& view, uint32_t tileIndex, uint32_t step) const;
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
 
+		// Double buffered linear float framebuffer, the kernels write to m_pHdrPixels (the back buffer)
+		// while the front buffer is resolved into m_pBuffer by the tone mapping pass
+		std::vector<ColorRGB> m_HdrBuffers[2]{};
+		int m_TraceBufferIndex{};
+		ColorRGB* m_pHdrPixels{};
+		float m_LastTraceTime{};
+		float m_LastSamplesPerSecond{};
+		float m_LastDenoiseTime{};
+		uint32_t m_FrameNumber{};
+
+		// Per pixel counters of the last traced frame & the optional summary file, only used with RAY_STATS
+		std::vector<RayCounters> m_PixelStats{};
+		RayCounters* m_pPixelStats{};
+		std::ofstream m_RayStatsFile{};
+		HeatmapMode m_HeatmapMode{ HeatmapMode::Off };
+		bool m_IsHeatmapBuffer[2]{};
+		ToneMappingSettings m_ToneMapping{};
+
 		int m_Width{};
 		int m_Height{};
 		float m_AspectRatio{};
-		int m_Bounces{ 3 };
-		std::vector<Vector3> m_RayDirections;
+		PathSettings m_PathSettings{};
+		PathTracerSettings m_PathTracerSettings{};
+		Integrator m_Integrator{ Integrator::Whitted };
 
-		enum class LightingMode
-		{
-			ObservedArea, // Lambert cosine law
-			Radiance, // Incident Radiance
-			BRDF, // Scattering of the light
-			Combined // ObservedArea & Radiance & BRDF
-		};
+		FeatureBuffers m_Features{};
+		bool m_FeatureBuffersEnabled{};
+		Denoiser m_Denoiser{};
+		DenoiserSettings m_DenoiserSettings{};
+		bool m_DenoiserEnabled{};
+		uint32_t m_TileSize{ 32 };
 
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
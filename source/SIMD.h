@@ -0,0 +1,107 @@
+#pragma once
+#include <immintrin.h>
+#include <type_traits>
+
+// SSE2 is always available on x64, the AVX/FMA paths are picked up when compiling with /arch:AVX or /arch:AVX2
+#if defined(__AVX__)
+#define DAE_SIMD_AVX
+#endif
+
+#if defined(__AVX2__) || defined(__FMA__)
+#define DAE_SIMD_FMA
+#endif
+
+namespace dae
+{
+	namespace simd
+	{
+		// Lane 3 (w) of Vector3 and ColorRGB registers is padding and is ignored by the 3-component helpers below
+
+		inline __m128 Load(const float* p)
+		{
+			return _mm_load_ps(p);
+		}
+
+		inline void Store(float* p, __m128 v)
+		{
+			_mm_store_ps(p, v);
+		}
+
+		inline __m128 Splat(float f)
+		{
+			return _mm_set1_ps(f);
+		}
+
+		inline __m128 MulAdd(__m128 a, __m128 b, __m128 c)
+		{
+#ifdef DAE_SIMD_FMA
+			return _mm_fmadd_ps(a, b, c);
+#else
+			return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+		}
+
+		// Returns x + y + z of the register in every lane
+		inline __m128 HorizontalAdd3(__m128 v)
+		{
+			const __m128 y{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)) };
+			const __m128 z{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)) };
+			const __m128 x{ _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)) };
+			return _mm_add_ps(_mm_add_ps(x, y), z);
+		}
+
+		inline float Dot3(__m128 a, __m128 b)
+		{
+#ifdef DAE_SIMD_AVX
+			return _mm_cvtss_f32(_mm_dp_ps(a, b, 0x71));
+#else
+			return _mm_cvtss_f32(HorizontalAdd3(_mm_mul_ps(a, b)));
+#endif
+		}
+
+		inline float Dot4(__m128 a, __m128 b)
+		{
+#ifdef DAE_SIMD_AVX
+			return _mm_cvtss_f32(_mm_dp_ps(a, b, 0xF1));
+#else
+			const __m128 m{ _mm_mul_ps(a, b) };
+			const __m128 s{ _mm_add_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1))) };
+			return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2))));
+#endif
+		}
+
+		inline __m128 Cross3(__m128 a, __m128 b)
+		{
+			// (a.yzx * b.zxy) - (a.zxy * b.yzx), done with 3 shuffles instead of 4
+			const __m128 aYZX{ _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)) };
+			const __m128 bYZX{ _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1)) };
+			const __m128 c{ _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b)) };
+			return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+		}
+
+		// e^x in every lane, clamped to [-80, 80], about 2e-4 relative error (good for weights, not for shading)
+		// Splits x * log2(e) into an integer, which goes straight into the exponent bits, & a fraction for the polynomial
+		inline __m128 Exp(__m128 x)
+		{
+			x = _mm_min_ps(_mm_max_ps(x, Splat(-80.f)), Splat(80.f));
+			const __m128 t{ _mm_mul_ps(x, Splat(1.44269504f)) };
+
+			// Floor with SSE2 only, truncation rounds negative values up
+			__m128i integer{ _mm_cvttps_epi32(t) };
+			__m128 floored{ _mm_cvtepi32_ps(integer) };
+			const __m128 isRoundedUp{ _mm_cmpgt_ps(floored, t) };
+			integer = _mm_add_epi32(integer, _mm_castps_si128(isRoundedUp)); // True lanes are -1
+			floored = _mm_sub_ps(floored, _mm_and_ps(isRoundedUp, Splat(1.f)));
+
+			// 2^f for f in [0, 1), cubic minimax fit
+			const __m128 f{ _mm_sub_ps(t, floored) };
+			__m128 p{ Splat(7.9440238e-2f) };
+			p = MulAdd(p, f, Splat(2.2449434e-1f));
+			p = MulAdd(p, f, Splat(6.9606564e-1f));
+			p = MulAdd(p, f, Splat(1.f));
+
+			const __m128 scale{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integer, _mm_set1_epi32(127)), 23)) };
+			return _mm_mul_ps(p, scale);
+		}
+	}
+}
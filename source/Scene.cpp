@@ -2,59 +2,165 @@
 #include "Utils.h"
 #include "Material.h"
 #include "Timer.h"
+#include "Tracing.h"
+#include <random>
 
 namespace dae
 {
 
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene() :
-		m_Materials({ new Material_SolidColor({1,0,0}) })
+	Scene::Scene()
 	{
-		m_SphereGeometries.reserve(32);
-		m_PlaneGeometries.reserve(32);
-		m_TriangleMeshGeometries.reserve(32);
-		m_Lights.reserve(32);
-	}
-
-	Scene::~Scene()
-	{
-		for (auto& pMaterial : m_Materials)
-		{
-			delete pMaterial;
-			pMaterial = nullptr;
-		}
+		m_Materials.Add(Material_SolidColor{ { 1, 0, 0 } });
 
-		m_Materials.clear();
+		// Only to save a few early reallocations, handles stay valid past this either way
+		m_SphereGeometries.Reserve(32);
+		m_PlaneGeometries.Reserve(32);
+		m_TriangleMeshGeometries.Reserve(32);
+		m_Lights.Reserve(32);
 	}
 
+
 	void dae::Scene::GetClosestHit(const Ray& viewRay, HitRecord& closestHit) const
 	{		
 		Ray ray = viewRay;
+		const std::vector<Plane>& planeGeometries{ m_PlaneGeometries.GetData() };
+		const std::vector<Sphere>& sphereGeometries{ m_SphereGeometries.GetData() };
+		const std::vector<TriangleMesh>& triangleMeshGeometries{ m_TriangleMeshGeometries.GetData() };
+
+		// Only t & which primitive it was while searching, the surface gets filled in once at the end
+		HitCandidate closest{};
+
 		// Check the planes
-		const size_t planeGeometriesSize{ m_PlaneGeometries.size() };
+		const size_t planeGeometriesSize{ planeGeometries.size() };
+		RAY_STATS_ADD(primitiveTests, planeGeometriesSize);
 		for (size_t i{}; i < planeGeometriesSize; ++i)
 		{
-			GeometryUtils::HitTest_Plane(m_PlaneGeometries[i], ray, closestHit);
-			ray.max = closestHit.t;
+			if (GeometryUtils::HitTest_Plane(planeGeometries[i], ray, closest))
+			{
+				closest.primitiveIndex = static_cast<uint32_t>(i);
+				ray.max = closest.t;
+			}
 		}
 
 		// Check the spheres
-		const size_t sphereGeometriesSize{ m_SphereGeometries.size() };
-		for (size_t i{}; i < sphereGeometriesSize; ++i)
+		if (m_SphereAcceleration == SphereAcceleration::UniformGrid)
 		{
-			GeometryUtils::HitTest_Sphere(m_SphereGeometries[i], ray, closestHit);
-			ray.max = closestHit.t;
-		}		
+			if (m_SphereGrid.GetClosestHit(sphereGeometries, ray, closest))
+				ray.max = closest.t;
+		}
+		else
+		{
+			const size_t sphereGeometriesSize{ sphereGeometries.size() };
+			RAY_STATS_ADD(primitiveTests, sphereGeometriesSize);
+			for (size_t i{}; i < sphereGeometriesSize; ++i)
+			{
+				if (GeometryUtils::HitTest_Sphere(sphereGeometries[i], ray, closest))
+				{
+					closest.primitiveIndex = static_cast<uint32_t>(i);
+					ray.max = closest.t;
+				}
+			}
+		}
 
 		// Triangles
-		const size_t triangleMeshGeometriesSize{ m_TriangleMeshGeometries.size() };
+		const size_t triangleMeshGeometriesSize{ triangleMeshGeometries.size() };
 		for (size_t i{}; i < triangleMeshGeometriesSize; ++i)
 		{
-			GeometryUtils::HitTest_TriangleMesh(m_TriangleMeshGeometries[i], ray, closestHit, false);
-			ray.max = closestHit.t;
+			if (GeometryUtils::HitTest_TriangleMesh(triangleMeshGeometries[i], ray, closest, false))
+			{
+				closest.instanceIndex = static_cast<uint32_t>(i);
+				ray.max = closest.t;
+			}
+		}
+
+		switch (closest.type)
+		{
+		case PrimitiveType::Plane:
+			GeometryUtils::ResolveHit(planeGeometries[closest.primitiveIndex], viewRay, closest, closestHit);
+			break;
+		case PrimitiveType::Sphere:
+			GeometryUtils::ResolveHit(sphereGeometries[closest.primitiveIndex], viewRay, closest, closestHit);
+			break;
+		case PrimitiveType::Triangle:
+			GeometryUtils::ResolveHit(triangleMeshGeometries[closest.instanceIndex], viewRay, closest, closestHit);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void Scene::Reload()
+	{
+		// Meshes give their buffers back to the arena before it's reset
+		m_TriangleMeshGeometries.Clear();
+		m_SphereGeometries.Clear();
+		m_PlaneGeometries.Clear();
+		m_Lights.Clear();
+		m_GeometryArena.Reset();
+
+		m_Materials.Clear();
+		m_Materials.Add(Material_SolidColor{ { 1, 0, 0 } });
+
+		m_Camera = {};
+		m_ResourceFiles.clear();
+		m_ReflectionsEnabled = false;
+		m_SphereAcceleration = m_PendingSphereAcceleration = SphereAcceleration::Linear;
+		Initialize();
+		SwapBuffers();
+	}
+
+	void Scene::InitializeInstance(const Scene& prototype)
+	{
+		Initialize();
+
+		// Initialize is deterministic, so the meshes line up one to one with the prototype's
+		std::vector<TriangleMesh>& triangleMeshGeometries{ m_TriangleMeshGeometries.GetData() };
+		const std::vector<TriangleMesh>& prototypeMeshes{ prototype.m_TriangleMeshGeometries.GetData() };
+		assert(triangleMeshGeometries.size() == prototypeMeshes.size());
+		for (size_t i{}; i < triangleMeshGeometries.size(); ++i)
+			triangleMeshGeometries[i].ShareSource(prototypeMeshes[i]);
+	}
+
+	GeometryMemoryReport Scene::GetGeometryMemoryReport() const
+	{
+		GeometryMemoryReport report{ m_GeometryArena.GetReport() };
+		report.meshCount = m_TriangleMeshGeometries.Size();
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			const MeshMemoryReport meshReport{ triangleMesh.GetMemoryReport() };
+			report.vertexCount += meshReport.vertexCount;
+			report.triangleCount += meshReport.triangleCount;
+		}
+		return report;
+	}
+
+	std::vector<MeshMemoryReport> Scene::GetMeshMemoryReports() const
+	{
+		std::vector<MeshMemoryReport> reports{};
+		reports.reserve(m_TriangleMeshGeometries.Size());
+		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+			reports.push_back(triangleMesh.GetMemoryReport());
+		return reports;
+	}
+
+	void Scene::SwapBuffers()
+	{
+		m_RenderCamera = m_Camera;
+
+		for (TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
+		{
+			triangleMesh.SwapTransforms();
+		}
+
+		// Derived scenes move their spheres before calling this, so the grid sees this frame's positions
+		m_SphereAcceleration = m_PendingSphereAcceleration;
+		if (m_SphereAcceleration == SphereAcceleration::UniformGrid)
+		{
+			TRACE_SCOPE("SphereGrid::Build");
+			m_SphereGrid.Build(m_SphereGeometries.GetData());
 		}
-		
 	}
 
 	bool Scene::DoesHit(Ray& ray) const
@@ -66,11 +172,20 @@ namespace dae
 		//		return true;
 		//}
 
-		for (const Sphere& sphere : m_SphereGeometries)
+		if (m_SphereAcceleration == SphereAcceleration::UniformGrid)
 		{
-			if (GeometryUtils::HitTest_Sphere(sphere, ray))
+			if (m_SphereGrid.DoesHit(m_SphereGeometries.GetData(), ray))
 				return true;
-		}		
+		}
+		else
+		{
+			for (const Sphere& sphere : m_SphereGeometries)
+			{
+				RAY_STATS_ADD(primitiveTests, 1);
+				if (GeometryUtils::HitTest_Sphere(sphere, ray))
+					return true;
+			}
+		}
 
 		for (const TriangleMesh& triangleMesh : m_TriangleMeshGeometries)
 		{
@@ -82,39 +197,62 @@ namespace dae
 	}
 
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	SphereHandle Scene::AddSphere(const Vector3& origin, float radius, MaterialId materialIndex)
 	{
 		Sphere s;
 		s.origin = origin;
 		s.radius = radius;
 		s.materialIndex = materialIndex;
 
-		m_SphereGeometries.emplace_back(s);
-		return &m_SphereGeometries.back();
+		return m_SphereGeometries.Add(s);
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	PlaneHandle Scene::AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex)
 	{
 		Plane p;
 		p.origin = origin;
 		p.normal = normal;
 		p.materialIndex = materialIndex;
 
-		m_PlaneGeometries.emplace_back(p);
-		return &m_PlaneGeometries.back();
+		return m_PlaneGeometries.Add(p);
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMeshHandle Scene::AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex)
 	{
-		TriangleMesh m{};
+		TriangleMesh m{ m_GeometryArena.GetResource() };
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
-		m_TriangleMeshGeometries.emplace_back(m);
-		return &m_TriangleMeshGeometries.back();
+		return m_TriangleMeshGeometries.Add(std::move(m));
+	}
+
+	TriangleMeshHandle Scene::AddCompactTriangleMesh(TriangleMesh source, BVHBuilder builder)
+	{
+		// The compact mesh brings its own BVH
+		source.bvhBuilder = BVHBuilder::None;
+		source.UpdateAABB();
+		source.UpdateTransforms();
+		source.SwapTransforms();
+
+		TriangleMesh m{ m_GeometryArena.GetResource() };
+		m.cullMode = source.cullMode;
+		m.materialIndex = source.materialIndex;
+		m.compact.Build(source.transformedPositions.data(), static_cast<uint32_t>(source.transformedPositions.size()),
+			source.indices.data(), source.transformedNormals.data(), static_cast<uint32_t>(source.indices.size() / 3), builder);
+		m.transformedMinAABB = m.compact.GetMinAABB();
+		m.transformedMaxAABB = m.compact.GetMaxAABB();
+
+		return m_TriangleMeshGeometries.Add(std::move(m));
 	}
 
-	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+	bool Scene::LoadOBJ(const std::string& fileName, TriangleMesh& mesh)
+	{
+		if (std::find(m_ResourceFiles.begin(), m_ResourceFiles.end(), fileName) == m_ResourceFiles.end())
+			m_ResourceFiles.push_back(fileName);
+		return Utils::ParseOBJ(fileName, mesh.positions, mesh.normals, mesh.indices);
+	}
+
+	LightHandle Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.origin = origin;
@@ -122,11 +260,10 @@ namespace dae
 		l.color = color;
 		l.type = LightType::Point;
 
-		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		return m_Lights.Add(l);
 	}
 
-	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
+	LightHandle Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.direction = direction;
@@ -134,15 +271,10 @@ namespace dae
 		l.color = color;
 		l.type = LightType::Directional;
 
-		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		return m_Lights.Add(l);
 	}
 
-	unsigned char Scene::AddMaterial(Material* pMaterial)
-	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
-	}
+
 #pragma endregion
 #pragma endregion
 
@@ -150,12 +282,12 @@ namespace dae
 	void Scene_W1::Initialize()
 	{
 		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial(Material_SolidColor{ colors::Blue });
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialId matId_Solid_Yellow = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const MaterialId matId_Solid_Green = AddMaterial(Material_SolidColor{ colors::Green });
+		const MaterialId matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
 
 		//Spheres
@@ -174,25 +306,23 @@ namespace dae
 	void Scene_W2::Update(dae::Timer* pTimer)
 	{
 		Scene::Update(pTimer);
-		++currentColorOffset;
-		Material_SolidColor* matChanging{ static_cast<Material_SolidColor*>(m_Materials[matId_Changing_Color]) };
+		// 60 color steps per second, from the scene time so a frame looks the same no matter how it was reached
+		const int currentColorOffset{ static_cast<int>(pTimer->GetTotal() * 60.f) };
 
 		// Make every sphere shift through colors
-		const size_t sphereGeometriesSize{ m_SphereGeometries.size() };
-		for (size_t i{}; i < sphereGeometriesSize; ++i)
-		{
-			Sphere& sphere{ m_SphereGeometries[i] };
-			//sphere.materialIndex = static_cast<unsigned char>(i % m_Materials.size());
-			const float offSet{ abs(currentColorOffset % 255 + 1 - 128) / 255.0f };
-			const float colorRed{ 0.5f + offSet };
-			const float colorGreen{ 1.0f - offSet };
-			const float colorBlue{ 0.0f };
-
-			ColorRGB color{ colorRed,colorGreen,colorBlue };
-			matChanging->SetColor(color);
+		// The material is shared with the frame that might still be tracing, so only apply it in SwapBuffers
+		const float offSet{ abs(currentColorOffset % 255 + 1 - 128) / 255.0f };
+		const float colorRed{ 0.5f + offSet };
+		const float colorGreen{ 1.0f - offSet };
+		const float colorBlue{ 0.0f };
+		m_PendingColor = ColorRGB{ colorRed,colorGreen,colorBlue };
+	}
 
-		}
+	void Scene_W2::SwapBuffers()
+	{
+		Scene::SwapBuffers();
 
+		m_Materials.Get<Material_SolidColor>(matId_Changing_Color).SetColor(m_PendingColor);
 	}
 	void Scene_W2::Initialize()
 	{
@@ -200,13 +330,15 @@ namespace dae
 		m_Camera.SetFov(45.0f);
 
 		// default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial(Material_SolidColor{ colors::Blue });
+		const MaterialId matId_Solid_Yellow = AddMaterial(Material_SolidColor{ colors::Yellow });
+		const MaterialId matId_Solid_Green = AddMaterial(Material_SolidColor{ colors::Green });
+		const MaterialId matId_Solid_Magenta = AddMaterial(Material_SolidColor{ colors::Magenta });
 
-		matId_Changing_Color = AddMaterial(new Material_SolidColor{ colors::Cyan });
+		// Own copy, it's recolored every frame
+		matId_Changing_Color = AddMaterial(Material_SolidColor{ colors::Cyan }, true);
+		m_PendingColor = colors::Cyan;
 
 		// Planes
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matId_Solid_Green);
@@ -240,15 +372,15 @@ namespace dae
 		m_Camera.origin = { 0.0f, 3.0f, -9.0f };
 		m_Camera.SetFov(45.0f);
 
-		const auto matCt_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
-		const auto matCt_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
-		const auto matCt_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.1f));
+		const auto matCt_GrayRoughMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
+		const auto matCt_GrayMediumMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
+		const auto matCt_GraySmoothMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.1f));
 
-		const auto matCt_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
-		const auto matCt_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
-		const auto matCt_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
+		const auto matCt_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
+		const auto matCt_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
+		const auto matCt_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
 
-		const auto matLamber_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.0f));
+		const auto matLamber_GrayBlue = AddMaterial(Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.0f));
 
 		// Planes
 		AddPlane({ 0.0f, 0.0f, 10.0f }, { 0.0f, 0.0f, -1.0f }, matLamber_GrayBlue);  // BACK
@@ -260,9 +392,9 @@ namespace dae
 		AddPlane({ 0.0f, 0.0f, -100.0f }, { 0.0f, 0.0f, 1.0f }, matLamber_GrayBlue);  // BEHIND
 
 		//// TEMP Lambert-Phone spheres & materials
-		const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.0f));
-		const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.0f));
-		const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.0f));
+		const auto matLambertPhong1 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.0f));
+		const auto matLambertPhong2 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.0f));
+		const auto matLambertPhong3 = AddMaterial(Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.0f));
 
 		//AddSphere(Vector3(-1.75f, 1.0f, 0.f), 0.75f, matLambertPhong1);
 		//AddSphere(Vector3(0.0f, 1.0f, 0.f), 0.75f, matLambertPhong2);
@@ -289,10 +421,10 @@ namespace dae
 		m_Camera.origin = { 0.f, 1.f, -5.0f };
 		m_Camera.SetFov(45.0f);
 
-		const auto matLambert_Red = AddMaterial(new Material_Lambert(colors::Red, 1.f));
-		const auto matLambert_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.0f));
-		const auto matLambert_Yellow = AddMaterial(new Material_Lambert(colors::Yellow, 1.f));
-		const auto matCt_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
+		const auto matLambert_Red = AddMaterial(Material_Lambert(colors::Red, 1.f));
+		const auto matLambert_Blue = AddMaterial(Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.0f));
+		const auto matLambert_Yellow = AddMaterial(Material_Lambert(colors::Yellow, 1.f));
+		const auto matCt_GraySmoothMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.960f, 0.915f }, 1.f, 0.1f));
 
 		//// Triangles
 		//TriangleCullMode cullMode(TriangleCullMode::NoCulling);
@@ -320,8 +452,8 @@ namespace dae
 		m_Camera.SetFov(45.0f);
 
 		// Materials
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(ColorRGB(colors::White), 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(ColorRGB(colors::White), 1.f));
 
 		// Planes
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);  // BACK
@@ -331,7 +463,8 @@ namespace dae
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue);  // LEFT	
 
 
-		pMesh = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
+		m_Mesh = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		pMesh->positions = { {-0.75f, -1.f, 0.f}, {-0.75f, 1.0f, 0.f}, {0.75f, 1.f, 1.f}, {0.75f, -1.f, 0.f} };
 		pMesh->indices = {
 			0, 1, 2,
@@ -367,6 +500,7 @@ namespace dae
 		// Rotate the trianglemesh frame by frame
 		// Ptimer gettotal time will increase the longer the scene runs (accumulated time)
 
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		pMesh->RotateY(PI_DIV_4 * pTimer->GetTotal());
 		pMesh->UpdateTransforms();
 
@@ -379,16 +513,16 @@ namespace dae
 		m_Camera.SetFov(45.0f);
 
 		// Materials
-		const auto matCt_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
-		const auto matCt_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
-		const auto matCt_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.1f));
+		const auto matCt_GrayRoughMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
+		const auto matCt_GrayMediumMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
+		const auto matCt_GraySmoothMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.1f));
 
-		const auto matCt_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
-		const auto matCt_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
-		const auto matCt_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
+		const auto matCt_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
+		const auto matCt_GrayMediumPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.6f));
+		const auto matCt_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		// Planes
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);	// BACK
@@ -408,27 +542,31 @@ namespace dae
 
 		// Triangles
 		const Triangle baseTriangle = { { -.75f, 1.5f, 0.f }, { .75f, 0.f, 0.f }, { -.75f, 0.f, 0.f } };
+		TriangleMesh* pMesh{};
 
 		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_Meshes[0]->AppendTriangle(baseTriangle, true);
-		m_Meshes[0]->Translate({ -1.75f, 4.5f, 0.f });
-		m_Meshes[0]->CalculateNormals();
-		m_Meshes[0]->UpdateAABB();
-		m_Meshes[0]->UpdateTransforms();
+		pMesh = GetTriangleMesh(m_Meshes[0]);
+		pMesh->AppendTriangle(baseTriangle, true);
+		pMesh->Translate({ -1.75f, 4.5f, 0.f });
+		pMesh->CalculateNormals();
+		pMesh->UpdateAABB();
+		pMesh->UpdateTransforms();
 
 		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
-		m_Meshes[1]->Translate({ 0.f, 4.5f, 0.f });
-		m_Meshes[1]->CalculateNormals();
-		m_Meshes[1]->UpdateAABB();
-		m_Meshes[1]->UpdateTransforms();
+		pMesh = GetTriangleMesh(m_Meshes[1]);
+		pMesh->AppendTriangle(baseTriangle, true);
+		pMesh->Translate({ 0.f, 4.5f, 0.f });
+		pMesh->CalculateNormals();
+		pMesh->UpdateAABB();
+		pMesh->UpdateTransforms();
 
 		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
-		m_Meshes[2]->Translate({ 1.75f, 4.5f, 0.f });
-		m_Meshes[2]->CalculateNormals();
-		m_Meshes[2]->UpdateAABB();
-		m_Meshes[2]->UpdateTransforms();
+		pMesh = GetTriangleMesh(m_Meshes[2]);
+		pMesh->AppendTriangle(baseTriangle, true);
+		pMesh->Translate({ 1.75f, 4.5f, 0.f });
+		pMesh->CalculateNormals();
+		pMesh->UpdateAABB();
+		pMesh->UpdateTransforms();
 
 
 		// Lights
@@ -446,10 +584,11 @@ namespace dae
 
 
 		const float yawAngle = (cos(pTimer->GetTotal()) + 1.f) * 0.5f * PI_2;
-		for (TriangleMesh* mesh : m_Meshes)
+		for (TriangleMeshHandle mesh : m_Meshes)
 		{
-			mesh->RotateY(yawAngle);
-			mesh->UpdateTransforms();
+			TriangleMesh* pMesh{ GetTriangleMesh(mesh) };
+			pMesh->RotateY(yawAngle);
+			pMesh->UpdateTransforms();
 		}
 
 	}
@@ -461,8 +600,8 @@ namespace dae
 
 		// Materials
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		// Planes
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);	// BACK
@@ -472,9 +611,13 @@ namespace dae
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue);	// LEFT
 
 		// Bunny
-		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		m_Mesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		//Utils::ParseOBJ("Resources/truck2.obj", pMesh->positions, pMesh->normals, pMesh->indices);
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		LoadOBJ("Resources/lowpoly_bunny2.obj", *pMesh);
+
+		// Rebuilt every frame, but at this size the better tree saves a lot more tracing time than LBVH saves building (--bench-bvh)
+		pMesh->bvhBuilder = BVHBuilder::BinnedSAH;
 
 		//pMesh->CalculateNormals();
 		pMesh->Scale({ 2.f, 2.f, 2.f });
@@ -495,6 +638,7 @@ namespace dae
 		
 		const float yawAngle = (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2;
 
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		pMesh->RotateY(yawAngle);
 		pMesh->UpdateTransforms();
 	}
@@ -502,24 +646,25 @@ namespace dae
 	void Scene_Extra::Initialize()
 	{
 		sceneName = "Bunny Scene with mirror";
+		m_Meshes.clear();
 		m_ReflectionsEnabled = true;
 		m_Camera.origin = { -2.5f, 3.f, -9.f };
 		m_Camera.SetYaw(25.0f);
 		m_Camera.SetFov(45.0f);
 
 		// Materials
-		//const auto matCt_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
-		//const auto matCt_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
-		const auto matCt_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.05f));
+		//const auto matCt_GrayRoughMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 1.f));
+		//const auto matCt_GrayMediumMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.6f));
+		const auto matCt_GraySmoothMetal = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.05f));
 
-		//const auto matCt_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
-		const auto matCt_RedMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.8f, 0.2f, 0.3f }, 0.f, 0.6f));
-		const auto matCt_GreenMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.2f, 0.8f, 0.2f }, 0.f, 0.6f));
-		const auto matCt_BlueMediumPlastic = AddMaterial(new Material_CookTorrence({ 0.0f, 0.80f, 1.0f }, 0.f, 0.8f));
-		//const auto matCt_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
+		//const auto matCt_GrayRoughPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 1.f));
+		const auto matCt_RedMediumPlastic = AddMaterial(Material_CookTorrence({ 0.8f, 0.2f, 0.3f }, 0.f, 0.6f));
+		const auto matCt_GreenMediumPlastic = AddMaterial(Material_CookTorrence({ 0.2f, 0.8f, 0.2f }, 0.f, 0.6f));
+		const auto matCt_BlueMediumPlastic = AddMaterial(Material_CookTorrence({ 0.0f, 0.80f, 1.0f }, 0.f, 0.8f));
+		//const auto matCt_GraySmoothPlastic = AddMaterial(Material_CookTorrence({ 0.75f, 0.75f, 0.75f }, 0.f, 0.1f));
 
-		//const auto matLambert_Blue = AddMaterial(new Material_Lambert({ 0.0f, 0.80f, 1.0f }, 1.f));
-		const auto matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		//const auto matLambert_Blue = AddMaterial(Material_Lambert({ 0.0f, 0.80f, 1.0f }, 1.f));
+		const auto matLambert_White = AddMaterial(Material_Lambert(colors::White, 1.f));
 
 		// Planes
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matCt_BlueMediumPlastic);	// BACK
@@ -532,36 +677,38 @@ namespace dae
 		AddSphere({ 0.f, 4.f, 2.f }, 1.0f, matCt_GraySmoothMetal);
 
 		// Bunny
-		TriangleMesh* pMesh = m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White));
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		TriangleMesh* pMesh = GetTriangleMesh(m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White)));
+		LoadOBJ("Resources/lowpoly_bunny2.obj", *pMesh);
 		pMesh->Translate({ -2.f, 0.f, 2.f });
 		pMesh->RotateY({ 10.f });
 
-		pMesh = m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White));
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		pMesh = GetTriangleMesh(m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White)));
+		LoadOBJ("Resources/lowpoly_bunny2.obj", *pMesh);
 		pMesh->Translate({ 2.f, 0.f, 2.f });
 		pMesh->RotateY({ -25.f });
 
-		pMesh = m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White));
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		pMesh = GetTriangleMesh(m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White)));
+		LoadOBJ("Resources/lowpoly_bunny2.obj", *pMesh);
 		pMesh->Translate({ 0.f, 0.f, 3.f });
 		pMesh->RotateY({ 35.f });
 
 		// Companion cube
-		pMesh = m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCt_RedMediumPlastic));
-		Utils::ParseOBJ("Resources/lowpoly_CompanionCube.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		pMesh = GetTriangleMesh(m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCt_RedMediumPlastic)));
+		LoadOBJ("Resources/lowpoly_CompanionCube.obj", *pMesh);
 		pMesh->Translate({ 3.5f, 0.75f, 7.f });
 		pMesh->RotateY({ 45.f });
 		pMesh->Scale({ 3.f, 3.f, 3.f });
 
-		pMesh = m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCt_RedMediumPlastic));
-		Utils::ParseOBJ("Resources/lowpoly_CompanionCube.obj", pMesh->positions, pMesh->normals, pMesh->indices);
+		pMesh = GetTriangleMesh(m_Meshes.emplace_back(AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCt_RedMediumPlastic)));
+		LoadOBJ("Resources/lowpoly_CompanionCube.obj", *pMesh);
 		pMesh->Translate({ -3.5f, 0.75f, 7.f });
 		pMesh->RotateY({ 20.f });
 		pMesh->Scale({ 3.f, 3.f, 3.f });
 
-		for (TriangleMesh* pMesh : m_Meshes)
+		for (TriangleMeshHandle mesh : m_Meshes)
 		{
+			pMesh = GetTriangleMesh(mesh);
+			pMesh->bvhBuilder = BVHBuilder::BinnedSAH;
 			pMesh->UpdateAABB();
 			pMesh->UpdateTransforms();
 		}
@@ -577,8 +724,9 @@ namespace dae
 
 		float multiplier = 1.0f;
 
-		for (TriangleMesh* pMesh : m_Meshes)
+		for (TriangleMeshHandle mesh : m_Meshes)
 		{
+			TriangleMesh* pMesh{ GetTriangleMesh(mesh) };
 			multiplier /= 0.7f;
 			const float yawAngle = (pTimer->GetTotal() + 1.f) * 0.5f * PI_2 / multiplier;
 			pMesh->RotateY(yawAngle);
@@ -586,4 +734,138 @@ namespace dae
 		}
 
 	}
+#pragma region SCENE SPHERE FIELD
+	void Scene_SphereField::Initialize()
+	{
+		sceneName = "Sphere Field";
+		m_Camera.origin = { 0.f, 3.f, -9.f };
+		m_Camera.SetFov(45.0f);
+
+		// Too many spheres to test one by one
+		SetSphereAcceleration(SphereAcceleration::UniformGrid);
+
+		// Materials
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+		const MaterialId sphereMaterials[]
+		{
+			AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.3f)),
+			AddMaterial(Material_CookTorrence({ 0.8f, 0.2f, 0.3f }, 0.f, 0.6f)),
+			AddMaterial(Material_CookTorrence({ 0.2f, 0.8f, 0.2f }, 0.f, 0.6f)),
+			AddMaterial(Material_Lambert({ 0.0f, 0.80f, 1.0f }, 1.f))
+		};
+
+		// Planes
+		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);	// BACK
+		AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue);	// BOTTOM
+
+		// Spheres, jittered lattice with a fixed seed so every run (and the regression references) look the same
+		constexpr int countX{ 40 }, countY{ 25 }, countZ{ 40 };
+		constexpr float radius{ 0.06f };
+		std::mt19937 rng{ 1337 };
+		std::uniform_real_distribution<float> jitter{ -0.05f, 0.05f };
+
+		m_BaseOrigins.clear();
+		m_BaseOrigins.reserve(countX * countY * countZ);
+		for (int z{}; z < countZ; ++z)
+		{
+			for (int y{}; y < countY; ++y)
+			{
+				for (int x{}; x < countX; ++x)
+				{
+					const Vector3 origin{ -4.f + x * 0.2f + jitter(rng), 0.5f + y * 0.2f + jitter(rng), z * 0.2f + jitter(rng) };
+					AddSphere(origin, radius, sphereMaterials[(x + y + z) % std::size(sphereMaterials)]);
+					m_BaseOrigins.push_back(origin);
+				}
+			}
+		}
+		m_PendingOrigins = m_BaseOrigins;
+
+		// Lights
+		AddPointLight({ 0.f, 5.f, 5.f }, 50.f, { 1.f, .61f, .45f }); // BACKLIGHT
+		AddPointLight({ -2.5f, 5.f, -5.f }, 70.f, { 1.f, .8f, .45f }); // FRONT LIGHT LEFT
+		AddPointLight({ 2.5f, 2.5f, -5.f }, 50.f, { 0.34f, .47f, .68f });
+	}
+
+	void Scene_SphereField::Update(dae::Timer* pTimer)
+	{
+		Scene::Update(pTimer);
+
+		// Every sphere bobs up & down, a wave running over the field
+		const float time{ pTimer->GetTotal() };
+		for (size_t i{}; i < m_BaseOrigins.size(); ++i)
+		{
+			const Vector3& base{ m_BaseOrigins[i] };
+			m_PendingOrigins[i] = base + Vector3{ 0.f, 0.15f * sinf(2.f * time + base.x + base.z), 0.f };
+		}
+	}
+
+	void Scene_SphereField::SwapBuffers()
+	{
+		// Move the spheres first, the base class rebuilds the grid over the new positions
+		std::vector<Sphere>& spheres{ m_SphereGeometries.GetData() };
+		for (size_t i{}; i < spheres.size() && i < m_PendingOrigins.size(); ++i)
+			spheres[i].origin = m_PendingOrigins[i];
+
+		Scene::SwapBuffers();
+	}
+#pragma endregion
+
+	void Scene_MirrorCorridor::Initialize()
+	{
+		sceneName = "Mirror Corridor";
+		m_ReflectionsEnabled = true;
+		m_Camera.origin = { -1.2f, 2.f, -6.f };
+		m_Camera.SetYaw(20.0f);
+		m_Camera.SetFov(60.0f);
+
+		// Materials
+		const auto matCt_Mirror = AddMaterial(Material_CookTorrence({ 0.972f, 0.96f, 0.915f }, 1.f, 0.02f));
+		const auto matCt_RedMediumPlastic = AddMaterial(Material_CookTorrence({ 0.8f, 0.2f, 0.3f }, 0.f, 0.6f));
+		const auto matCt_GreenMediumPlastic = AddMaterial(Material_CookTorrence({ 0.2f, 0.8f, 0.2f }, 0.f, 0.6f));
+		const auto matCt_CopperMediumMetal = AddMaterial(Material_CookTorrence({ 0.955f, 0.637f, 0.538f }, 1.f, 0.4f));
+		const auto matLambert_GrayBlue = AddMaterial(Material_Lambert({ 0.49f, 0.57f, 0.57f }, 1.f));
+
+		// Planes
+		AddPlane({ -2.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matCt_Mirror);	// LEFT
+		AddPlane({ 2.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matCt_Mirror);	// RIGHT
+		AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, matLambert_GrayBlue);	// BOTTOM
+		AddPlane({ 0.f, 0.f, 20.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue);	// BACK
+
+		// Spheres down the corridor, repeated endlessly by the mirrors
+		AddSphere({ -0.8f, 0.6f, 0.f }, 0.6f, matCt_RedMediumPlastic);
+		AddSphere({ 0.9f, 1.f, 4.f }, 1.f, matCt_CopperMediumMetal);
+		AddSphere({ -0.5f, 0.8f, 9.f }, 0.8f, matCt_GreenMediumPlastic);
+
+		// Lights
+		AddPointLight({ 0.f, 5.f, -3.f }, 50.f, { 1.f, .8f, .45f });
+		AddPointLight({ 0.f, 5.f, 10.f }, 70.f, { 0.34f, .47f, .68f });
+	}
+
+	const std::vector<SceneEntry>& GetBuiltInScenes()
+	{
+		static const std::vector<SceneEntry> scenes
+		{
+			{ "W1", [] { return new Scene_W1(); } },
+			{ "W2", [] { return new Scene_W2(); } },
+			{ "W3", [] { return new Scene_W3(); } },
+			{ "W3_Test", [] { return new Scene_W3_Test(); } },
+			{ "W4_TestScene", [] { return new Scene_W4_TestScene(); } },
+			{ "W4_ReferenceScene", [] { return new Scene_W4_ReferenceScene(); } },
+			{ "W4_BunnyScene", [] { return new Scene_W4_BunnyScene(); } },
+			{ "Extra", [] { return new Scene_Extra(); } },
+			{ "SphereField", [] { return new Scene_SphereField(); } },
+			{ "MirrorCorridor", [] { return new Scene_MirrorCorridor(); } },
+		};
+		return scenes;
+	}
+
+	Scene* CreateScene(const std::string& name)
+	{
+		for (const SceneEntry& entry : GetBuiltInScenes())
+		{
+			if (name == entry.name)
+				return entry.create();
+		}
+		return nullptr;
+	}
 }
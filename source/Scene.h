@@ -1,27 +1,36 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "SlotMap.h"
+#include "Material.h"
+#include "GeometryArena.h"
+#include "SphereGrid.h"
 
 namespace dae
 {
 	//Forward Declarations
 	class Timer;
-	class Material;
 	struct Plane;
 	struct Sphere;
 	struct Light;
 
+	using SphereHandle = Handle<Sphere>;
+	using PlaneHandle = Handle<Plane>;
+	using TriangleMeshHandle = Handle<TriangleMesh>;
+	using LightHandle = Handle<Light>;
+
 	//Scene Base Class
 	
 	class Scene
 	{
 	public:
 		Scene();
-		virtual ~Scene();
+		virtual ~Scene() = default;
 
 		Scene(const Scene&) = delete;
 		Scene(Scene&&) noexcept = delete;
@@ -29,41 +38,100 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
+		// Initialize for one more copy of an already initialized scene of the same type (e.g. frames in flight of an animation)
+		// The meshes keep only their transformed data & BVHs, positions, normals, indices & compact meshes are read from the prototype's
+		// The prototype has to outlive this scene, it may keep animating (Update & SwapBuffers never touch those buffers)
+		void InitializeInstance(const Scene& prototype);
 		virtual void Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			if (m_IsCameraInputEnabled)
+				m_Camera.Update(pTimer);
 		}
 
+		// Publishes everything Update changed to the renderer (camera snapshot, mesh transforms, ...)
+		// Update only writes back buffers, so it can run while the previous frame is still being traced
+		// Only call when no frame is in flight
+		virtual void SwapBuffers();
+
+		// Drops all objects, materials & mesh memory in one go and runs Initialize again
+		// Only call when no frame is in flight
+		void Reload();
+		GeometryMemoryReport GetGeometryMemoryReport() const;
+		std::vector<MeshMemoryReport> GetMeshMemoryReports() const;
+
 		Camera& GetCamera() { return m_Camera; }
+		// Copy of the camera taken at the last SwapBuffers, the one the renderer traces with
+		Camera& GetRenderCamera() { return m_RenderCamera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(Ray& ray) const;
 		bool GetReflectionsEnabled() const { return m_ReflectionsEnabled; }
-
-		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
-		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
-		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		// Off for offline renders, the camera then only moves when the scene itself moves it
+		void SetCameraInput(bool isEnabled) { m_IsCameraInputEnabled = isEnabled; }
+		SphereAcceleration GetSphereAcceleration() const { return m_SphereAcceleration; }
+		// Takes effect at the next SwapBuffers, so it's safe while a frame is in flight
+		void SetSphereAcceleration(SphereAcceleration acceleration) { m_PendingSphereAcceleration = acceleration; }
+
+		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries.GetData(); }
+		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries.GetData(); }
+		const std::vector<Light>& GetLights() const { return m_Lights.GetData(); }
+		const MaterialRegistry& GetMaterials() const { return m_Materials; }
+
+		// nullptr once the object is removed, don't hold on to the pointer across Add/Remove calls
+		Sphere* GetSphere(SphereHandle handle) { return m_SphereGeometries.Get(handle); }
+		Plane* GetPlane(PlaneHandle handle) { return m_PlaneGeometries.Get(handle); }
+		TriangleMesh* GetTriangleMesh(TriangleMeshHandle handle) { return m_TriangleMeshGeometries.Get(handle); }
+		Light* GetLight(LightHandle handle) { return m_Lights.Get(handle); }
+		// Files the last Initialize read, caches hash them to notice when a scene's inputs changed
+		const std::vector<std::string>& GetResourceFiles() const { return m_ResourceFiles; }
 
 	protected:
 		std::string	sceneName;
 
-		std::vector<Plane> m_PlaneGeometries{};
-		std::vector<Sphere> m_SphereGeometries{};
-		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
-		std::vector<Light> m_Lights{};
-		std::vector<Material*> m_Materials{};
+		// Backs all mesh buffers, declared before the meshes so it outlives them
+		GeometryArena m_GeometryArena{};
+
+		// Dense storage + generational handles, objects can be added & removed without invalidating other handles
+		SlotMap<Plane> m_PlaneGeometries{};
+		SlotMap<Sphere> m_SphereGeometries{};
+		SlotMap<TriangleMesh> m_TriangleMeshGeometries{};
+		SlotMap<Light> m_Lights{};
+		MaterialRegistry m_Materials{};
 		
 		bool m_ReflectionsEnabled{};
+
+		// Linear by default, scenes with many small spheres switch to the grid in Initialize
+		SphereAcceleration m_SphereAcceleration{ SphereAcceleration::Linear };
+		SphereAcceleration m_PendingSphereAcceleration{ SphereAcceleration::Linear };
+		// Rebuilt every SwapBuffers while active, spheres may have moved
+		SphereGrid m_SphereGrid{};
 		
 		Camera m_Camera{};
-
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
-
-		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
-		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		Camera m_RenderCamera{};
+		bool m_IsCameraInputEnabled{ true };
+
+		std::vector<std::string> m_ResourceFiles{};
+
+		// Adding & removing changes what the renderer reads, so only do it in Initialize or in a SwapBuffers override (not during Update)
+		SphereHandle AddSphere(const Vector3& origin, float radius, MaterialId materialIndex = 0);
+		PlaneHandle AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex = 0);
+		TriangleMeshHandle AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex = 0);
+		// Bakes the source's transform into a static CompactMesh in the scene's arena
+		// Build the source on the heap (std::vector constructors), then only the compact copy stays around
+		TriangleMeshHandle AddCompactTriangleMesh(TriangleMesh source, BVHBuilder builder = BVHBuilder::BinnedSAH);
+
+		// Utils::ParseOBJ into the mesh's buffers, remembers the file for GetResourceFiles
+		bool LoadOBJ(const std::string& fileName, TriangleMesh& mesh);
+
+		LightHandle AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
+		LightHandle AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+		// Identical materials are shared, pass isUnique to get a material of its own (e.g. to change it at runtime)
+		template<typename MaterialType>
+		MaterialId AddMaterial(const MaterialType& material, bool isUnique = false) { return m_Materials.Add(material, isUnique); }
+
+		bool RemoveSphere(SphereHandle handle) { return m_SphereGeometries.Remove(handle); }
+		bool RemovePlane(PlaneHandle handle) { return m_PlaneGeometries.Remove(handle); }
+		bool RemoveTriangleMesh(TriangleMeshHandle handle) { return m_TriangleMeshGeometries.Remove(handle); }
+		bool RemoveLight(LightHandle handle) { return m_Lights.Remove(handle); }
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -96,11 +164,12 @@ namespace dae
 		Scene_W2& operator=(Scene_W2&&) noexcept = delete;
 
 		virtual void Update(dae::Timer* pTimer) override;
+		void SwapBuffers() override;
 
 		void Initialize() override;
 	private:
-		unsigned char matId_Changing_Color{};
-		int currentColorOffset{ 0 };
+		MaterialId matId_Changing_Color{};
+		ColorRGB m_PendingColor{};
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -152,7 +221,7 @@ namespace dae
 		void Update(dae::Timer* pTimer) override;
 
 	private:
-		TriangleMesh* pMesh{ nullptr };
+		TriangleMeshHandle m_Mesh{};
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -172,7 +241,7 @@ namespace dae
 		void Update(dae::Timer* pTimer) override;
 
 	private:
-		TriangleMesh* m_Meshes[3]{};
+		TriangleMeshHandle m_Meshes[3]{};
 
 	};
 
@@ -193,7 +262,7 @@ namespace dae
 		void Update(dae::Timer* pTimer) override;
 
 	private:
-		TriangleMesh* pMesh{ nullptr };
+		TriangleMeshHandle m_Mesh{};
 
 	};
 	
@@ -214,8 +283,57 @@ namespace dae
 		void Update(dae::Timer* pTimer) override;
 
 	private:
-		std::vector<TriangleMesh*> m_Meshes{};
+		std::vector<TriangleMeshHandle> m_Meshes{};
+
+	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Sphere Field, tens of thousands of small bobbing spheres on the uniform grid
+	class Scene_SphereField final : public Scene
+	{
+	public:
+		Scene_SphereField() = default;
+		~Scene_SphereField() override = default;
+
+		Scene_SphereField(const Scene_SphereField&) = delete;
+		Scene_SphereField(Scene_SphereField&&) noexcept = delete;
+		Scene_SphereField& operator=(const Scene_SphereField&) = delete;
+		Scene_SphereField& operator=(Scene_SphereField&&) noexcept = delete;
+
+		void Initialize() override;
+		void Update(dae::Timer* pTimer) override;
+		void SwapBuffers() override;
+
+	private:
+		// Same order as the spheres, Update writes the pending positions & SwapBuffers moves the spheres
+		std::vector<Vector3> m_BaseOrigins{};
+		std::vector<Vector3> m_PendingOrigins{};
+	};
 
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Mirror Corridor, two facing mirrors so a reflection ray bounces until the path gives up
+	class Scene_MirrorCorridor final : public Scene
+	{
+	public:
+		Scene_MirrorCorridor() = default;
+		~Scene_MirrorCorridor() override = default;
+
+		Scene_MirrorCorridor(const Scene_MirrorCorridor&) = delete;
+		Scene_MirrorCorridor(Scene_MirrorCorridor&&) noexcept = delete;
+		Scene_MirrorCorridor& operator=(const Scene_MirrorCorridor&) = delete;
+		Scene_MirrorCorridor& operator=(Scene_MirrorCorridor&&) noexcept = delete;
+
+		void Initialize() override;
+	};
+
+	// Every built-in scene by name, for the headless modes (regression, distributed rendering)
+	struct SceneEntry
+	{
+		const char* name{};
+		std::function<Scene*()> create{};
 	};
 
+	const std::vector<SceneEntry>& GetBuiltInScenes();
+	// nullptr for unknown names
+	Scene* CreateScene(const std::string& name);
 }
@@ -0,0 +1,144 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dae
+{
+	// Stable reference to an object in a SlotMap<T>
+	// The generation goes up every time a slot is reused, so handles to removed objects stay detectably invalid
+	template<typename T>
+	struct Handle
+	{
+		uint32_t index{ UINT32_MAX };
+		uint32_t generation{};
+
+		bool IsNull() const { return index == UINT32_MAX; }
+		bool operator==(const Handle& other) const = default;
+	};
+
+	/**
+	 * \brief Dense object storage with O(1) add, remove & lookup through generational handles
+	 * Objects live contiguously (iterate GetData() in the hot loops), removal moves the last object into the hole
+	 * Pointers from Get are only valid until the next Add/Remove, keep the handle instead
+	 */
+	template<typename T>
+	class SlotMap
+	{
+	public:
+		using HandleType = Handle<T>;
+
+		void Reserve(size_t capacity)
+		{
+			m_Data.reserve(capacity);
+			m_DataToSlot.reserve(capacity);
+			m_Slots.reserve(capacity);
+		}
+
+		template<typename... Args>
+		HandleType Emplace(Args&&... args)
+		{
+			uint32_t slotIndex{};
+			if (m_FreeHead != UINT32_MAX)
+			{
+				// Reuse a free slot, its dataIndex holds the next free slot
+				slotIndex = m_FreeHead;
+				m_FreeHead = m_Slots[slotIndex].dataIndex;
+			}
+			else
+			{
+				slotIndex = static_cast<uint32_t>(m_Slots.size());
+				m_Slots.emplace_back();
+			}
+
+			Slot& slot{ m_Slots[slotIndex] };
+			slot.dataIndex = static_cast<uint32_t>(m_Data.size());
+			m_Data.emplace_back(std::forward<Args>(args)...);
+			m_DataToSlot.push_back(slotIndex);
+
+			return { slotIndex, slot.generation };
+		}
+
+		HandleType Add(const T& object) { return Emplace(object); }
+		HandleType Add(T&& object) { return Emplace(std::move(object)); }
+
+		bool Remove(HandleType handle)
+		{
+			if (!Contains(handle))
+				return false;
+
+			Slot& slot{ m_Slots[handle.index] };
+			const uint32_t dataIndex{ slot.dataIndex };
+			const uint32_t lastIndex{ static_cast<uint32_t>(m_Data.size() - 1) };
+
+			// Swap & pop keeps the data dense
+			if (dataIndex != lastIndex)
+			{
+				m_Data[dataIndex] = std::move(m_Data[lastIndex]);
+				m_DataToSlot[dataIndex] = m_DataToSlot[lastIndex];
+				m_Slots[m_DataToSlot[dataIndex]].dataIndex = dataIndex;
+			}
+			m_Data.pop_back();
+			m_DataToSlot.pop_back();
+
+			++slot.generation;
+			slot.dataIndex = m_FreeHead;
+			m_FreeHead = handle.index;
+			return true;
+		}
+
+		bool Contains(HandleType handle) const
+		{
+			return handle.index < m_Slots.size() && m_Slots[handle.index].generation == handle.generation;
+		}
+
+		// nullptr for stale or null handles
+		T* Get(HandleType handle)
+		{
+			return Contains(handle) ? &m_Data[m_Slots[handle.index].dataIndex] : nullptr;
+		}
+
+		const T* Get(HandleType handle) const
+		{
+			return Contains(handle) ? &m_Data[m_Slots[handle.index].dataIndex] : nullptr;
+		}
+
+		void Clear()
+		{
+			// Bump every live slot so all outstanding handles go stale, then chain them all into the free list
+			for (uint32_t slotIndex : m_DataToSlot)
+				++m_Slots[slotIndex].generation;
+			for (uint32_t slotIndex{}; slotIndex < m_Slots.size(); ++slotIndex)
+				m_Slots[slotIndex].dataIndex = slotIndex + 1 < m_Slots.size() ? slotIndex + 1 : UINT32_MAX;
+			m_FreeHead = m_Slots.empty() ? UINT32_MAX : 0;
+
+			m_Data.clear();
+			m_DataToSlot.clear();
+		}
+
+		size_t Size() const { return m_Data.size(); }
+		bool Empty() const { return m_Data.empty(); }
+
+		std::vector<T>& GetData() { return m_Data; }
+		const std::vector<T>& GetData() const { return m_Data; }
+
+		typename std::vector<T>::iterator begin() { return m_Data.begin(); }
+		typename std::vector<T>::iterator end() { return m_Data.end(); }
+		typename std::vector<T>::const_iterator begin() const { return m_Data.begin(); }
+		typename std::vector<T>::const_iterator end() const { return m_Data.end(); }
+
+	private:
+		struct Slot
+		{
+			// Index into m_Data while alive, next free slot while free
+			uint32_t dataIndex{};
+			uint32_t generation{};
+		};
+
+		std::vector<T> m_Data{};
+		std::vector<uint32_t> m_DataToSlot{};
+		std::vector<Slot> m_Slots{};
+		uint32_t m_FreeHead{ UINT32_MAX };
+	};
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	// How a scene finds sphere hits
+	enum class SphereAcceleration
+	{
+		Linear, // Test every sphere, best for a handful of big ones
+		UniformGrid // SphereGrid, for dense fields of many small, similar sized spheres
+	};
+
+	/**
+	 * \brief Uniform grid over a set of spheres, each cell lists the spheres whose bounding box overlaps it
+	 * Built from scratch every time (O(n), counting sort in parallel), so moving spheres need no refitting
+	 * Traversed with a 3D-DDA, stops at the first cell that contains a hit closer than the cell's exit
+	 */
+	class SphereGrid final
+	{
+	public:
+		// Spheres can be reordered or moved between builds, but the indices stored in the cells point into this exact vector
+		void Build(const std::vector<Sphere>& spheres);
+
+		// Fills in the sphere's index in spheres, see Scene::GetClosestHit
+		bool GetClosestHit(const std::vector<Sphere>& spheres, const Ray& ray, HitCandidate& hit) const;
+		bool DoesHit(const std::vector<Sphere>& spheres, const Ray& ray) const;
+
+		uint32_t GetCellCount() const { return m_Resolution[0] * m_Resolution[1] * m_Resolution[2]; }
+		// Sphere references over all cells, divide by the sphere count for the average duplication
+		size_t GetReferenceCount() const { return m_SphereIndices.size(); }
+
+	private:
+		// Calls visitCell(firstIndex, lastIndex, cellExitT) front to back until it returns true
+		template<typename VisitCell>
+		bool Traverse(const Ray& ray, VisitCell&& visitCell) const;
+
+		void GetCellRange(const Sphere& sphere, int cellMin[3], int cellMax[3]) const;
+
+		Vector3 m_Min{};
+		Vector3 m_Max{};
+		Vector3 m_CellSize{};
+		Vector3 m_InvCellSize{};
+		uint32_t m_Resolution[3]{};
+
+		// Cell c owns m_SphereIndices[m_CellStart[c], m_CellStart[c + 1])
+		std::vector<uint32_t> m_CellStart{};
+		std::vector<uint32_t> m_SphereIndices{};
+		// Reused between builds, so a steady state rebuild doesn't allocate
+		std::vector<uint32_t> m_WriteCursor{};
+	};
+}
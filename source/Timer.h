@@ -24,6 +24,9 @@ namespace dae
 		void Update();
 		void Stop();
 
+		// Drives the timer by hand instead of by the clock, offline renders get the same state for the same frame every run
+		void SetTime(float totalTime, float elapsedTime) { m_TotalTime = totalTime; m_ElapsedTime = elapsedTime; }
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
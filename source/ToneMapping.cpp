@@ -0,0 +1,174 @@
+#include "ToneMapping.h"
+
+#include <array>
+#include <cassert>
+#include <ppl.h>
+
+#include "SDL_pixels.h"
+
+namespace dae
+{
+	namespace
+	{
+		// Linear > sRGB lookup table, sampled over [0, 1], avoids a powf per channel
+		constexpr int sRGBTableSize{ 4096 };
+
+		const std::array<float, sRGBTableSize>& GetSRGBTable()
+		{
+			static const std::array<float, sRGBTableSize> table = []
+				{
+					std::array<float, sRGBTableSize> result{};
+					for (int i{}; i < sRGBTableSize; ++i)
+					{
+						const float linear{ i / float(sRGBTableSize - 1) };
+						result[i] = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+					}
+					return result;
+				}();
+			return table;
+		}
+
+		// 4x4 Bayer matrix thresholds
+		constexpr float BayerMatrix[4][4]
+		{
+			{ 0.f, 8.f, 2.f, 10.f },
+			{ 12.f, 4.f, 14.f, 6.f },
+			{ 3.f, 11.f, 1.f, 9.f },
+			{ 15.f, 7.f, 13.f, 5.f }
+		};
+
+		// Offset in [-0.5, 0.5] of one 8-bit step
+		constexpr float GetDitherOffset(int x, int y)
+		{
+			return (BayerMatrix[y & 3][x & 3] + 0.5f) / 16.f - 0.5f;
+		}
+
+		template<ToneMappingOperator toneMapping>
+		__m128 ApplyToneMapping(__m128 c)
+		{
+			const __m128 one{ simd::Splat(1.f) };
+			if constexpr (toneMapping == ToneMappingOperator::MaxToOne)
+			{
+				const __m128 maxValue{ _mm_max_ps(_mm_max_ps(
+					_mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)),
+					_mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))),
+					_mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))) };
+				return _mm_div_ps(c, _mm_max_ps(maxValue, one));
+			}
+			else if constexpr (toneMapping == ToneMappingOperator::Reinhard)
+			{
+				return _mm_div_ps(c, _mm_add_ps(c, one));
+			}
+			else
+			{
+				// (c * (2.51c + 0.03)) / (c * (2.43c + 0.59) + 0.14)
+				const __m128 numerator{ _mm_mul_ps(c, simd::MulAdd(c, simd::Splat(2.51f), simd::Splat(0.03f))) };
+				const __m128 denominator{ simd::MulAdd(c, simd::MulAdd(c, simd::Splat(2.43f), simd::Splat(0.59f)), simd::Splat(0.14f)) };
+				return _mm_min_ps(_mm_div_ps(numerator, denominator), one);
+			}
+		}
+
+		struct PixelPacking
+		{
+			uint32_t rShift{};
+			uint32_t gShift{};
+			uint32_t bShift{};
+			uint32_t aMask{};
+		};
+
+		template<ToneMappingOperator toneMapping, bool sRGBEncoding, bool dithering>
+		void ResolveRow(const ColorRGB* pSource, uint32_t* pDestination, int width, int y, float exposure, const PixelPacking& packing)
+		{
+			const __m128 exposureScale{ simd::Splat(exposure) };
+			const __m128 zero{ _mm_setzero_ps() };
+			const __m128 one{ simd::Splat(1.f) };
+			const __m128 maxValue{ simd::Splat(255.f) };
+			const __m128 tableScale{ simd::Splat(float(sRGBTableSize - 1)) };
+			const float* pSRGBTable{ GetSRGBTable().data() };
+
+			for (int x{}; x < width; ++x)
+			{
+				const __m128 linear{ _mm_max_ps(_mm_mul_ps(pSource[x].Load(), exposureScale), zero) };
+				const __m128 c{ _mm_min_ps(ApplyToneMapping<toneMapping>(linear), one) };
+
+				__m128 encoded{ c };
+				if constexpr (sRGBEncoding)
+				{
+					alignas(16) int32_t indices[4];
+					_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(c, tableScale)));
+					encoded = _mm_setr_ps(pSRGBTable[indices[0]], pSRGBTable[indices[1]], pSRGBTable[indices[2]], 0.f);
+				}
+
+				__m128 scaled{ _mm_mul_ps(encoded, maxValue) };
+				if constexpr (dithering)
+					scaled = _mm_add_ps(scaled, simd::Splat(GetDitherOffset(x, y)));
+
+				// Round, then saturate to [0, 255] while packing down to bytes: r | g << 8 | b << 16
+				__m128i packed{ _mm_cvtps_epi32(scaled) };
+				packed = _mm_packs_epi32(packed, packed);
+				packed = _mm_packus_epi16(packed, packed);
+				const uint32_t rgb{ static_cast<uint32_t>(_mm_cvtsi128_si32(packed)) };
+
+				pDestination[x] = ((rgb & 0xFF) << packing.rShift)
+					| (((rgb >> 8) & 0xFF) << packing.gShift)
+					| (((rgb >> 16) & 0xFF) << packing.bShift)
+					| packing.aMask;
+			}
+		}
+
+		using ResolveRowFunc = void(*)(const ColorRGB*, uint32_t*, int, int, float, const PixelPacking&);
+
+		template<ToneMappingOperator toneMapping>
+		constexpr ResolveRowFunc ResolveRowKernels[2][2]
+		{
+			{ &ResolveRow<toneMapping, false, false>, &ResolveRow<toneMapping, false, true> },
+			{ &ResolveRow<toneMapping, true, false>, &ResolveRow<toneMapping, true, true> }
+		};
+	}
+
+	void ToneMapping::Resolve(const ColorRGB* pSource, uint32_t* pDestination, int width, int height,
+		const SDL_PixelFormat* pFormat, const ToneMappingSettings& settings)
+	{
+		// Only 32-bit formats with 8-bit channels are supported (all window surfaces we get)
+		assert(pFormat->BytesPerPixel == 4);
+		const PixelPacking packing{ pFormat->Rshift, pFormat->Gshift, pFormat->Bshift, pFormat->Amask };
+
+		// Select the specialized kernel once for the whole pass
+		ResolveRowFunc resolveRow{};
+		switch (settings.toneMapping)
+		{
+		default:
+		case ToneMappingOperator::MaxToOne:
+			resolveRow = ResolveRowKernels<ToneMappingOperator::MaxToOne>[settings.sRGBEncoding][settings.dithering];
+			break;
+		case ToneMappingOperator::Reinhard:
+			resolveRow = ResolveRowKernels<ToneMappingOperator::Reinhard>[settings.sRGBEncoding][settings.dithering];
+			break;
+		case ToneMappingOperator::ACES:
+			resolveRow = ResolveRowKernels<ToneMappingOperator::ACES>[settings.sRGBEncoding][settings.dithering];
+			break;
+		}
+
+		const float exposure{ settings.exposure };
+		concurrency::parallel_for(0, height,
+			[=, &packing](int y)
+			{
+				resolveRow(pSource + y * width, pDestination + y * width, width, y, exposure, packing);
+			});
+	}
+
+	const char* ToneMapping::GetName(ToneMappingOperator toneMapping)
+	{
+		switch (toneMapping)
+		{
+		case ToneMappingOperator::MaxToOne:
+			return "MaxToOne";
+		case ToneMappingOperator::Reinhard:
+			return "Reinhard";
+		case ToneMappingOperator::ACES:
+			return "ACES";
+		default:
+			return "Unknown";
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+
+#include "Math.h"
+
+struct SDL_PixelFormat;
+
+namespace dae
+{
+	enum class ToneMappingOperator
+	{
+		MaxToOne, // Scale down so the brightest channel is 1 (the original behaviour)
+		Reinhard, // c / (1 + c)
+		ACES // Narkowicz' fit of the ACES filmic curve
+	};
+
+	struct ToneMappingSettings
+	{
+		ToneMappingOperator toneMapping{ ToneMappingOperator::MaxToOne };
+		float exposure{ 1.f };
+		bool sRGBEncoding{ false };
+		bool dithering{ true };
+	};
+
+	namespace ToneMapping
+	{
+		/**
+		 * \brief Post pass that turns the linear HDR framebuffer into packed 8-bit pixels
+		 * \param pSource Linear float colors, width * height pixels
+		 * \param pDestination 32-bit pixels in the given pixel format
+		 * \param pFormat Destination pixel format, only the channel shifts & alpha mask are used
+		 */
+		void Resolve(const ColorRGB* pSource, uint32_t* pDestination, int width, int height,
+			const SDL_PixelFormat* pFormat, const ToneMappingSettings& settings);
+
+		const char* GetName(ToneMappingOperator toneMapping);
+	}
+}
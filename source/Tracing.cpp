@@ -0,0 +1,144 @@
+#include "Tracing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	namespace
+	{
+		struct TraceEvent
+		{
+			const char* pName{};
+			uint64_t start{};
+			uint64_t end{};
+		};
+
+		// Single writer ring buffer, only the owning thread writes, Start & Stop wait until it's out of Record
+		// When a recording outgrows it the oldest events are overwritten
+		struct ThreadBuffer
+		{
+			static constexpr uint64_t capacity{ 1 << 14 };
+
+			TraceEvent events[capacity]{};
+			std::atomic<uint64_t> head{};
+			std::atomic<bool> isWriting{};
+			uint32_t threadId{};
+			std::string name{};
+		};
+
+		// Buffers are only added on a thread's first event, so this lock is never on the hot path
+		std::mutex g_BuffersMutex{};
+		std::vector<std::unique_ptr<ThreadBuffer>> g_Buffers{};
+
+		const std::chrono::steady_clock::time_point g_Epoch{ std::chrono::steady_clock::now() };
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			static thread_local ThreadBuffer* pBuffer{ nullptr };
+			if (!pBuffer)
+			{
+				std::lock_guard<std::mutex> lock{ g_BuffersMutex };
+				std::unique_ptr<ThreadBuffer>& buffer{ g_Buffers.emplace_back(std::make_unique<ThreadBuffer>()) };
+				buffer->threadId = static_cast<uint32_t>(g_Buffers.size());
+				buffer->name = "Worker " + std::to_string(buffer->threadId);
+				pBuffer = buffer.get();
+			}
+			return *pBuffer;
+		}
+
+		// Call with g_BuffersMutex held & recording off, afterwards no thread touches its buffer until the next Start
+		void WaitForWriters()
+		{
+			for (const std::unique_ptr<ThreadBuffer>& buffer : g_Buffers)
+			{
+				while (buffer->isWriting.load())
+					std::this_thread::yield();
+			}
+		}
+	}
+
+	std::atomic<bool> Tracing::Detail::g_IsRecording{ false };
+
+	uint64_t Tracing::Detail::Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_Epoch).count();
+	}
+
+	void Tracing::Detail::Record(const char* pName, uint64_t start, uint64_t end)
+	{
+		ThreadBuffer& buffer{ GetThreadBuffer() };
+
+		// Flag first, then check the recording again: once Stop has seen the flag down it knows this thread
+		// either finished its write or will see the recording is over, a scope that outlives Stop is dropped
+		buffer.isWriting.store(true);
+		if (g_IsRecording.load())
+		{
+			const uint64_t head{ buffer.head.load(std::memory_order_relaxed) };
+			buffer.events[head % ThreadBuffer::capacity] = { pName, start, end };
+			buffer.head.store(head + 1, std::memory_order_release);
+		}
+		buffer.isWriting.store(false, std::memory_order_release);
+	}
+
+	void Tracing::Start()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ g_BuffersMutex };
+			// Still off, a thread that's in Record from the last recording is finishing its event
+			WaitForWriters();
+			for (const std::unique_ptr<ThreadBuffer>& buffer : g_Buffers)
+				buffer->head.store(0, std::memory_order_relaxed);
+		}
+		Detail::g_IsRecording.store(true);
+	}
+
+	bool Tracing::Stop(const std::string& fileName)
+	{
+		Detail::g_IsRecording.store(false);
+
+		std::lock_guard<std::mutex> lock{ g_BuffersMutex };
+		// Other threads (workers, the image writer) can still be closing scopes, nothing gets added after this
+		WaitForWriters();
+
+		std::ofstream file(fileName);
+		if (!file)
+			return false;
+
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		bool isFirst{ true };
+		for (const std::unique_ptr<ThreadBuffer>& buffer : g_Buffers)
+		{
+			const uint64_t head{ buffer->head.load(std::memory_order_acquire) };
+			if (head == 0)
+				continue;
+
+			file << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"args\":{\"name\":\"" << buffer->name << "\"}}";
+			isFirst = false;
+
+			// Complete events ("X") with timestamps & durations in microseconds
+			const uint64_t count{ std::min(head, ThreadBuffer::capacity) };
+			for (uint64_t i{ head - count }; i < head; ++i)
+			{
+				const TraceEvent& event{ buffer->events[i % ThreadBuffer::capacity] };
+				file << ",\n{\"name\":\"" << event.pName << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+			}
+		}
+		file << "\n]}\n";
+		return file.good();
+	}
+
+	void Tracing::SetThreadName(const char* pName)
+	{
+		GetThreadBuffer().name = pName;
+	}
+}
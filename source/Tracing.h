@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timing events, written as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev)
+// Comment out to compile every TRACE_SCOPE away, when compiled in but not recording a scope costs one relaxed load
+#define TRACE_EVENTS
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#if defined(TRACE_EVENTS)
+// Name has to be a string literal (or otherwise outlive the recording), only the pointer is stored
+#define TRACE_SCOPE(name) const dae::Tracing::Scope TRACE_CONCAT(traceScope, __LINE__){ name }
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+namespace dae
+{
+	namespace Tracing
+	{
+		namespace Detail
+		{
+			extern std::atomic<bool> g_IsRecording;
+			uint64_t Now();
+			void Record(const char* pName, uint64_t start, uint64_t end);
+		}
+
+		inline bool IsRecording() { return Detail::g_IsRecording.load(std::memory_order_relaxed); }
+
+		// Clears every thread's buffer & starts recording
+		void Start();
+		// Stops recording & writes the JSON file, safe while other threads are still in a scope, those events are dropped
+		bool Stop(const std::string& fileName);
+
+		// Shows up as the thread's name in the viewer, other threads are called Worker N
+		void SetThreadName(const char* pName);
+
+		class Scope final
+		{
+		public:
+			explicit Scope(const char* pName) :
+				m_pName(IsRecording() ? pName : nullptr),
+				m_Start(m_pName ? Detail::Now() : 0)
+			{
+			}
+
+			~Scope()
+			{
+				if (m_pName)
+					Detail::Record(m_pName, m_Start, Detail::Now());
+			}
+
+			Scope(const Scope&) = delete;
+			Scope(Scope&&) noexcept = delete;
+			Scope& operator=(const Scope&) = delete;
+			Scope& operator=(Scope&&) noexcept = delete;
+
+		private:
+			const char* m_pName{};
+			uint64_t m_Start{};
+		};
+	}
+}
@@ -3,310 +3,348 @@
 #include <fstream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "RayStats.h"
 #include <iostream>
 
-#define MOLLER_TRUMBORE
-//#define OPTIMIZED_PLANE
-
-//#define ANALYTIC  // Use analytic sphere collision, else geometric
-
 namespace dae
 {
+	// Intersection algorithms, all compiled in & picked at runtime (used to be #defines)
+	enum class SphereIntersection
+	{
+		Geometric,
+		Analytic
+	};
+
+	enum class PlaneIntersection
+	{
+		Default, // Only hits from the front side of the plane
+		Optimized // Double sided, bails on parallel rays first
+	};
+
+	enum class TriangleIntersection
+	{
+		MollerTrumbore,
+		EdgeFunction // Plane intersection + inside test against the 3 edges
+	};
+
+	struct IntersectionVariants
+	{
+		SphereIntersection sphere{ SphereIntersection::Geometric };
+		PlaneIntersection plane{ PlaneIntersection::Default };
+		TriangleIntersection triangle{ TriangleIntersection::MollerTrumbore };
+	};
+
 	namespace GeometryUtils
 	{
+		// Variants the non-template hit tests dispatch to, set it before rendering starts (it's not synchronized)
+		inline IntersectionVariants g_IntersectionVariants{};
+
 #pragma region Sphere HitTest
 		//SPHERE HIT-TESTS
-		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		// Closest hit queries only fill in t & the type, the caller stamps the index & ResolveHit does the rest for the final hit
+		template<SphereIntersection variant>
+		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
 		{
-
-#ifdef ANALYTIC
+			if constexpr (variant == SphereIntersection::Analytic)
+			{
 #pragma region Analytic
 
-			Vector3 L = sphere.origin - ray.origin;
-			float tca = Vector3::Dot(L, ray.direction);
+				Vector3 L = sphere.origin - ray.origin;
+				float tca = Vector3::Dot(L, ray.direction);
 
-			//if (tca < 0) 
-			//	return false;
+				//if (tca < 0) 
+				//	return false;
 			
-			float d2 = tca * tca - Vector3::Dot(L, L) + sphere.radius * sphere.radius;
+				float d2 = tca * tca - Vector3::Dot(L, L) + sphere.radius * sphere.radius;
 			
-			if (d2 < 0.0f)
-				return false;
+				if (d2 < 0.0f)
+					return false;
 			
 
-			const float thc = sqrtf(d2);
-			const float t0 = tca - thc;
+				const float thc = sqrtf(d2);
+				const float t0 = tca - thc;
 
-			if (t0 > ray.min && t0 < ray.max)
-			{
-				if (ignoreHitRecord)
-					return true;
+				if (t0 > ray.min && t0 < ray.max)
+				{
+					if (ignoreHitRecord)
+						return true;
 
-				hitRecord.didHit = true;
-				hitRecord.materialIndex = sphere.materialIndex;
-				hitRecord.t = t0;
-				hitRecord.origin = ray.origin + (ray.direction * hitRecord.t);
-				hitRecord.normal = (hitRecord.origin - sphere.origin) / sphere.radius;
-				return true;
-			}
-			return false;
+					hit.t = t0;
+					hit.type = PrimitiveType::Sphere;
+					return true;
+				}
+				return false;
 			
 			
 #pragma endregion
-#else
+			}
+			else
+			{
 #pragma region Geometric
-			//Vector from ray origin to center of sphere
-			const Vector3 tc{ sphere.origin - ray.origin };   // Vector TC  (T is start, C is center of sphere)
+				//Vector from ray origin to center of sphere
+				const Vector3 tc{ sphere.origin - ray.origin };   // Vector TC  (T is start, C is center of sphere)
 
-			//Vector3 a{ Vector3::Dot(ray.direction, ray.direction) };
-			const float dp{ Vector3::Dot(tc, ray.direction) };  // Vector TP  (P is perpendicular to the raycast, and goes to C)
-			const float odSqr{ tc.SqrMagnitude() - (dp* dp) };  // Power of length between P & C
-			if (odSqr > (sphere.radius * sphere.radius))
-			{
-				// Optimization, if odSqr is larger than radius square, it's a miss.
-				return false;
-			}
-			const float tca{ sqrtf((sphere.radius * sphere.radius) - odSqr) };  // Distance I1 P
-			const float ti1{ dp - tca };  // Distance from origin to Intersection Point 1
+				//Vector3 a{ Vector3::Dot(ray.direction, ray.direction) };
+				const float dp{ Vector3::Dot(tc, ray.direction) };  // Vector TP  (P is perpendicular to the raycast, and goes to C)
+				const float odSqr{ tc.SqrMagnitude() - (dp* dp) };  // Power of length between P & C
+				if (odSqr > (sphere.radius * sphere.radius))
+				{
+					// Optimization, if odSqr is larger than radius square, it's a miss.
+					return false;
+				}
+				const float tca{ sqrtf((sphere.radius * sphere.radius) - odSqr) };  // Distance I1 P
+				const float ti1{ dp - tca };  // Distance from origin to Intersection Point 1
 
 
-			if (ti1 >= ray.min && ti1 <= ray.max)
-			{
-				if (ignoreHitRecord) return true;
-
-				const Vector3 pointI1{ ray.origin + ray.direction * ti1 };  // Point I1
-				hitRecord.didHit = true;
-				hitRecord.materialIndex = sphere.materialIndex;
-				hitRecord.origin = pointI1;
-				hitRecord.normal = (pointI1 - sphere.origin) / sphere.radius;
-				hitRecord.t = ti1;
-				return true;
-			}
-			return false;
+				if (ti1 >= ray.min && ti1 <= ray.max)
+				{
+					if (ignoreHitRecord) return true;
+
+					hit.t = ti1;
+					hit.type = PrimitiveType::Sphere;
+					return true;
+				}
+				return false;
 #pragma endregion
-#endif // ANALYTIC
+			}
+		}
+
+		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
+		{
+			if (g_IntersectionVariants.sphere == SphereIntersection::Analytic)
+				return HitTest_Sphere<SphereIntersection::Analytic>(sphere, ray, hit, ignoreHitRecord);
+			return HitTest_Sphere<SphereIntersection::Geometric>(sphere, ray, hit, ignoreHitRecord);
 		}
 
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray)
 		{
-			HitRecord temp{};
+			HitCandidate temp{};
 			return HitTest_Sphere(sphere, ray, temp, true);
 		}
 #pragma endregion
 #pragma region Plane HitTest
 		//PLANE HIT-TESTS
-		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		template<PlaneIntersection variant>
+		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
 		{
-//#ifdef OPTIMIZED_PLANE
-			//const float denominator{ Vector3::Dot(plane.normal, ray.direction) };
-
-			//if (abs(denominator) > FLT_EPSILON)
-			//{
-			//	Vector3 rayOriginToPlaneOrigin{plane.origin - ray.origin };
-			//	const float t{ Vector3::Dot(rayOriginToPlaneOrigin, plane.normal) / denominator};
-
-			//	// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
-			//	if (t >= ray.min && t <= ray.max)
-			//	{
-			//		// We can calculate where point P is, by multiplying the direction, with the distance (t) found earlier.
-			//		// Add that to the ray's origin to find P
-			//		if (ignoreHitRecord) 
-			//			return true;
-
-			//		hitRecord.didHit = true;
-			//		hitRecord.materialIndex = plane.materialIndex;
-			//		hitRecord.normal = plane.normal;
-			//		hitRecord.origin = ray.origin + (t * ray.direction);
-			//		hitRecord.t = t;
-			//		return true;
-
-			//	}
-			//}
-			//return false;
-//#else
-			const float rayDotNormal{ Vector3::Dot((plane.origin - ray.origin), plane.normal) };
-
-			if (rayDotNormal > 0.0f)
-				return false;
+			if constexpr (variant == PlaneIntersection::Optimized)
+			{
+				const float denominator{ Vector3::Dot(plane.normal, ray.direction) };
+
+				if (abs(denominator) > FLT_EPSILON)
+				{
+					Vector3 rayOriginToPlaneOrigin{plane.origin - ray.origin };
+					const float t{ Vector3::Dot(rayOriginToPlaneOrigin, plane.normal) / denominator};
 
-			const float t{ rayDotNormal / Vector3::Dot(ray.direction, plane.normal) };
+					// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
+					if (t >= ray.min && t <= ray.max)
+					{
+						if (ignoreHitRecord) 
+							return true;
+
+						hit.t = t;
+						hit.type = PrimitiveType::Plane;
+						return true;
 
-			// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
-			if ((t >= ray.min) && (t <= ray.max))
+					}
+				}
+				return false;
+			}
+			else
 			{
-				// We can calculate where point P is, by multiplying the direction, with the distance (t) found earlier.
-				// Add that to the ray's origin to find P
-				if (ignoreHitRecord) return true;
-				hitRecord.didHit = true;
-				hitRecord.materialIndex = plane.materialIndex;
-				hitRecord.normal = plane.normal;
-				hitRecord.origin = ray.origin + (t * ray.direction);
-				hitRecord.t = t;
-				return true;
+				const float rayDotNormal{ Vector3::Dot((plane.origin - ray.origin), plane.normal) };
+
+				if (rayDotNormal > 0.0f)
+					return false;
+
+				const float t{ rayDotNormal / Vector3::Dot(ray.direction, plane.normal) };
 
+				// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
+				if ((t >= ray.min) && (t <= ray.max))
+				{
+					if (ignoreHitRecord) return true;
+					hit.t = t;
+					hit.type = PrimitiveType::Plane;
+					return true;
+
+				}
+				return false;
 			}
-			return false;
-//#endif
+		}
+
+		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
+		{
+			if (g_IntersectionVariants.plane == PlaneIntersection::Optimized)
+				return HitTest_Plane<PlaneIntersection::Optimized>(plane, ray, hit, ignoreHitRecord);
+			return HitTest_Plane<PlaneIntersection::Default>(plane, ray, hit, ignoreHitRecord);
 		}
 
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray)
 		{
-			HitRecord temp{};
+			HitCandidate temp{};
 			return HitTest_Plane(plane, ray, temp, true);
 		}
 #pragma endregion
 #pragma region Triangle HitTest
 		//TRIANGLE HIT-TESTS
-		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		// Algorithm, cull mode & query type (closest hit vs any hit) are template parameters so the checks compile away,
+		// use HitTest_TriangleMesh (or the non-template overload below) to pick the right specialization at runtime
+		template<TriangleIntersection variant, TriangleCullMode cullMode, bool ignoreHitRecord>
+		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitCandidate& hit)
 		{
-#ifdef MOLLER_TRUMBORE
-			// MllerTrumbore intersection algorithm
-			const Vector3 edge1{ triangle.v1 - triangle.v0 };
-			const Vector3 edge2{ triangle.v2 - triangle.v0 };
-			
-			const Vector3 h{ Vector3::Cross(ray.direction, edge2) };
-			const float a{ Vector3::Dot(edge1, h) };
+			// Shadow rays (ignoreHitRecord true) have inverted culling
+			constexpr bool cullBackFaces{ ignoreHitRecord ? cullMode == TriangleCullMode::FrontFaceCulling : cullMode == TriangleCullMode::BackFaceCulling };
+			constexpr bool cullFrontFaces{ ignoreHitRecord ? cullMode == TriangleCullMode::BackFaceCulling : cullMode == TriangleCullMode::FrontFaceCulling };
 
-			if (a < -FLT_EPSILON)
-			{
-				// Backface hit
-				if (!ignoreHitRecord && triangle.cullMode == TriangleCullMode::BackFaceCulling)
-					// Remove the face if it's "culled" away
-					return false;
-				if (ignoreHitRecord && triangle.cullMode == TriangleCullMode::FrontFaceCulling)
-					// Shadow rays (ignorehitrecord true) have inverted culling
-					return false;
-			}
-			else if (a > FLT_EPSILON)
-			{
-				// Frontface hit
-				if (!ignoreHitRecord && triangle.cullMode == TriangleCullMode::FrontFaceCulling)
-					// Remove the face if it's "culled" away
-					return false;
-				if (ignoreHitRecord && triangle.cullMode == TriangleCullMode::BackFaceCulling)
-					// Shadow rays (ignorehitrecord true) have inverted culling
-					return false;
-			}
-			else
+			if constexpr (variant == TriangleIntersection::MollerTrumbore)
 			{
-				return false;
-			}
+				// MllerTrumbore intersection algorithm
+				const Vector3 edge1{ triangle.v1 - triangle.v0 };
+				const Vector3 edge2{ triangle.v2 - triangle.v0 };
+			
+				const Vector3 h{ Vector3::Cross(ray.direction, edge2) };
+				const float a{ Vector3::Dot(edge1, h) };
 
-			const float f{ 1.0f / a };
-			const Vector3 s{ ray.origin - triangle.v0 };
-			const float u{ f * Vector3::Dot(s, h) };
+				// a < 0 is a backface hit, a > 0 a frontface hit, (close to) 0 means the ray is parallel to the triangle
+				if constexpr (cullBackFaces)
+				{
+					if (a <= FLT_EPSILON)
+						return false;
+				}
+				else if constexpr (cullFrontFaces)
+				{
+					if (a >= -FLT_EPSILON)
+						return false;
+				}
+				else
+				{
+					if (abs(a) <= FLT_EPSILON)
+						return false;
+				}
 
-			if (u < 0.0f || u > 1.0f)
-				return false;
+				const float f{ 1.0f / a };
+				const Vector3 s{ ray.origin - triangle.v0 };
+				const float u{ f * Vector3::Dot(s, h) };
 
-			const Vector3 q{ Vector3::Cross(s, edge1) };
-			const float v{ f * Vector3::Dot(ray.direction, q) };
+				if (u < 0.0f || u > 1.0f)
+					return false;
 
-			if (v < 0.0f || u + v > 1.0f)
-				return false;
+				const Vector3 q{ Vector3::Cross(s, edge1) };
+				const float v{ f * Vector3::Dot(ray.direction, q) };
 
-			const float t{ f * Vector3::Dot(edge2, q) };
-			if (t > ray.min && t < ray.max)
-			{
-				if (ignoreHitRecord) return true;
-				hitRecord.didHit = true;
-				hitRecord.materialIndex = triangle.materialIndex;
-				hitRecord.origin = ray.origin + (ray.direction * t);
-				hitRecord.normal = triangle.normal;
-				hitRecord.t = t;
-				return true;
-			}
-			return false;
-#else
-			// Clockwise all edges of the triangle
-			const Vector3 edgeA{ triangle.v1 - triangle.v0 };
-			const Vector3 edgeB{ triangle.v2 - triangle.v1 };
-			const Vector3 edgeC{ triangle.v0 - triangle.v2 };
-
-			// Cross the 2 edges to get the normal of the triangle
-			const Vector3 normal{ triangle.normal };
-
-			// Check if the ray is parallel to the triangle
-			const float NdotV{ Vector3::Dot(ray.direction, normal) };
-			if (NdotV == 0)
-			{
-				return false;  // If the ray faces away from the plane of the triangle, it won't ever hit
-			}
-			else if (NdotV > 0)
-			{
-				// BACK FACE towards us
-				if (!ignoreHitRecord && triangle.cullMode == TriangleCullMode::BackFaceCulling)
-				{
-					// Don't render the back face if we cull the back face (culling == strip/remove)
+				if (v < 0.0f || u + v > 1.0f)
 					return false;
-				}
-				else if (ignoreHitRecord && triangle.cullMode == TriangleCullMode::FrontFaceCulling)
+
+				const float t{ f * Vector3::Dot(edge2, q) };
+				if (t > ray.min && t < ray.max)
 				{
-					// Shadowrays are inverted so we invert the culling for shadowrays (ignorehitrecord true)
-					return false;
+					if constexpr (ignoreHitRecord) return true;
+					hit.t = t;
+					hit.u = u;
+					hit.v = v;
+					hit.type = PrimitiveType::Triangle;
+					return true;
 				}
+				return false;
 			}
 			else
 			{
-				// FRONT FACE towards us
-				if (!ignoreHitRecord && triangle.cullMode == TriangleCullMode::FrontFaceCulling)
+				// Clockwise all edges of the triangle
+				const Vector3 edgeA{ triangle.v1 - triangle.v0 };
+				const Vector3 edgeB{ triangle.v2 - triangle.v1 };
+				const Vector3 edgeC{ triangle.v0 - triangle.v2 };
+
+				// Cross the 2 edges to get the normal of the triangle
+				const Vector3 normal{ triangle.normal };
+
+				// Check if the ray is parallel to the triangle
+				const float NdotV{ Vector3::Dot(ray.direction, normal) };
+				if (NdotV == 0)
+					return false;  // If the ray faces away from the plane of the triangle, it won't ever hit
+
+				// NdotV > 0 means the BACK FACE is towards us, otherwise the FRONT FACE
+				if constexpr (cullBackFaces)
 				{
-					// Don't render the front face if we cull the front face
-					return false;
+					if (NdotV > 0)
+						return false;
 				}
-
-				if (ignoreHitRecord && triangle.cullMode == TriangleCullMode::BackFaceCulling)
+				else if constexpr (cullFrontFaces)
 				{
-					// If it's a shadow ray (ignorehitrecord true), we invert the culling
-					return false;
+					if (NdotV < 0)
+						return false;
 				}
-			}
 
 
-			// Average of the 3 points to get the center of the triangle
-			const Vector3 center{ (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f };
+				// Average of the 3 points to get the center of the triangle
+				const Vector3 center{ (triangle.v0 + triangle.v1 + triangle.v2) / 3.0f };
 
-			// Calculate distance hitPoint
-			const Vector3 l{ center - ray.origin };  // Point to the center of the 'plane'
-			const float t{ Vector3::Dot(l, normal) / NdotV };
+				// Calculate distance hitPoint
+				const Vector3 l{ center - ray.origin };  // Point to the center of the 'plane'
+				const float t{ Vector3::Dot(l, normal) / NdotV };
 
-			// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
-			if (t < ray.min || t > ray.max)
-				return false;  // T is out of bounds
+				// Check if T exceeds the boundaries set in the ray struct (tMin & tMax)
+				if (t < ray.min || t > ray.max)
+					return false;  // T is out of bounds
 
-			// We can calculate where point P is, by multiplying the direction, with the distance (t) found earlier.
-			// Add that to the ray's origin to find P
-			const Vector3 p{ ray.origin + (t * ray.direction) };  // Point on the plane
+				// We can calculate where point P is, by multiplying the direction, with the distance (t) found earlier.
+				// Add that to the ray's origin to find P
+				const Vector3 p{ ray.origin + (t * ray.direction) };  // Point on the plane
 
 
-			// Now we check wether the found point is inside or outside the triangle bounds
-			//const Vector3 pointToSide{ p - triangle.v0 };
+				// Now we check wether the found point is inside or outside the triangle bounds
+				// Each test is twice the area of the sub triangle across from a vertex, so they double as barycentrics
+				const float areaV2{ Vector3::Dot(normal, Vector3::Cross(edgeA, p - triangle.v0)) };
+				if (areaV2 < 0)
+					return false;  // Point is outside the triangle
 
-			if (Vector3::Dot(normal, Vector3::Cross(edgeA, p - triangle.v0)) < 0)
-				return false;  // Point is outside the triangle
+				const float areaV0{ Vector3::Dot(normal, Vector3::Cross(edgeB, p - triangle.v1)) };
+				if (areaV0 < 0)
+					return false;  // Point is outside the triangle
 
-			if (Vector3::Dot(normal, Vector3::Cross(edgeB, p - triangle.v1)) < 0)
-				return false;  // Point is outside the triangle
+				const float areaV1{ Vector3::Dot(normal, Vector3::Cross(edgeC, p - triangle.v2)) };
+				if (areaV1 < 0)
+					return false;  // Point is outside the triangle
 
-			if (Vector3::Dot(normal, Vector3::Cross(edgeC, p - triangle.v2)) < 0)
-				return false;  // Point is outside the triangle
+				if constexpr (ignoreHitRecord)
+					return true;
 
-			if (ignoreHitRecord)
+				const float invArea{ 1.f / (areaV0 + areaV1 + areaV2) };
+				hit.t = t;
+				hit.u = areaV1 * invArea;
+				hit.v = areaV2 * invArea;
+				hit.type = PrimitiveType::Triangle;
 				return true;
+			}
+		}
 
-			hitRecord.didHit = true;
-			hitRecord.materialIndex = triangle.materialIndex;
-			hitRecord.origin = p;
-			hitRecord.normal = normal;
-			hitRecord.t = t;
+		template<TriangleIntersection variant>
+		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord)
+		{
+			switch (triangle.cullMode)
+			{
+			case TriangleCullMode::FrontFaceCulling:
+				return ignoreHitRecord ? HitTest_Triangle<variant, TriangleCullMode::FrontFaceCulling, true>(triangle, ray, hit)
+					: HitTest_Triangle<variant, TriangleCullMode::FrontFaceCulling, false>(triangle, ray, hit);
+			case TriangleCullMode::BackFaceCulling:
+				return ignoreHitRecord ? HitTest_Triangle<variant, TriangleCullMode::BackFaceCulling, true>(triangle, ray, hit)
+					: HitTest_Triangle<variant, TriangleCullMode::BackFaceCulling, false>(triangle, ray, hit);
+			default:
+				return ignoreHitRecord ? HitTest_Triangle<variant, TriangleCullMode::NoCulling, true>(triangle, ray, hit)
+					: HitTest_Triangle<variant, TriangleCullMode::NoCulling, false>(triangle, ray, hit);
+			}
+		}
 
-			return true;
-#endif
+		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
+		{
+			// Runtime dispatch for single triangles, meshes pick their kernel once per mesh instead
+			if (g_IntersectionVariants.triangle == TriangleIntersection::EdgeFunction)
+				return HitTest_Triangle<TriangleIntersection::EdgeFunction>(triangle, ray, hit, ignoreHitRecord);
+			return HitTest_Triangle<TriangleIntersection::MollerTrumbore>(triangle, ray, hit, ignoreHitRecord);
 		}
 
 		inline bool HitTest_Triangle(const Triangle& triangle, const Ray& ray)
 		{
-			HitRecord temp{};
+			HitCandidate temp{};
 			return HitTest_Triangle(triangle, ray, temp, true);
 		}
 #pragma endregion
@@ -337,53 +375,301 @@ namespace dae
 
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		// Distance to where the ray enters the box, FLT_MAX on a miss or when the box starts beyond the closest hit so far
+		inline float SlabTest_AABB(const Vector3& minAABB, const Vector3& maxAABB, const Ray& ray, const Vector3& invDirection)
 		{
-			// Opitimization using slabtest
-			// Checks if ray hits the slab/bounding box (AABB), stops the calculation if ray doesn't hit this box
-			if (!SlabTest_TriangleMesh(mesh, ray))
-				return false;
-						
-			// Loop through all triangles in the mesh, and check if they hit the ray.
-		
-			const size_t trianglePositionsSize{ mesh.positions.size() };
-			const size_t meshIndicesSize{ mesh.indices.size() };
+			const float tx1 = (minAABB.x - ray.origin.x) * invDirection.x;
+			const float tx2 = (maxAABB.x - ray.origin.x) * invDirection.x;
+
+			float tmin = std::min(tx1, tx2);
+			float tmax = std::max(tx1, tx2);
+
+			const float ty1 = (minAABB.y - ray.origin.y) * invDirection.y;
+			const float ty2 = (maxAABB.y - ray.origin.y) * invDirection.y;
+
+			tmin = std::max(tmin, std::min(ty1, ty2));
+			tmax = std::min(tmax, std::max(ty1, ty2));
+
+			const float tz1 = (minAABB.z - ray.origin.z) * invDirection.z;
+			const float tz2 = (maxAABB.z - ray.origin.z) * invDirection.z;
+
+			tmin = std::max(tmin, std::min(tz1, tz2));
+			tmax = std::min(tmax, std::max(tz1, tz2));
+
+			if (tmax > 0 && tmax >= tmin && tmin < ray.max)
+				return tmin;
+			return FLT_MAX;
+		}
+
+		// Front to back traversal of the mesh's BVH, same specializations as the triangle loop below
+		template<TriangleIntersection variant, TriangleCullMode cullMode, bool ignoreHitRecord>
+		inline bool HitTest_TriangleMeshBVH(const TriangleMesh& mesh, Ray& ray, HitCandidate& hit)
+		{
+			const std::vector<BVHNode>& nodes{ mesh.bvh.GetNodes() };
+			const std::vector<uint32_t>& triangleIndices{ mesh.bvh.GetTriangleIndices() };
+			const std::pmr::vector<int>& indices{ mesh.GetIndices() };
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
 
 			Triangle triangle;
-			//HitRecord tempHitrecord{};
-			for (size_t i{}; i < meshIndicesSize; i += 3)
+			bool didHit{ false };
+
+			// Far children still to visit & where the ray enters them, at most one per level
+			uint32_t stack[BVH::MaxDepth];
+			float stackDistances[BVH::MaxDepth];
+			uint32_t stackSize{};
+
+			// The mesh's slab test already covers the root
+			uint32_t nodeIndex{};
+			for (;;)
 			{
-				triangle.v0 = mesh.transformedPositions[mesh.indices[i]];
-				triangle.v1 = mesh.transformedPositions[mesh.indices[i + 1]];
-				triangle.v2 = mesh.transformedPositions[mesh.indices[i + 2]];
-				triangle.normal = mesh.transformedNormals[i / 3];
-				triangle.cullMode = mesh.cullMode;
-				triangle.materialIndex = mesh.materialIndex;
+				const BVHNode& node{ nodes[nodeIndex] };
+				RAY_STATS_ADD(traversalSteps, 1);
+
+				if (node.IsLeaf())
+				{
+					RAY_STATS_ADD(triangleTests, node.triangleCount);
+					for (uint32_t i{ node.leftFirst }; i < node.leftFirst + node.triangleCount; ++i)
+					{
+						const uint32_t triangleIndex{ triangleIndices[i] };
+						triangle.v0 = mesh.transformedPositions[indices[3 * triangleIndex]];
+						triangle.v1 = mesh.transformedPositions[indices[3 * triangleIndex + 1]];
+						triangle.v2 = mesh.transformedPositions[indices[3 * triangleIndex + 2]];
+						if constexpr (variant == TriangleIntersection::EdgeFunction)
+							triangle.normal = mesh.transformedNormals[triangleIndex];
+
+						if (HitTest_Triangle<variant, cullMode, ignoreHitRecord>(triangle, ray, hit))
+						{
+							if constexpr (ignoreHitRecord)
+								return true;
+							hit.primitiveIndex = triangleIndex;
+							ray.max = hit.t;
+							didHit = true;
+						}
+					}
+				}
+				else
+				{
+					uint32_t nearIndex{ node.leftFirst };
+					uint32_t farIndex{ node.leftFirst + 1 };
+					float nearDistance{ SlabTest_AABB(nodes[nearIndex].minAABB, nodes[nearIndex].maxAABB, ray, invDirection) };
+					float farDistance{ SlabTest_AABB(nodes[farIndex].minAABB, nodes[farIndex].maxAABB, ray, invDirection) };
+					RAY_STATS_ADD(slabTests, 2);
+
+					if (farDistance < nearDistance)
+					{
+						std::swap(nearIndex, farIndex);
+						std::swap(nearDistance, farDistance);
+					}
 
+					if (nearDistance != FLT_MAX)
+					{
+						if (farDistance != FLT_MAX)
+						{
+							stack[stackSize] = farIndex;
+							stackDistances[stackSize] = farDistance;
+							++stackSize;
+						}
+						nodeIndex = nearIndex;
+						continue;
+					}
+				}
 
-				if (HitTest_Triangle(triangle, ray, hitRecord, ignoreHitRecord))
+				// Pop the next far child, skipping the ones that start beyond a hit found in the meantime
+				do
 				{
-					if (ignoreHitRecord)
+					if (stackSize == 0)
+						return didHit;
+					--stackSize;
+				} while (stackDistances[stackSize] >= ray.max);
+				nodeIndex = stack[stackSize];
+			}
+		}
+
+		// Traversal of a CompactMesh's wide BVH, children are decoded & tested one by one, the hit ones pushed far to near
+		template<TriangleIntersection variant, TriangleCullMode cullMode, bool ignoreHitRecord>
+		inline bool HitTest_TriangleMeshCompact(const TriangleMesh& mesh, Ray& ray, HitCandidate& hit)
+		{
+			const CompactMesh& compact{ mesh.GetCompact() };
+			const std::pmr::vector<CompactBVHNode>& nodes{ compact.GetNodes() };
+			const std::pmr::vector<uint32_t>& indices{ compact.GetIndices() };
+			const Vector3 invDirection{ 1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z };
+
+			Triangle triangle;
+			bool didHit{ false };
+
+			// Each visited node replaces itself with at most 4 children, with some room for the levels that split up oversized leaves
+			struct StackEntry
+			{
+				uint32_t index;
+				uint32_t triangleCount;
+				float distance;
+			};
+			StackEntry stack[CompactBVHNode::MaxChildren * BVH::MaxDepth];
+			uint32_t stackSize{ 1 };
+			stack[0] = { 0, 0, 0.f };
+
+			while (stackSize > 0)
+			{
+				const StackEntry entry{ stack[--stackSize] };
+				if (entry.distance >= ray.max)
+					continue;
+				RAY_STATS_ADD(traversalSteps, 1);
+
+				if (entry.triangleCount > 0)
+				{
+					RAY_STATS_ADD(triangleTests, entry.triangleCount);
+					for (uint32_t i{ entry.index }; i < entry.index + entry.triangleCount; ++i)
 					{
-						return true;
+						triangle.v0 = compact.GetPosition(indices[3 * i]);
+						triangle.v1 = compact.GetPosition(indices[3 * i + 1]);
+						triangle.v2 = compact.GetPosition(indices[3 * i + 2]);
+						if constexpr (variant == TriangleIntersection::EdgeFunction)
+							triangle.normal = compact.GetNormal(i);
+
+						if (HitTest_Triangle<variant, cullMode, ignoreHitRecord>(triangle, ray, hit))
+						{
+							if constexpr (ignoreHitRecord)
+								return true;
+							hit.primitiveIndex = i;
+							ray.max = hit.t;
+							didHit = true;
+						}
+					}
+					continue;
+				}
+
+				const CompactBVHNode& node{ nodes[entry.index] };
+				RAY_STATS_ADD(slabTests, node.childCount);
+
+				// Insertion sort on the way in, so the nearest child ends up on top
+				const uint32_t firstChild{ stackSize };
+				for (int child{}; child < node.childCount; ++child)
+				{
+					Vector3 minAABB{};
+					Vector3 maxAABB{};
+					node.GetChildBounds(child, minAABB, maxAABB);
+					const float distance{ SlabTest_AABB(minAABB, maxAABB, ray, invDirection) };
+					if (distance == FLT_MAX)
+						continue;
+
+					uint32_t slot{ stackSize++ };
+					while (slot > firstChild && stack[slot - 1].distance < distance)
+					{
+						stack[slot] = stack[slot - 1];
+						--slot;
 					}
-					ray.max = hitRecord.t;
+					stack[slot] = { node.childIndex[child], node.triangleCount[child], distance };
+				}
+			}
+			return didHit;
+		}
+
+		// Fully specialized triangle loop, one instance per algorithm, cull mode & query type
+		// Returns whether this mesh had a hit closer than ray.max, only t, the triangle & the barycentrics are written
+		template<TriangleIntersection variant, TriangleCullMode cullMode, bool ignoreHitRecord>
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, Ray& ray, HitCandidate& hit)
+		{
+			if (!mesh.GetCompact().Empty())
+				return HitTest_TriangleMeshCompact<variant, cullMode, ignoreHitRecord>(mesh, ray, hit);
+			if (!mesh.bvh.Empty())
+				return HitTest_TriangleMeshBVH<variant, cullMode, ignoreHitRecord>(mesh, ray, hit);
+
+			// Loop through all triangles in the mesh, and check if they hit the ray.
+			const std::pmr::vector<int>& indices{ mesh.GetIndices() };
+			const size_t meshIndicesSize{ indices.size() };
+
+			Triangle triangle;
+			bool didHit{ false };
+			for (size_t i{}; i < meshIndicesSize; i += 3)
+			{
+				triangle.v0 = mesh.transformedPositions[indices[i]];
+				triangle.v1 = mesh.transformedPositions[indices[i + 1]];
+				triangle.v2 = mesh.transformedPositions[indices[i + 2]];
+				if constexpr (variant == TriangleIntersection::EdgeFunction)
+					triangle.normal = mesh.transformedNormals[i / 3];
+
+				RAY_STATS_ADD(triangleTests, 1);
+				if (HitTest_Triangle<variant, cullMode, ignoreHitRecord>(triangle, ray, hit))
+				{
+					if constexpr (ignoreHitRecord)
+						return true;
+					hit.primitiveIndex = static_cast<uint32_t>(i / 3);
+					ray.max = hit.t;
+					didHit = true;
+				}
+			}
+			return didHit;
+		}
+
+		using TriangleMeshKernel = bool(*)(const TriangleMesh&, Ray&, HitCandidate&);
 
-				}				
+		// Indexed by [variant][cullMode][ignoreHitRecord]
+		inline constexpr TriangleMeshKernel TriangleMeshKernels[2][3][2]
+		{
+			{
+				{ &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::FrontFaceCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::FrontFaceCulling, true> },
+				{ &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::BackFaceCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::BackFaceCulling, true> },
+				{ &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::NoCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::MollerTrumbore, TriangleCullMode::NoCulling, true> }
+			},
+			{
+				{ &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::FrontFaceCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::FrontFaceCulling, true> },
+				{ &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::BackFaceCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::BackFaceCulling, true> },
+				{ &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::NoCulling, false>, &HitTest_TriangleMesh<TriangleIntersection::EdgeFunction, TriangleCullMode::NoCulling, true> }
 			}
-			return hitRecord.didHit;
+		};
+
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, Ray& ray, HitCandidate& hit, bool ignoreHitRecord = false)
+		{
+			// Opitimization using slabtest
+			// Checks if ray hits the slab/bounding box (AABB), stops the calculation if ray doesn't hit this box
+			RAY_STATS_ADD(slabTests, 1);
+			if (!SlabTest_TriangleMesh(mesh, ray))
+				return false;
+
+			RAY_STATS_ADD(traversalSteps, 1);
+
+			// Pick the specialized kernel once for the whole mesh
+			return TriangleMeshKernels[static_cast<int>(g_IntersectionVariants.triangle)][static_cast<int>(mesh.cullMode)][ignoreHitRecord](mesh, ray, hit);
 		}
 
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, Ray& ray)
 		{
-			HitRecord temp{};
+			HitCandidate temp{};
 			return HitTest_TriangleMesh(mesh, ray, temp, true);
 		}
+#pragma endregion
+#pragma region Hit Resolve
+		// Surface of the final closest hit, traversal only kept a HitCandidate
+		// Same math the hit tests used to do for every candidate, so the results don't change
+		inline void ResolveHit(const Plane& plane, const Ray& ray, const HitCandidate& hit, HitRecord& hitRecord)
+		{
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = plane.materialIndex;
+			hitRecord.normal = plane.normal;
+			hitRecord.origin = ray.origin + (hit.t * ray.direction);
+			hitRecord.t = hit.t;
+		}
 
-		
+		inline void ResolveHit(const Sphere& sphere, const Ray& ray, const HitCandidate& hit, HitRecord& hitRecord)
+		{
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = sphere.materialIndex;
+			hitRecord.origin = ray.origin + (ray.direction * hit.t);
+			hitRecord.normal = (hitRecord.origin - sphere.origin) / sphere.radius;
+			hitRecord.t = hit.t;
+		}
+
+		inline void ResolveHit(const TriangleMesh& mesh, const Ray& ray, const HitCandidate& hit, HitRecord& hitRecord)
+		{
+			hitRecord.didHit = true;
+			hitRecord.materialIndex = mesh.materialIndex;
+			hitRecord.origin = ray.origin + (ray.direction * hit.t);
+			const CompactMesh& compact{ mesh.GetCompact() };
+			hitRecord.normal = compact.Empty() ? mesh.transformedNormals[hit.primitiveIndex] : compact.GetNormal(hit.primitiveIndex);
+			hitRecord.t = hit.t;
+		}
 #pragma endregion
 	}
-
 	namespace LightUtils
 	{
 		//Direction from target to light
@@ -505,6 +791,21 @@ namespace dae
 
 			return true;
 		}
+
+		// For mesh buffers: parses into temporaries first, so the arena only sees one allocation per buffer at its final size
+		static bool ParseOBJ(const std::string& filename, std::pmr::vector<Vector3>& positions, std::pmr::vector<Vector3>& normals, std::pmr::vector<int>& indices)
+		{
+			std::vector<Vector3> parsedPositions{};
+			std::vector<Vector3> parsedNormals{};
+			std::vector<int> parsedIndices{};
+			if (!ParseOBJ(filename, parsedPositions, parsedNormals, parsedIndices))
+				return false;
+
+			positions.assign(parsedPositions.begin(), parsedPositions.end());
+			normals.assign(parsedNormals.begin(), parsedNormals.end());
+			indices.assign(parsedIndices.begin(), parsedIndices.end());
+			return true;
+		}
 #pragma warning(pop)
 	}
 }
\ No newline at end of file
@@ -1,53 +1,198 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <algorithm>
 #include <string>
 
+#include "SIMD.h"
+
 namespace dae
 {
 	struct Vector4;
-	struct Vector3
+
+	// Header-only so everything inlines into the hot loops
+	// Padded to 16 bytes & aligned so it can be loaded straight into an SSE register,
+	// the constexpr paths are used when evaluated at compile time, the SIMD paths at runtime
+	struct alignas(16) Vector3
 	{
 		float x{};
 		float y{};
 		float z{};
+		float padding{}; // Unused 4th lane, keeps loads/stores aligned
+
+		constexpr Vector3() = default;
+		constexpr Vector3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		constexpr Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
+		constexpr Vector3(const Vector4& v);
+		explicit Vector3(__m128 v) { simd::Store(&x, v); }
+
+		__m128 Load() const { return simd::Load(&x); }
+
+		float Magnitude() const noexcept
+		{
+			return sqrtf(SqrMagnitude());
+		}
+
+		constexpr float SqrMagnitude() const noexcept
+		{
+			return Dot(*this, *this);
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			*this /= m;
+			return m;
+		}
+
+		Vector3 Normalized() const
+		{
+			const __m128 v{ Load() };
+			return Vector3{ _mm_div_ps(v, _mm_sqrt_ps(simd::Splat(simd::Dot3(v, v)))) };
+		}
+
+		static constexpr float Dot(const Vector3& v1, const Vector3& v2) noexcept
+		{
+			if (std::is_constant_evaluated())
+				return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+			return simd::Dot3(v1.Load(), v2.Load());
+		}
+
+		static constexpr Vector3 Cross(const Vector3& v1, const Vector3& v2) noexcept
+		{
+			if (std::is_constant_evaluated())
+			{
+				return {
+					v1.y * v2.z - v1.z * v2.y,
+					v1.z * v2.x - v1.x * v2.z,
+					v1.x * v2.y - v1.y * v2.x
+				};
+			}
+			return Vector3{ simd::Cross3(v1.Load(), v2.Load()) };
+		}
+
+		static constexpr Vector3 Project(const Vector3& v1, const Vector3& v2)
+		{
+			return (v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static constexpr Vector3 Reject(const Vector3& v1, const Vector3& v2)
+		{
+			return (v1 - v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static constexpr Vector3 Reflect(const Vector3& v1, const Vector3& v2)
+		{
+			return v1 - (v2 * (2.f * Dot(v1, v2)));
+		}
+
+		static constexpr Vector3 Lico(float f1, const Vector3& v1, float f2, const Vector3& v2, float f3, const Vector3& v3)
+		{
+			return v1 * f1 + v2 * f2 + v3 * f3;
+		}
+
+		static constexpr Vector3 Min(const Vector3& v1, const Vector3& v2) noexcept
+		{
+			// Get smallest components of the 2 vectors and combine into one
+			if (std::is_constant_evaluated())
+				return { std::min(v1.x, v2.x), std::min(v1.y, v2.y), std::min(v1.z, v2.z) };
+			return Vector3{ _mm_min_ps(v1.Load(), v2.Load()) };
+		}
+
+		static constexpr Vector3 Max(const Vector3& v1, const Vector3& v2) noexcept
+		{
+			// Get biggest components of the 2 vectors and combine into one
+			if (std::is_constant_evaluated())
+				return { std::max(v1.x, v2.x), std::max(v1.y, v2.y), std::max(v1.z, v2.z) };
+			return Vector3{ _mm_max_ps(v1.Load(), v2.Load()) };
+		}
+
+		constexpr Vector4 ToPoint4() const noexcept;
+		constexpr Vector4 ToVector4() const noexcept;
+
+		std::string ToString() const
+		{
+			// Returns the vector as a string
+			std::string output{};
+			output += "(";
+			output += std::to_string(x) + ", ";
+			output += std::to_string(y) + ", ";
+			output += std::to_string(z) + ")";
+			return output;
+		}
+
+#pragma region Operator Overloads
+		constexpr Vector3 operator*(float scale) const
+		{
+			if (std::is_constant_evaluated())
+				return { x * scale, y * scale, z * scale };
+			return Vector3{ _mm_mul_ps(Load(), simd::Splat(scale)) };
+		}
+
+		constexpr Vector3 operator/(float scale) const
+		{
+			if (std::is_constant_evaluated())
+				return { x / scale, y / scale, z / scale };
+			return Vector3{ _mm_div_ps(Load(), simd::Splat(scale)) };
+		}
+
+		constexpr Vector3 operator+(const Vector3& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x + v.x, y + v.y, z + v.z };
+			return Vector3{ _mm_add_ps(Load(), v.Load()) };
+		}
 
-		Vector3() = default;
-		Vector3(float _x, float _y, float _z);
-		Vector3(const Vector3& from, const Vector3& to);
-		Vector3(const Vector4& v);
-
-		float Magnitude() const noexcept;
-		float SqrMagnitude() const noexcept;
-		float Normalize();
-		Vector3 Normalized() const;
-
-		static float Dot(const Vector3& v1, const Vector3& v2) noexcept;
-		static Vector3 Cross(const Vector3& v1, const Vector3& v2) noexcept;
-		static Vector3 Project(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reject(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reflect(const Vector3& v1, const Vector3& v2);
-		static Vector3 Lico(float f1, const Vector3& v1, float f2, const Vector3& v2, float f3, const Vector3& v3);
-
-		static Vector3 Min(const Vector3& v1, const Vector3& v2) noexcept;
-		static Vector3 Max(const Vector3& v1, const Vector3& v2) noexcept;
-		
-		Vector4 ToPoint4() const noexcept;
-		Vector4 ToVector4() const noexcept;
-
-		std::string ToString() const;
-
-		//Member Operators
-		Vector3 operator*(float scale) const;
-		Vector3 operator/(float scale) const;
-		Vector3 operator+(const Vector3& v) const;
-		Vector3 operator-(const Vector3& v) const;
-		Vector3 operator-() const;
-		//Vector3& operator-();
-		Vector3& operator+=(const Vector3& v);
-		Vector3& operator-=(const Vector3& v);
-		Vector3& operator/=(float scale);
-		Vector3& operator*=(float scale);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector3 operator-(const Vector3& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x - v.x, y - v.y, z - v.z };
+			return Vector3{ _mm_sub_ps(Load(), v.Load()) };
+		}
+
+		constexpr Vector3 operator-() const
+		{
+			return { -x, -y, -z };
+		}
+
+		constexpr Vector3& operator+=(const Vector3& v)
+		{
+			return *this = *this + v;
+		}
+
+		constexpr Vector3& operator-=(const Vector3& v)
+		{
+			return *this = *this - v;
+		}
+
+		constexpr Vector3& operator/=(float scale)
+		{
+			return *this = *this / scale;
+		}
+
+		constexpr Vector3& operator*=(float scale)
+		{
+			return *this = *this * scale;
+		}
+
+		constexpr float& operator[](int index)
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+
+		constexpr float operator[](int index) const
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+#pragma endregion
 
 		static const Vector3 UnitX;
 		static const Vector3 UnitY;
@@ -55,9 +200,31 @@ namespace dae
 		static const Vector3 Zero;
 	};
 
+	inline constexpr Vector3 Vector3::UnitX{ 1, 0, 0 };
+	inline constexpr Vector3 Vector3::UnitY{ 0, 1, 0 };
+	inline constexpr Vector3 Vector3::UnitZ{ 0, 0, 1 };
+	inline constexpr Vector3 Vector3::Zero{ 0, 0, 0 };
+
 	//Global Operators
-	inline Vector3 operator*(float scale, const Vector3& v)
+	constexpr Vector3 operator*(float scale, const Vector3& v)
+	{
+		return v * scale;
+	}
+}
+
+#include "Vector4.h"
+
+namespace dae
+{
+	constexpr Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	constexpr Vector4 Vector3::ToPoint4() const noexcept
+	{
+		return { x, y, z, 1 };
+	}
+
+	constexpr Vector4 Vector3::ToVector4() const noexcept
 	{
-		return { v.x * scale, v.y * scale, v.z * scale };
+		return { x, y, z, 0 };
 	}
 }
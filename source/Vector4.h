@@ -1,9 +1,15 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+
+#include "SIMD.h"
 
 namespace dae
 {
 	struct Vector3;
-	struct Vector4
+
+	// Header-only, 16 byte aligned so a Vector4 maps 1:1 onto an SSE register
+	struct alignas(16) Vector4
 	{
 		float x;
 		float y;
@@ -11,22 +17,95 @@ namespace dae
 		float w;
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
-
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector4 Normalized() const;
-
-		static float Dot(const Vector4& v1, const Vector4& v2);
-
-		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr Vector4(const Vector3& v, float _w);
+		explicit Vector4(__m128 v) { simd::Store(&x, v); }
+
+		__m128 Load() const { return simd::Load(&x); }
+
+		float Magnitude() const
+		{
+			return sqrtf(SqrMagnitude());
+		}
+
+		constexpr float SqrMagnitude() const
+		{
+			return Dot(*this, *this);
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			*this = *this * (1.f / m);
+			return m;
+		}
+
+		Vector4 Normalized() const
+		{
+			const __m128 v{ Load() };
+			return Vector4{ _mm_div_ps(v, _mm_sqrt_ps(simd::Splat(simd::Dot4(v, v)))) };
+		}
+
+		static constexpr float Dot(const Vector4& v1, const Vector4& v2)
+		{
+			if (std::is_constant_evaluated())
+				return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
+			return simd::Dot4(v1.Load(), v2.Load());
+		}
+
+#pragma region Operator Overloads
+		constexpr Vector4 operator*(float scale) const
+		{
+			if (std::is_constant_evaluated())
+				return { x * scale, y * scale, z * scale, w * scale };
+			return Vector4{ _mm_mul_ps(Load(), simd::Splat(scale)) };
+		}
+
+		constexpr Vector4 operator+(const Vector4& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x + v.x, y + v.y, z + v.z, w + v.w };
+			return Vector4{ _mm_add_ps(Load(), v.Load()) };
+		}
+
+		constexpr Vector4 operator-(const Vector4& v) const
+		{
+			if (std::is_constant_evaluated())
+				return { x - v.x, y - v.y, z - v.z, w - v.w };
+			return Vector4{ _mm_sub_ps(Load(), v.Load()) };
+		}
+
+		constexpr Vector4& operator+=(const Vector4& v)
+		{
+			return *this = *this + v;
+		}
+
+		constexpr float& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		constexpr float operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+#pragma endregion
 	};
 }
+
+#include "Vector3.h"
+
+namespace dae
+{
+	constexpr Vector4::Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+}
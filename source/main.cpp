@@ -5,12 +5,25 @@
 #undef main
 
 //Standard includes
+#include <cctype>
+#include <charconv>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "Benchmarks.h"
+#include "Regression.h"
+#include "Distributed.h"
+#include "Daemon.h"
+#include "Animation.h"
+#include "ImageWriter.h"
+#include "FramePipeline.h"
+#include "Tracing.h"
+#include "Utils.h"
 
 using namespace dae;
 
@@ -20,11 +33,216 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+void PrintMemoryReports(const Scene* pScene)
+{
+	std::cout << pScene->GetGeometryMemoryReport() << "\n";
+	for (const MeshMemoryReport& report : pScene->GetMeshMemoryReports())
+		std::cout << "  " << report << "\n";
+}
+
+// Value of an --name=value argument, or the fallback
+std::string GetOption(int argc, char* args[], const std::string& name, const std::string& fallback)
+{
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (arg.rfind(name + "=", 0) == 0)
+			return arg.substr(name.size() + 1);
+	}
+	return fallback;
+}
+
+// The whole text has to be the number, "12x" or "" are rejected instead of read as 12 or 0
+template<typename T>
+bool ParseNumber(const std::string& text, T& value)
+{
+	const char* pEnd{ text.data() + text.size() };
+	const auto [pLast, error]{ std::from_chars(text.data(), pEnd, value) };
+	return error == std::errc{} && pLast == pEnd;
+}
+
+// GetOption parsed as a number, reports which option was wrong
+template<typename T>
+bool GetNumberOption(int argc, char* args[], const std::string& name, const std::string& fallback, T& value)
+{
+	const std::string text{ GetOption(argc, args, name, fallback) };
+	if (ParseNumber(text, value))
+		return true;
+	std::cerr << "Invalid value for " << name << ": '" << text << "'\n";
+	return false;
+}
+
+int PrintUsage()
+{
+	std::cerr << "Usage: RayTracer [mode] [options]\n"
+		"  (no mode) opens the interactive window [--ray-stats=file]\n"
+		"  --bench-math | --bench-intersections | --bench-spheres | --bench-bvh\n"
+		"  --bench-views | --bench-paths | --bench-pathtracer | --bench-denoiser [--scene=Name]\n"
+		"  --regress [--update]\n"
+		"  --distributed [workers] [--scene=Name] [--kill-worker]\n"
+		"  --animate [--scene=Name] [--frames=0-59] [--fps=30] [--in-flight=N] [--output=prefix]\n"
+		"  --daemon [--socket=path]\n"
+		"  --submit --scene=Name --output=file.png [--width=640] [--height=480] [--priority=0] [--camera=x,y,z,yaw,pitch,fov] [--socket=path]\n"
+		"  --daemon-stats | --daemon-stop [--socket=path]\n"
+		"  --sphere=analytic|geometric --plane=optimized|default --triangle=edge|moller pick the intersection algorithms\n";
+	return 1;
+}
+
+void ParseIntersectionVariants(int argc, char* args[])
+{
+	// e.g. --sphere=analytic --plane=optimized --triangle=edge, anything else keeps the defaults
+	IntersectionVariants& variants{ GeometryUtils::g_IntersectionVariants };
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		if (arg == "--sphere=analytic")
+			variants.sphere = SphereIntersection::Analytic;
+		else if (arg == "--sphere=geometric")
+			variants.sphere = SphereIntersection::Geometric;
+		else if (arg == "--plane=optimized")
+			variants.plane = PlaneIntersection::Optimized;
+		else if (arg == "--plane=default")
+			variants.plane = PlaneIntersection::Default;
+		else if (arg == "--triangle=edge")
+			variants.triangle = TriangleIntersection::EdgeFunction;
+		else if (arg == "--triangle=moller")
+			variants.triangle = TriangleIntersection::MollerTrumbore;
+	}
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	ParseIntersectionVariants(argc, args);
+
+	//Headless modes
+	const std::string mode{ argc > 1 ? args[1] : "" };
+	if (mode == "--bench-math")
+	{
+		Benchmarks::RunMathBenchmark();
+		return 0;
+	}
+	if (mode == "--bench-intersections")
+	{
+		Benchmarks::RunIntersectionBenchmark();
+		return 0;
+	}
+	if (mode == "--bench-spheres")
+	{
+		Benchmarks::RunSphereGridBenchmark();
+		return 0;
+	}
+	if (mode == "--bench-bvh")
+	{
+		Benchmarks::RunBVHBenchmark();
+		return 0;
+	}
+	if (mode == "--bench-views")
+	{
+		Benchmarks::RunMultiViewBenchmark(GetOption(argc, args, "--scene", "W4_ReferenceScene"));
+		return 0;
+	}
+	if (mode == "--bench-paths")
+	{
+		Benchmarks::RunPathTerminationBenchmark(GetOption(argc, args, "--scene", "MirrorCorridor"));
+		return 0;
+	}
+	if (mode == "--bench-pathtracer")
+	{
+		Benchmarks::RunPathTracerBenchmark(GetOption(argc, args, "--scene", "W4_ReferenceScene"));
+		return 0;
+	}
+	if (mode == "--bench-denoiser")
+	{
+		Benchmarks::RunDenoiserBenchmark(GetOption(argc, args, "--scene", "W4_ReferenceScene"));
+		return 0;
+	}
+	if (mode == "--regress")
+	{
+		// --regress --update stores the current images & timings as the new references
+		Regression::Settings settings{};
+		settings.updateReferences = argc > 2 && std::string(args[2]) == "--update";
+		return Regression::Run(settings);
+	}
+	if (mode == "--distributed")
+	{
+		// --distributed [workers] [--scene=Name] [--kill-worker] renders one frame over local worker processes
+		Distributed::Settings settings{};
+		settings.sceneName = GetOption(argc, args, "--scene", settings.sceneName);
+		for (int i{ 2 }; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			if (arg == "--kill-worker")
+				settings.killWorkerAfterTiles = 32;
+			else if (std::isdigit(static_cast<unsigned char>(arg[0])) && !ParseNumber(arg, settings.workerCount))
+			{
+				std::cerr << "Invalid worker count: '" << arg << "'\n";
+				return PrintUsage();
+			}
+		}
+		return Distributed::RunCoordinator(settings);
+	}
+	if (mode == "--animate")
+	{
+		// --animate [--scene=Name] [--frames=0-59] [--fps=30] [--in-flight=N] [--output=prefix] renders numbered PNGs at a fixed time step
+		Animation::Settings settings{};
+		settings.sceneName = GetOption(argc, args, "--scene", settings.sceneName);
+		settings.outputPrefix = GetOption(argc, args, "--output", settings.outputPrefix);
+		if (!GetNumberOption(argc, args, "--fps", "30", settings.frameRate)
+			|| !GetNumberOption(argc, args, "--in-flight", "0", settings.framesInFlight))
+			return PrintUsage();
+		const std::string frames{ GetOption(argc, args, "--frames", "0-59") };
+		// A single number renders just that frame
+		const size_t dash{ frames.find('-') };
+		if (!ParseNumber(frames.substr(0, dash), settings.firstFrame)
+			|| !ParseNumber(dash == std::string::npos ? frames : frames.substr(dash + 1), settings.lastFrame))
+		{
+			std::cerr << "Invalid value for --frames: '" << frames << "'\n";
+			return PrintUsage();
+		}
+		return Animation::RenderBatch(settings);
+	}
+	if (mode == "--daemon")
+	{
+		// --daemon [--socket=path] keeps running until --daemon-stop
+		Daemon::Settings settings{};
+		settings.socketPath = GetOption(argc, args, "--socket", settings.socketPath);
+		return Daemon::Run(settings);
+	}
+	if (mode == "--submit")
+	{
+		// --submit --scene=Name --output=file.png [--width=640] [--height=480] [--priority=0] [--camera=x,y,z,yaw,pitch,fov] [--socket=path]
+		Daemon::JobRequest request{};
+		const std::string sceneName{ GetOption(argc, args, "--scene", "W4_ReferenceScene") };
+		const std::string outputFile{ GetOption(argc, args, "--output", "render.png") };
+		sceneName.copy(request.sceneName, sizeof(request.sceneName) - 1);
+		outputFile.copy(request.outputFile, sizeof(request.outputFile) - 1);
+		if (!GetNumberOption(argc, args, "--width", "640", request.width)
+			|| !GetNumberOption(argc, args, "--height", "480", request.height)
+			|| !GetNumberOption(argc, args, "--priority", "0", request.priority))
+			return PrintUsage();
+
+		std::istringstream camera{ GetOption(argc, args, "--camera", "") };
+		char separator{};
+		request.overrideCamera = static_cast<bool>(camera >> request.cameraOrigin.x >> separator >> request.cameraOrigin.y >> separator >> request.cameraOrigin.z
+			>> separator >> request.cameraYaw >> separator >> request.cameraPitch >> separator >> request.cameraFov);
+		return Daemon::Submit(GetOption(argc, args, "--socket", "raytracer.sock"), request);
+	}
+	if (mode == "--daemon-stats")
+		return Daemon::PrintStats(GetOption(argc, args, "--socket", "raytracer.sock"));
+	if (mode == "--daemon-stop")
+		return Daemon::Stop(GetOption(argc, args, "--socket", "raytracer.sock"));
+	if (mode == "--worker" && argc > 4)
+	{
+		// Spawned by --distributed, not meant to be started by hand
+		uint16_t port{};
+		uint32_t processIndex{};
+		if (!ParseNumber(args[3], port) || !ParseNumber(args[4], processIndex))
+		{
+			std::cerr << "Invalid worker port or index: '" << args[3] << "' '" << args[4] << "'\n";
+			return PrintUsage();
+		}
+		return Distributed::RunWorker(args[2], port, processIndex);
+	}
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -44,18 +262,35 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	const auto pImageWriter = new ImageWriter();
 
 	const auto pScene = new Scene_W4_ReferenceScene;
 	pScene->Initialize();
 	pRenderer->SetReflections(pScene->GetReflectionsEnabled());
+	PrintMemoryReports(pScene);
+
+	// Per frame traversal counters, only when asked for so debug builds don't leave a growing file behind
+	const std::string rayStatsFile{ GetOption(argc, args, "--ray-stats", "") };
+	if (!rayStatsFile.empty())
+		pRenderer->SetRayStatsFile(rayStatsFile);
+
+	// Update, trace & present overlap, F9 switches back to the sequential loop for comparison
+	const auto pPipeline = new FramePipeline(pRenderer, pScene);
 
 	//Start loop
 	pTimer->Start();
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool isRecording = false;
+	bool isTracing = false;
+	Tracing::SetThreadName("Main");
+	uint32_t screenshotNumber = 0;
+	uint32_t recordedFrameNumber = 0;
 	while (isLooping)
 	{
+		TRACE_SCOPE("Frame");
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -70,6 +305,18 @@ int main(int argc, char* args[])
 				{
 					case SDL_SCANCODE_X:
 						takeScreenshot = true;
+						break;
+					case SDL_SCANCODE_F1:
+						if (not e.key.repeat)
+						{
+							// The scene is about to be torn down, nothing may still be tracing it
+							pPipeline->Finish();
+							pScene->Reload();
+							pRenderer->SetReflections(pScene->GetReflectionsEnabled());
+							std::cout << "Scene reloaded\n";
+							PrintMemoryReports(pScene);
+						}
+						break;
 					case SDL_SCANCODE_F2:
 						if (not e.key.repeat)pRenderer->ToggleShadows();
 						break;
@@ -79,19 +326,86 @@ int main(int argc, char* args[])
 					case SDL_SCANCODE_F4:
 						if (not e.key.repeat) pRenderer->ToggleReflections();
 						break;
+					case SDL_SCANCODE_F5:
+						if (not e.key.repeat) pRenderer->CycleToneMapping();
+						break;
 					case SDL_SCANCODE_F6:
 						if (not e.key.repeat) pTimer->StartBenchmark();
 						break;
+					case SDL_SCANCODE_F7:
+						if (not e.key.repeat) pRenderer->ToggleSRGBEncoding();
+						break;
+					case SDL_SCANCODE_F8:
+						if (not e.key.repeat)
+						{
+							isRecording = !isRecording;
+							std::cout << (isRecording ? "Recording started\n" : "Recording stopped\n");
+						}
+						break;
+					case SDL_SCANCODE_F11:
+						if (not e.key.repeat)
+						{
+							isTracing = !isTracing;
+							if (isTracing)
+							{
+								Tracing::Start();
+								std::cout << "Tracing started\n";
+							}
+							else
+							{
+								// Let the frame in flight finish so its scopes make it into the file, Stop drops anything still open
+								pPipeline->Finish();
+								if (Tracing::Stop("trace.json"))
+									std::cout << "Tracing stopped, open trace.json in chrome://tracing or ui.perfetto.dev\n";
+								else
+									std::cout << "Something went wrong. Trace not saved!\n";
+							}
+						}
+						break;
+					case SDL_SCANCODE_F10:
+						if (not e.key.repeat) pRenderer->CycleHeatmapMode();
+						break;
+					case SDL_SCANCODE_P:
+						if (not e.key.repeat)
+						{
+							// The averages would mix both integrators otherwise
+							pRenderer->ToggleIntegrator();
+							pPipeline->ResetStats();
+						}
+						break;
+					case SDL_SCANCODE_N:
+						if (not e.key.repeat) pRenderer->ToggleDenoiser();
+						break;
+					case SDL_SCANCODE_T:
+						if (not e.key.repeat) pRenderer->ToggleTemporalAccumulation();
+						break;
+					case SDL_SCANCODE_B:
+						if (not e.key.repeat)
+						{
+							// 30 fps deadline, coarse first & refined where it matters most
+							pPipeline->SetTraceBudget(pPipeline->GetTraceBudget() > 0.f ? 0.f : 1000.f / 30.f);
+							pPipeline->ResetStats();
+							if (pPipeline->GetTraceBudget() > 0.f)
+								std::cout << "Trace budget: " << pPipeline->GetTraceBudget() << " ms\n";
+							else
+								std::cout << "Trace budget off\n";
+						}
+						break;
+					case SDL_SCANCODE_F9:
+						if (not e.key.repeat)
+						{
+							pPipeline->TogglePipelined();
+							pPipeline->ResetStats();
+							std::cout << (pPipeline->IsPipelined() ? "Pipelined frame loop\n" : "Sequential frame loop\n");
+						}
+						break;
 				}
 			}
 			
 		}
 
-		//--------- Update ---------
-		pScene->Update(pTimer);
-
-		//--------- Render ---------
-		pRenderer->Render(pScene);
+		//--------- Update, Render & Present ---------
+		pPipeline->Frame(pTimer);
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -100,21 +414,57 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "dFPS: " << pTimer->GetdFPS() << "\n";
+
+			const FramePipelineStats stats{ pPipeline->GetStats() };
+			std::cout << (pPipeline->IsPipelined() ? "Pipelined" : "Sequential")
+				<< " | frame: " << stats.frameTime << " ms, latency: " << stats.latency << " ms"
+				<< " | update: " << stats.updateTime << " ms, trace: " << stats.traceTime << " ms, present: " << stats.presentTime << " ms"
+				<< " | stall: " << stats.stallTime << " ms, overlap: " << stats.GetOverlap() << "x\n";
+			if (pRenderer->GetIntegrator() == Renderer::Integrator::PathTracer)
+				std::cout << "Path tracer | " << pRenderer->GetPathTracerSettings().samplesPerPixel << " spp, "
+					<< stats.samplesPerSecond / 1'000'000.f << " Msamples/s\n";
+			if (pRenderer->GetDenoiser())
+				std::cout << "Denoiser | " << stats.denoiseTime << " ms on top of the trace"
+					<< (pRenderer->GetDenoiserSettings().temporalAccumulation ? ", accumulating\n" : "\n");
+			if (stats.budgetedFrames > 0)
+				std::cout << "Budget " << pPipeline->GetTraceBudget() << " ms | coverage: " << stats.coverage * 100.f << "%, complete: "
+					<< stats.completeFrames << " of " << stats.budgetedFrames << " frames\n";
+			pPipeline->ResetStats();
 		}
 
-		//Save screenshot after full render
+		//Save screenshot after full render, encoding happens on the writer thread
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << "\n";
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << "\n";
+			TRACE_SCOPE("Screenshot");
+			pImageWriter->Enqueue(pRenderer->CaptureFrame(ImageFormat::PNG, ImageWriter::MakeFileName("Screenshot", screenshotNumber, ImageFormat::PNG)));
+			pImageWriter->Enqueue(pRenderer->CaptureFrame(ImageFormat::EXR, ImageWriter::MakeFileName("Screenshot", screenshotNumber, ImageFormat::EXR)));
+			std::cout << "Screenshot " << screenshotNumber << " queued!" << "\n";
+			++screenshotNumber;
 			takeScreenshot = false;
 		}
+
+		//Record every frame as a numbered image sequence
+		if (isRecording)
+		{
+			TRACE_SCOPE("CaptureFrame");
+			pImageWriter->Enqueue(pRenderer->CaptureFrame(ImageFormat::PNG, ImageWriter::MakeFileName("Frame", recordedFrameNumber, ImageFormat::PNG)));
+			++recordedFrameNumber;
+		}
 	}
+	pPipeline->Finish();
 	pTimer->Stop();
+	if (isTracing)
+		Tracing::Stop("trace.json");
+
+	//Make sure every queued image is on disk
+	pImageWriter->Flush();
+	std::cout << "Images written: " << pImageWriter->GetFramesWritten()
+		<< ", failed: " << pImageWriter->GetFramesFailed()
+		<< ", backpressure stalls: " << pImageWriter->GetBackpressureStalls() << "\n";
 
 	//Shutdown "framework"
+	delete pPipeline;
+	delete pImageWriter;
 	delete pScene;
 	delete pRenderer;
 	delete pTimer;